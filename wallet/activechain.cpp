@@ -0,0 +1,45 @@
+#include "activechain.h"
+
+#include "blockindex.h"
+
+#include <boost/thread/locks.hpp>
+
+void CActiveChain::SetTip(const CBlockIndexSmartPtr& pindexTip)
+{
+    boost::unique_lock<boost::shared_mutex> lock(mtx);
+
+    if (!pindexTip) {
+        vChain.clear();
+        return;
+    }
+    vChain.resize(pindexTip->nHeight + 1);
+    CBlockIndexSmartPtr pindex = pindexTip;
+    while (pindex && vChain[pindex->nHeight] != pindex) {
+        vChain[pindex->nHeight] = pindex;
+        pindex                  = boost::atomic_load(&pindex->pprev);
+    }
+}
+
+CBlockIndexSmartPtr CActiveChain::AtHeight(int nHeight) const
+{
+    boost::shared_lock<boost::shared_mutex> lock(mtx);
+
+    if (nHeight < 0 || nHeight >= static_cast<int>(vChain.size()))
+        return nullptr;
+    return vChain[nHeight];
+}
+
+int CActiveChain::Height() const
+{
+    boost::shared_lock<boost::shared_mutex> lock(mtx);
+
+    return static_cast<int>(vChain.size()) - 1;
+}
+
+bool CActiveChain::Contains(const CBlockIndex* pindex) const
+{
+    boost::shared_lock<boost::shared_mutex> lock(mtx);
+
+    return pindex && pindex->nHeight >= 0 && pindex->nHeight < static_cast<int>(vChain.size()) &&
+           vChain[pindex->nHeight].get() == pindex;
+}
@@ -0,0 +1,36 @@
+#ifndef ACTIVECHAIN_H
+#define ACTIVECHAIN_H
+
+#include "globals.h"
+
+#include <boost/thread/shared_mutex.hpp>
+#include <vector>
+
+/**
+ * The blocks of the best chain indexed by height, so that the block at a given height is found
+ * without walking the chain from the tip or from the genesis block.
+ */
+class CActiveChain
+{
+    std::vector<CBlockIndexSmartPtr> vChain;
+    mutable boost::shared_mutex      mtx;
+
+public:
+    /**
+     * Makes pindexTip the tip of the chain. Only the blocks above the fork with the previous tip
+     * are replaced, so moving the tip by a block or a short reorganization costs little. A null
+     * pindexTip empties the chain.
+     */
+    void SetTip(const CBlockIndexSmartPtr& pindexTip);
+
+    /** The block at nHeight in the chain, or null if there's none */
+    CBlockIndexSmartPtr AtHeight(int nHeight) const;
+
+    /** The height of the tip, or -1 if the chain is empty */
+    int Height() const;
+
+    /** Whether the block is part of the chain */
+    bool Contains(const CBlockIndex* pindex) const;
+};
+
+#endif // ACTIVECHAIN_H
@@ -0,0 +1,202 @@
+#ifndef ADDRESSINDEX_H
+#define ADDRESSINDEX_H
+
+#include "amount.h"
+#include "outpoint.h"
+#include "script.h"
+#include "serialize.h"
+#include "txout.h"
+#include "uint256.h"
+
+#include <map>
+#include <vector>
+
+class CTransaction;
+class CTxDB;
+class CTxDBChanges;
+
+/** An output that an input of a block spends, and the height of the block that created it */
+class CSpentOutput
+{
+public:
+    CTxOut       txout;
+    unsigned int nHeight;
+
+    CSpentOutput() : nHeight(0) {}
+    CSpentOutput(const CTxOut& txoutIn, unsigned int nHeightIn) : txout(txoutIn), nHeight(nHeightIn) {}
+};
+
+// heights and output numbers are serialized big endian in the keys of the address index, so that the
+// records of an address are sorted by them in the db
+template <typename Stream>
+void SerializeBigEndian32(Stream& s, uint32_t n)
+{
+    const unsigned char buf[4] = {
+        static_cast<unsigned char>(n >> 24), static_cast<unsigned char>(n >> 16),
+        static_cast<unsigned char>(n >> 8), static_cast<unsigned char>(n)};
+    s.write(reinterpret_cast<const char*>(buf), sizeof(buf));
+}
+
+template <typename Stream>
+uint32_t UnserializeBigEndian32(Stream& s)
+{
+    unsigned char buf[4];
+    s.read(reinterpret_cast<char*>(buf), sizeof(buf));
+    return (uint32_t(buf[0]) << 24) | (uint32_t(buf[1]) << 16) | (uint32_t(buf[2]) << 8) |
+           uint32_t(buf[3]);
+}
+
+/** An address in the address index: the hash of a public key or of a script */
+class CIndexedAddress
+{
+public:
+    enum Type : uint8_t
+    {
+        PUBKEYHASH = 1,
+        SCRIPTHASH = 2
+    };
+
+    uint8_t nAddrType;
+    uint160 hash;
+
+    CIndexedAddress() : nAddrType(0), hash(0) {}
+    CIndexedAddress(uint8_t nAddrTypeIn, const uint160& hashIn) : nAddrType(nAddrTypeIn), hash(hashIn)
+    {
+    }
+
+    IMPLEMENT_SERIALIZE(READWRITE(nAddrType); READWRITE(hash);)
+
+    /** The address an output pays to, if it's one the index has */
+    static bool FromScript(const CScript& scriptPubKey, CIndexedAddress& address);
+    static bool FromDestination(const CTxDestination& dest, CIndexedAddress& address);
+    CTxDestination GetDestination() const;
+
+    friend bool operator<(const CIndexedAddress& a, const CIndexedAddress& b)
+    {
+        return a.nAddrType < b.nAddrType || (a.nAddrType == b.nAddrType && a.hash < b.hash);
+    }
+    friend bool operator==(const CIndexedAddress& a, const CIndexedAddress& b)
+    {
+        return a.nAddrType == b.nAddrType && a.hash == b.hash;
+    }
+};
+
+/**
+ * Key of a record of the address index: an output paying to the address, or an input spending such an
+ * output. The value of the record is the change of the balance of the address, in satoshis.
+ */
+class CAddressIndexKey
+{
+public:
+    CIndexedAddress address;
+    unsigned int    nHeight;
+    uint256         txhash;
+    // the output number, or the input number if fSpending is set
+    unsigned int nIndex;
+    bool         fSpending;
+
+    CAddressIndexKey() : nHeight(0), txhash(0), nIndex(0), fSpending(false) {}
+    CAddressIndexKey(const CIndexedAddress& addressIn, unsigned int nHeightIn, const uint256& txhashIn,
+                     unsigned int nIndexIn, bool fSpendingIn)
+        : address(addressIn), nHeight(nHeightIn), txhash(txhashIn), nIndex(nIndexIn),
+          fSpending(fSpendingIn)
+    {
+    }
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return ::GetSerializeSize(address, nType, nVersion) + 4 + sizeof(txhash) + 4 + 1;
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        ::Serialize(s, address, nType, nVersion);
+        SerializeBigEndian32(s, nHeight);
+        ::Serialize(s, txhash, nType, nVersion);
+        SerializeBigEndian32(s, nIndex);
+        ::Serialize(s, static_cast<uint8_t>(fSpending), nType, nVersion);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        ::Unserialize(s, address, nType, nVersion);
+        nHeight = UnserializeBigEndian32(s);
+        ::Unserialize(s, txhash, nType, nVersion);
+        nIndex            = UnserializeBigEndian32(s);
+        uint8_t nSpending = 0;
+        ::Unserialize(s, nSpending, nType, nVersion);
+        fSpending = nSpending != 0;
+    }
+};
+
+/** Key of a record of the unspent outputs of an address; the value is a CAddressUnspentValue */
+class CAddressUnspentKey
+{
+public:
+    CIndexedAddress address;
+    uint256         txhash;
+    unsigned int    nIndex;
+
+    CAddressUnspentKey() : txhash(0), nIndex(0) {}
+    CAddressUnspentKey(const CIndexedAddress& addressIn, const uint256& txhashIn, unsigned int nIndexIn)
+        : address(addressIn), txhash(txhashIn), nIndex(nIndexIn)
+    {
+    }
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return ::GetSerializeSize(address, nType, nVersion) + sizeof(txhash) + 4;
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        ::Serialize(s, address, nType, nVersion);
+        ::Serialize(s, txhash, nType, nVersion);
+        SerializeBigEndian32(s, nIndex);
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        ::Unserialize(s, address, nType, nVersion);
+        ::Unserialize(s, txhash, nType, nVersion);
+        nIndex = UnserializeBigEndian32(s);
+    }
+};
+
+class CAddressUnspentValue
+{
+public:
+    CAmount nValue;
+    CScript scriptPubKey;
+    int     nHeight;
+
+    CAddressUnspentValue() : nValue(0), nHeight(0) {}
+    CAddressUnspentValue(CAmount nValueIn, const CScript& scriptPubKeyIn, int nHeightIn)
+        : nValue(nValueIn), scriptPubKey(scriptPubKeyIn), nHeight(nHeightIn)
+    {
+    }
+
+    IMPLEMENT_SERIALIZE(READWRITE(nValue); READWRITE(scriptPubKey); READWRITE(nHeight);)
+};
+
+/**
+ * Adds the changes of the address index that connecting the transactions of a block at nHeight makes
+ * to changes, or, unless fConnect is set, the changes that disconnecting them makes. spentOutputs has
+ * the outputs that the inputs of the transactions spend.
+ */
+void AddAddressIndexChanges(const std::vector<CTransaction>& vtx, int nHeight,
+                            const std::map<COutPoint, CSpentOutput>& spentOutputs, bool fConnect,
+                            CTxDBChanges& changes);
+
+/**
+ * Reads the outputs that the inputs of the transactions spend from the tx db. The transactions that
+ * create them must have tx indexes, so this can't be used for the inputs of a block being connected.
+ */
+bool ReadSpentOutputs(CTxDB& txdb, const std::vector<CTransaction>& vtx,
+                      std::map<COutPoint, CSpentOutput>& spentOutputs);
+
+#endif // ADDRESSINDEX_H
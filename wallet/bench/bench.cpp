@@ -0,0 +1,212 @@
+#include "bench.h"
+
+#include "json/json_spirit_value.h"
+#include "json/json_spirit_writer_template.h"
+
+#include <algorithm>
+#include <atomic>
+#include <boost/regex.hpp>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+
+static std::atomic<uint64_t> nAllocationCount{0};
+
+static void* CountedAlloc(std::size_t size)
+{
+    nAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size) { return CountedAlloc(size); }
+void* operator new[](std::size_t size) { return CountedAlloc(size); }
+void  operator delete(void* p) noexcept { std::free(p); }
+void  operator delete[](void* p) noexcept { std::free(p); }
+
+namespace benchmark {
+
+uint64_t GetAllocationCount() { return nAllocationCount.load(std::memory_order_relaxed); }
+
+// batches shorter than this are dominated by the cost of reading the clock, and aren't recorded
+static const Clock::duration MIN_SAMPLE_TIME = std::chrono::microseconds(10);
+
+static double ToNanos(Clock::duration d)
+{
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+}
+
+State::State(Clock::duration minTimeIn)
+    : minTime(minTimeIn), totalTime(Clock::duration::zero()), nIterations(0), nBatchSize(1),
+      nBatchEnd(0), nItemsPerIteration(1), nAllocationsStart(0), nAllocations(0)
+{
+}
+
+bool State::KeepRunning()
+{
+    if (nIterations == 0) {
+        nAllocationsStart = GetAllocationCount();
+        startTime         = Clock::now();
+        batchStartTime    = startTime;
+        nBatchEnd         = nBatchSize;
+    }
+    if (nIterations >= nBatchEnd && !EndBatch())
+        return false;
+    ++nIterations;
+    return true;
+}
+
+bool State::EndBatch()
+{
+    const Clock::time_point now     = Clock::now();
+    const Clock::duration   elapsed = now - batchStartTime;
+    totalTime                       = now - startTime;
+
+    if (elapsed >= MIN_SAMPLE_TIME)
+        vSamples.push_back(ToNanos(elapsed) / nBatchSize);
+    if (totalTime >= minTime && !vSamples.empty()) {
+        nAllocations = GetAllocationCount() - nAllocationsStart;
+        return false;
+    }
+
+    // a benchmark should be made of a few dozen batches at least
+    if (elapsed * 16 < minTime)
+        nBatchSize *= 2;
+    nBatchEnd      = nIterations + nBatchSize;
+    batchStartTime = Clock::now();
+    return true;
+}
+
+double State::GetTotalSeconds() const { return ToNanos(totalTime) / 1e9; }
+
+double State::GetAllocationsPerIteration() const
+{
+    return nIterations > 0 ? static_cast<double>(nAllocations) / nIterations : 0;
+}
+
+void ConsolePrinter::Header()
+{
+    fprintf(stdout, "%-32s %12s %10s %16s %16s %16s %14s\n", "# benchmark", "iterations", "items",
+            "min (ns)", "median (ns)", "max (ns)", "allocs/iter");
+}
+
+void ConsolePrinter::Print(const Result& result)
+{
+    if (!result.fSuccess) {
+        fprintf(stdout, "%-32s FAILED: %s\n", result.name.c_str(), result.strError.c_str());
+        return;
+    }
+    fprintf(stdout, "%-32s %12lu %10lu %16.1f %16.1f %16.1f %14.1f\n", result.name.c_str(),
+            static_cast<unsigned long>(result.nIterations),
+            static_cast<unsigned long>(result.nItemsPerIteration), result.nMinNanos,
+            result.nMedianNanos, result.nMaxNanos, result.nAllocsPerIteration);
+}
+
+void CsvPrinter::Header()
+{
+    fprintf(stdout,
+            "name,iterations,items_per_iteration,total_seconds,min_ns,median_ns,max_ns,"
+            "allocs_per_iteration,error\n");
+}
+
+void CsvPrinter::Print(const Result& result)
+{
+    std::string strError = result.strError;
+    std::replace(strError.begin(), strError.end(), ',', ';');
+    std::replace(strError.begin(), strError.end(), '\n', ' ');
+    fprintf(stdout, "%s,%lu,%lu,%.6f,%.1f,%.1f,%.1f,%.1f,%s\n", result.name.c_str(),
+            static_cast<unsigned long>(result.nIterations),
+            static_cast<unsigned long>(result.nItemsPerIteration), result.nTotalSeconds,
+            result.nMinNanos, result.nMedianNanos, result.nMaxNanos, result.nAllocsPerIteration,
+            strError.c_str());
+}
+
+void JsonPrinter::Print(const Result& result) { vResults.push_back(result); }
+
+void JsonPrinter::Footer()
+{
+    json_spirit::Array benchmarks;
+    for (const Result& result : vResults) {
+        json_spirit::Object obj;
+        obj.push_back(json_spirit::Pair("name", result.name));
+        obj.push_back(json_spirit::Pair("success", result.fSuccess));
+        if (!result.fSuccess) {
+            obj.push_back(json_spirit::Pair("error", result.strError));
+        } else {
+            obj.push_back(json_spirit::Pair("iterations", static_cast<int64_t>(result.nIterations)));
+            obj.push_back(json_spirit::Pair("items_per_iteration",
+                                            static_cast<int64_t>(result.nItemsPerIteration)));
+            obj.push_back(json_spirit::Pair("total_seconds", result.nTotalSeconds));
+            obj.push_back(json_spirit::Pair("min_ns", result.nMinNanos));
+            obj.push_back(json_spirit::Pair("median_ns", result.nMedianNanos));
+            obj.push_back(json_spirit::Pair("max_ns", result.nMaxNanos));
+            obj.push_back(json_spirit::Pair("allocs_per_iteration", result.nAllocsPerIteration));
+        }
+        benchmarks.push_back(obj);
+    }
+    json_spirit::Object root;
+    root.push_back(json_spirit::Pair("benchmarks", benchmarks));
+    fprintf(stdout, "%s\n", json_spirit::write_string(json_spirit::Value(root), true).c_str());
+}
+
+BenchRunner::BenchmarkMap& BenchRunner::Benchmarks()
+{
+    static BenchmarkMap benchmarks;
+    return benchmarks;
+}
+
+BenchRunner::BenchRunner(const std::string& name, const BenchFunction& func)
+{
+    Benchmarks().insert(std::make_pair(name, func));
+}
+
+std::vector<std::string> BenchRunner::List()
+{
+    std::vector<std::string> names;
+    for (const auto& p : Benchmarks())
+        names.push_back(p.first);
+    return names;
+}
+
+bool BenchRunner::RunAll(Printer& printer, const std::string& filter, Clock::duration minTime)
+{
+    const boost::regex reFilter(filter);
+
+    bool fAllSucceeded = true;
+    printer.Header();
+    for (const auto& p : Benchmarks()) {
+        if (!boost::regex_match(p.first, reFilter))
+            continue;
+
+        Result result{p.first, true, "", 0, 1, 0, 0, 0, 0, 0};
+        State  state(minTime);
+        try {
+            p.second(state);
+            if (state.GetSamples().empty())
+                throw std::runtime_error("the benchmark loop didn't run");
+        } catch (std::exception& ex) {
+            result.fSuccess = false;
+            result.strError = ex.what();
+        }
+
+        if (result.fSuccess) {
+            std::vector<double> vSamples = state.GetSamples();
+            std::sort(vSamples.begin(), vSamples.end());
+            result.nIterations         = state.GetIterations();
+            result.nItemsPerIteration  = state.GetItemsPerIteration();
+            result.nTotalSeconds       = state.GetTotalSeconds();
+            result.nMinNanos           = vSamples.front();
+            result.nMedianNanos        = vSamples[vSamples.size() / 2];
+            result.nMaxNanos           = vSamples.back();
+            result.nAllocsPerIteration = state.GetAllocationsPerIteration();
+        }
+        fAllSucceeded = fAllSucceeded && result.fSuccess;
+        printer.Print(result);
+        fflush(stdout);
+    }
+    printer.Footer();
+    return fAllSucceeded;
+}
+} // namespace benchmark
@@ -0,0 +1,142 @@
+#ifndef BENCH_BENCH_H
+#define BENCH_BENCH_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/preprocessor/cat.hpp>
+#include <boost/preprocessor/stringize.hpp>
+
+/**
+ * A small benchmark harness, in the spirit of the one of Bitcoin Core.
+ *
+ * A benchmark is a function that does its setup, then runs the code to be measured in a
+ * `while (state.KeepRunning())` loop, and is registered with BENCHMARK(function). Iterations are
+ * timed in batches that grow until a batch takes long enough to be measured reliably; the loop ends
+ * once the benchmark ran for the minimum time. The fastest, median and slowest batch, per
+ * iteration, are reported.
+ *
+ * Benchmarks that process many items per iteration (transactions of a block, keys of a batch) set
+ * the number of items, so results can be compared as a throughput too.
+ *
+ * The benchmark program replaces the global operator new to count heap allocations, and the number
+ * of allocations per iteration, from all threads, is reported along with the times.
+ */
+namespace benchmark {
+
+typedef std::chrono::steady_clock Clock;
+
+/** Number of heap allocations made by the program so far */
+uint64_t GetAllocationCount();
+
+class State
+{
+public:
+    explicit State(Clock::duration minTimeIn);
+
+    bool KeepRunning();
+
+    /** Number of items that a single iteration processes, 1 by default */
+    void SetItemsPerIteration(uint64_t nItems) { nItemsPerIteration = nItems; }
+
+    uint64_t GetIterations() const { return nIterations; }
+    uint64_t GetItemsPerIteration() const { return nItemsPerIteration; }
+    double   GetTotalSeconds() const;
+    double   GetAllocationsPerIteration() const;
+    /** Nanoseconds per iteration of every timed batch */
+    const std::vector<double>& GetSamples() const { return vSamples; }
+
+private:
+    Clock::duration   minTime;
+    Clock::time_point startTime;
+    Clock::time_point batchStartTime;
+    Clock::duration   totalTime;
+    uint64_t          nIterations;
+    uint64_t          nBatchSize;
+    uint64_t          nBatchEnd;
+    uint64_t          nItemsPerIteration;
+    uint64_t          nAllocationsStart;
+    uint64_t          nAllocations;
+
+    std::vector<double> vSamples;
+
+    bool EndBatch();
+};
+
+typedef std::function<void(State&)> BenchFunction;
+
+struct Result
+{
+    std::string name;
+    bool        fSuccess;
+    std::string strError;
+    uint64_t    nIterations;
+    uint64_t    nItemsPerIteration;
+    double      nTotalSeconds;
+    double      nMinNanos;
+    double      nMedianNanos;
+    double      nMaxNanos;
+    double      nAllocsPerIteration;
+};
+
+/** Writes results as they come; each kind has a human readable or a machine readable format */
+class Printer
+{
+public:
+    virtual ~Printer() = default;
+    virtual void Header() {}
+    virtual void Print(const Result& result) = 0;
+    virtual void Footer() {}
+};
+
+class ConsolePrinter : public Printer
+{
+public:
+    void Header() override;
+    void Print(const Result& result) override;
+};
+
+class CsvPrinter : public Printer
+{
+public:
+    void Header() override;
+    void Print(const Result& result) override;
+};
+
+/** All the results in a single JSON object, written when every benchmark is done */
+class JsonPrinter : public Printer
+{
+    std::vector<Result> vResults;
+
+public:
+    void Print(const Result& result) override;
+    void Footer() override;
+};
+
+class BenchRunner
+{
+    typedef std::map<std::string, BenchFunction> BenchmarkMap;
+    static BenchmarkMap& Benchmarks();
+
+public:
+    BenchRunner(const std::string& name, const BenchFunction& func);
+
+    static std::vector<std::string> List();
+
+    /**
+     * Runs the benchmarks whose name matches the regular expression filter, each for at least
+     * minTime. Returns false if any of them failed.
+     */
+    static bool RunAll(Printer& printer, const std::string& filter, Clock::duration minTime);
+};
+} // namespace benchmark
+
+// BENCHMARK(foo) registers the function foo as the benchmark "foo"
+#define BENCHMARK(n)                                                                                 \
+    benchmark::BenchRunner BOOST_PP_CAT(bench_, BOOST_PP_CAT(__LINE__, n))(BOOST_PP_STRINGIZE(n), n);
+
+#endif // BENCH_BENCH_H
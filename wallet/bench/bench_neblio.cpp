@@ -0,0 +1,68 @@
+#include "bench.h"
+
+#include "chainparams.h"
+#include "util.h"
+
+#include <boost/filesystem.hpp>
+#include <cstdio>
+#include <memory>
+
+static void PrintUsage()
+{
+    fprintf(stdout,
+            "Usage: neblio-bench [options]\n"
+            "\n"
+            "Options:\n"
+            "  -filter=<regex>       Run only the benchmarks whose name matches (default: .*)\n"
+            "  -mintime=<ms>         Minimum time every benchmark runs for (default: 1000)\n"
+            "  -printer=<format>     Output format: console, csv or json (default: console)\n"
+            "  -list                 List the benchmarks and exit\n"
+            "  -datadir=<dir>        Directory for the scratch tx db (default: a temporary one)\n");
+}
+
+int main(int argc, char* argv[])
+{
+    ParseParameters(argc, argv);
+    if (mapArgs.exists("-?") || mapArgs.exists("-help")) {
+        PrintUsage();
+        return 0;
+    }
+    if (GetBoolArg("-list")) {
+        for (const std::string& name : benchmark::BenchRunner::List())
+            fprintf(stdout, "%s\n", name.c_str());
+        return 0;
+    }
+
+    std::unique_ptr<benchmark::Printer> printer;
+    const std::string                   strPrinter = GetArg("-printer", "console");
+    if (strPrinter == "console") {
+        printer.reset(new benchmark::ConsolePrinter);
+    } else if (strPrinter == "csv") {
+        printer.reset(new benchmark::CsvPrinter);
+    } else if (strPrinter == "json") {
+        printer.reset(new benchmark::JsonPrinter);
+    } else {
+        fprintf(stderr, "Error: unknown printer %s\n", strPrinter.c_str());
+        return 1;
+    }
+
+    // the tx db benchmarks, and the debug log, go to a data dir that's removed when done
+    boost::filesystem::path tempDataDir;
+    if (!mapArgs.exists("-datadir")) {
+        tempDataDir = boost::filesystem::temp_directory_path() /
+                      boost::filesystem::unique_path("neblio-bench-%%%%-%%%%-%%%%");
+        boost::filesystem::create_directories(tempDataDir);
+        SoftSetArg("-datadir", tempDataDir.string());
+    }
+
+    SelectParams(NetworkType::Mainnet);
+
+    const bool fSuccess = benchmark::BenchRunner::RunAll(
+        *printer, GetArg("-filter", ".*"), std::chrono::milliseconds(GetArg("-mintime", 1000)));
+
+    if (!tempDataDir.empty()) {
+        boost::system::error_code ec;
+        boost::filesystem::remove_all(tempDataDir, ec);
+    }
+    return fSuccess ? 0 : 1;
+}
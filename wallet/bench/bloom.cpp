@@ -0,0 +1,43 @@
+#include "bench.h"
+#include "data.h"
+
+#include "bloom.h"
+
+static void BloomFilterInsertContains(benchmark::State& state)
+{
+    std::vector<unsigned char> vKey(32);
+    while (state.KeepRunning()) {
+        CBloomFilter filter(10000, 0.000001, 0, BLOOM_UPDATE_ALL);
+        for (unsigned i = 0; i < 1000; i++) {
+            vKey[0] = static_cast<unsigned char>(i);
+            vKey[1] = static_cast<unsigned char>(i >> 8);
+            filter.insert(vKey);
+        }
+        for (unsigned i = 0; i < 1000; i++) {
+            vKey[2] = static_cast<unsigned char>(i);
+            filter.contains(vKey);
+        }
+    }
+}
+
+// matching the transactions of a block against a wallet's filter, as done for SPV peers
+static void BloomFilterMatchTxs(benchmark::State& state)
+{
+    benchmark::data::SigningKey key;
+    benchmark::data::SigningKey otherKey;
+    const CTransaction txFrom = benchmark::data::MakeFundingTx(otherKey.scriptPubKey, 100, 1500000000);
+    std::vector<CTransaction> vtx;
+    for (unsigned i = 0; i < txFrom.vout.size(); i++)
+        vtx.push_back(benchmark::data::MakeSpendingTx(otherKey, txFrom, i, 1500000000));
+
+    CBloomFilter filter(100, 0.0001, 0, BLOOM_UPDATE_NONE);
+    filter.insert(std::vector<unsigned char>(key.keyID.begin(), key.keyID.end()));
+    state.SetItemsPerIteration(vtx.size());
+    while (state.KeepRunning()) {
+        for (const CTransaction& tx : vtx)
+            filter.IsRelevantAndUpdate(tx);
+    }
+}
+
+BENCHMARK(BloomFilterInsertContains);
+BENCHMARK(BloomFilterMatchTxs);
@@ -0,0 +1,51 @@
+#include "bench.h"
+#include "data.h"
+
+#include "blockindex.h"
+#include "txindex.h"
+#include "util.h"
+
+#include <boost/make_shared.hpp>
+#include <stdexcept>
+
+static const unsigned BLOCK_TXS = 500;
+
+// a block of transactions spending the outputs of a stored one, connected with fJustCheck so the tx
+// db is left as it is and the same block can be connected again; this runs all the checks of the
+// inputs, their scripts included, and reads the spent transaction from the db for every input
+static void ConnectBlockSynthetic(benchmark::State& state)
+{
+    const unsigned nTime = static_cast<unsigned>(GetAdjustedTime());
+
+    benchmark::data::TempTxDB   txdb;
+    benchmark::data::SigningKey key;
+
+    const unsigned     nFundingTime = nTime - 1000;
+    const CTransaction txFrom =
+        benchmark::data::MakeFundingTx(key.scriptPubKey, BLOCK_TXS, nFundingTime);
+    const CBlock     fundingBlock = benchmark::data::MakeBlock({txFrom}, uint256(1), nFundingTime);
+    const uint256    fundingKey   = fundingBlock.GetHash();
+    const CDiskTxPos posFrom(fundingKey, benchmark::data::GetTxOffsetInBlock(fundingBlock, 1));
+    if (!txdb.get().WriteBlock(fundingKey, fundingBlock) ||
+        !txdb.get().UpdateTxIndex(txFrom.GetHash(), CTxIndex(posFrom, txFrom.vout.size())) ||
+        !txdb.get().FlushCache(true))
+        throw std::runtime_error("failed to store the funding block");
+
+    std::vector<CTransaction> vtx;
+    for (unsigned i = 0; i < BLOCK_TXS; i++)
+        vtx.push_back(benchmark::data::MakeSpendingTx(key, txFrom, i, nTime));
+    CBlock        block     = benchmark::data::MakeBlock(vtx, fundingKey, nTime);
+    const uint256 hashBlock = block.GetHash();
+
+    CBlockIndexSmartPtr pindex = boost::make_shared<CBlockIndex>(hashBlock, block);
+    pindex->phashBlock         = &hashBlock;
+    pindex->nHeight            = 1;
+
+    state.SetItemsPerIteration(block.vtx.size());
+    while (state.KeepRunning()) {
+        if (!block.ConnectBlock(txdb.get(), pindex, true))
+            throw std::runtime_error("ConnectBlock failed");
+    }
+}
+
+BENCHMARK(ConnectBlockSynthetic);
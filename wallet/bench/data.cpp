@@ -0,0 +1,139 @@
+#include "data.h"
+
+#include "amount.h"
+#include "key.h"
+#include "util.h"
+#include "version.h"
+
+#include <stdexcept>
+
+namespace benchmark {
+namespace data {
+
+SigningKey::SigningKey()
+{
+    CKey key;
+    key.MakeNewKey(true);
+    keystore.AddKey(key);
+    keyID = key.GetPubKey().GetID();
+    scriptPubKey.SetDestination(keyID);
+}
+
+CTransaction MakeFundingTx(const CScript& scriptPubKey, unsigned nOutputs, unsigned nTime)
+{
+    CTransaction tx;
+    tx.nTime = nTime;
+    tx.vin.resize(1);
+    tx.vin[0].prevout   = COutPoint(uint256(1), 0);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vout.resize(nOutputs);
+    for (CTxOut& txout : tx.vout) {
+        txout.nValue       = COIN;
+        txout.scriptPubKey = scriptPubKey;
+    }
+    return tx;
+}
+
+CTransaction MakeSpendingTx(const SigningKey& key, const CTransaction& txFrom, unsigned nOut,
+                            unsigned nTime)
+{
+    CTransaction tx;
+    tx.nTime = nTime;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(txFrom.GetHash(), nOut);
+    tx.vout.resize(1);
+    tx.vout[0].nValue       = txFrom.vout[nOut].nValue - CENT;
+    tx.vout[0].scriptPubKey = key.scriptPubKey;
+    if (SignSignature(key.keystore, txFrom, tx, 0) == SignatureState::Failed)
+        throw std::runtime_error("failed to sign a synthetic transaction");
+    return tx;
+}
+
+CBlock MakeBlock(const std::vector<CTransaction>& vtx, const uint256& hashPrevBlock, unsigned nTime)
+{
+    CBlock block;
+    block.nVersion      = 6;
+    block.hashPrevBlock = hashPrevBlock;
+    block.nTime         = nTime;
+    block.nBits         = 0x1e0fffff;
+    block.nNonce        = 0;
+
+    CTransaction coinbase;
+    coinbase.nTime = nTime;
+    coinbase.vin.resize(1);
+    coinbase.vin[0].prevout.SetNull();
+    coinbase.vin[0].scriptSig = CScript() << static_cast<int64_t>(nTime) << OP_0;
+    coinbase.vout.resize(1);
+    coinbase.vout[0].SetEmpty();
+
+    block.vtx.push_back(coinbase);
+    block.vtx.insert(block.vtx.end(), vtx.begin(), vtx.end());
+    block.hashMerkleRoot = block.GetMerkleRoot();
+    return block;
+}
+
+unsigned GetTxOffsetInBlock(const CBlock& block, unsigned nTx)
+{
+    // the same layout ConnectBlock() assumes when it writes the tx index
+    unsigned nTxPos = ::GetSerializeSize(CBlock(), SER_DISK, CLIENT_VERSION) -
+                      (2 * GetSizeOfCompactSize(0)) + GetSizeOfCompactSize(block.vtx.size());
+    for (unsigned i = 0; i < nTx; i++)
+        nTxPos += ::GetSerializeSize(block.vtx[i], SER_DISK, CLIENT_VERSION);
+    return nTxPos;
+}
+
+TempTxDB::TempTxDB() : prevDbDir(CTxDB::DB_DIR)
+{
+    CTxDB::DB_DIR                         = "bench-txdb";
+    CTxDB::QuickSyncHigherControl_Enabled = false;
+    CTxDB::__deleteDb();
+    txdb.reset(new CTxDB);
+}
+
+TempTxDB::~TempTxDB()
+{
+    txdb->Close();
+    txdb.reset();
+    CTxDB::__deleteDb();
+    CTxDB::DB_DIR = prevDbDir;
+}
+
+static CTransaction TxFromHex(const std::string& hex)
+{
+    CDataStream  stream(ParseHex(hex), SER_NETWORK, PROTOCOL_VERSION);
+    CTransaction tx;
+    stream >> tx;
+    return tx;
+}
+
+CTransaction NTP1IssuanceTx()
+{
+    // 66216fa9cc0167568c3e5f8b66e7fe3690072f66a5f41df222327de7af10ff80, issuing NIBBL
+    return TxFromHex(
+        "010000001af29a5a012081139a3e0d764e9fb415bf1601c5bc24eba093c3f6a735aaa9d81d27d55dc5010000006"
+        "b483045022100ea2baf384bb518ed939a1dfc02df634be2186c5e35d79a09fc7c1f1379987bc102200e286cc382"
+        "9fbe574bda0cacfe8e918755574685bcb8af8a67b2d24f0087122d012103bd4c76349aae4b81011eddce127f36c"
+        "ffd6b7beaf84c80d5d4e6cf06e5c8596cffffffff0310270000000000001976a9144e2a50f7e8c58ff9a0175f95"
+        "616a1657b49a06a888ac1027000000000000456a434e5401014e4942424cab10c04e20e0aec73d58c8fbf2a9c26"
+        "a6dc3ed666c7b80fef215620c817703b1e5d8b1870211ce7cdf50718b4789245fb80f58992019002019f0e073eb"
+        "0b000000001976a9144e2a50f7e8c58ff9a0175f95616a1657b49a06a888ac00000000");
+}
+
+std::vector<std::pair<CTransaction, NTP1Transaction>> NTP1IssuanceInputs()
+{
+    const CTransaction txVin = TxFromHex(
+        "0100000089f3995a013458f5fa9bc91103a1dcdd6f1e582bc35e3ca513a924bad1e3098dd540fb4e03010000004"
+        "9483045022100e8dedce5f1950a07dbbd60dfb959e21113523b9d98df2fc1973e530beafd53b3022047450cd1a1"
+        "6d74f83c2ba769cb0a0ba28c848e440cc915d268218e7b8d0e541701ffffffff02306a04c2210000001976a91494"
+        "229f861ecf642374f132de7cc739f314ee4ada88ac008c8647000000001976a9144e2a50f7e8c58ff9a0175f956"
+        "16a1657b49a06a888ac00000000");
+
+    std::vector<std::pair<CTransaction, NTP1Transaction>> inputs{{txVin, NTP1Transaction()}};
+    for (auto&& input : inputs) {
+        input.second.readNTP1DataFromTx_minimal(input.first);
+    }
+    return inputs;
+}
+
+} // namespace data
+} // namespace benchmark
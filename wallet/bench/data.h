@@ -0,0 +1,68 @@
+#ifndef BENCH_DATA_H
+#define BENCH_DATA_H
+
+#include "block.h"
+#include "keystore.h"
+#include "ntp1/ntp1transaction.h"
+#include "script.h"
+#include "transaction.h"
+#include "txdb.h"
+
+#include <boost/filesystem/path.hpp>
+#include <memory>
+#include <utility>
+#include <vector>
+
+/** Synthetic transactions and blocks, built the same way on every run, and a scratch tx db */
+namespace benchmark {
+namespace data {
+
+/** A fresh key in a keystore, and the pay-to-pubkey-hash script that it can spend */
+struct SigningKey
+{
+    CBasicKeyStore keystore;
+    CKeyID         keyID;
+    CScript        scriptPubKey;
+
+    SigningKey();
+};
+
+/** A transaction with nOutputs outputs of 1 NEBL each to scriptPubKey, spending a made up input */
+CTransaction MakeFundingTx(const CScript& scriptPubKey, unsigned nOutputs, unsigned nTime);
+
+/** A signed transaction spending output nOut of txFrom back to the same key, minus a fee */
+CTransaction MakeSpendingTx(const SigningKey& key, const CTransaction& txFrom, unsigned nOut,
+                            unsigned nTime);
+
+/** A proof-of-work block with a coinbase followed by vtx, and its merkle root set */
+CBlock MakeBlock(const std::vector<CTransaction>& vtx, const uint256& hashPrevBlock, unsigned nTime);
+
+/**
+ * Offset of the transaction nTx of block in its serialization, which is what the tx index points to
+ * when the block is written to the tx db
+ */
+unsigned GetTxOffsetInBlock(const CBlock& block, unsigned nTx);
+
+/** An empty tx db in a directory of its own in the data dir, deleted along with the object */
+class TempTxDB
+{
+    boost::filesystem::path prevDbDir;
+    std::unique_ptr<CTxDB>  txdb;
+
+public:
+    TempTxDB();
+    ~TempTxDB();
+    TempTxDB(const TempTxDB&) = delete;
+    TempTxDB& operator=(const TempTxDB&) = delete;
+
+    CTxDB& get() { return *txdb; }
+};
+
+/** An NTP1 issuance transaction of mainnet, with the input it spends */
+CTransaction                                          NTP1IssuanceTx();
+std::vector<std::pair<CTransaction, NTP1Transaction>> NTP1IssuanceInputs();
+
+} // namespace data
+} // namespace benchmark
+
+#endif // BENCH_DATA_H
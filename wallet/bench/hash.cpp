@@ -0,0 +1,49 @@
+#include "bench.h"
+#include "data.h"
+
+#include "hash.h"
+#include "scrypt.h"
+
+// the proof-of-work hash of a header, as computed for every header and block received
+static void ScryptBlockHash(benchmark::State& state)
+{
+    CBlock block = benchmark::data::MakeBlock({}, uint256(1), 1500000000);
+    while (state.KeepRunning()) {
+        block.nNonce++;
+        scrypt_blockhash(CVOIDBEGIN(block.nVersion));
+    }
+}
+
+// the same, for a batch of headers hashed together in SIMD lanes
+static void ScryptBlockHashBatch(benchmark::State& state)
+{
+    static const std::size_t nHeaders = 16;
+    std::vector<CBlock>      vBlocks(nHeaders, benchmark::data::MakeBlock({}, uint256(1), 1500000000));
+    std::vector<const void*> vHeaders;
+    for (std::size_t i = 0; i < nHeaders; i++) {
+        vBlocks[i].nNonce = i;
+        vHeaders.push_back(CVOIDBEGIN(vBlocks[i].nVersion));
+    }
+    std::vector<uint256> vHashes(nHeaders);
+    state.SetItemsPerIteration(nHeaders);
+    while (state.KeepRunning()) {
+        for (CBlock& block : vBlocks)
+            block.nNonce += nHeaders;
+        scrypt_blockhash_batch(vHeaders.data(), vHashes.data(), nHeaders);
+    }
+}
+
+// the txid of a single input, single output transaction
+static void SerializeHashTx(benchmark::State& state)
+{
+    benchmark::data::SigningKey key;
+    const CTransaction txFrom = benchmark::data::MakeFundingTx(key.scriptPubKey, 1, 1500000000);
+    const CTransaction tx     = benchmark::data::MakeSpendingTx(key, txFrom, 0, 1500000000);
+    while (state.KeepRunning()) {
+        SerializeHash(tx);
+    }
+}
+
+BENCHMARK(ScryptBlockHash);
+BENCHMARK(ScryptBlockHashBatch);
+BENCHMARK(SerializeHashTx);
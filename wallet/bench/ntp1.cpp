@@ -0,0 +1,18 @@
+#include "bench.h"
+#include "data.h"
+
+#include "ntp1/ntp1transaction.h"
+
+// parsing an issuance and assigning the issued tokens to its outputs
+static void NTP1ReadDataFromTx(benchmark::State& state)
+{
+    const CTransaction tx = benchmark::data::NTP1IssuanceTx();
+    const std::vector<std::pair<CTransaction, NTP1Transaction>> inputs =
+        benchmark::data::NTP1IssuanceInputs();
+    while (state.KeepRunning()) {
+        NTP1Transaction ntp1tx;
+        ntp1tx.readNTP1DataFromTx(tx, inputs);
+    }
+}
+
+BENCHMARK(NTP1ReadDataFromTx);
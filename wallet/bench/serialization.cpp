@@ -0,0 +1,73 @@
+#include "bench.h"
+#include "data.h"
+
+#include "version.h"
+
+static const unsigned BLOCK_TXS = 1000;
+
+static CBlock MakeFullBlock()
+{
+    benchmark::data::SigningKey key;
+    const CTransaction txFrom = benchmark::data::MakeFundingTx(key.scriptPubKey, BLOCK_TXS, 1500000000);
+    std::vector<CTransaction> vtx;
+    for (unsigned i = 0; i < BLOCK_TXS; i++)
+        vtx.push_back(benchmark::data::MakeSpendingTx(key, txFrom, i, 1500000000));
+    return benchmark::data::MakeBlock(vtx, uint256(1), 1500000000);
+}
+
+static void SerializeTx(benchmark::State& state)
+{
+    benchmark::data::SigningKey key;
+    const CTransaction txFrom = benchmark::data::MakeFundingTx(key.scriptPubKey, 1, 1500000000);
+    const CTransaction tx     = benchmark::data::MakeSpendingTx(key, txFrom, 0, 1500000000);
+    CDataStream        ss(SER_NETWORK, PROTOCOL_VERSION);
+    while (state.KeepRunning()) {
+        ss.clear();
+        ss << tx;
+    }
+}
+
+static void DeserializeTx(benchmark::State& state)
+{
+    benchmark::data::SigningKey key;
+    const CTransaction txFrom = benchmark::data::MakeFundingTx(key.scriptPubKey, 1, 1500000000);
+    CDataStream        ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << benchmark::data::MakeSpendingTx(key, txFrom, 0, 1500000000);
+    const std::vector<char> vSerialized(ss.begin(), ss.end());
+
+    CTransaction tx;
+    while (state.KeepRunning()) {
+        CDataStream stream(vSerialized, SER_NETWORK, PROTOCOL_VERSION);
+        stream >> tx;
+    }
+}
+
+static void SerializeBlock(benchmark::State& state)
+{
+    const CBlock block = MakeFullBlock();
+    CDataStream  ss(SER_NETWORK, PROTOCOL_VERSION);
+    state.SetItemsPerIteration(block.vtx.size());
+    while (state.KeepRunning()) {
+        ss.clear();
+        ss << block;
+    }
+}
+
+static void DeserializeBlock(benchmark::State& state)
+{
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << MakeFullBlock();
+    const std::vector<char> vSerialized(ss.begin(), ss.end());
+
+    CBlock block;
+    state.SetItemsPerIteration(BLOCK_TXS + 1);
+    while (state.KeepRunning()) {
+        CDataStream stream(vSerialized, SER_NETWORK, PROTOCOL_VERSION);
+        stream >> block;
+    }
+}
+
+BENCHMARK(SerializeTx);
+BENCHMARK(DeserializeTx);
+BENCHMARK(SerializeBlock);
+BENCHMARK(DeserializeBlock);
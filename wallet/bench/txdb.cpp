@@ -0,0 +1,262 @@
+#include "bench.h"
+#include "data.h"
+
+#include "chainparams.h"
+#include "diskblockindex.h"
+#include "globals.h"
+#include "main.h"
+#include "txindex.h"
+
+#include <stdexcept>
+
+static const unsigned BATCH_SIZE      = 1000;
+static const unsigned LARGE_BLOCK_TXS = 4000;
+static const unsigned BLOCK_INDEX_SIZE = 20000;
+
+static CBlock MakeStoredBlock(const benchmark::data::SigningKey& key, unsigned nTxs)
+{
+    const CTransaction txFrom = benchmark::data::MakeFundingTx(key.scriptPubKey, nTxs, 1500000000);
+    std::vector<CTransaction> vtx;
+    for (unsigned i = 0; i < nTxs; i++)
+        vtx.push_back(benchmark::data::MakeSpendingTx(key, txFrom, i, 1500000000));
+    return benchmark::data::MakeBlock(vtx, uint256(1), 1500000000);
+}
+
+// tx indices of made up transactions, all pointing to the same place
+static std::vector<std::pair<uint256, CTxIndex>> MakeTxIndices()
+{
+    std::vector<std::pair<uint256, CTxIndex>> vTxIndices;
+    for (unsigned i = 0; i < BATCH_SIZE; i++) {
+        vTxIndices.push_back(std::make_pair(uint256(i + 1), CTxIndex(CDiskTxPos(uint256(1), 100), 2)));
+    }
+    return vTxIndices;
+}
+
+static void TxDBWriteBlock(benchmark::State& state)
+{
+    benchmark::data::TempTxDB   txdb;
+    benchmark::data::SigningKey key;
+    const CBlock                block = MakeStoredBlock(key, 100);
+    const uint256               hash  = block.GetHash();
+    while (state.KeepRunning()) {
+        txdb.get().TxnBegin();
+        if (!txdb.get().WriteBlock(hash, block))
+            throw std::runtime_error("WriteBlock failed");
+        txdb.get().TxnCommit();
+    }
+}
+
+static void TxDBReadBlock(benchmark::State& state)
+{
+    benchmark::data::TempTxDB   txdb;
+    benchmark::data::SigningKey key;
+    const CBlock                blockStored = MakeStoredBlock(key, 100);
+    if (!txdb.get().WriteBlock(blockStored.GetHash(), blockStored))
+        throw std::runtime_error("WriteBlock failed");
+
+    CBlock block;
+    while (state.KeepRunning()) {
+        if (!txdb.get().ReadBlock(blockStored.GetHash(), block))
+            throw std::runtime_error("ReadBlock failed");
+    }
+}
+
+// a single transaction out of a stored block, as read for the inputs of every transaction connected
+static void TxDBReadTx(benchmark::State& state)
+{
+    benchmark::data::TempTxDB   txdb;
+    benchmark::data::SigningKey key;
+    const CBlock                block = MakeStoredBlock(key, 100);
+    if (!txdb.get().WriteBlock(block.GetHash(), block))
+        throw std::runtime_error("WriteBlock failed");
+    const CDiskTxPos pos(block.GetHash(), benchmark::data::GetTxOffsetInBlock(block, 50));
+
+    CTransaction tx;
+    while (state.KeepRunning()) {
+        if (!txdb.get().ReadTx(pos, tx))
+            throw std::runtime_error("ReadTx failed");
+    }
+    if (tx.GetHash() != block.vtx[50].GetHash())
+        throw std::runtime_error("ReadTx read the wrong transaction");
+}
+
+// the first transaction of a block with thousands of them; the rest of the block must not be decoded
+static void TxDBReadTxLargeBlock(benchmark::State& state)
+{
+    benchmark::data::TempTxDB   txdb;
+    benchmark::data::SigningKey key;
+    const CBlock                block = MakeStoredBlock(key, LARGE_BLOCK_TXS);
+    if (!txdb.get().WriteBlock(block.GetHash(), block))
+        throw std::runtime_error("WriteBlock failed");
+    const CDiskTxPos pos(block.GetHash(), benchmark::data::GetTxOffsetInBlock(block, 1));
+
+    CTransaction tx;
+    while (state.KeepRunning()) {
+        if (!txdb.get().ReadTx(pos, tx))
+            throw std::runtime_error("ReadTx failed");
+    }
+    if (tx.GetHash() != block.vtx[1].GetHash())
+        throw std::runtime_error("ReadTx read the wrong transaction");
+}
+
+// every transaction of a block with thousands of them, read one by one in a single batch
+static void TxDBReadTxManyLargeBlock(benchmark::State& state)
+{
+    benchmark::data::TempTxDB   txdb;
+    benchmark::data::SigningKey key;
+    const CBlock                block = MakeStoredBlock(key, LARGE_BLOCK_TXS);
+    if (!txdb.get().WriteBlock(block.GetHash(), block))
+        throw std::runtime_error("WriteBlock failed");
+    std::vector<CDiskTxPos> vPositions;
+    for (unsigned i = 0; i < block.vtx.size(); i++)
+        vPositions.push_back(CDiskTxPos(block.GetHash(), benchmark::data::GetTxOffsetInBlock(block, i)));
+
+    std::vector<boost::optional<CTransaction>> vRead;
+    state.SetItemsPerIteration(vPositions.size());
+    while (state.KeepRunning()) {
+        if (!txdb.get().ReadTxMany(vPositions, vRead))
+            throw std::runtime_error("ReadTxMany failed");
+    }
+    if (!vRead.back() || vRead.back()->GetHash() != block.vtx.back().GetHash())
+        throw std::runtime_error("ReadTxMany read the wrong transaction");
+}
+
+// tx index updates of a block, written through the tx db cache to the db
+static void TxDBUpdateTxIndex(benchmark::State& state)
+{
+    benchmark::data::TempTxDB                       txdb;
+    const std::vector<std::pair<uint256, CTxIndex>> vTxIndices = MakeTxIndices();
+    state.SetItemsPerIteration(vTxIndices.size());
+    while (state.KeepRunning()) {
+        for (const auto& p : vTxIndices) {
+            if (!txdb.get().UpdateTxIndex(p.first, p.second))
+                throw std::runtime_error("UpdateTxIndex failed");
+        }
+        if (!txdb.get().FlushCache(true))
+            throw std::runtime_error("FlushCache failed");
+    }
+}
+
+// tx indices read in a batch from the db; the cache is emptied after every batch
+static void TxDBReadTxIndex(benchmark::State& state)
+{
+    benchmark::data::TempTxDB                       txdb;
+    const std::vector<std::pair<uint256, CTxIndex>> vTxIndices = MakeTxIndices();
+    std::vector<uint256>                            vHashes;
+    for (const auto& p : vTxIndices) {
+        txdb.get().UpdateTxIndex(p.first, p.second);
+        vHashes.push_back(p.first);
+    }
+    txdb.get().FlushCache(true);
+
+    std::vector<boost::optional<CTxIndex>> vRead;
+    state.SetItemsPerIteration(vHashes.size());
+    while (state.KeepRunning()) {
+        if (!txdb.get().ReadTxIndexMany(vHashes, vRead))
+            throw std::runtime_error("ReadTxIndexMany failed");
+        txdb.get().FlushCache(true);
+    }
+}
+
+// a chain of proof-of-work block index entries with their trust stored, as LoadBlockIndex finds them
+// after its first run; the stake modifier checksums at the checkpoint heights match the checkpoints
+static std::vector<CDiskBlockIndex> MakeBlockIndexEntries()
+{
+    const MapStakeModifierCheckpoints& checkpoints = Params().StakeModifierCheckpoints();
+    std::vector<CDiskBlockIndex>       entries(BLOCK_INDEX_SIZE);
+    for (unsigned i = 0; i < entries.size(); i++) {
+        CDiskBlockIndex& entry = entries[i];
+        entry.nHeight          = i;
+        entry.nTime            = 1500000000 + 120 * i;
+        entry.nBits            = 0x1e0fffff;
+        entry.nNonce           = i;
+        entry.hashPrev         = (i > 0 ? entries[i - 1].GetBlockHash() : 0);
+        entry.nChainTrust      = i + 1;
+
+        const auto it                = checkpoints.find(i);
+        entry.nStakeModifierChecksum = (it != checkpoints.cend() ? it->second : i);
+    }
+    for (unsigned i = 0; i + 1 < entries.size(); i++)
+        entries[i].hashNext = entries[i + 1].GetBlockHash();
+    return entries;
+}
+
+static std::vector<std::string> SerializeBlockIndexEntries()
+{
+    std::vector<std::string> vRecords;
+    for (const CDiskBlockIndex& entry : MakeBlockIndexEntries()) {
+        CDataStream ss(SER_DISK, CLIENT_VERSION);
+        ss << entry << CDiskBlockIndexTrust(entry);
+        vRecords.push_back(ss.str());
+    }
+    return vRecords;
+}
+
+// all of LoadBlockIndex, from the db to mapBlockIndex; the index loaded by the previous iteration is
+// dropped first
+static void TxDBLoadBlockIndex(benchmark::State& state)
+{
+    benchmark::data::TempTxDB txdb;
+    for (const CDiskBlockIndex& entry : MakeBlockIndexEntries()) {
+        if (!txdb.get().WriteBlockIndex(entry) || !txdb.get().FlushCache(false))
+            throw std::runtime_error("WriteBlockIndex failed");
+    }
+    if (!txdb.get().WriteBlockIndexTrustHeight(BLOCK_INDEX_SIZE - 1) || !txdb.get().FlushCache(true))
+        throw std::runtime_error("WriteBlockIndexTrustHeight failed");
+
+    state.SetItemsPerIteration(BLOCK_INDEX_SIZE);
+    while (state.KeepRunning()) {
+        mapBlockIndex.clear();
+        setStakeSeen.clear();
+        if (!txdb.get().LoadBlockIndex())
+            throw std::runtime_error("LoadBlockIndex failed");
+    }
+    const std::size_t nLoaded = mapBlockIndex.size();
+    mapBlockIndex.clear();
+    setStakeSeen.clear();
+    if (nLoaded != BLOCK_INDEX_SIZE)
+        throw std::runtime_error("LoadBlockIndex loaded the wrong number of entries");
+}
+
+// block index records unserialized the way LoadBlockIndex did before CDataStreamView: every value
+// copied into a string, and that into a CDataStream
+static void UnserializeBlockIndexCopy(benchmark::State& state)
+{
+    const std::vector<std::string> vRecords = SerializeBlockIndexEntries();
+    CDiskBlockIndex                diskindex;
+    CDiskBlockIndexTrust           trust;
+    state.SetItemsPerIteration(vRecords.size());
+    while (state.KeepRunning()) {
+        for (const std::string& record : vRecords) {
+            const std::string value(record.data(), record.size());
+            CDataStream       ss(value.data(), value.data() + value.size(), SER_DISK, CLIENT_VERSION);
+            ss >> diskindex >> trust;
+        }
+    }
+}
+
+// the same records unserialized in place, as LoadBlockIndex does from the memory map
+static void UnserializeBlockIndexView(benchmark::State& state)
+{
+    const std::vector<std::string> vRecords = SerializeBlockIndexEntries();
+    CDiskBlockIndex                diskindex;
+    CDiskBlockIndexTrust           trust;
+    state.SetItemsPerIteration(vRecords.size());
+    while (state.KeepRunning()) {
+        for (const std::string& record : vRecords) {
+            CDataStreamView ss(record.data(), record.data() + record.size(), SER_DISK, CLIENT_VERSION);
+            ss >> diskindex >> trust;
+        }
+    }
+}
+
+BENCHMARK(TxDBWriteBlock);
+BENCHMARK(TxDBReadBlock);
+BENCHMARK(TxDBReadTx);
+BENCHMARK(TxDBReadTxLargeBlock);
+BENCHMARK(TxDBReadTxManyLargeBlock);
+BENCHMARK(TxDBUpdateTxIndex);
+BENCHMARK(TxDBReadTxIndex);
+BENCHMARK(TxDBLoadBlockIndex);
+BENCHMARK(UnserializeBlockIndexCopy);
+BENCHMARK(UnserializeBlockIndexView);
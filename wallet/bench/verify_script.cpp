@@ -0,0 +1,37 @@
+#include "bench.h"
+#include "data.h"
+
+#include "script.h"
+
+#include <stdexcept>
+
+// a full ECDSA verification of a pay-to-pubkey-hash input; erasing cached signatures (as block
+// connection does) means nothing is ever found in, or added to, the signature cache
+static void VerifySignatureP2PKH(benchmark::State& state)
+{
+    benchmark::data::SigningKey key;
+    const CTransaction txFrom = benchmark::data::MakeFundingTx(key.scriptPubKey, 1, 1500000000);
+    const CTransaction txTo   = benchmark::data::MakeSpendingTx(key, txFrom, 0, 1500000000);
+    while (state.KeepRunning()) {
+        if (VerifySignature(txFrom, txTo, 0, true, true, 0, true).isErr())
+            throw std::runtime_error("signature verification failed");
+    }
+}
+
+// the same input, with its signature found in the signature cache after the first verification,
+// like transactions of a block that were already accepted to the mempool
+static void SignatureCacheHit(benchmark::State& state)
+{
+    benchmark::data::SigningKey key;
+    const CTransaction txFrom = benchmark::data::MakeFundingTx(key.scriptPubKey, 1, 1500000000);
+    const CTransaction txTo   = benchmark::data::MakeSpendingTx(key, txFrom, 0, 1500000000);
+    if (VerifySignature(txFrom, txTo, 0, true, true, 0).isErr())
+        throw std::runtime_error("signature verification failed");
+    while (state.KeepRunning()) {
+        if (VerifySignature(txFrom, txTo, 0, true, true, 0).isErr())
+            throw std::runtime_error("signature verification failed");
+    }
+}
+
+BENCHMARK(VerifySignatureP2PKH);
+BENCHMARK(SignatureCacheHit);
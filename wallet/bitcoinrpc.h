@@ -31,6 +31,7 @@ enum HTTPStatusCode
     HTTP_FORBIDDEN             = 403,
     HTTP_NOT_FOUND             = 404,
     HTTP_INTERNAL_SERVER_ERROR = 500,
+    HTTP_SERVICE_UNAVAILABLE   = 503,
 };
 
 // Bitcoin RPC error codes
@@ -88,6 +89,13 @@ enum RPCErrorCode
 
 };
 
+/** Threads that run RPC requests */
+static const int DEFAULT_RPC_THREADS = 4;
+/** Requests that may wait for a free RPC thread before new ones are turned away */
+static const int DEFAULT_RPC_WORK_QUEUE = 16;
+/** Seconds an idle keep-alive RPC connection stays open */
+static const int DEFAULT_RPC_SERVER_TIMEOUT = 30;
+
 extern boost::atomic_bool fRpcListening;
 
 json_spirit::Object JSONRPCError(int code, const std::string& message);
@@ -125,6 +133,7 @@ public:
     rpcfn_type  actor;
     bool        okSafeMode;
     bool        unlocked;
+    bool        readonly; // runs in parallel with the other read-only requests of a batch
 };
 
 /**
@@ -290,6 +299,13 @@ extern json_spirit::Value getblock(const json_spirit::Array& params, bool fHelp)
 extern json_spirit::Value getblockbynumber(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value gettxout(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value exportblockchain(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getaddresstxids(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getaddressdeltas(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getaddressbalance(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getaddressutxos(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getntp1tokeninfo(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getntp1tokenholders(const json_spirit::Array& params, bool fHelp);
+extern json_spirit::Value getntp1addressbalances(const json_spirit::Array& params, bool fHelp);
 extern json_spirit::Value waitforblockheight(const json_spirit::Array& params, bool fHelp);
 
 std::vector<NTP1SendTokensOneRecipientData>
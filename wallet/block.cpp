@@ -1,12 +1,17 @@
 #include "block.h"
 
 #include "NetworkForks.h"
+#include "activechain.h"
+#include "addressindex.h"
 #include "blockindex.h"
+#include "blockindexpool.h"
 #include "blocklocator.h"
 #include "checkpoints.h"
+#include "checkqueue.h"
 #include "kernel.h"
 #include "main.h"
 #include "merkle.h"
+#include "ntp1/ntp1index.h"
 #include "ntp1/ntp1transaction.h"
 #include "txmempool.h"
 #include "ui_interface.h"
@@ -119,7 +124,27 @@ void CBlock::SetNull()
     nDoS = 0;
 }
 
-uint256 CBlock::GetPoWHash() const { return scrypt_blockhash(CVOIDBEGIN(nVersion)); }
+uint256 CBlock::GetPoWHash() const
+{
+    return cachedHash.Get(CVOIDBEGIN(nVersion), scrypt_blockhash);
+}
+
+void CBlock::PrecomputeHashes(const std::vector<CBlock>& blocks)
+{
+    std::vector<const CBlock*> vToHash;
+    std::vector<const void*>   vHeaders;
+    for (const CBlock& block : blocks) {
+        if (!block.cachedHash.IsCurrent(CVOIDBEGIN(block.nVersion))) {
+            vToHash.push_back(&block);
+            vHeaders.push_back(CVOIDBEGIN(block.nVersion));
+        }
+    }
+    std::vector<uint256> vHashes(vHeaders.size());
+    scrypt_blockhash_batch(vHeaders.data(), vHashes.data(), vHeaders.size());
+    for (std::size_t i = 0; i < vToHash.size(); i++) {
+        vToHash[i]->cachedHash.Set(vHeaders[i], vHashes[i]);
+    }
+}
 
 int64_t CBlock::GetBlockTime() const { return (int64_t)nTime; }
 
@@ -134,6 +159,27 @@ void CBlock::UpdateTime(const CBlockIndex* /*pindexPrev*/)
 
 bool CBlock::DisconnectBlock(CTxDB& txdb, CBlockIndexSmartPtr& pindex)
 {
+    // the address index brings back the outputs the block spent, which are read before their tx
+    // indexes are changed
+    if (fAddressIndex) {
+        std::map<COutPoint, CSpentOutput> spentOutputs;
+        if (!ReadSpentOutputs(txdb, vtx, spentOutputs))
+            return error("DisconnectBlock() : Failed to read the spent outputs for the address index");
+        CTxDBChanges changes;
+        AddAddressIndexChanges(vtx, pindex->nHeight, spentOutputs, false, changes);
+        txdb.AddAddressIndexChanges(std::move(changes));
+    }
+    // the NTP1 data of the transactions is kept in the db after they're disconnected
+    if (fNTP1Index) {
+        std::map<uint256, NTP1Transaction> ntp1txs;
+        if (!ReadNTP1IndexTxs(txdb, vtx, ntp1txs))
+            return error("DisconnectBlock() : Failed to read the NTP1 data for the NTP1 index");
+        CTxDBChanges changes;
+        if (!AddNTP1IndexChanges(txdb, vtx, pindex->nHeight, ntp1txs, false, changes))
+            return error("DisconnectBlock() : Failed to update the NTP1 index");
+        txdb.AddNTP1IndexChanges(std::move(changes));
+    }
+
     // Disconnect in reverse order
     for (int i = vtx.size() - 1; i >= 0; i--)
         if (!vtx[i].DisconnectInputs(txdb))
@@ -502,6 +548,26 @@ bool CBlock::CheckBIP30Attack(CTxDB& txdb, const uint256& hashTx)
     return true;
 }
 
+// adds the outputs that the inputs of tx spend to spentOutputs, for the address index
+static void AddSpentOutputs(const CTransaction& tx, const MapPrevTx& mapInputs,
+                            const CBlockIndexSmartPtr&         pindex,
+                            std::map<COutPoint, CSpentOutput>& spentOutputs)
+{
+    for (const CTxIn& txin : tx.vin) {
+        const auto it = mapInputs.find(txin.prevout.hash);
+        if (it == mapInputs.cend() || txin.prevout.n >= it->second.second.vout.size())
+            continue;
+        // outputs spent in the same block are in a block that isn't in the main chain yet
+        const CDiskTxPos& pos     = it->second.first.pos;
+        unsigned int      nHeight = pindex->nHeight;
+        if (pos.nBlockPos != pindex->blockKeyInDB) {
+            const auto mi = mapBlockIndex.find(pos.nBlockPos);
+            nHeight       = (mi != mapBlockIndex.cend() ? mi->second->nHeight : 0);
+        }
+        spentOutputs[txin.prevout] = CSpentOutput(it->second.second.vout[txin.prevout.n], nHeight);
+    }
+}
+
 bool CBlock::ConnectBlock(CTxDB& txdb, const CBlockIndexSmartPtr& pindex, bool fJustCheck)
 {
     printf("Connecting block: %s\n", this->GetHash().ToString().c_str());
@@ -532,12 +598,18 @@ bool CBlock::ConnectBlock(CTxDB& txdb, const CBlockIndexSmartPtr& pindex, bool f
 
     std::map<uint256, std::vector<std::pair<CTransaction, NTP1Transaction>>> mapQueuedNTP1Inputs;
 
+    // the outputs spent by the block, for the address index
+    std::map<COutPoint, CSpentOutput> mapSpentOutputs;
+
     unsigned int nSigOps = 0;
 
     // map of issued token names in this block vs token hashes
     // this is used to prevent duplicate token names
     std::unordered_map<std::string, uint256> issuedTokensSymbolsInThisBlock;
 
+    // script checks are handed to the worker threads (if any) while the rest of the block is processed
+    CCheckQueueControl<CScriptCheck> control(nScriptCheckThreads ? &scriptcheckqueue : nullptr);
+
     for (CTransaction& tx : vtx) {
         uint256 hashTx = tx.GetHash();
 
@@ -567,6 +639,9 @@ bool CBlock::ConnectBlock(CTxDB& txdb, const CBlockIndexSmartPtr& pindex, bool f
             if (!tx.FetchInputs(txdb, mapQueuedChanges, true, false, mapInputs, fInvalid))
                 return false;
 
+            if (fAddressIndex && !fJustCheck)
+                AddSpentOutputs(tx, mapInputs, pindex, mapSpentOutputs);
+
             // Add in sigops done by pay-to-script-hash inputs;
             // this is to prevent a "rogue miner" from creating
             // an incredibly-expensive-to-validate block.
@@ -622,16 +697,31 @@ bool CBlock::ConnectBlock(CTxDB& txdb, const CBlockIndexSmartPtr& pindex, bool f
                 }
             }
 
-            if (tx.ConnectInputs(mapInputs, mapQueuedChanges, posThisTx, pindex, true, false, this)
+            std::vector<CScriptCheck> vChecks;
+            if (tx.ConnectInputs(mapInputs, mapQueuedChanges, posThisTx, pindex, true, false, this,
+                                 nScriptCheckThreads ? &vChecks : nullptr)
                     .isErr()) {
                 return false;
             }
+            control.Add(vChecks);
         }
 
         mapQueuedChanges[hashTx]          = CTxIndex(posThisTx, tx.vout.size());
         mapQueuedNTP1Inputs[tx.GetHash()] = inputsWithNTP1;
     }
 
+    CScriptCheck failedCheck;
+    if (!control.Wait(&failedCheck)) {
+        const std::string msg = strprintf("mandatory-script-verify-flag-failed (%s)",
+                                          ScriptErrorString(failedCheck.GetScriptError()));
+        reject                = CBlockReject(REJECT_INVALID, msg, this->GetHash());
+        return DoS(100,
+                   error("ConnectBlock() : %s input %u VerifySignature failed in block %s: %s",
+                         failedCheck.GetTx() ? failedCheck.GetTx()->GetHash().ToString().c_str() : "",
+                         failedCheck.GetInputIndex(), this->GetHash().ToString().c_str(),
+                         msg.c_str()));
+    }
+
     if (IsProofOfWork()) {
         const CAmount nExpectedReward = GetProofOfWorkReward(nFees);
         const CAmount nRewardInBlock  = vtx[0].GetValueOut();
@@ -674,6 +764,12 @@ bool CBlock::ConnectBlock(CTxDB& txdb, const CBlockIndexSmartPtr& pindex, bool f
             return error("ConnectBlock() : UpdateTxIndex failed");
     }
 
+    if (fAddressIndex) {
+        CTxDBChanges changes;
+        AddAddressIndexChanges(vtx, pindex->nHeight, mapSpentOutputs, true, changes);
+        txdb.AddAddressIndexChanges(std::move(changes));
+    }
+
     // This scope does NTP1 data writing
     {
         try {
@@ -692,6 +788,17 @@ bool CBlock::ConnectBlock(CTxDB& txdb, const CBlockIndexSmartPtr& pindex, bool f
         }
     }
 
+    // the NTP1 data of the block was written just above, so tokens spent in the block are found too
+    if (fNTP1Index) {
+        std::map<uint256, NTP1Transaction> ntp1txs;
+        if (!ReadNTP1IndexTxs(txdb, vtx, ntp1txs))
+            return error("ConnectBlock() : Failed to read the NTP1 data for the NTP1 index");
+        CTxDBChanges changes;
+        if (!AddNTP1IndexChanges(txdb, vtx, pindex->nHeight, ntp1txs, true, changes))
+            return error("ConnectBlock() : Failed to update the NTP1 index");
+        txdb.AddNTP1IndexChanges(std::move(changes));
+    }
+
     // Update block index on disk without changing it in memory.
     // The memory index structure will be changed after the db commits.
     if (pindex->pprev) {
@@ -803,9 +910,9 @@ bool CBlock::SetBestChain(CTxDB& txdb, const CBlockIndexSmartPtr& pindexNew,
 
     // New best block
     hashBestChain = hash;
+    activeChain.SetTip(pindexNew);
     boost::atomic_store(&pindexBest, pindexNew);
     CBlockIndexSmartPtr pindexBestPtr = boost::atomic_load(&pindexBest);
-    pblockindexFBBHLast               = nullptr;
     nBestHeight                       = pindexBestPtr->nHeight;
     nBestChainTrust                   = pindexNew->nChainTrust;
     nTimeBestReceived                 = GetTime();
@@ -938,27 +1045,7 @@ bool CBlock::ReadFromDisk(const CBlockIndex* pindex, CTxDB& txdb, bool fReadTran
 
 bool CBlock::IsProofOfStake() const { return (vtx.size() > 1 && vtx[1].IsCoinStake()); }
 
-CBlockIndexSmartPtr CBlock::FindBlockByHeight(int nHeight)
-{
-    CBlockIndexSmartPtr pblockindex;
-    if (nHeight < nBestHeight / 2) {
-        pblockindex = boost::atomic_load(&pindexGenesisBlock);
-    } else {
-        pblockindex = boost::atomic_load(&pindexBest);
-    }
-    if (pblockindexFBBHLast &&
-        abs(nHeight - pblockindex->nHeight) > abs(nHeight - pblockindexFBBHLast->nHeight)) {
-        pblockindex = pblockindexFBBHLast;
-    }
-    while (pblockindex->nHeight > nHeight) {
-        pblockindex = pblockindex->pprev;
-    }
-    while (pblockindex->nHeight < nHeight) {
-        pblockindex = pblockindex->pnext;
-    }
-    pblockindexFBBHLast = pblockindex;
-    return pblockindex;
-}
+CBlockIndexSmartPtr CBlock::FindBlockByHeight(int nHeight) { return activeChain.AtHeight(nHeight); }
 
 void CBlock::InvalidChainFound(const CBlockIndexSmartPtr& pindexNew, CTxDB& txdb)
 {
@@ -1130,7 +1217,7 @@ bool CBlock::AddToBlockIndex(uint256 nBlockPos, const uint256& hashProof, CTxDB&
         return error("AddToBlockIndex() : %s already exists", hash.ToString().c_str());
 
     // Construct new block index object
-    CBlockIndexSmartPtr pindexNew = boost::make_shared<CBlockIndex>(nBlockPos, *this);
+    CBlockIndexSmartPtr pindexNew = BlockIndexPool().Make(nBlockPos, *this);
     if (!pindexNew)
         return error("AddToBlockIndex() : new CBlockIndex failed");
     pindexNew->phashBlock              = &hash;
@@ -1442,6 +1529,13 @@ bool CBlock::AcceptBlock()
     if (!WriteToDisk(nBlockPos, hashProof))
         return error("AcceptBlock() : WriteToDisk failed");
 
+    // old blocks may have become prunable now, once the tx db cache was flushed
+    if (nPruneTarget > 0) {
+        CTxDB txdb;
+        if (!PruneBlockStore(txdb))
+            printf("AcceptBlock() : failed to prune the blocks db\n");
+    }
+
     // Relay inventory, but don't relay old inventory during initial block download
     int nBlockEstimate = Checkpoints::GetTotalBlocksEstimate();
     if (hashBestChain == hash) {
@@ -1506,6 +1600,7 @@ bool CBlock::SignBlock(const CWallet& wallet, int64_t nFees,
     vtx[0].nTime = nTime = coinStake->nTime;
     nTime                = std::max(pindexBestPtr->GetPastTimeLimit() + 1, GetMaxTransactionTime());
     nTime                = std::max(GetBlockTime(), PastDrift(pindexBestPtr->GetBlockTime()));
+    vtx[0].InvalidateHash();
 
     // we have to make sure that we have no future timestamps in our transactions set
     for (auto it = vtx.begin(); it != vtx.end();) {
@@ -1566,6 +1661,7 @@ bool CBlock::SignBlockWithSpecificKey(const COutPoint& outputToStake, const CKey
     vtx[0].nTime = nTime = coinStake->nTime;
     nTime                = std::max(pindexBestPtr->GetPastTimeLimit() + 1, GetMaxTransactionTime());
     nTime                = std::max(GetBlockTime(), PastDrift(pindexBestPtr->GetBlockTime()));
+    vtx[0].InvalidateHash();
 
     // we have to make sure that we have no future timestamps in our transactions set
     for (auto it = vtx.begin(); it != vtx.end();) {
@@ -1729,6 +1825,13 @@ bool CBlock::WriteToDisk(const uint256& nBlockPos, const uint256& hashProof)
 
     success = true;
     txEnder.reset();
+
+    // during the initial download, the tx db cache takes the changes of many blocks before they're
+    // written; afterwards, every block is written right away
+    if (!txdb.FlushCache(!IsInitialBlockDownload())) {
+        printf("Failed to flush the tx db cache after writing block %s\n",
+               this->GetHash().ToString().c_str());
+    }
     return true;
 }
 
@@ -1,6 +1,7 @@
 #ifndef BLOCK_H
 #define BLOCK_H
 
+#include "cachedhash.h"
 #include "globals.h"
 #include "outpoint.h"
 #include "transaction.h"
@@ -102,10 +103,14 @@ public:
 
     bool IsNull() const;
 
+    /** The hash is recomputed only when the header changed since it was last computed */
     uint256 GetHash() const;
 
     uint256 GetPoWHash() const;
 
+    /** Hashes the headers of blocks whose hash isn't known yet in batches, so GetHash() is cheap */
+    static void PrecomputeHashes(const std::vector<CBlock>& blocks);
+
     int64_t GetBlockTime() const;
 
     void UpdateTime(const CBlockIndex* pindexPrev);
@@ -184,6 +189,7 @@ public:
 
     bool CheckBlockSignature() const;
 
+    /** The block at nHeight in the best chain, or null if there's none */
     static CBlockIndexSmartPtr FindBlockByHeight(int nHeight);
 
     static void InvalidChainFound(const CBlockIndexSmartPtr& pindexNew, CTxDB& txdb);
@@ -192,6 +198,11 @@ public:
                     const bool createDbTransaction = true);
 
 private:
+    // the serialized header, from nVersion to nNonce
+    static const std::size_t HEADER_SIZE = 80;
+
+    CCachedHeaderHash<HEADER_SIZE> cachedHash;
+
     bool SetBestChainInner(CTxDB& txdb, const CBlockIndexSmartPtr& pindexNew,
                            const bool createDbTransaction = true);
 };
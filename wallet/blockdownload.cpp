@@ -0,0 +1,451 @@
+#include "blockdownload.h"
+
+#include "bignum.h"
+#include "serialize.h"
+#include "version.h"
+
+#include <algorithm>
+
+/** The trust of a block with the target nBits, as CBlockIndex::GetBlockTrust() */
+static uint256 GetHeaderTrust(unsigned int nBits)
+{
+    CBigNum bnTarget;
+    bnTarget.SetCompact(nBits);
+
+    if (bnTarget <= 0)
+        return 0;
+
+    return ((CBigNum(1) << 256) / (bnTarget + 1)).getuint256();
+}
+
+CBlockDownloader::CBlockDownloader(const LookupBlockFunction& lookupBlockIn,
+                                   const CheckHeaderFunction& checkHeaderIn)
+    : lookupBlock(lookupBlockIn), checkHeader(checkHeaderIn), hashBase(0), nBaseHeight(-1),
+      nBaseChainTrust(0), nHeaderChainTrustAdjust(0), fHeadersDropped(false), nHeldBlocksSize(0),
+      nHeadersSyncPeer(-1), nHeadersSyncTime(0)
+{
+}
+
+void CBlockDownloader::AddPeer(NodeId node)
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    PeerState&                      peer = mapPeers[node];
+    peer.hashBestKnown                   = 0;
+    peer.hashTipAsked                    = 0;
+    peer.nBlocksInFlight                 = 0;
+    peer.nStallingSince                  = 0;
+}
+
+void CBlockDownloader::RemovePeer(NodeId node)
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    mapPeers.erase(node);
+    for (auto it = mapBlocksInFlight.begin(); it != mapBlocksInFlight.end();) {
+        if (it->second.node == node) {
+            it = mapBlocksInFlight.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    if (nHeadersSyncPeer == node) {
+        nHeadersSyncPeer = -1;
+    }
+
+    // A peer can send headers for blocks it never delivers, and leave or get disconnected for
+    // stalling. Its headers must not keep the download waiting for those blocks.
+    int nMaxKnownHeight = nBaseHeight;
+    for (const auto& p : mapPeers) {
+        nMaxKnownHeight = std::max(nMaxKnownHeight, GetBestKnownHeight(p.second));
+    }
+    if (nBaseHeight >= 0 && nMaxKnownHeight < GetBestHeaderHeightUnlocked()) {
+        TruncateHeaderChain(nMaxKnownHeight - nBaseHeight);
+        fHeadersDropped = true;
+    }
+}
+
+CBlockDownloader::HeadersResult CBlockDownloader::AcceptHeaders(NodeId                     node,
+                                                                const std::vector<CBlock>& vHeaders)
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+
+    if (nHeadersSyncPeer == node) {
+        nHeadersSyncPeer = -1;
+    }
+    if (vHeaders.empty()) {
+        return HeadersResult::Accepted;
+    }
+
+    std::vector<uint256> vHashes;
+    vHashes.reserve(vHeaders.size());
+    for (const CBlock& header : vHeaders) {
+        if (!vHashes.empty() && header.hashPrevBlock != vHashes.back()) {
+            return HeadersResult::Invalid;
+        }
+        vHashes.push_back(header.GetHash());
+        if (setFailedBlocks.count(vHashes.back()) || setFailedBlocks.count(header.hashPrevBlock)) {
+            return HeadersResult::Invalid;
+        }
+    }
+
+    // skip the headers of blocks we have already
+    std::size_t nFirst = 0;
+    int         nHeight;
+    while (nFirst < vHashes.size() && LookupBlock(vHashes[nFirst], nHeight)) {
+        nFirst++;
+    }
+    if (nFirst == vHashes.size()) {
+        UpdateBestKnown(node, vHashes.back());
+        return HeadersResult::Accepted;
+    }
+
+    // find what the new headers build on; nKeep is the size the header chain keeps under them
+    const uint256& hashPrev = vHeaders[nFirst].hashPrevBlock;
+    int            nPrevHeight;
+    uint256        nPrevChainTrust;
+    std::size_t    nKeep;
+    bool           fInHeaderChain;
+    auto           itPrev = mapHeaderHeights.find(hashPrev);
+    if (itPrev != mapHeaderHeights.end() || (nBaseHeight >= 0 && hashPrev == hashBase)) {
+        nPrevHeight    = itPrev != mapHeaderHeights.end() ? itPrev->second : nBaseHeight;
+        nKeep          = nPrevHeight - nBaseHeight;
+        fInHeaderChain = true;
+        // skip the headers the chain has already
+        while (nFirst < vHashes.size() && nKeep < vHeaderChain.size() &&
+               vHeaderChain[nKeep] == vHashes[nFirst]) {
+            nFirst++;
+            nKeep++;
+            nPrevHeight++;
+        }
+        nPrevChainTrust = GetChainTrustUnlocked(nKeep);
+    } else if (lookupBlock(hashPrev, nPrevHeight, nPrevChainTrust)) {
+        nKeep          = 0;
+        fInHeaderChain = false;
+    } else {
+        return HeadersResult::Unconnected;
+    }
+
+    std::vector<uint256> vChainTrust;
+    vChainTrust.reserve(vHeaders.size() - nFirst);
+    uint256 nChainTrust = nPrevChainTrust;
+    for (std::size_t i = nFirst; i < vHeaders.size(); i++) {
+        unsigned int nTrustBits;
+        if (!checkHeader(vHeaders[i], nPrevHeight + 1 + static_cast<int>(i - nFirst), nTrustBits)) {
+            return HeadersResult::Invalid;
+        }
+        nChainTrust += GetHeaderTrust(nTrustBits);
+        vChainTrust.push_back(nChainTrust);
+    }
+
+    // the header chain is only replaced by one with more chain trust, not just more headers
+    if (nBaseHeight >= 0 && nChainTrust <= GetChainTrustUnlocked(vHeaderChain.size())) {
+        UpdateBestKnown(node, vHashes.back());
+        return HeadersResult::Accepted;
+    }
+
+    if (fInHeaderChain) {
+        TruncateHeaderChain(nKeep);
+    } else {
+        TruncateHeaderChain(0);
+        hashBase                = hashPrev;
+        nBaseHeight             = nPrevHeight;
+        nBaseChainTrust         = nPrevChainTrust;
+        nHeaderChainTrustAdjust = 0;
+    }
+    for (std::size_t i = nFirst; i < vHashes.size(); i++) {
+        vHeaderChain.push_back(vHashes[i]);
+        vHeaderChainTrust.push_back(vChainTrust[i - nFirst] - nHeaderChainTrustAdjust);
+        mapHeaderHeights[vHashes[i]] = nBaseHeight + static_cast<int>(vHeaderChain.size());
+    }
+    UpdateBestKnown(node, vHashes.back());
+    return HeadersResult::Accepted;
+}
+
+int CBlockDownloader::GetBestHeaderHeight() const
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    return GetBestHeaderHeightUnlocked();
+}
+
+std::vector<uint256> CBlockDownloader::GetLocatorHashes(uint256& baseHash) const
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    std::vector<uint256>            vHashes;
+    int                             nStep = 1;
+    for (int i = static_cast<int>(vHeaderChain.size()) - 1; i >= 0; i -= nStep) {
+        vHashes.push_back(vHeaderChain[i]);
+        if (vHashes.size() > 10)
+            nStep *= 2;
+    }
+    baseHash = hashBase;
+    return vHashes;
+}
+
+bool CBlockDownloader::StartHeadersSync(NodeId node, int64_t nNow)
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    if (nHeadersSyncPeer != -1 && nNow - nHeadersSyncTime < HEADERS_RESPONSE_TIMEOUT) {
+        return false;
+    }
+    nHeadersSyncPeer = node;
+    nHeadersSyncTime = nNow;
+    return true;
+}
+
+bool CBlockDownloader::StartTipCheck(NodeId node, uint256& hashTip)
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    auto                            itPeer = mapPeers.find(node);
+    if (itPeer == mapPeers.end() || vHeaderChain.empty()) {
+        return false;
+    }
+    PeerState& peer = itPeer->second;
+    hashTip         = vHeaderChain.back();
+    if (peer.hashTipAsked == hashTip || GetBestKnownHeight(peer) == GetBestHeaderHeightUnlocked()) {
+        return false;
+    }
+    peer.hashTipAsked = hashTip;
+    return true;
+}
+
+std::vector<uint256> CBlockDownloader::RequestBlocks(NodeId node, int64_t nNow)
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    AdvanceBase();
+
+    std::vector<uint256> vToRequest;
+    auto                 itPeer = mapPeers.find(node);
+    if (itPeer == mapPeers.end()) {
+        return vToRequest;
+    }
+    PeerState& peer = itPeer->second;
+    if (peer.nBlocksInFlight >= MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+        return vToRequest;
+    }
+    const int nBestKnownHeight = GetBestKnownHeight(peer);
+
+    // Only the first block, which never has to be held, is requested while the held blocks are
+    // full. It's the one that lets them be connected.
+    const bool fHeldFull = nHeldBlocksSize >= MAX_HELD_BLOCKS_SIZE;
+    const std::size_t nWindowEnd =
+        std::min(vHeaderChain.size(), static_cast<std::size_t>(BLOCK_DOWNLOAD_WINDOW));
+    for (std::size_t i = 0; i < nWindowEnd && !(fHeldFull && i > 0); i++) {
+        const int nHeight = nBaseHeight + 1 + static_cast<int>(i);
+        if (nHeight > nBestKnownHeight) {
+            return vToRequest;
+        }
+        const uint256& hash = vHeaderChain[i];
+        int            nHeightInIndex;
+        if (mapBlocksInFlight.count(hash) || mapHeldBlocks.count(nHeight) ||
+            LookupBlock(hash, nHeightInIndex)) {
+            continue;
+        }
+        mapBlocksInFlight[hash] = InFlight{node, nNow};
+        vToRequest.push_back(hash);
+        if (++peer.nBlocksInFlight >= MAX_BLOCKS_IN_TRANSIT_PER_PEER) {
+            return vToRequest;
+        }
+    }
+
+    // This peer could download more if the window moved on. Whoever has the first block of the
+    // window holds it up.
+    if (vToRequest.empty() && (fHeldFull || nWindowEnd < vHeaderChain.size())) {
+        auto itFirst = mapBlocksInFlight.find(vHeaderChain.front());
+        if (itFirst != mapBlocksInFlight.end() && itFirst->second.node != node) {
+            auto itStalling = mapPeers.find(itFirst->second.node);
+            if (itStalling != mapPeers.end() && itStalling->second.nStallingSince == 0) {
+                itStalling->second.nStallingSince = nNow;
+            }
+        }
+    }
+    return vToRequest;
+}
+
+bool CBlockDownloader::IsStalling(NodeId node, int64_t nNow) const
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    auto                            itPeer = mapPeers.find(node);
+    if (itPeer == mapPeers.end()) {
+        return false;
+    }
+    if (itPeer->second.nStallingSince != 0 &&
+        nNow - itPeer->second.nStallingSince > BLOCK_STALLING_TIMEOUT) {
+        return true;
+    }
+    if (itPeer->second.nBlocksInFlight > 0) {
+        for (const auto& p : mapBlocksInFlight) {
+            if (p.second.node == node && nNow - p.second.nTimeRequested > BLOCK_DOWNLOAD_TIMEOUT) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool CBlockDownloader::BlockReceived(const uint256& hash)
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    auto                            it = mapBlocksInFlight.find(hash);
+    if (it == mapBlocksInFlight.end()) {
+        return false;
+    }
+    auto itPeer = mapPeers.find(it->second.node);
+    if (itPeer != mapPeers.end()) {
+        itPeer->second.nBlocksInFlight--;
+        itPeer->second.nStallingSince = 0;
+    }
+    mapBlocksInFlight.erase(it);
+    return true;
+}
+
+void CBlockDownloader::BlockNotFound(NodeId node, const uint256& hash)
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    auto                            it = mapBlocksInFlight.find(hash);
+    if (it == mapBlocksInFlight.end() || it->second.node != node) {
+        return;
+    }
+    mapBlocksInFlight.erase(it);
+    auto itPeer = mapPeers.find(node);
+    if (itPeer == mapPeers.end()) {
+        return;
+    }
+    PeerState& peer = itPeer->second;
+    peer.nBlocksInFlight--;
+    peer.nStallingSince = 0;
+    // it doesn't have the rest of the header chain from there either
+    auto itHeight = mapHeaderHeights.find(hash);
+    if (itHeight != mapHeaderHeights.end() && GetBestKnownHeight(peer) >= itHeight->second) {
+        const std::size_t nIndex = itHeight->second - nBaseHeight - 1;
+        peer.hashBestKnown       = nIndex > 0 ? vHeaderChain[nIndex - 1] : uint256(0);
+    }
+}
+
+bool CBlockDownloader::HoldBlock(const CBlock& block)
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    auto                            it = mapHeaderHeights.find(block.GetHash());
+    if (it == mapHeaderHeights.end()) {
+        return false;
+    }
+    if (mapHeldBlocks.count(it->second)) {
+        return true;
+    }
+    const std::size_t nSize = ::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION);
+    mapHeldBlocks.insert(std::make_pair(it->second, HeldBlock{block, nSize}));
+    nHeldBlocksSize += nSize;
+    return true;
+}
+
+bool CBlockDownloader::TakeConnectableBlock(CBlock& block)
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    if (mapHeldBlocks.empty()) {
+        return false;
+    }
+    auto it = mapHeldBlocks.begin();
+    int  nPrevHeight;
+    if (!LookupBlock(it->second.block.hashPrevBlock, nPrevHeight)) {
+        return false;
+    }
+    block = std::move(it->second.block);
+    nHeldBlocksSize -= it->second.nSize;
+    mapHeldBlocks.erase(it);
+    return true;
+}
+
+void CBlockDownloader::BlockFailed(const uint256& hash)
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    setFailedBlocks.insert(hash);
+    auto it = mapHeaderHeights.find(hash);
+    if (it != mapHeaderHeights.end()) {
+        TruncateHeaderChain(it->second - nBaseHeight - 1);
+    }
+}
+
+bool CBlockDownloader::TakeHeadersDropped()
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    const bool                      fDropped = fHeadersDropped;
+    fHeadersDropped                          = false;
+    return fDropped;
+}
+
+std::size_t CBlockDownloader::GetBlocksInFlight(NodeId node) const
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    auto                            it = mapPeers.find(node);
+    return it == mapPeers.end() ? 0 : it->second.nBlocksInFlight;
+}
+
+std::size_t CBlockDownloader::GetHeldBlocksCount() const
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    return mapHeldBlocks.size();
+}
+
+bool CBlockDownloader::LookupBlock(const uint256& hash, int& nHeight) const
+{
+    uint256 nChainTrust;
+    return lookupBlock(hash, nHeight, nChainTrust);
+}
+
+int CBlockDownloader::GetBestHeaderHeightUnlocked() const
+{
+    return nBaseHeight < 0 ? -1 : nBaseHeight + static_cast<int>(vHeaderChain.size());
+}
+
+uint256 CBlockDownloader::GetChainTrustUnlocked(std::size_t nSize) const
+{
+    return nSize == 0 ? nBaseChainTrust : vHeaderChainTrust[nSize - 1] + nHeaderChainTrustAdjust;
+}
+
+int CBlockDownloader::GetBestKnownHeight(const PeerState& peer) const
+{
+    auto it = mapHeaderHeights.find(peer.hashBestKnown);
+    return it == mapHeaderHeights.end() ? -1 : it->second;
+}
+
+void CBlockDownloader::UpdateBestKnown(NodeId node, const uint256& hash)
+{
+    auto itPeer = mapPeers.find(node);
+    auto it     = mapHeaderHeights.find(hash);
+    if (itPeer != mapPeers.end() && it != mapHeaderHeights.end() &&
+        it->second > GetBestKnownHeight(itPeer->second)) {
+        itPeer->second.hashBestKnown = hash;
+    }
+}
+
+void CBlockDownloader::TruncateHeaderChain(std::size_t nNewSize)
+{
+    while (vHeaderChain.size() > nNewSize) {
+        mapHeaderHeights.erase(vHeaderChain.back());
+        vHeaderChain.pop_back();
+        vHeaderChainTrust.pop_back();
+    }
+    const int nLastHeight = nBaseHeight + static_cast<int>(nNewSize);
+    for (auto it = mapHeldBlocks.upper_bound(nLastHeight); it != mapHeldBlocks.end();) {
+        nHeldBlocksSize -= it->second.nSize;
+        it = mapHeldBlocks.erase(it);
+    }
+}
+
+void CBlockDownloader::AdvanceBase()
+{
+    int     nHeight;
+    uint256 nChainTrust;
+    while (!vHeaderChain.empty() && lookupBlock(vHeaderChain.front(), nHeight, nChainTrust)) {
+        hashBase                = vHeaderChain.front();
+        nBaseHeight             = nHeight;
+        nBaseChainTrust         = nChainTrust;
+        nHeaderChainTrustAdjust = nChainTrust - vHeaderChainTrust.front();
+        mapHeaderHeights.erase(hashBase);
+        vHeaderChain.pop_front();
+        vHeaderChainTrust.pop_front();
+    }
+    // blocks that got connected some other way
+    while (!mapHeldBlocks.empty() && mapHeldBlocks.begin()->first <= nBaseHeight) {
+        nHeldBlocksSize -= mapHeldBlocks.begin()->second.nSize;
+        mapHeldBlocks.erase(mapHeldBlocks.begin());
+    }
+}
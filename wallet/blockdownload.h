@@ -0,0 +1,200 @@
+#ifndef BLOCKDOWNLOAD_H
+#define BLOCKDOWNLOAD_H
+
+#include "block.h"
+#include "uint256.h"
+
+#include <boost/thread/mutex.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <vector>
+
+/** Number of blocks of the header chain, from the first one we don't have, that can be in download */
+static const int BLOCK_DOWNLOAD_WINDOW = 1024;
+/** Number of blocks that can be requested from a single peer at once */
+static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
+/** Seconds a peer can hold up a full download window before it's considered stalling */
+static const int64_t BLOCK_STALLING_TIMEOUT = 5;
+/** Seconds a peer has to deliver a block it was asked for */
+static const int64_t BLOCK_DOWNLOAD_TIMEOUT = 60;
+/** Seconds the headers sync peer has to answer a getheaders before another peer is picked */
+static const int64_t HEADERS_RESPONSE_TIMEOUT = 2 * 60;
+/** Number of headers in a full headers message */
+static const unsigned int MAX_HEADERS_RESULTS = 2000;
+/** Number of headers past the best block that are fetched before the headers sync waits for blocks */
+static const int HEADERS_DOWNLOAD_AHEAD = 100000;
+/** Serialized size of the blocks that are held for their parent at most, in bytes */
+static const std::size_t MAX_HELD_BLOCKS_SIZE = 64 * 1000 * 1000;
+
+/**
+ * Headers-first block download. Headers from peers are linked into a header chain that builds on
+ * a block of the block index. Block bodies along that chain are then requested from every peer
+ * that has them, in a window that moves forward as blocks are connected, with a limit on the
+ * blocks in flight per peer. Requested blocks that arrive before their parent are held here until
+ * it's connected, instead of going to the orphan blocks.
+ *
+ * The header chain is only a download schedule: blocks still go through the full validation when
+ * they are processed, and the best chain is chosen by chain trust as before.
+ */
+class CBlockDownloader
+{
+public:
+    typedef int64_t NodeId;
+    /** Sets nHeight and nChainTrust and returns true if the block is in the block index */
+    typedef std::function<bool(const uint256& hash, int& nHeight, uint256& nChainTrust)>
+        LookupBlockFunction;
+    /**
+     * Checks of a header that don't need its transactions, at the height it would have. nTrustBits
+     * is set to the target the trust of the header is counted at: its own if its proof was checked,
+     * or else the easiest one its block can have, as a target nobody checked can be made up.
+     */
+    typedef std::function<bool(const CBlock& header, int nHeight, unsigned int& nTrustBits)>
+        CheckHeaderFunction;
+
+    enum class HeadersResult
+    {
+        Accepted,
+        // the first header doesn't build on a known block or header
+        Unconnected,
+        Invalid
+    };
+
+    CBlockDownloader(const LookupBlockFunction& lookupBlockIn, const CheckHeaderFunction& checkHeaderIn);
+    CBlockDownloader(const CBlockDownloader&) = delete;
+    CBlockDownloader& operator=(const CBlockDownloader&) = delete;
+
+    /**
+     * Only peers that serve blocks (NODE_NETWORK) should be added. A peer is only asked for the
+     * blocks of headers it has sent.
+     */
+    void AddPeer(NodeId node);
+    /**
+     * Forgets the peer, so the blocks it was asked for can be requested from others. The headers
+     * that none of the remaining peers has sent are dropped, as their blocks can't be downloaded.
+     */
+    void RemovePeer(NodeId node);
+
+    /**
+     * Links headers, each building on the one before, into the header chain. The header chain is
+     * replaced if they make one with more chain trust. The last header is remembered as one that
+     * node has.
+     */
+    HeadersResult AcceptHeaders(NodeId node, const std::vector<CBlock>& vHeaders);
+
+    /** Height of the tip of the header chain, -1 if there's none */
+    int GetBestHeaderHeight() const;
+
+    /**
+     * Hashes of the header chain from its tip backwards, in exponentially larger steps, for a block
+     * locator. baseHash is set to the block of the block index the chain builds on. Empty if there's
+     * no header chain.
+     */
+    std::vector<uint256> GetLocatorHashes(uint256& baseHash) const;
+
+    /**
+     * Makes node the peer the header chain is synced from and returns true, unless a peer is at it
+     * already and hasn't timed out. The sync peer is released by the next headers it sends.
+     */
+    bool StartHeadersSync(NodeId node, int64_t nNow);
+
+    /**
+     * Returns true if node hasn't sent the tip of the header chain, and wasn't asked for it since
+     * the tip changed. hashTip is set to the tip, which node should be asked for.
+     */
+    bool StartTipCheck(NodeId node, uint256& hashTip);
+
+    /** Picks blocks of the download window to request from node, and marks them as in flight */
+    std::vector<uint256> RequestBlocks(NodeId node, int64_t nNow);
+
+    /** Whether node held up the download window for too long, or didn't deliver a block in time */
+    bool IsStalling(NodeId node, int64_t nNow) const;
+
+    /** Marks the block as arrived and returns true if it was requested */
+    bool BlockReceived(const uint256& hash);
+
+    /** Lets others be asked for a block node doesn't have, without counting it as stalling */
+    void BlockNotFound(NodeId node, const uint256& hash);
+
+    /** Keeps a block of the header chain until its parent is connected; false if it's not in it */
+    bool HoldBlock(const CBlock& block);
+
+    /** Takes out the lowest held block if its parent is in the block index now */
+    bool TakeConnectableBlock(CBlock& block);
+
+    /** Cuts the header chain at a block that failed validation, and rejects headers building on it */
+    void BlockFailed(const uint256& hash);
+
+    /** Returns true once after headers were dropped with a peer that left, to look for blocks anew */
+    bool TakeHeadersDropped();
+
+    std::size_t GetBlocksInFlight(NodeId node) const;
+    std::size_t GetHeldBlocksCount() const;
+
+private:
+    struct PeerState
+    {
+        // the best header of the header chain the peer has sent
+        uint256     hashBestKnown;
+        uint256     hashTipAsked;
+        std::size_t nBlocksInFlight;
+        // when the peer started holding up the download window, 0 if it doesn't
+        int64_t nStallingSince;
+    };
+
+    struct InFlight
+    {
+        NodeId  node;
+        int64_t nTimeRequested;
+    };
+
+    struct HeldBlock
+    {
+        CBlock      block;
+        std::size_t nSize;
+    };
+
+    mutable boost::mutex mtx;
+    LookupBlockFunction  lookupBlock;
+    CheckHeaderFunction  checkHeader;
+
+    // the header chain, whose blocks aren't in the block index yet, except for those that were
+    // connected since the last AdvanceBase(); vHeaderChain[i] is at height nBaseHeight + 1 + i, and
+    // vHeaderChainTrust[i] + nHeaderChainTrustAdjust is the chain trust up to it. The trust of a
+    // header is a lower bound where its proof isn't checked, so the adjustment takes in the real
+    // trust of the blocks the base moves past.
+    uint256                          hashBase;
+    int                              nBaseHeight;
+    uint256                          nBaseChainTrust;
+    std::deque<uint256>              vHeaderChain;
+    std::deque<uint256>              vHeaderChainTrust;
+    uint256                          nHeaderChainTrustAdjust;
+    std::unordered_map<uint256, int> mapHeaderHeights;
+    bool                             fHeadersDropped;
+
+    std::map<NodeId, PeerState>           mapPeers;
+    std::unordered_map<uint256, InFlight> mapBlocksInFlight;
+    std::map<int, HeldBlock>              mapHeldBlocks; // by height
+    std::size_t                           nHeldBlocksSize;
+    std::set<uint256>                     setFailedBlocks;
+
+    NodeId  nHeadersSyncPeer;
+    int64_t nHeadersSyncTime;
+
+    bool    LookupBlock(const uint256& hash, int& nHeight) const;
+    int     GetBestHeaderHeightUnlocked() const;
+    /** Chain trust of the first nSize headers of the header chain */
+    uint256 GetChainTrustUnlocked(std::size_t nSize) const;
+    /** Height of the best header of the header chain the peer has sent, -1 if there's none */
+    int     GetBestKnownHeight(const PeerState& peer) const;
+    void    UpdateBestKnown(NodeId node, const uint256& hash);
+    void    TruncateHeaderChain(std::size_t nNewSize);
+    /** Moves the base past the headers whose blocks are in the block index now */
+    void AdvanceBase();
+};
+
+#endif // BLOCKDOWNLOAD_H
@@ -1,6 +1,6 @@
 #include "blockindexcatalog.h"
 
-#include <boost/make_shared.hpp>
+#include "blockindexpool.h"
 #include <utility>
 
 CBlockIndexSmartPtr BlockIndexCatalog::InsertBlockIndex(uint256 hash)
@@ -14,7 +14,7 @@ CBlockIndexSmartPtr BlockIndexCatalog::InsertBlockIndex(uint256 hash)
         return mi->second;
 
     // Create new
-    CBlockIndexSmartPtr pindexNew = boost::make_shared<CBlockIndex>();
+    CBlockIndexSmartPtr pindexNew = BlockIndexPool().Make();
     if (!pindexNew)
         throw std::runtime_error("LoadBlockIndex() : new CBlockIndex failed");
     mi = blockIndexMap.insert(std::make_pair(hash, pindexNew)).first;
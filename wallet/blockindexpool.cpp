@@ -0,0 +1,40 @@
+#include "blockindexpool.h"
+
+#include "blockindex.h"
+
+#include <new>
+
+CBlockIndexPool::~CBlockIndexPool()
+{
+    for (char* pchunk : vChunks)
+        ::operator delete(pchunk);
+}
+
+void* CBlockIndexPool::AllocateRaw(std::size_t nBytes, std::size_t nAlign)
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+
+    // chunks are meant for many small entries
+    if (nBytes + nAlign > CHUNK_SIZE)
+        throw std::bad_alloc();
+
+    std::size_t nOffset = (nChunkUsed + nAlign - 1) / nAlign * nAlign;
+    if (vChunks.empty() || nOffset + nBytes > CHUNK_SIZE) {
+        vChunks.push_back(static_cast<char*>(::operator new(CHUNK_SIZE)));
+        nOffset = 0;
+    }
+    nChunkUsed = nOffset + nBytes;
+    return vChunks.back() + nOffset;
+}
+
+std::size_t CBlockIndexPool::GetMemoryUsage() const
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    return vChunks.size() * CHUNK_SIZE;
+}
+
+CBlockIndexPool& BlockIndexPool()
+{
+    static CBlockIndexPool* pool = new CBlockIndexPool;
+    return *pool;
+}
@@ -0,0 +1,93 @@
+#ifndef BLOCKINDEXPOOL_H
+#define BLOCKINDEXPOOL_H
+
+#include "globals.h"
+
+#include <boost/make_shared.hpp>
+#include <boost/thread/mutex.hpp>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+/**
+ * Storage for CBlockIndex entries. Each entry, together with its reference count, is carved out of
+ * large contiguous chunks instead of being allocated on its own on the heap. That spares the heap's
+ * per-allocation overhead for every one of the millions of entries, and keeps entries created one
+ * after another (mostly blocks of neighbouring heights) next to each other in memory.
+ *
+ * Block index entries live as long as the node does, so memory of a released entry isn't reused;
+ * the chunks are freed with the pool, which therefore has to outlive all the entries made in it.
+ */
+class CBlockIndexPool
+{
+public:
+    /** An allocator handing out memory of the pool; deallocating is a no-op */
+    template <typename T>
+    class Allocator
+    {
+        CBlockIndexPool* pool;
+
+        template <typename U>
+        friend class Allocator;
+
+    public:
+        typedef T value_type;
+
+        explicit Allocator(CBlockIndexPool* poolIn) : pool(poolIn) {}
+        template <typename U>
+        Allocator(const Allocator<U>& other) : pool(other.pool)
+        {
+        }
+
+        T* allocate(std::size_t n)
+        {
+            return static_cast<T*>(pool->AllocateRaw(n * sizeof(T), alignof(T)));
+        }
+        void deallocate(T*, std::size_t) {}
+
+        template <typename U>
+        bool operator==(const Allocator<U>& other) const
+        {
+            return pool == other.pool;
+        }
+        template <typename U>
+        bool operator!=(const Allocator<U>& other) const
+        {
+            return pool != other.pool;
+        }
+    };
+
+    CBlockIndexPool() : nChunkUsed(0) {}
+    ~CBlockIndexPool();
+    CBlockIndexPool(const CBlockIndexPool&) = delete;
+    CBlockIndexPool& operator=(const CBlockIndexPool&) = delete;
+
+    /** Creates a block index entry in the pool, passing args to the CBlockIndex constructor */
+    template <typename... Args>
+    CBlockIndexSmartPtr Make(Args&&... args)
+    {
+        return boost::allocate_shared<CBlockIndex>(Allocator<CBlockIndex>(this),
+                                                   std::forward<Args>(args)...);
+    }
+
+    /** Bytes taken by the chunks allocated so far */
+    std::size_t GetMemoryUsage() const;
+
+private:
+    static const std::size_t CHUNK_SIZE = 1 << 20;
+
+    mutable boost::mutex mtx;
+    std::vector<char*>   vChunks;
+    // bytes handed out from the last chunk
+    std::size_t nChunkUsed;
+
+    void* AllocateRaw(std::size_t nBytes, std::size_t nAlign);
+};
+
+/**
+ * The pool all block index entries of mapBlockIndex are created in. It's never destroyed, as
+ * entries can be referenced by static objects that are destroyed late at exit.
+ */
+CBlockIndexPool& BlockIndexPool();
+
+#endif // BLOCKINDEXPOOL_H
@@ -14,6 +14,12 @@ CBlockLocator::CBlockLocator(uint256 hashBlock)
 
 CBlockLocator::CBlockLocator(const std::vector<uint256>& vHaveIn) { vHave = vHaveIn; }
 
+CBlockLocator::CBlockLocator(const std::vector<uint256>& vHashesAbove, const CBlockIndex* pindex)
+{
+    Set(pindex);
+    vHave.insert(vHave.begin(), vHashesAbove.begin(), vHashesAbove.end());
+}
+
 void CBlockLocator::SetNull() { vHave.clear(); }
 
 bool CBlockLocator::IsNull() { return vHave.empty(); }
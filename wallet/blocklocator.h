@@ -27,6 +27,9 @@ public:
 
     CBlockLocator(const std::vector<uint256>& vHaveIn);
 
+    /** A locator of pindex, with vHashesAbove (hashes of headers building on it) in front */
+    CBlockLocator(const std::vector<uint256>& vHashesAbove, const CBlockIndex* pindex);
+
     IMPLEMENT_SERIALIZE(if (!(nType & SER_GETHASH)) READWRITE(nVersion); READWRITE(vHave);)
 
     void SetNull();
@@ -0,0 +1,157 @@
+#ifndef CACHEDHASH_H
+#define CACHEDHASH_H
+
+#include "uint256.h"
+
+#include <array>
+#include <atomic>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/mutex.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/**
+ * A hash that's computed once and kept until it's invalidated. Whoever changes the hashed object
+ * must call Invalidate(). Copies keep the hash, so they must be invalidated on their own.
+ * Concurrent readers are fine; changing the object while it's read is not, as usual.
+ */
+class CCachedHash
+{
+public:
+    CCachedHash() : state(EMPTY) {}
+    CCachedHash(const CCachedHash& other) : state(EMPTY)
+    {
+        uint256 hashOther;
+        if (other.Get(hashOther)) {
+            Set(hashOther);
+        }
+    }
+    CCachedHash& operator=(const CCachedHash& other)
+    {
+        if (this != &other) {
+            uint256 hashOther;
+            const bool fHasHash = other.Get(hashOther);
+            Invalidate();
+            if (fHasHash) {
+                Set(hashOther);
+            }
+        }
+        return *this;
+    }
+
+    /** Sets hashOut and returns true if the hash is known */
+    bool Get(uint256& hashOut) const
+    {
+        if (state.load(std::memory_order_acquire) != READY) {
+            return false;
+        }
+        hashOut = hash;
+        return true;
+    }
+
+    /** Keeps the hash, unless another thread is keeping one at the same time */
+    void Set(const uint256& hashIn) const
+    {
+        uint8_t expected = EMPTY;
+        if (state.compare_exchange_strong(expected, STORING, std::memory_order_acquire)) {
+            hash = hashIn;
+            state.store(READY, std::memory_order_release);
+        }
+    }
+
+    void Invalidate() const { state.store(EMPTY, std::memory_order_release); }
+
+private:
+    enum : uint8_t
+    {
+        EMPTY,
+        STORING,
+        READY
+    };
+
+    mutable std::atomic<uint8_t> state;
+    mutable uint256              hash;
+};
+
+/**
+ * The hash of a fixed size header, kept together with a copy of the header it was computed from.
+ * It's recomputed only when the header bytes differ from that copy, so the header can be changed
+ * anywhere without invalidating the hash.
+ */
+template <std::size_t HeaderSize>
+class CCachedHeaderHash
+{
+public:
+    typedef uint256 (*HashFunction)(const void* pheader);
+
+    CCachedHeaderHash() : fValid(false) {}
+    CCachedHeaderHash(const CCachedHeaderHash& other) : fValid(false) { CopyFrom(other); }
+    CCachedHeaderHash& operator=(const CCachedHeaderHash& other)
+    {
+        if (this != &other) {
+            CopyFrom(other);
+        }
+        return *this;
+    }
+
+    /** The hash of the HeaderSize bytes at pheader, calling hashFunction only if they changed */
+    uint256 Get(const void* pheader, HashFunction hashFunction) const
+    {
+        std::array<unsigned char, HeaderSize> headerNow;
+        std::memcpy(headerNow.data(), pheader, HeaderSize);
+        {
+            boost::lock_guard<boost::mutex> lock(mtx);
+            if (fValid && header == headerNow) {
+                return hash;
+            }
+        }
+        const uint256 hashNow = hashFunction(headerNow.data());
+        boost::lock_guard<boost::mutex> lock(mtx);
+        header = headerNow;
+        hash   = hashNow;
+        fValid = true;
+        return hashNow;
+    }
+
+    /** True if the hash of the HeaderSize bytes at pheader is kept, and Get() won't compute it */
+    bool IsCurrent(const void* pheader) const
+    {
+        boost::lock_guard<boost::mutex> lock(mtx);
+        return fValid && std::memcmp(header.data(), pheader, HeaderSize) == 0;
+    }
+
+    /** Keeps a hash of the HeaderSize bytes at pheader that was computed elsewhere */
+    void Set(const void* pheader, const uint256& hashIn) const
+    {
+        boost::lock_guard<boost::mutex> lock(mtx);
+        std::memcpy(header.data(), pheader, HeaderSize);
+        hash   = hashIn;
+        fValid = true;
+    }
+
+private:
+    mutable boost::mutex                          mtx;
+    mutable std::array<unsigned char, HeaderSize> header;
+    mutable uint256                               hash;
+    mutable bool                                  fValid;
+
+    void CopyFrom(const CCachedHeaderHash& other)
+    {
+        std::array<unsigned char, HeaderSize> headerOther;
+        uint256                               hashOther;
+        bool                                  fValidOther;
+        {
+            boost::lock_guard<boost::mutex> lock(other.mtx);
+            headerOther = other.header;
+            hashOther   = other.hash;
+            fValidOther = other.fValid;
+        }
+        boost::lock_guard<boost::mutex> lock(mtx);
+        header = headerOther;
+        hash   = hashOther;
+        fValid = fValidOther;
+    }
+};
+
+#endif // CACHEDHASH_H
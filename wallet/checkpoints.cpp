@@ -38,14 +38,14 @@ int GetTotalBlocksEstimate()
     }
 }
 
-CBlockIndex* GetLastCheckpoint(const std::map<uint256, CBlockIndexSmartPtr>& mapBlockIndex)
+CBlockIndex* GetLastCheckpoint(const BlockIndexMapType& mapBlockIndex)
 {
     const MapCheckpoints& checkpoints = Params().Checkpoints();
 
     BOOST_REVERSE_FOREACH(const MapCheckpoints::value_type& i, checkpoints)
     {
-        const uint256&                                         hash = i.second;
-        std::map<uint256, CBlockIndexSmartPtr>::const_iterator it   = mapBlockIndex.find(hash);
+        const uint256&                    hash = i.second;
+        BlockIndexMapType::const_iterator it   = mapBlockIndex.find(hash);
         if (it != mapBlockIndex.end())
             return boost::atomic_load(&it->second).get();
     }
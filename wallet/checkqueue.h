@@ -0,0 +1,240 @@
+#ifndef CHECKQUEUE_H
+#define CHECKQUEUE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+template <typename T>
+class CCheckQueueControl;
+
+/**
+ * Queue for verifications that have to be performed.
+ * The verifications are represented by a type T, which must provide an operator(), returning a bool.
+ *
+ * One thread (the master) is assumed to push batches of verifications onto the queue, where they are
+ * processed by N-1 worker threads. When the master is done adding work, it temporarily joins the worker
+ * pool as an N'th worker, until all jobs are done.
+ */
+template <typename T>
+class CCheckQueue
+{
+    /** Mutex to protect the inner state */
+    std::mutex mutex;
+
+    /** Worker threads block on this when out of work */
+    std::condition_variable condWorker;
+
+    /** Master thread blocks on this when out of work */
+    std::condition_variable condMaster;
+
+    /** The queue of elements to be processed.
+     *  As the order of booleans doesn't matter, it is used as a LIFO (stack) */
+    std::vector<T> queue;
+
+    /** The number of workers (including the master) that are idle */
+    int nIdle;
+
+    /** The total number of workers (including the master) */
+    int nTotal;
+
+    /** The temporary evaluation result */
+    bool fAllOk;
+
+    /** The first check that failed since the last Wait(), valid if fHaveFailedCheck is set */
+    T    failedCheck;
+    bool fHaveFailedCheck;
+
+    /**
+     * Number of verifications that haven't completed yet.
+     * This includes elements that are no longer queued, but still in the
+     * worker's own batches.
+     */
+    unsigned int nTodo;
+
+    /** Whether we're shutting down */
+    bool fQuit;
+
+    /** The maximum number of elements to be processed in one batch */
+    const unsigned int nBatchSize;
+
+    /** Internal function that does bulk of the verification work. */
+    bool Loop(bool fMaster = false, T* pFailedCheck = nullptr)
+    {
+        std::condition_variable& cond = fMaster ? condMaster : condWorker;
+        std::vector<T>           vChecks;
+        vChecks.reserve(nBatchSize);
+        unsigned int nNow = 0;
+        bool         fOk  = true;
+        // the check of this worker's last batch that failed, if any
+        T    localFailedCheck;
+        bool fLocalFailed = false;
+        do {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                // first do the clean-up of the previous loop run (allowing us to do it in the same
+                // critsect)
+                if (nNow) {
+                    fAllOk &= fOk;
+                    if (fLocalFailed && !fHaveFailedCheck) {
+                        failedCheck.swap(localFailedCheck);
+                        fHaveFailedCheck = true;
+                    }
+                    fLocalFailed = false;
+                    nTodo -= nNow;
+                    if (nTodo == 0 && !fMaster)
+                        // We processed the last element; inform the master it can exit and return the
+                        // result
+                        condMaster.notify_one();
+                } else {
+                    // first iteration
+                    nTotal++;
+                }
+                // logically, the do loop starts here
+                // on shutdown, workers quit, but the master keeps going until its work is done
+                while (queue.empty() && !(fQuit && !fMaster)) {
+                    if (fMaster && nTodo == 0) {
+                        nTotal--;
+                        bool fRet = fAllOk;
+                        if (pFailedCheck != nullptr && fHaveFailedCheck)
+                            pFailedCheck->swap(failedCheck);
+                        // reset the status for new work later
+                        fAllOk           = true;
+                        failedCheck      = T();
+                        fHaveFailedCheck = false;
+                        // return the current status
+                        return fRet;
+                    }
+                    nIdle++;
+                    cond.wait(lock); // wait
+                    nIdle--;
+                }
+                if (fQuit && !fMaster) {
+                    nTotal--;
+                    return false;
+                }
+                // Decide how many work units to process now.
+                // * Do not try to do everything at once, but aim for increasingly smaller batches so
+                //   all workers finish approximately simultaneously.
+                // * Try to account for idle jobs which will instantly start helping.
+                // * Don't do batches smaller than 1 (duh), or larger than nBatchSize.
+                nNow = std::max(1U, std::min(nBatchSize, (unsigned int)queue.size() /
+                                                             (nTotal + nIdle + 1)));
+                vChecks.resize(nNow);
+                for (unsigned int i = 0; i < nNow; i++) {
+                    // We want the lock on the mutex to be as short as possible, so swap jobs from the
+                    // global queue to the local batch vector instead of copying.
+                    vChecks[i].swap(queue.back());
+                    queue.pop_back();
+                }
+                // Check whether we need to do work at all
+                fOk = fAllOk;
+            }
+            // execute work
+            for (T& check : vChecks) {
+                if (fOk) {
+                    fOk = check();
+                    if (!fOk) {
+                        localFailedCheck.swap(check);
+                        fLocalFailed = true;
+                    }
+                }
+            }
+            vChecks.clear();
+        } while (true);
+    }
+
+public:
+    /** Mutex to ensure only one concurrent CCheckQueueControl */
+    std::mutex ControlMutex;
+
+    //! Create a new check queue
+    explicit CCheckQueue(unsigned int nBatchSizeIn)
+        : nIdle(0), nTotal(0), fAllOk(true), fHaveFailedCheck(false), nTodo(0), fQuit(false),
+          nBatchSize(nBatchSizeIn)
+    {
+    }
+
+    //! Worker thread
+    void Thread() { Loop(); }
+
+    //! Wait until execution finishes, and return whether all evaluations were successful.
+    //! On failure, the first failing check is swapped into pFailedCheck if one is given.
+    bool Wait(T* pFailedCheck = nullptr) { return Loop(true, pFailedCheck); }
+
+    //! Add a batch of checks to the queue
+    void Add(std::vector<T>& vChecks)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (T& check : vChecks) {
+            queue.push_back(T());
+            check.swap(queue.back());
+        }
+        nTodo += vChecks.size();
+        if (vChecks.size() == 1)
+            condWorker.notify_one();
+        else if (vChecks.size() > 1)
+            condWorker.notify_all();
+    }
+
+    //! Wake up all the workers and make them exit; used on shutdown
+    void Quit()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        fQuit = true;
+        condWorker.notify_all();
+    }
+};
+
+/**
+ * RAII-style controller object for a CCheckQueue that guarantees the passed queue is finished before
+ * continuing. If no queue is given, nothing is done and the checks are expected to be run by the caller.
+ */
+template <typename T>
+class CCheckQueueControl
+{
+private:
+    CCheckQueue<T>* const                        pqueue;
+    bool                                         fDone;
+    std::unique_ptr<std::lock_guard<std::mutex>> controlLock;
+
+public:
+    CCheckQueueControl()                          = delete;
+    CCheckQueueControl(const CCheckQueueControl&) = delete;
+    CCheckQueueControl& operator=(const CCheckQueueControl&) = delete;
+
+    explicit CCheckQueueControl(CCheckQueue<T>* const pqueueIn) : pqueue(pqueueIn), fDone(false)
+    {
+        // passed queue is supposed to be unused, or nullptr
+        if (pqueue != nullptr) {
+            controlLock.reset(new std::lock_guard<std::mutex>(pqueue->ControlMutex));
+        }
+    }
+
+    bool Wait(T* pFailedCheck = nullptr)
+    {
+        if (pqueue == nullptr)
+            return true;
+        bool fRet = pqueue->Wait(pFailedCheck);
+        fDone     = true;
+        return fRet;
+    }
+
+    void Add(std::vector<T>& vChecks)
+    {
+        if (pqueue != nullptr)
+            pqueue->Add(vChecks);
+    }
+
+    ~CCheckQueueControl()
+    {
+        if (!fDone)
+            Wait();
+    }
+};
+
+#endif // CHECKQUEUE_H
@@ -0,0 +1,192 @@
+#ifndef CUCKOOCACHE_H
+#define CUCKOOCACHE_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+/**
+ * A fixed-memory set of 128-bit keys, for caching the results of expensive checks.
+ *
+ * Keys are expected to be uniformly distributed already (the output of a keyed hash), so the slots a
+ * key may live in are taken directly from its bits. Every key has NUM_HASHES candidate slots; when
+ * all of them are taken, inserting moves one of the occupants to another of its slots, cuckoo-style,
+ * and after a bounded number of moves the last key moved out is dropped.
+ *
+ * The table is split into shards. Lookups don't lock: each shard has a sequence counter that writers
+ * make odd while modifying the shard, and a reader that sees the counter change under it retries.
+ * Writers to the same shard are serialized by a mutex; writers to different shards don't contend.
+ *
+ * Erasing only marks a slot as free to be overwritten; an erased key is no longer reported as
+ * contained.
+ */
+class CCuckooCache
+{
+public:
+    struct Key
+    {
+        uint64_t k0;
+        uint64_t k1;
+    };
+
+    static const int         NUM_HASHES = 8;
+    static const std::size_t NUM_SHARDS = 16;
+
+private:
+    struct Shard
+    {
+        // two words per slot, holding k0 and k1 of the key in it
+        std::unique_ptr<std::atomic<uint64_t>[]> words;
+        // whether the slot is empty or erased, and so may be overwritten
+        std::unique_ptr<std::atomic<bool>[]> fCollectable;
+        uint32_t                             nSlots      = 0;
+        uint32_t                             nDepthLimit = 0;
+        std::atomic<uint32_t>                nSequence{0};
+        std::mutex                           mutexWrite;
+    };
+
+    std::unique_ptr<Shard[]> shards;
+
+    static Shard& ShardFor(std::unique_ptr<Shard[]>& shards, const Key& key)
+    {
+        return shards[key.k1 % NUM_SHARDS];
+    }
+
+    static std::array<uint32_t, NUM_HASHES> Locations(const Shard& shard, const Key& key)
+    {
+        // double hashing; mapping the high 32 bits onto [0, nSlots) with a multiply avoids a division
+        std::array<uint32_t, NUM_HASHES> locs;
+        const uint64_t                   h2 = (key.k1 / NUM_SHARDS) | 1;
+        for (int i = 0; i < NUM_HASHES; i++) {
+            const uint64_t h = (key.k0 + i * h2) >> 32;
+            locs[i]          = static_cast<uint32_t>((h * shard.nSlots) >> 32);
+        }
+        return locs;
+    }
+
+    static bool SlotHolds(const Shard& shard, uint32_t loc, const Key& key)
+    {
+        return !shard.fCollectable[loc].load(std::memory_order_relaxed) &&
+               shard.words[2 * loc].load(std::memory_order_relaxed) == key.k0 &&
+               shard.words[2 * loc + 1].load(std::memory_order_relaxed) == key.k1;
+    }
+
+    static void StoreSlot(Shard& shard, uint32_t loc, const Key& key)
+    {
+        shard.words[2 * loc].store(key.k0, std::memory_order_relaxed);
+        shard.words[2 * loc + 1].store(key.k1, std::memory_order_relaxed);
+        shard.fCollectable[loc].store(false, std::memory_order_relaxed);
+    }
+
+public:
+    /** Creates a cache taking about nBytes of memory, with at least one slot per shard */
+    explicit CCuckooCache(std::size_t nBytes) : shards(new Shard[NUM_SHARDS])
+    {
+        const std::size_t nSlotBytes = 2 * sizeof(uint64_t) + sizeof(bool);
+        const std::size_t nSlots     = std::max<std::size_t>(1, nBytes / nSlotBytes / NUM_SHARDS);
+        for (std::size_t s = 0; s < NUM_SHARDS; s++) {
+            Shard& shard = shards[s];
+            shard.nSlots = static_cast<uint32_t>(std::min<std::size_t>(nSlots, UINT32_MAX));
+            shard.words.reset(new std::atomic<uint64_t>[2 * shard.nSlots]);
+            shard.fCollectable.reset(new std::atomic<bool>[shard.nSlots]);
+            for (uint32_t i = 0; i < shard.nSlots; i++) {
+                shard.words[2 * i].store(0, std::memory_order_relaxed);
+                shard.words[2 * i + 1].store(0, std::memory_order_relaxed);
+                shard.fCollectable[i].store(true, std::memory_order_relaxed);
+            }
+            // how many keys an insertion may move around before giving up; log2 of the shard size
+            shard.nDepthLimit = 1;
+            while ((uint64_t(1) << shard.nDepthLimit) < shard.nSlots)
+                shard.nDepthLimit++;
+        }
+    }
+
+    CCuckooCache(const CCuckooCache&) = delete;
+    CCuckooCache& operator=(const CCuckooCache&) = delete;
+
+    std::size_t GetSlotCount() const { return NUM_SHARDS * shards[0].nSlots; }
+
+    /**
+     * Whether the key is in the cache. With fErase, a key that is found is erased as well; that is
+     * meant for keys that won't be looked up again, such as those of transactions just mined.
+     */
+    bool contains(const Key& key, bool fErase)
+    {
+        Shard&                                 shard = ShardFor(shards, key);
+        const std::array<uint32_t, NUM_HASHES> locs  = Locations(shard, key);
+        while (true) {
+            const uint32_t nSequence = shard.nSequence.load(std::memory_order_acquire);
+            if (nSequence & 1) {
+                // a writer is in the middle of modifying this shard
+                std::this_thread::yield();
+                continue;
+            }
+            int found = -1;
+            for (int i = 0; i < NUM_HASHES && found < 0; i++) {
+                if (SlotHolds(shard, locs[i], key))
+                    found = static_cast<int>(locs[i]);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (shard.nSequence.load(std::memory_order_relaxed) != nSequence)
+                continue;
+            // Should a writer have moved the key away by now, another key gets marked instead; the
+            // only harm in that is a cache miss later.
+            if (found >= 0 && fErase)
+                shard.fCollectable[found].store(true, std::memory_order_relaxed);
+            return found >= 0;
+        }
+    }
+
+    void insert(const Key& key)
+    {
+        Shard&                           shard = ShardFor(shards, key);
+        std::lock_guard<std::mutex>      lock(shard.mutexWrite);
+        std::array<uint32_t, NUM_HASHES> locs = Locations(shard, key);
+        for (uint32_t loc : locs) {
+            if (SlotHolds(shard, loc, key))
+                return;
+        }
+
+        const uint32_t nSequence = shard.nSequence.load(std::memory_order_relaxed);
+        shard.nSequence.store(nSequence + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        Key      current = key;
+        uint32_t lastLoc = locs[NUM_HASHES - 1];
+        for (uint32_t depth = 0; depth < shard.nDepthLimit; depth++) {
+            bool fStored = false;
+            for (uint32_t loc : locs) {
+                if (shard.fCollectable[loc].load(std::memory_order_relaxed)) {
+                    StoreSlot(shard, loc, current);
+                    fStored = true;
+                    break;
+                }
+            }
+            if (fStored)
+                break;
+
+            // All the slots are taken; swap the key with the occupant of the slot after the one used
+            // last, so that a key moved back and forth doesn't return where it came from
+            int lastIndex = 0;
+            while (lastIndex < NUM_HASHES && locs[lastIndex] != lastLoc)
+                lastIndex++;
+            lastLoc = locs[(lastIndex + 1) % NUM_HASHES];
+
+            const Key evicted = {shard.words[2 * lastLoc].load(std::memory_order_relaxed),
+                                 shard.words[2 * lastLoc + 1].load(std::memory_order_relaxed)};
+            StoreSlot(shard, lastLoc, current);
+            current = evicted;
+            locs    = Locations(shard, current);
+        }
+        // if the depth limit was reached, the last key moved out is dropped
+
+        shard.nSequence.store(nSequence + 2, std::memory_order_release);
+    }
+};
+
+#endif // CUCKOOCACHE_H
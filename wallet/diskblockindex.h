@@ -52,4 +52,28 @@ public:
     void print() const { printf("%s\n", ToString().c_str()); }
 };
 
+/** Chain trust and stake modifier checksum of a block index entry. They're stored in the db right
+ *  after the CDiskBlockIndex record, so that older clients, which stop reading at blockHash, can
+ *  still load the entry, and so that LoadBlockIndex() doesn't have to recompute them. */
+class CDiskBlockIndexTrust
+{
+public:
+    uint256      nChainTrust;
+    unsigned int nStakeModifierChecksum;
+
+    CDiskBlockIndexTrust()
+    {
+        nChainTrust            = 0;
+        nStakeModifierChecksum = 0;
+    }
+
+    explicit CDiskBlockIndexTrust(const CBlockIndex& index)
+    {
+        nChainTrust            = index.nChainTrust;
+        nStakeModifierChecksum = index.nStakeModifierChecksum;
+    }
+
+    IMPLEMENT_SERIALIZE(READWRITE(nChainTrust); READWRITE(nStakeModifierChecksum);)
+};
+
 #endif // DISKBLOCKINDEX_H
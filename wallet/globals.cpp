@@ -1,5 +1,6 @@
 #include "globals.h"
 
+#include "activechain.h"
 #include "txmempool.h"
 
 CTxMemPool              mempool;
@@ -8,11 +9,13 @@ boost::atomic<uint32_t> nTransactionsUpdated{0};
 BlockIndexMapType   mapBlockIndex;
 CBlockIndexSmartPtr pindexBest{nullptr};
 CBlockIndexSmartPtr pindexGenesisBlock = nullptr;
+CActiveChain        activeChain;
 
 bool               fUseFastIndex;
 boost::atomic<int> nBestHeight{-1};
-
-CBlockIndexSmartPtr pblockindexFBBHLast;
+uint64_t           nPruneTarget  = 0;
+bool               fAddressIndex = false;
+bool               fNTP1Index    = false;
 
 boost::atomic<int64_t> NodeIDCounter{0};
 
@@ -8,13 +8,15 @@
 #include <boost/atomic.hpp>
 #include <boost/shared_ptr.hpp>
 #include <map>
+#include <unordered_map>
 
 class CTxMemPool;
 class CBlockIndex;
+class CActiveChain;
 
 using CBlockIndexSmartPtr      = boost::shared_ptr<CBlockIndex>;
 using ConstCBlockIndexSmartPtr = boost::shared_ptr<const CBlockIndex>;
-using BlockIndexMapType        = std::map<uint256, CBlockIndexSmartPtr>;
+using BlockIndexMapType        = std::unordered_map<uint256, CBlockIndexSmartPtr>;
 
 extern CTxMemPool              mempool;
 extern boost::atomic<uint32_t> nTransactionsUpdated;
@@ -23,9 +25,17 @@ extern CCriticalSection    cs_main;
 extern BlockIndexMapType   mapBlockIndex;
 extern CBlockIndexSmartPtr pindexBest;
 extern CBlockIndexSmartPtr pindexGenesisBlock;
+/** The blocks of the chain ending at pindexBest, by height */
+extern CActiveChain        activeChain;
 
 extern bool               fUseFastIndex;
 extern boost::atomic<int> nBestHeight;
+/** -prune target for the size of the blocks db, in bytes; 0 if pruning is disabled */
+extern uint64_t nPruneTarget;
+/** Whether -addressindex is set, and the address index is kept up to date with the main chain */
+extern bool fAddressIndex;
+/** Whether -ntp1index is set, and the NTP1 token index is kept up to date with the main chain */
+extern bool fNTP1Index;
 
 /** The maximum allowed size for a serialized block, in bytes (network rule) */
 static const unsigned int MAX_BLOCK_SIZE     = 8000000;
@@ -49,6 +59,24 @@ static const unsigned int LOCKTIME_THRESHOLD = 500000000; // Tue Nov  5 00:53:20
 static const unsigned int MAX_REJECT_MESSAGE_LENGTH = 111;
 /** Maximum length of the user agent string in `version` message */
 static const unsigned int MAX_SUBVERSION_LENGTH = 256;
+/** Maximum number of script-checking threads allowed */
+static const int MAX_SCRIPTCHECK_THREADS = 16;
+/** -par default (number of script-checking threads, 0 = auto) */
+static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** -maxsigcachemb default, in megabytes */
+static const int64_t DEFAULT_MAX_SIG_CACHE_SIZE = 32;
+/** Upper limit of -maxsigcachemb, in megabytes */
+static const int64_t MAX_MAX_SIG_CACHE_SIZE = 4096;
+/** -dbcache default, in megabytes */
+static const int64_t DEFAULT_DB_CACHE_SIZE = 100;
+/** seconds after which the tx db cache is flushed during initial block download */
+static const int64_t DB_CACHE_FLUSH_INTERVAL = 10 * 60;
+/** Blocks within this depth from the tip are never pruned, so reorgs can disconnect them (~2 days) */
+static const int MIN_BLOCKS_TO_KEEP = 5760;
+/** Minimum -prune target, in megabytes */
+static const uint64_t MIN_PRUNE_TARGET_MB = 550;
+/** seconds after which blocks that weren't prunable before are looked at again */
+static const int64_t PRUNE_RESCAN_INTERVAL = 60 * 60;
 
 static const int64_t COIN_YEAR_REWARD = 10 * CENT; // 10%
 
@@ -61,8 +89,6 @@ extern boost::atomic<int64_t> NodeIDCounter;
 /** Subversion as sent to the P2P network in `version` messages */
 extern std::string strSubVersion;
 
-extern CBlockIndexSmartPtr pblockindexFBBHLast;
-
 namespace Checkpoints {
 /** Checkpointing mode */
 enum CPMode
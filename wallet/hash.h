@@ -121,6 +121,26 @@ inline uint160 Hash160(const std::vector<unsigned char>& vch)
 
 unsigned int MurmurHash3(unsigned int nHashSeed, const std::vector<unsigned char>& vDataToHash);
 
+/** SipHash-2-4, a keyed hash fast enough for hash tables whose keys an attacker may choose */
+class CSipHasher
+{
+    uint64_t v[4];
+    uint64_t tmp;
+    int      count;
+
+public:
+    /** Construct a SipHash calculator initialized with 128-bit key (k0, k1) */
+    CSipHasher(uint64_t k0, uint64_t k1);
+    /** Hash a 64-bit integer worth of data, as if it were 8 little-endian bytes.
+     *  Can only be used when a multiple of 8 bytes have been written so far.
+     */
+    CSipHasher& Write(uint64_t data);
+    /** Hash arbitrary bytes */
+    CSipHasher& Write(const unsigned char* data, size_t size);
+    /** Compute the 64-bit SipHash-2-4 of the data written so far. The object remains untouched. */
+    uint64_t Finalize() const;
+};
+
 template <typename CTXType, int (*InitFunc)(CTXType*), int (*UpdateFunc)(CTXType*, const void*, size_t),
           int (*FinalFunc)(unsigned char*, CTXType*), unsigned DigestSize>
 class HashCalculator
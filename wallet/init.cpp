@@ -42,6 +42,9 @@ boost::atomic<bool>      appInitiated{false};
 
 LockedVar<boost::signals2::signal<void()>> StopRPCRequests;
 
+// file descriptors used by the databases, the logs, the listen sockets and RPC, besides peers
+static const int MIN_CORE_FILEDESCRIPTORS = 150;
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // Shutdown
@@ -115,9 +118,14 @@ void Shutdown(void* /*parg*/)
     if (fFirstThread) {
         fShutdown.store(true, boost::memory_order_seq_cst);
         nTransactionsUpdated++;
+        scriptcheckqueue.Quit();
         //        CTxDB().Close();
         FlushDBWalletTransient(false);
         StopNode();
+        if (glob_db_main) {
+            // write the changes of the last blocks that are still in the tx db cache
+            CTxDB().FlushCache();
+        }
         FlushDBWalletTransient(true);
         boost::filesystem::remove(GetPidFile());
         UnregisterWallet(pwalletMain);
@@ -150,7 +158,7 @@ void HandleSIGHUP(int) { fReopenDebugLog = true; }
 //
 // Start
 //
-#if !defined(QT_GUI) && !defined(NEBLIO_UNITTESTS)
+#if !defined(QT_GUI) && !defined(NEBLIO_UNITTESTS) && !defined(NEBLIO_BENCH)
 bool AppInit(int argc, char* argv[])
 {
     bool fRet = false;
@@ -265,9 +273,17 @@ std::string HelpMessage()
         "  -pid=<file>            " + _("Specify pid file (default: nebliod.pid)") + "\n" +
         "  -datadir=<dir>         " + _("Specify data directory") + "\n" +
         "  -wallet=<dir>          " + _("Specify wallet file (within data directory)") + "\n" +
-        "  -dbcache=<n>           " + _("Set database cache size in megabytes (default: 25)") + "\n" +
+        "  -dbcache=<n>           " + _("Set database cache size in megabytes (default: 100)") + "\n" +
+        "  -prune=<n>             " + _("Delete old blocks whose outputs are all spent to keep the blocks database below <n> megabytes. Pruned blocks can't be served to peers, exported or rescanned (default: 0 = disabled, minimum: 550)") + "\n" +
+        "  -addressindex          " + _("Maintain an index of the transactions of every address, used by the getaddress* RPC calls (default: 0)") + "\n" +
+        "  -ntp1index             " + _("Maintain an index of NTP1 tokens and the token balances of every address, used by the getntp1token* and getntp1addressbalances RPC calls (default: 0)") + "\n" +
         "  -maxorphanblocks=<n>   " + _("Keep at most <n> unconnectable blocks in memory (default: 750)") + "\n" +
+        "  -headersfirst          " + _("Sync headers first and download blocks from all peers in parallel (default: 1)") + "\n" +
         "  -maxorphantx=<n>       " + _("Keep at most <n> unconnectable transactions in memory (default: 100)") + "\n" +
+        "  -maxmempool=<n>        " + _("Keep the transaction memory pool below <n> megabytes (default: 300)") + "\n" +
+        "  -maxsigcachemb=<n>     " + _("Keep at most <n> megabytes of verified signatures in memory (default: 32, maximum: 4096)") + "\n" +
+        "  -maxsigcachesize=<n>   " + _("Keep at most <n> verified signatures in memory; ignored if -maxsigcachemb is set") + "\n" +
+        "  -par=<n>               " + _("Set the number of script verification threads (up to 16, 0 = auto, <0 = leave that many cores free, default: 0)") + "\n" +
         "  -dblogsize=<n>         " + _("Set database disk log size in megabytes (default: 100)") + "\n" +
         "  -timeout=<n>           " + _("Specify connection timeout in milliseconds (default: 5000)") + "\n" +
         "  -proxy=<ip:port>       " + _("Connect through socks proxy") + "\n" +
@@ -276,6 +292,7 @@ std::string HelpMessage()
         "  -dns                   " + _("Allow DNS lookups for -addnode, -seednode and -connect") + "\n" +
         "  -port=<port>           " + _("Listen for connections on <port> (default: 6325 or testnet: 16325)") + "\n" +
         "  -maxconnections=<n>    " + _("Maintain at most <n> connections to peers (default: 125)") + "\n" +
+        "  -msghandlers=<n>       " + _("Use <n> threads to process messages of peers (1-16, default: 4)") + "\n" +
         "  -addnode=<ip>          " + _("Add a node to connect to and attempt to keep the connection open") + "\n" +
         "  -connect=<ip>          " + _("Connect only to the specified node(s)") + "\n" +
         "  -seednode=<ip>         " + _("Connect to a node to retrieve peer addresses, and disconnect") + "\n" +
@@ -326,6 +343,9 @@ std::string HelpMessage()
         "  -rpcpassword=<pw>      " + _("Password for JSON-RPC connections") + "\n" +
         "  -rpcport=<port>        " + _("Listen for JSON-RPC connections on <port> (default: 6326 or testnet: 16326 or regtest: 26326)") + "\n" +
         "  -rpcallowip=<ip>       " + _("Allow JSON-RPC connections from specified IP address") + "\n" +
+        "  -rpcthreads=<n>        " + _("Use <n> threads to run JSON-RPC requests (default: 4)") + "\n" +
+        "  -rpcworkqueue=<n>      " + _("Turn JSON-RPC requests away once <n> of them wait for a thread (default: 16)") + "\n" +
+        "  -rpcservertimeout=<n>  " + _("Close idle keep-alive JSON-RPC connections after <n> seconds (default: 30)") + "\n" +
         "  -rpcconnect=<ip>       " + _("Send commands to node running on <ip> (default: 127.0.0.1)") + "\n" +
         "  -blocknotify=<cmd>     " + _("Execute command when the best block changes (%s in cmd is replaced by block hash)") + "\n" +
         "  -walletnotify=<cmd>    " + _("Execute command when a wallet transaction changes (%s in cmd is replaced by TxID)") + "\n" +
@@ -342,8 +362,7 @@ std::string HelpMessage()
 
         "\n" + _("Block creation options:") + "\n" +
         "  -blockminsize=<n>      "   + _("Set minimum block size in bytes (default: 0)") + "\n" +
-        "  -blockmaxsize=<n>      "   + _("Set maximum block size in bytes (default: 250000)") + "\n" +
-        "  -blockprioritysize=<n> "   + _("Set maximum size of high-priority/low-fee transactions in bytes (default: 27000)") + "\n";
+        "  -blockmaxsize=<n>      "   + _("Set maximum block size in bytes (default: 250000)") + "\n";
     // clang-format on
     return strUsage;
 }
@@ -498,12 +517,60 @@ bool AppInit2()
     fPrintToDebugger = GetBoolArg("-printtodebugger");
     fLogTimestamps   = GetBoolArg("-logtimestamps", true);
 
+    // -par=0 means autodetect, but nScriptCheckThreads==0 means no concurrency
+    nScriptCheckThreads = GetArg("-par", DEFAULT_SCRIPTCHECK_THREADS);
+    if (nScriptCheckThreads <= 0)
+        nScriptCheckThreads += static_cast<int>(boost::thread::hardware_concurrency());
+    if (nScriptCheckThreads <= 1)
+        nScriptCheckThreads = 0;
+    else if (nScriptCheckThreads > MAX_SCRIPTCHECK_THREADS)
+        nScriptCheckThreads = MAX_SCRIPTCHECK_THREADS;
+
+    std::size_t nSigCacheBytes = 0;
+    if (!GetSignatureCacheBytes(nSigCacheBytes))
+        return InitError(strprintf(_("-maxsigcachemb must be between 0 and %d megabytes, and "
+                                     "-maxsigcachesize must be a matching number of signatures"),
+                                   static_cast<int>(MAX_MAX_SIG_CACHE_SIZE)));
+    printf("Using %" PRIszu " bytes for the signature cache\n", nSigCacheBytes);
+
+    // every connection takes a file descriptor, on top of the databases, logs and listen sockets
+    const int nMaxConnections = GetArg("-maxconnections", 125);
+    const int nFD             = RaiseFileDescriptorLimit(nMaxConnections + MIN_CORE_FILEDESCRIPTORS);
+    if (nFD < nMaxConnections + MIN_CORE_FILEDESCRIPTORS) {
+        const int nAllowed = std::max(nFD - MIN_CORE_FILEDESCRIPTORS, 0);
+        InitWarning(strprintf(_("Warning: -maxconnections lowered from %d to %d, because of the limit "
+                                "of open files."),
+                              nMaxConnections, nAllowed));
+        mapArgs.set("-maxconnections", std::to_string(nAllowed));
+    }
+
     if (mapArgs.exists("-timeout")) {
         int nNewTimeout = GetArg("-timeout", 5000);
         if (nNewTimeout > 0 && nNewTimeout < 600000)
             nConnectTimeout = nNewTimeout;
     }
 
+    if (mapArgs.exists("-prune")) {
+        const int64_t nPruneMB = GetArg("-prune", 0);
+        if (nPruneMB < 0)
+            return InitError(_("Invalid value for -prune: it can't be negative"));
+        if (nPruneMB > 0 && static_cast<uint64_t>(nPruneMB) < MIN_PRUNE_TARGET_MB)
+            return InitError(strprintf(_("-prune is set below the minimum of %d megabytes"),
+                                       static_cast<int>(MIN_PRUNE_TARGET_MB)));
+        nPruneTarget = static_cast<uint64_t>(nPruneMB) * 1024 * 1024;
+        if (nPruneTarget > 0) {
+            printf("Pruning blocks to keep the blocks database below %" PRId64 " MiB\n", nPruneMB);
+            // old blocks can't be served anymore
+            nLocalServices &= ~static_cast<uint64_t>(NODE_NETWORK);
+        }
+    }
+
+    fAddressIndex = GetBoolArg("-addressindex", false);
+    fNTP1Index    = GetBoolArg("-ntp1index", false);
+    if (fAddressIndex && nPruneTarget > 0)
+        return InitError(_("-addressindex can't be used with -prune, as reorganizations need the "
+                           "spent outputs of old blocks"));
+
     boost::optional<std::string> payTxFee = mapArgs.get("-paytxfee");
     if (payTxFee) {
         if (!ParseMoney(*payTxFee, nTransactionFee))
@@ -599,6 +666,13 @@ bool AppInit2()
     if (fDaemon)
         fprintf(stdout, "neblio server starting\n");
 
+    // the master thread (the one connecting blocks) works too, so only n-1 workers are started
+    if (nScriptCheckThreads) {
+        printf("Using %d threads for script verification\n", nScriptCheckThreads);
+        for (int i = 0; i < nScriptCheckThreads - 1; i++)
+            NewThread(ThreadScriptCheck, nullptr);
+    }
+
     int64_t nStart;
 
     // ********************************************************* Step 5: verify database integrity
@@ -828,6 +902,17 @@ bool AppInit2()
     }
     printf(" block index %15" PRId64 "ms\n", GetTimeMillis() - nStart);
 
+    {
+        LOCK(cs_main);
+        CTxDB txdb;
+        if (!txdb.SyncAddressIndex(fAddressIndex))
+            return InitError(_("Failed to build the address index; it can't be built after blocks "
+                               "were pruned, unless the blockchain is downloaded again"));
+        if (!txdb.SyncNTP1Index(fNTP1Index))
+            return InitError(_("Failed to build the NTP1 index; it can't be built after blocks were "
+                               "pruned, unless the blockchain is downloaded again"));
+    }
+
     if (GetBoolArg("-printblockindex") || GetBoolArg("-printblocktree")) {
         PrintBlockTree();
         return false;
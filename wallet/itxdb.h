@@ -26,6 +26,10 @@ public:
     virtual bool                 ReadTxIndex(const uint256& hash, CTxIndex& txindex)                 = 0;
     virtual bool                 UpdateTxIndex(const uint256& hash, const CTxIndex& txindex)         = 0;
     virtual bool                 ReadTx(const CDiskTxPos& txPos, CTransaction& tx)                   = 0;
+    virtual bool ReadTxIndexMany(const std::vector<uint256>&              hashes,
+                                 std::vector<boost::optional<CTxIndex>>& txindexes)                  = 0;
+    virtual bool ReadTxMany(const std::vector<CDiskTxPos>&             txPositions,
+                            std::vector<boost::optional<CTransaction>>& txs)                         = 0;
     virtual bool                 ReadNTP1Tx(const uint256& hash, NTP1Transaction& ntp1tx)            = 0;
     virtual bool                 WriteNTP1Tx(const uint256& hash, const NTP1Transaction& ntp1tx)     = 0;
     virtual bool                 ReadAllIssuanceTxs(std::vector<uint256>& txs)                       = 0;
@@ -41,6 +45,9 @@ public:
     virtual bool ReadDiskTx(const uint256& hash, CTransaction& tx)                                   = 0;
     virtual bool ReadDiskTx(const COutPoint& outpoint, CTransaction& tx, CTxIndex& txindex)          = 0;
     virtual bool ReadDiskTx(const COutPoint& outpoint, CTransaction& tx)                             = 0;
+    virtual bool ReadDiskTxMany(const std::vector<uint256>&                  hashes,
+                                std::vector<boost::optional<CTxIndex>>&     txindexes,
+                                std::vector<boost::optional<CTransaction>>& txs)                     = 0;
     virtual bool ReadBlock(const uint256& hash, CBlock& blk, bool fReadTransactions = true)          = 0;
     virtual bool WriteBlock(const uint256& hash, const CBlock& blk)                                  = 0;
     virtual bool WriteBlockIndex(const CDiskBlockIndex& blockindex)                                  = 0;
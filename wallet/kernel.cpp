@@ -330,6 +330,95 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned
     return true;
 }
 
+bool GetStakeKernelPrefix(const CBlock& blockFrom, unsigned int nTxPrevOffset,
+                          const CTransaction& txPrev, const COutPoint& prevout,
+                          CStakeKernelPrefix& prefixRet)
+{
+    int     nStakeModifierHeight = 0;
+    int64_t nStakeModifierTime   = 0;
+    if (!GetKernelStakeModifier(blockFrom.GetHash(), prefixRet.nStakeModifier, nStakeModifierHeight,
+                                nStakeModifierTime, false))
+        return false;
+    prefixRet.nTimeBlockFrom = blockFrom.GetBlockTime();
+    prefixRet.nTxPrevOffset  = nTxPrevOffset;
+    prefixRet.nTimeTxPrev    = txPrev.nTime;
+    prefixRet.nPrevout       = prevout.n;
+    prefixRet.nValueIn       = txPrev.vout[prevout.n].nValue;
+    return true;
+}
+
+// the kernel hash preimage, serialized as CheckStakeKernelHash() does it, with the coinstake time last
+static const std::size_t STAKE_KERNEL_SIZE = 28;
+
+static void WriteLE32(unsigned char* p, uint32_t n)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = static_cast<unsigned char>(n >> (8 * i));
+}
+
+static void WriteStakeKernelPrefix(unsigned char* p, const CStakeKernelPrefix& prefix)
+{
+    WriteLE32(p, static_cast<uint32_t>(prefix.nStakeModifier));
+    WriteLE32(p + 4, static_cast<uint32_t>(prefix.nStakeModifier >> 32));
+    WriteLE32(p + 8, prefix.nTimeBlockFrom);
+    WriteLE32(p + 12, prefix.nTxPrevOffset);
+    WriteLE32(p + 16, prefix.nTimeTxPrev);
+    WriteLE32(p + 20, prefix.nPrevout);
+}
+
+uint256 GetStakeKernelHash(const CStakeKernelPrefix& prefix, unsigned int nTimeTx)
+{
+    unsigned char kernel[STAKE_KERNEL_SIZE];
+    WriteStakeKernelPrefix(kernel, prefix);
+    WriteLE32(kernel + 24, nTimeTx);
+    return Hash(kernel, kernel + STAKE_KERNEL_SIZE);
+}
+
+static CBigNum GetStakeKernelTarget(const CBigNum& bnTargetPerCoinDay, const CStakeKernelPrefix& prefix,
+                                    unsigned int nTimeTx)
+{
+    const CBigNum bnCoinDayWeight = CBigNum(prefix.nValueIn) *
+                                    GetWeight((int64_t)prefix.nTimeTxPrev, (int64_t)nTimeTx) / COIN /
+                                    (24 * 60 * 60);
+    return bnCoinDayWeight * bnTargetPerCoinDay;
+}
+
+bool FindStakeKernelTime(unsigned int nBits, const CStakeKernelPrefix& prefix, unsigned int nTimeTxFirst,
+                         unsigned int nTimeTxLast, unsigned int& nTimeTxRet)
+{
+    // the times that CheckStakeKernelHash() rejects right away
+    const unsigned int nSMA = Params().StakeMinAge();
+    nTimeTxFirst            = std::max(nTimeTxFirst, prefix.nTimeTxPrev);
+    nTimeTxFirst            = std::max(nTimeTxFirst, prefix.nTimeBlockFrom + nSMA);
+    if (nTimeTxFirst > nTimeTxLast)
+        return false;
+
+    CBigNum bnTargetPerCoinDay;
+    bnTargetPerCoinDay.SetCompact(nBits);
+
+    // The target grows with the coin's weight, so no time has a larger one than the latest. Hashes are
+    // compared to that one first, which takes no big number arithmetic, and only those below it are
+    // compared to the target of their own time.
+    const CBigNum bnTargetLast = GetStakeKernelTarget(bnTargetPerCoinDay, prefix, nTimeTxLast);
+    if (bnTargetLast < 0)
+        return false;
+    const uint256 targetLast = bnTargetLast.bitSize() > 256 ? ~uint256(0) : bnTargetLast.getuint256();
+
+    unsigned char kernel[STAKE_KERNEL_SIZE];
+    WriteStakeKernelPrefix(kernel, prefix);
+    for (int64_t nTimeTx = nTimeTxLast; nTimeTx >= nTimeTxFirst; nTimeTx--) {
+        WriteLE32(kernel + 24, static_cast<uint32_t>(nTimeTx));
+        const uint256 hashProofOfStake = Hash(kernel, kernel + STAKE_KERNEL_SIZE);
+        if (hashProofOfStake > targetLast)
+            continue;
+        if (CBigNum(hashProofOfStake) > GetStakeKernelTarget(bnTargetPerCoinDay, prefix, nTimeTx))
+            continue;
+        nTimeTxRet = static_cast<unsigned int>(nTimeTx);
+        return true;
+    }
+    return false;
+}
+
 // Check kernel hash target and coinstake signature
 bool CheckProofOfStake(const CTransaction& tx, unsigned int nBits, uint256& hashProofOfStake,
                        uint256& targetProofOfStake)
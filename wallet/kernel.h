@@ -25,6 +25,31 @@ bool CheckStakeKernelHash(unsigned int nBits, const CBlock& blockFrom, unsigned
                           uint256& hashProofOfStake, uint256& targetProofOfStake,
                           bool fPrintProofOfStake = false);
 
+// What the kernel hash of a staking output is made of, except the coinstake's time. It stays the same as
+// long as the blocks it was taken from stay in the main chain.
+struct CStakeKernelPrefix
+{
+    uint64_t     nStakeModifier;
+    unsigned int nTimeBlockFrom;
+    unsigned int nTxPrevOffset;
+    unsigned int nTimeTxPrev;
+    unsigned int nPrevout;
+    int64_t      nValueIn;
+};
+
+// Get the kernel prefix of a staking output; fails if its stake modifier isn't known yet
+bool GetStakeKernelPrefix(const CBlock& blockFrom, unsigned int nTxPrevOffset,
+                          const CTransaction& txPrev, const COutPoint& prevout,
+                          CStakeKernelPrefix& prefixRet);
+
+// Get the kernel hash of a staking output for a coinstake time
+uint256 GetStakeKernelHash(const CStakeKernelPrefix& prefix, unsigned int nTimeTx);
+
+// Check the kernel hashes of the coinstake times from nTimeTxLast back to nTimeTxFirst, the same way
+// CheckStakeKernelHash() does, and set nTimeTxRet to the latest that meets the hash target
+bool FindStakeKernelTime(unsigned int nBits, const CStakeKernelPrefix& prefix, unsigned int nTimeTxFirst,
+                         unsigned int nTimeTxLast, unsigned int& nTimeTxRet);
+
 // Check kernel hash target and coinstake signature
 // Sets hashProofOfStake on success return
 bool CheckProofOfStake(const CTransaction& tx, unsigned int nBits, uint256& hashProofOfStake,
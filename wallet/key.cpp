@@ -9,6 +9,11 @@
 #include <openssl/ecdsa.h>
 #include <openssl/obj_mac.h>
 
+#ifdef USE_SECP256K1
+#include <secp256k1.h>
+#include <secp256k1_recovery.h>
+#endif
+
 #include "crypto_highlevel.h"
 #include "key.h"
 
@@ -500,7 +505,7 @@ CPubKey CKey::GetPubKey() const
     return CPubKey(vchPubKey);
 }
 
-bool CKey::Sign(uint256 hash, std::vector<unsigned char>& vchSig) const
+bool CKey::SignOpenSSL(uint256 hash, std::vector<unsigned char>& vchSig) const
 {
     vchSig.clear();
     ECDSA_SIG* sig = ECDSA_do_sign((unsigned char*)&hash, sizeof(hash), pkey);
@@ -545,7 +550,7 @@ bool CKey::Sign(uint256 hash, std::vector<unsigned char>& vchSig) const
 // The format is one header byte, followed by two times 32 bytes for the serialized r and s values.
 // The header byte: 0x1B = first key with even y, 0x1C = first key with odd y,
 //                  0x1D = second key with even y, 0x1E = second key with odd y
-bool CKey::SignCompact(uint256 hash, std::vector<unsigned char>& vchSig)
+bool CKey::SignCompactOpenSSL(uint256 hash, std::vector<unsigned char>& vchSig)
 {
     bool       fOk = false;
     ECDSA_SIG* sig = ECDSA_do_sign((unsigned char*)&hash, sizeof(hash), pkey);
@@ -601,7 +606,7 @@ bool CKey::SignCompact(uint256 hash, std::vector<unsigned char>& vchSig)
 // This is only slightly more CPU intensive than just verifying it.
 // If this function succeeds, the recovered public key is guaranteed to be valid
 // (the signature is a valid signature of the given data for that key)
-bool CKey::SetCompactSignature(uint256 hash, const std::vector<unsigned char>& vchSig)
+bool CKey::SetCompactSignatureOpenSSL(uint256 hash, const std::vector<unsigned char>& vchSig)
 {
     if (vchSig.size() != 65)
         return false;
@@ -632,7 +637,8 @@ bool CKey::SetCompactSignature(uint256 hash, const std::vector<unsigned char>& v
     return false;
 }
 
-bool CKey::Verify(uint256 hash, const std::vector<unsigned char>& vchSigParam)
+bool CKey::NormalizeSignatureDER(const std::vector<unsigned char>& vchSigParam,
+                                 std::vector<unsigned char>&       vchNormalized)
 {
     // https://lists.linuxfoundation.org/pipermail/bitcoin-dev/2015-July/009697.html
     std::vector<unsigned char> vchSig(vchSigParam.begin(), vchSigParam.end());
@@ -675,12 +681,167 @@ bool CKey::Verify(uint256 hash, const std::vector<unsigned char>& vchSigParam)
     if (derlen <= 0)
         return false;
 
-    // -1 = error, 0 = bad sig, 1 = good
-    bool ret = ECDSA_verify(0, (unsigned char*)&hash, sizeof(hash), norm_der, derlen, pkey) == 1;
+    vchNormalized.assign(norm_der, norm_der + derlen);
     OPENSSL_free(norm_der);
-    return ret;
+    return true;
+}
+
+bool CKey::VerifyOpenSSL(uint256 hash, const std::vector<unsigned char>& vchSig)
+{
+    std::vector<unsigned char> vchNormalized;
+    if (!NormalizeSignatureDER(vchSig, vchNormalized))
+        return false;
+
+    // -1 = error, 0 = bad sig, 1 = good
+    return ECDSA_verify(0, (unsigned char*)&hash, sizeof(hash), &vchNormalized[0],
+                        vchNormalized.size(), pkey) == 1;
+}
+
+#ifdef USE_SECP256K1
+namespace {
+/** The libsecp256k1 context shared by all keys; it's only ever used read-only after creation */
+const secp256k1_context* GetSecp256k1Context()
+{
+    static const secp256k1_context* ctx = []() {
+        secp256k1_context* c =
+            secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+        if (c == NULL)
+            throw key_error("GetSecp256k1Context() : secp256k1_context_create failed");
+        // blind the signing computations against side-channel attacks
+        uint256 seed = GetRandHash();
+        if (!secp256k1_context_randomize(c, seed.begin()))
+            throw key_error("GetSecp256k1Context() : secp256k1_context_randomize failed");
+        return c;
+    }();
+    return ctx;
+}
+
+/** The private key of a CKey as a 32-byte secret, or an empty one if the key has none */
+CSecret GetSecretForSigning(const CKey& key)
+{
+    if (EC_KEY_get0_private_key(key.getRawKey()) == NULL)
+        return CSecret();
+    bool fCompressed;
+    return key.GetSecret(fCompressed);
+}
+} // namespace
+
+bool CKey::Sign(uint256 hash, std::vector<unsigned char>& vchSig) const
+{
+    vchSig.clear();
+    const CSecret secret = GetSecretForSigning(*this);
+    if (secret.size() != 32)
+        return false;
+    const secp256k1_context*  ctx = GetSecp256k1Context();
+    secp256k1_ecdsa_signature sig;
+    // the signatures made are always low-S, as with OpenSSL above
+    if (!secp256k1_ecdsa_sign(ctx, &sig, hash.begin(), &secret[0], secp256k1_nonce_function_rfc6979,
+                              NULL))
+        return false;
+    size_t nSize = 72;
+    vchSig.resize(nSize);
+    secp256k1_ecdsa_signature_serialize_der(ctx, &vchSig[0], &nSize, &sig);
+    vchSig.resize(nSize);
+    return true;
+}
+
+bool CKey::SignCompact(uint256 hash, std::vector<unsigned char>& vchSig)
+{
+    const CSecret secret = GetSecretForSigning(*this);
+    if (secret.size() != 32)
+        return false;
+    const secp256k1_context*              ctx = GetSecp256k1Context();
+    secp256k1_ecdsa_recoverable_signature sig;
+    if (!secp256k1_ecdsa_sign_recoverable(ctx, &sig, hash.begin(), &secret[0],
+                                          secp256k1_nonce_function_rfc6979, NULL))
+        return false;
+    int nRecId = -1;
+    vchSig.assign(65, 0);
+    secp256k1_ecdsa_recoverable_signature_serialize_compact(ctx, &vchSig[1], &nRecId, &sig);
+    vchSig[0] = nRecId + 27 + (fCompressedPubKey ? 4 : 0);
+    return true;
+}
+
+bool CKey::SetCompactSignature(uint256 hash, const std::vector<unsigned char>& vchSig)
+{
+    if (vchSig.size() != 65)
+        return false;
+    int nV = vchSig[0];
+    if (nV < 27 || nV >= 35)
+        return false;
+    const bool fCompressed = nV >= 31;
+    if (fCompressed)
+        nV -= 4;
+    Reset();
+
+    const secp256k1_context*              ctx = GetSecp256k1Context();
+    secp256k1_ecdsa_recoverable_signature sig;
+    if (!secp256k1_ecdsa_recoverable_signature_parse_compact(ctx, &sig, &vchSig[1], nV - 27))
+        return false;
+    secp256k1_pubkey pubkey;
+    if (!secp256k1_ecdsa_recover(ctx, &pubkey, &sig, hash.begin()))
+        return false;
+    std::vector<unsigned char> vchPubKey(65);
+    size_t                     nSize = vchPubKey.size();
+    const unsigned int         nFlags =
+        fCompressed ? SECP256K1_EC_COMPRESSED : SECP256K1_EC_UNCOMPRESSED;
+    secp256k1_ec_pubkey_serialize(ctx, &vchPubKey[0], &nSize, &pubkey, nFlags);
+    vchPubKey.resize(nSize);
+    return SetPubKey(CPubKey(vchPubKey));
 }
 
+bool CKey::Verify(uint256 hash, const std::vector<unsigned char>& vchSig)
+{
+    if (EC_KEY_get0_public_key(pkey) == NULL)
+        return false;
+
+    // Parse the signature the way OpenSSL does, and have libsecp256k1 parse the strict DER result
+    // of that. Parsing the original with a lax DER parser instead would accept encodings (such as
+    // negative r or s) that OpenSSL rejects, which in turn would make this a fork of the consensus.
+    std::vector<unsigned char> vchNormalized;
+    if (!NormalizeSignatureDER(vchSig, vchNormalized))
+        return false;
+    const secp256k1_context*  ctx = GetSecp256k1Context();
+    secp256k1_ecdsa_signature sig;
+    // out of range or negative values are parsed as r = s = 0, which won't verify
+    if (!secp256k1_ecdsa_signature_parse_der(ctx, &sig, &vchNormalized[0], vchNormalized.size()))
+        return false;
+    // OpenSSL accepts high-S signatures, libsecp256k1 only verifies their low-S equivalent
+    secp256k1_ecdsa_signature_normalize(ctx, &sig, &sig);
+
+    std::vector<unsigned char> vchPubKey = GetPubKey().Raw();
+    // OpenSSL accepts hybrid encoded public keys (0x06/0x07 followed by both coordinates), for
+    // which it has already checked that the parity in the prefix matches y; libsecp256k1 doesn't,
+    // so they're passed on as uncompressed keys
+    if (vchPubKey.size() == 65 && (vchPubKey[0] == 0x06 || vchPubKey[0] == 0x07))
+        vchPubKey[0] = 0x04;
+    secp256k1_pubkey pubkey;
+    if (!secp256k1_ec_pubkey_parse(ctx, &pubkey, &vchPubKey[0], vchPubKey.size()))
+        return false;
+    return secp256k1_ecdsa_verify(ctx, &sig, hash.begin(), &pubkey) == 1;
+}
+#else
+bool CKey::Sign(uint256 hash, std::vector<unsigned char>& vchSig) const
+{
+    return SignOpenSSL(hash, vchSig);
+}
+
+bool CKey::SignCompact(uint256 hash, std::vector<unsigned char>& vchSig)
+{
+    return SignCompactOpenSSL(hash, vchSig);
+}
+
+bool CKey::SetCompactSignature(uint256 hash, const std::vector<unsigned char>& vchSig)
+{
+    return SetCompactSignatureOpenSSL(hash, vchSig);
+}
+
+bool CKey::Verify(uint256 hash, const std::vector<unsigned char>& vchSig)
+{
+    return VerifyOpenSSL(hash, vchSig);
+}
+#endif
+
 bool CKey::IsValid()
 {
     if (!fSet)
@@ -703,6 +864,14 @@ bool ECC_InitSanityCheck()
         return false;
     EC_KEY_free(pkey);
 
+#ifdef USE_SECP256K1
+    try {
+        GetSecp256k1Context();
+    } catch (const key_error&) {
+        return false;
+    }
+#endif
+
     // TODO Is there more EC functionality that could be missing?
     return true;
 }
@@ -132,6 +132,9 @@ public:
     bool     SetPubKey(const CPubKey& vchPubKey);
     CPubKey  GetPubKey() const;
 
+    // The functions below sign and verify with libsecp256k1 when built with USE_SECP256K1, and with
+    // OpenSSL otherwise.
+
     bool Sign(uint256 hash, std::vector<unsigned char>& vchSig) const;
 
     // create a compact signature (65 bytes), which allows reconstructing the used public key
@@ -148,6 +151,19 @@ public:
 
     bool Verify(uint256 hash, const std::vector<unsigned char>& vchSig);
 
+    // The OpenSSL implementations of the functions above; always available, so that the
+    // libsecp256k1 ones can be tested against them.
+    bool SignOpenSSL(uint256 hash, std::vector<unsigned char>& vchSig) const;
+    bool SignCompactOpenSSL(uint256 hash, std::vector<unsigned char>& vchSig);
+    bool SetCompactSignatureOpenSSL(uint256 hash, const std::vector<unsigned char>& vchSig);
+    bool VerifyOpenSSL(uint256 hash, const std::vector<unsigned char>& vchSig);
+
+    // Re-encode a signature the way OpenSSL parses it (tolerating non-canonical DER), so that
+    // whatever verifies it accepts exactly the signatures that have always been accepted.
+    // Returns false if OpenSSL can't parse the signature at all.
+    static bool NormalizeSignatureDER(const std::vector<unsigned char>& vchSig,
+                                      std::vector<unsigned char>&       vchNormalized);
+
     bool IsValid();
 
     // Check whether an element of a signature (r or s) is valid.
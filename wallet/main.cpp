@@ -4,8 +4,10 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "main.h"
+#include "activechain.h"
 #include "alert.h"
 #include "block.h"
+#include "blockdownload.h"
 #include "checkpoints.h"
 #include "db.h"
 #include "disktxpos.h"
@@ -56,6 +58,10 @@ uint256             hashBestChain     = 0;
 int64_t             nTimeBestReceived = 0;
 boost::atomic<bool> fImporting{false};
 
+// batch size of 128 as in bitcoin; script checks are cheap to swap but expensive to run
+CCheckQueue<CScriptCheck> scriptcheckqueue(128);
+int                       nScriptCheckThreads = 0;
+
 CMedianFilter<int> cPeerBlockCounts(5, 0); // Amount of blocks that other nodes claim to have
 
 std::unordered_map<uint256, CBlock*> mapOrphanBlocks;
@@ -65,6 +71,73 @@ set<pair<COutPoint, unsigned int>>   setStakeSeenOrphan;
 map<uint256, CTransaction> mapOrphanTransactions;
 map<uint256, set<uint256>> mapOrphanTransactionsByPrev;
 
+bool static LookupBlockForDownload(const uint256& hash, int& nHeight, uint256& nChainTrust)
+{
+    BlockIndexMapType::iterator mi = mapBlockIndex.find(hash);
+    if (mi == mapBlockIndex.end())
+        return false;
+    CBlockIndexSmartPtr pindex = boost::atomic_load(&mi->second);
+    nHeight                    = pindex->nHeight;
+    nChainTrust                = pindex->nChainTrust;
+    return true;
+}
+
+bool static CheckHeaderForDownload(const CBlock& header, int nHeight, unsigned int& nTrustBits)
+{
+    // the rest of the checks need the transactions of the block
+    if (header.GetBlockTime() > FutureDrift(GetAdjustedTime()))
+        return error("CheckHeaderForDownload() : header %s too far in the future",
+                     header.GetHash().ToString().c_str());
+    if (!Checkpoints::CheckHardened(nHeight, header.GetHash()))
+        return error("CheckHeaderForDownload() : header %s at height %d rejected by checkpoint",
+                     header.GetHash().ToString().c_str(), nHeight);
+    // A header doesn't say whether its block is proof-of-stake, but no coin is old enough to stake
+    // before the stake min age has passed since the genesis block, so until then a block up to the
+    // last proof-of-work block has to meet its target. The kernel of a proof-of-stake block is in
+    // its coinstake, which is checked with the full block.
+    const Consensus::Params& params       = Params().GetConsensus();
+    const int64_t            nStakeMinAge = std::min(params.nStakeMinAgeV1, params.nStakeMinAgeV2);
+    if (nHeight <= Params().LastPoWBlock() &&
+        header.GetBlockTime() < Params().GenesisBlock().GetBlockTime() + nStakeMinAge) {
+        if (!CheckProofOfWork(header.GetPoWHash(), header.nBits))
+            return error("CheckHeaderForDownload() : header %s at height %d has invalid proof-of-work",
+                         header.GetHash().ToString().c_str(), nHeight);
+        nTrustBits = header.nBits;
+        return true;
+    }
+    // Nothing backs the target of the other headers, which could be set to make them outrank the
+    // real chain, so they count as if they had the easiest target a block can have
+    nTrustBits = std::max(Params().PoWLimit(), Params().PoSLimit()).GetCompact();
+    return true;
+}
+
+CBlockDownloader blockDownloader(LookupBlockForDownload, CheckHeaderForDownload);
+
+bool static HeadersFirst()
+{
+    static const bool fHeadersFirst = GetBoolArg("-headersfirst", true);
+    return fHeadersFirst;
+}
+
+void static PushGetHeaders(CNode* pnode, const uint256& hashStop = uint256(0))
+{
+    // continue from the tip of the header chain if there's one
+    uint256              hashBase;
+    std::vector<uint256> vHashes    = blockDownloader.GetLocatorHashes(hashBase);
+    // to ask for the tip itself, start from its parent
+    if (hashStop != 0 && !vHashes.empty() && vHashes.front() == hashStop)
+        vHashes.erase(vHashes.begin());
+    CBlockIndexSmartPtr  pindexFrom = boost::atomic_load(&pindexBest);
+    if (!vHashes.empty()) {
+        BlockIndexMapType::iterator mi = mapBlockIndex.find(hashBase);
+        if (mi != mapBlockIndex.end())
+            pindexFrom = boost::atomic_load(&mi->second);
+    }
+    pnode->PushMessage("getheaders", CBlockLocator(vHashes, pindexFrom.get()), hashStop);
+}
+
+void FinalizeNode(int64_t nodeid) { blockDownloader.RemovePeer(nodeid); }
+
 // Constant stuff for coinbase transactions we create:
 CScript COINBASE_FLAGS;
 
@@ -429,7 +502,7 @@ Result<void, TxValidationState> AcceptToMemoryPool(CTxMemPool& pool, const CTran
         return Err(MakeInvalidTxState(TxValidationResult::TX_CONFLICT, "txn-already-in-mempool"));
 
     // Check for conflicts with in-memory transactions
-    CTransaction* ptxOld = NULL;
+    const CTransaction* ptxOld = NULL;
     {
         LOCK(pool.cs); // protect pool.mapNextTx
         for (unsigned int i = 0; i < tx.vin.size(); i++) {
@@ -460,6 +533,7 @@ Result<void, TxValidationState> AcceptToMemoryPool(CTxMemPool& pool, const CTran
         }
     }
 
+    int64_t nFees = 0;
     {
         /**
          * Using a pointer from the outside is important because a new instance of the database does not
@@ -503,7 +577,7 @@ Result<void, TxValidationState> AcceptToMemoryPool(CTxMemPool& pool, const CTran
         // you should add code here to check that the transaction does a
         // reasonable number of ECDSA signature verifications.
 
-        const int64_t      nFees = tx.GetValueIn(mapInputs) - tx.GetValueOut();
+        nFees                    = tx.GetValueIn(mapInputs) - tx.GetValueOut();
         const unsigned int nSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
 
         // Don't accept it if it can't get into a block
@@ -577,23 +651,51 @@ Result<void, TxValidationState> AcceptToMemoryPool(CTxMemPool& pool, const CTran
     }
 
     // Store transaction in memory
+    uint256 hashOld;
+    bool    fAccepted = false;
+    bool    fOldKept  = false;
     {
         LOCK(pool.cs);
+        // the pool owns the old transaction, so it is copied out before being replaced, to be put
+        // back if the new version doesn't make it past the size limit
+        std::unique_ptr<CTxMemPoolEntry> oldEntry;
+        std::set<uint256>                setOldParents;
         if (ptxOld) {
-            printf("AcceptToMemoryPool : replacing tx %s with new version\n",
-                   ptxOld->GetHash().ToString().c_str());
+            hashOld  = ptxOld->GetHash();
+            oldEntry = std::unique_ptr<CTxMemPoolEntry>(new CTxMemPoolEntry(*pool.mapTx.find(hashOld)));
+            for (const CTxIn& txin : ptxOld->vin)
+                if (pool.exists(txin.prevout.hash))
+                    setOldParents.insert(txin.prevout.hash);
+            printf("AcceptToMemoryPool : replacing tx %s with new version\n", hashOld.ToString().c_str());
             pool.remove(*ptxOld);
         }
-        pool.addUnchecked(hash, tx);
+        pool.addUnchecked(CTxMemPoolEntry(tx, nFees, GetTime()));
+
+        // Keep the pool within its memory bound by evicting the transactions paying the lowest fee
+        // rate; this one may be among them
+        pool.TrimToSize(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) * 1000000);
+        fAccepted = pool.exists(hash);
+        if (!fAccepted && oldEntry) {
+            // the old version only goes back if the trim didn't take its in-pool parents as well
+            fOldKept = true;
+            for (const uint256& parentHash : setOldParents)
+                if (!pool.exists(parentHash))
+                    fOldKept = false;
+            if (fOldKept)
+                pool.addUnchecked(*oldEntry);
+        }
     }
 
     ///// are we sure this is ok when loading transactions or restoring block txes
     // If updated, erase old tx from wallet
-    if (ptxOld)
-        EraseFromWallets(ptxOld->GetHash());
+    if (ptxOld && !fOldKept)
+        EraseFromWallets(hashOld);
+
+    if (!fAccepted)
+        return Err(MakeInvalidTxState(TxValidationResult::TX_MEMPOOL_POLICY, "mempool full"));
 
     printf("AcceptToMemoryPool : accepted %s (poolsz %" PRIszu ")\n",
-           hash.ToString().substr(0, 10).c_str(), pool.mapTx.size());
+           hash.ToString().substr(0, 10).c_str(), pool.size());
 
     return Ok();
 }
@@ -611,8 +713,14 @@ bool GetTransaction(const uint256& hash, CTransaction& tx, uint256& hashBlock)
         CTxDB    txdb("r");
         CTxIndex txindex;
         if (tx.ReadFromDisk(txdb, COutPoint(hash, 0), txindex)) {
+            // the block is keyed by its hash, so its header only has to be read if it's not indexed
+            BlockIndexMapType::iterator mi = mapBlockIndex.find(txindex.pos.nBlockPos);
+            if (mi != mapBlockIndex.end()) {
+                hashBlock = mi->second->GetBlockHash();
+                return true;
+            }
             CBlock block;
-            if (block.ReadFromDisk(txindex.pos.nBlockPos, false))
+            if (block.ReadFromDisk(txindex.pos.nBlockPos, txdb, false))
                 hashBlock = block.GetHash();
             return true;
         }
@@ -620,6 +728,106 @@ bool GetTransaction(const uint256& hash, CTransaction& tx, uint256& hashBlock)
     return false;
 }
 
+// A block is only read again to connect the blocks that spend its outputs, so it can be pruned once all
+// of them are spent by blocks that no reorg will disconnect. Outputs that can't be spent don't count.
+// Blocks with NTP1 transactions are kept, as token issuances are read to validate later ones.
+static bool IsBlockPrunable(const CBlock& block, const uint256& blockKey, int nSafeHeight, CTxDB& txdb)
+{
+    std::vector<uint256> hashes;
+    hashes.reserve(block.vtx.size());
+    for (const CTransaction& tx : block.vtx) {
+        hashes.push_back(tx.GetHash());
+        if (txdb.ContainsNTP1Tx(hashes.back()))
+            return false;
+    }
+    std::vector<boost::optional<CTxIndex>> txindexes;
+    if (!txdb.ReadTxIndexMany(hashes, txindexes))
+        return false;
+    for (unsigned i = 0; i < block.vtx.size(); i++) {
+        // a transaction that's indexed in another block has a duplicate there
+        if (!txindexes[i] || txindexes[i]->pos.nBlockPos != blockKey)
+            return false;
+        const std::vector<CTxOut>& vout = block.vtx[i].vout;
+        for (unsigned n = 0; n < txindexes[i]->vSpent.size() && n < vout.size(); n++) {
+            const CDiskTxPos& spent = txindexes[i]->vSpent[n];
+            if (spent.IsNull()) {
+                if (vout[n].IsEmpty() ||
+                    (!vout[n].scriptPubKey.empty() && vout[n].scriptPubKey[0] == OP_RETURN))
+                    continue;
+                return false;
+            }
+            BlockIndexMapType::const_iterator mi = mapBlockIndex.find(spent.nBlockPos);
+            if (mi == mapBlockIndex.cend() || mi->second->nHeight > nSafeHeight)
+                return false;
+        }
+    }
+    return true;
+}
+
+bool PruneBlockStore(CTxDB& txdb)
+{
+    AssertLockHeld(cs_main);
+
+    // the tx indexes decide what's prunable, and have to be in the db first; otherwise, a crash would
+    // bring back older ones that still need the pruned blocks
+    if (nPruneTarget == 0 || TxDBCache().HasUnflushedChanges())
+        return true;
+    const uint64_t nSize = txdb.GetBlocksDbSize();
+    if (nSize <= nPruneTarget)
+        return true;
+    const int nSafeHeight = nBestHeight - MIN_BLOCKS_TO_KEEP;
+    if (nSafeHeight <= 1)
+        return true;
+
+    // blocks are looked at from the oldest ones on, continuing where the last call stopped; once all the
+    // old enough ones were looked at, they're looked at again every PRUNE_RESCAN_INTERVAL, as more of
+    // their outputs are spent by then. During the initial download, this only runs after the tx db cache
+    // was flushed, so more blocks are looked at in one go.
+    const int      nMaxBlocksScanned = IsInitialBlockDownload() ? 100000 : 5000;
+    static int64_t nLastRescanTime   = 0;
+    int            nHeight           = 0;
+    if (!txdb.ReadPruneScanHeight(nHeight))
+        return error("PruneBlockStore(): failed to read the prune scan height");
+    if (nHeight >= nSafeHeight) {
+        if (GetTime() - nLastRescanTime < PRUNE_RESCAN_INTERVAL)
+            return true;
+        nLastRescanTime = GetTime();
+        nHeight         = 0;
+    }
+    // the genesis block is always kept
+    nHeight = std::max(nHeight, 1);
+
+    const int64_t        nStart  = GetTimeMillis();
+    const uint64_t       nToFree = nSize - nPruneTarget;
+    uint64_t             nFreed  = 0;
+    std::vector<uint256> vPrunable;
+    for (int nScanned = 0; nHeight < nSafeHeight && nScanned < nMaxBlocksScanned && nFreed < nToFree;
+         nHeight++, nScanned++) {
+        CBlockIndexSmartPtr pindex = activeChain.AtHeight(nHeight);
+        if (!pindex)
+            break;
+        if (!txdb.ContainsBlock(pindex->blockKeyInDB))
+            continue;
+        CBlock block;
+        if (!block.ReadFromDisk(pindex->blockKeyInDB, txdb, true))
+            continue;
+        if (IsBlockPrunable(block, pindex->blockKeyInDB, nSafeHeight, txdb)) {
+            vPrunable.push_back(pindex->blockKeyInDB);
+            nFreed += ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+        }
+    }
+
+    if (!txdb.PruneBlocks(vPrunable))
+        return error("PruneBlockStore(): failed to prune %" PRIszu " blocks", vPrunable.size());
+    if (!txdb.WritePruneScanHeight(nHeight))
+        return error("PruneBlockStore(): failed to write the prune scan height");
+    if (!vPrunable.empty()) {
+        printf("Pruned %" PRIszu " blocks (%" PRIu64 " kB) below height %d in %" PRId64 "ms\n",
+               vPrunable.size(), nFreed / 1024, nHeight, GetTimeMillis() - nStart);
+    }
+    return true;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // CBlock and CBlockIndex
@@ -1160,7 +1368,10 @@ bool ProcessBlock(CNode* pfrom, CBlock* pblock)
 
         // Ask this guy to fill in what we're missing
         if (pfrom) {
-            pfrom->PushGetBlocks(boost::atomic_load(&pindexBest).get(), GetOrphanRoot(pblock2));
+            if (HeadersFirst())
+                PushGetHeaders(pfrom);
+            else
+                pfrom->PushGetBlocks(boost::atomic_load(&pindexBest).get(), GetOrphanRoot(pblock2));
             // ppcoin: getblocks may not obtain the ancestor block rejected
             // earlier by duplicate-stake check so we ask for it again directly
             if (!IsInitialBlockDownload())
@@ -1195,6 +1406,17 @@ bool ProcessBlock(CNode* pfrom, CBlock* pblock)
     return true;
 }
 
+void static ProcessHeldBlocks()
+{
+    AssertLockHeld(cs_main);
+
+    CBlock block;
+    while (blockDownloader.TakeConnectableBlock(block)) {
+        if (!ProcessBlock(nullptr, &block) && block.nDoS)
+            blockDownloader.BlockFailed(block.GetHash());
+    }
+}
+
 CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter& filter)
 {
     header = block.GetBlockHeader();
@@ -1474,6 +1696,21 @@ bool LoadExternalBlockFile(FILE* fileIn)
 
     int nLoaded = 0;
     {
+        // blocks are read in batches, so that their headers are hashed together
+        static const std::size_t BLOCK_BATCH_SIZE = 16;
+        std::vector<CBlock>      vBatch;
+        auto                     processBatch = [&]() {
+            std::vector<CBlock> vBlocks;
+            vBlocks.swap(vBatch);
+            CBlock::PrecomputeHashes(vBlocks);
+            for (CBlock& block : vBlocks) {
+                LOCK(cs_main);
+                if (ProcessBlock(NULL, &block)) {
+                    nLoaded++;
+                }
+            }
+        };
+
         try {
             CAutoFile    blkdat(fileIn, SER_DISK, CLIENT_VERSION);
             unsigned int nPos = 0;
@@ -1519,19 +1756,24 @@ bool LoadExternalBlockFile(FILE* fileIn)
                 if (nSize > 0 && nSize <= nSizeLimit) {
                     CBlock block;
                     blkdat >> block;
+                    vBatch.push_back(block);
                     printf("Reading block at file pos: %u\n", nPos);
+                    nPos += 4 + nSize;
 
-                    LOCK(cs_main);
-
-                    if (ProcessBlock(NULL, &block)) {
-                        nLoaded++;
-                        nPos += 4 + nSize;
+                    if (vBatch.size() >= BLOCK_BATCH_SIZE) {
+                        processBatch();
                     }
                 }
             }
         } catch (std::exception& e) {
             printf("%s() : Deserialize or I/O error caught during load\n", __PRETTY_FUNCTION__);
         }
+        // the blocks read before the end of the file or an error
+        try {
+            processBatch();
+        } catch (std::exception& e) {
+            printf("%s() : Error caught while processing blocks\n", __PRETTY_FUNCTION__);
+        }
     }
     printf("Loaded %i blocks from external file in %" PRId64 "ms\n", nLoaded, GetTimeMillis() - nStart);
     return nLoaded > 0;
@@ -1588,6 +1830,15 @@ void ThreadImport(void* data)
     vnThreadsRunning[THREAD_IMPORT]--;
 }
 
+void ThreadScriptCheck(void* /*parg*/)
+{
+    RenameThread("neblio-scriptch");
+
+    vnThreadsRunning[THREAD_SCRIPTCHECK]++;
+    scriptcheckqueue.Thread();
+    vnThreadsRunning[THREAD_SCRIPTCHECK]--;
+}
+
 //////////////////////////////////////////////////////////////////////////////
 //
 // CAlert
@@ -1752,11 +2003,16 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
             }
         }
 
+        // only full nodes can serve the blocks of the header chain
+        if (!pfrom->fClient)
+            blockDownloader.AddPeer(pfrom->nodeid);
+
         // Ask the first connected node for block updates
         // For regtest, we need to sync immediately after connection; this is important for tests that
         // split and reconnect the network
+        // With headers-first, SendMessages() syncs the headers and downloads the blocks instead
         static int nAskedForBlocks = 0;
-        if ((!pfrom->fClient && !pfrom->fOneShot && !fImporting) &&
+        if ((!HeadersFirst() && !pfrom->fClient && !pfrom->fOneShot && !fImporting) &&
             (((pfrom->nStartingHeight > (nBestHeight - 144)) &&
               (pfrom->nVersion < NOBLKS_VERSION_START || pfrom->nVersion >= NOBLKS_VERSION_END) &&
               (nAskedForBlocks < 1 || vNodes.size() <= 1)) ||
@@ -1871,20 +2127,29 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
                 break;
             }
         }
+        for (const CInv& inv : vInv)
+            pfrom->AddInventoryKnown(inv);
+
+        // what we already have is chain state
+        LOCK(cs_main);
         CTxDB txdb("r");
+        bool  fGetHeaders = false;
         for (unsigned int nInv = 0; nInv < vInv.size(); nInv++) {
             const CInv& inv = vInv[nInv];
 
             if (fShutdown)
                 return true;
-            pfrom->AddInventoryKnown(inv);
 
             bool fAlreadyHave = AlreadyHave(txdb, inv);
             if (fDebug)
                 printf("  got inventory: %s  %s\n", inv.ToString().c_str(),
                        fAlreadyHave ? "have" : "new");
 
-            if (!fAlreadyHave) {
+            if (HeadersFirst() && inv.type == MSG_BLOCK) {
+                // new blocks come through their headers, which get them downloaded
+                if (!fImporting && (!fAlreadyHave || mapOrphanBlocks.count(inv.hash)))
+                    fGetHeaders = true;
+            } else if (!fAlreadyHave) {
                 if (!fImporting)
                     pfrom->AskFor(inv);
             } else if (inv.type == MSG_BLOCK && mapOrphanBlocks.count(inv.hash)) {
@@ -1901,6 +2166,8 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
             // Track requests for our stuff
             Inventory(inv.hash);
         }
+        if (fGetHeaders)
+            PushGetHeaders(pfrom);
     }
 
     else if (strCommand == "getdata") {
@@ -1914,6 +2181,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
         if (fDebugNet || (vInv.size() != 1))
             printf("received getdata (%" PRIszu " invsz)\n", vInv.size());
 
+        vector<CInv> vNotFound;
         for (const CInv& inv : vInv) {
             if (fShutdown)
                 return true;
@@ -1921,11 +2189,22 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
                 printf("received getdata for: %s\n", inv.ToString().c_str());
 
             if (inv.type == MSG_BLOCK || inv.type == MSG_FILTERED_BLOCK) {
-                // Send block from disk
-                BlockIndexMapType::iterator mi = mapBlockIndex.find(inv.hash);
-                if (mi != mapBlockIndex.end()) {
+                // Send block from disk; the block index is only locked to find it, not to read it
+                CBlockIndexSmartPtr pindex;
+                {
+                    LOCK(cs_main);
+                    BlockIndexMapType::iterator mi = mapBlockIndex.find(inv.hash);
+                    if (mi != mapBlockIndex.end())
+                        pindex = boost::atomic_load(&mi->second);
+                }
+                if (pindex) {
                     CBlock block;
-                    block.ReadFromDisk(boost::atomic_load(&mi->second).get());
+                    if (!block.ReadFromDisk(pindex.get())) {
+                        // blocks that were pruned can't be served
+                        printf("getdata: block %s is not available\n", inv.hash.ToString().c_str());
+                        vNotFound.push_back(inv);
+                        continue;
+                    }
                     if (inv.type == MSG_BLOCK)
                         pfrom->PushMessage("block", block);
                     else // MSG_FILTERED_BLOCK)
@@ -1941,9 +2220,15 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
                             // spec specified allows for us to provide duplicate txn here, however we
                             // MUST always provide at least what the remote peer needs
                             typedef std::pair<unsigned int, uint256> PairType;
-                            for (PairType& pair : merkleBlock.vMatchedTxn)
-                                if (!pfrom->setInventoryKnown.count(CInv(MSG_TX, pair.second)))
+                            for (PairType& pair : merkleBlock.vMatchedTxn) {
+                                bool fKnown;
+                                {
+                                    LOCK(pfrom->cs_inventory);
+                                    fKnown = pfrom->setInventoryKnown.count(CInv(MSG_TX, pair.second));
+                                }
+                                if (!fKnown)
                                     pfrom->PushMessage("tx", block.vtx[pair.first]);
+                            }
                             pfrom->PushMessage("merkleblock", merkleBlock);
                         }
                         // else
@@ -1955,6 +2240,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
                         // ppcoin: send latest proof-of-work block to allow the
                         // download node to accept as orphan (proof-of-stake
                         // block might be rejected by stake connection check)
+                        LOCK(cs_main);
                         vector<CInv> vInv;
                         vInv.push_back(
                             CInv(MSG_BLOCK, GetLastBlockIndex(pindexBest.get(), false)->GetBlockHash()));
@@ -1987,6 +2273,10 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
             // Track requests for our stuff
             Inventory(inv.hash);
         }
+
+        // let the peer ask someone else instead of waiting for the blocks to time out
+        if (!vNotFound.empty())
+            pfrom->PushMessage("notfound", vNotFound);
     }
 
     else if (strCommand == "getblocks") {
@@ -2038,7 +2328,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
             BlockIndexMapType::iterator mi = mapBlockIndex.find(hashStop);
             if (mi == mapBlockIndex.end())
                 return true;
-            CBlockIndexSmartPtr pindex = boost::atomic_load(&mi->second);
+            pindex = boost::atomic_load(&mi->second);
         } else {
             // Find the last block the caller has in the main chain
             pindex = locator.GetBlockIndex();
@@ -2047,7 +2337,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
         }
 
         vector<CBlock> vHeaders;
-        int            nLimit = 2000;
+        int            nLimit = MAX_HEADERS_RESULTS;
         printf("getheaders %d to %s\n", (pindex ? pindex->nHeight : -1), hashStop.ToString().c_str());
         for (; pindex; pindex = pindex->pnext) {
             vHeaders.push_back(pindex->GetBlockHeader());
@@ -2057,6 +2347,48 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
         pfrom->PushMessage("headers", vHeaders);
     }
 
+    else if (strCommand == "headers") {
+        vector<CBlock> vHeaders;
+        vRecv >> vHeaders;
+        if (vHeaders.size() > MAX_HEADERS_RESULTS) {
+            pfrom->Misbehaving(20);
+            return error("message headers size() = %" PRIszu "", vHeaders.size());
+        }
+
+        CBlock::PrecomputeHashes(vHeaders);
+        switch (blockDownloader.AcceptHeaders(pfrom->nodeid, vHeaders)) {
+        case CBlockDownloader::HeadersResult::Invalid:
+            pfrom->Misbehaving(20);
+            return error("invalid headers from %s", pfrom->addr.ToString().c_str());
+        case CBlockDownloader::HeadersResult::Unconnected:
+            // we're missing the headers before them
+            PushGetHeaders(pfrom);
+            return true;
+        case CBlockDownloader::HeadersResult::Accepted:
+            break;
+        }
+
+        // a full message means there are more
+        if (vHeaders.size() == MAX_HEADERS_RESULTS &&
+            blockDownloader.GetBestHeaderHeight() < nBestHeight + HEADERS_DOWNLOAD_AHEAD &&
+            blockDownloader.StartHeadersSync(pfrom->nodeid, GetTime()))
+            PushGetHeaders(pfrom);
+    }
+
+    else if (strCommand == "notfound") {
+        vector<CInv> vInv;
+        vRecv >> vInv;
+        if (vInv.size() > MAX_INV_SZ) {
+            pfrom->Misbehaving(20);
+            return error("message notfound size() = %" PRIszu "", vInv.size());
+        }
+
+        // a pruned peer may not have every block it has the header of
+        for (const CInv& inv : vInv)
+            if (inv.type == MSG_BLOCK)
+                blockDownloader.BlockNotFound(pfrom->nodeid, inv.hash);
+    }
+
     else if (strCommand == "tx") {
         vector<uint256> vWorkQueue;
         vector<uint256> vEraseQueue;
@@ -2133,11 +2465,20 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
         CInv inv(MSG_BLOCK, hashBlock);
         pfrom->AddInventoryKnown(inv);
 
+        // a block we downloaded ahead of its parent waits for it
+        if (blockDownloader.BlockReceived(hashBlock) && !mapBlockIndex.count(hashBlock) &&
+            !mapBlockIndex.count(block.hashPrevBlock) && blockDownloader.HoldBlock(block))
+            return true;
+
         if (ProcessBlock(pfrom, &block)) {
             mapAlreadyAskedFor.erase(inv);
-        } else if (block.reject) {
-            pfrom->PushMessage("reject", std::string("block"), block.reject->chRejectCode,
-                               block.reject->strRejectReason, block.reject->hashBlock);
+            ProcessHeldBlocks();
+        } else {
+            if (block.nDoS)
+                blockDownloader.BlockFailed(hashBlock);
+            if (block.reject)
+                pfrom->PushMessage("reject", std::string("block"), block.reject->chRejectCode,
+                                   block.reject->strRejectReason, block.reject->hashBlock);
         }
 
         if (block.nDoS) {
@@ -2148,7 +2489,10 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
     else if (strCommand == "getaddr") {
         // Don't return addresses older than nCutOff timestamp
         int64_t nCutOff = GetTime() - (nNodeLifespan * 24 * 60 * 60);
-        pfrom->vAddrToSend.clear();
+        {
+            LOCK(pfrom->cs_vAddrToSend);
+            pfrom->vAddrToSend.clear();
+        }
         vector<CAddress> vAddr = addrman.get().GetAddr();
         for (const CAddress& addr : vAddr)
             if (addr.nTime > nCutOff)
@@ -2272,6 +2616,16 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv)
     return true;
 }
 
+// Messages that change no chain state. The message handler threads process them for different peers
+// at the same time, where every other message is serialized by cs_main; their handlers lock cs_main
+// themselves for the chain state they read.
+static bool IsConcurrentMessage(const std::string& strCommand)
+{
+    return strCommand == "verack" || strCommand == "addr" || strCommand == "getaddr" ||
+           strCommand == "inv" || strCommand == "getdata" || strCommand == "ping" ||
+           strCommand == "filterload" || strCommand == "filteradd" || strCommand == "filterclear";
+}
+
 // requires LOCK(cs_vRecvMsg)
 bool ProcessMessages(CNode* pfrom)
 {
@@ -2342,7 +2696,9 @@ bool ProcessMessages(CNode* pfrom)
         // Process message
         bool fRet = false;
         try {
-            {
+            if (IsConcurrentMessage(strCommand)) {
+                fRet = ProcessMessage(pfrom, strCommand, vRecv);
+            } else {
                 LOCK(cs_main);
                 fRet = ProcessMessage(pfrom, strCommand, vRecv);
             }
@@ -2408,8 +2764,10 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
                 LOCK(cs_vNodes);
                 for (CNode* pnode : vNodes) {
                     // Periodically clear setAddrKnown to allow refresh broadcasts
-                    if (nLastRebroadcast)
+                    if (nLastRebroadcast) {
+                        LOCK(pnode->cs_vAddrToSend);
                         pnode->setAddrKnown.clear();
+                    }
 
                     // Rebroadcast our address
                     if (!fNoListen) {
@@ -2426,22 +2784,23 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         // Message: addr
         //
         if (fSendTrickle) {
-            vector<CAddress> vAddr;
-            vAddr.reserve(pto->vAddrToSend.size());
-            for (const CAddress& addr : pto->vAddrToSend) {
-                // returns true if wasn't already contained in the set
-                if (pto->setAddrKnown.insert(addr).second) {
-                    vAddr.push_back(addr);
-                    // receiver rejects addr messages larger than 1000
-                    if (vAddr.size() >= 1000) {
-                        pto->PushMessage("addr", vAddr);
-                        vAddr.clear();
-                    }
+            vector<CAddress> vAddrNew;
+            {
+                LOCK(pto->cs_vAddrToSend);
+                vAddrNew.reserve(pto->vAddrToSend.size());
+                for (const CAddress& addr : pto->vAddrToSend) {
+                    // returns true if wasn't already contained in the set
+                    if (pto->setAddrKnown.insert(addr).second)
+                        vAddrNew.push_back(addr);
                 }
+                pto->vAddrToSend.clear();
             }
-            pto->vAddrToSend.clear();
-            if (!vAddr.empty())
+            // receiver rejects addr messages larger than 1000
+            for (std::size_t i = 0; i < vAddrNew.size(); i += 1000) {
+                vector<CAddress> vAddr(vAddrNew.begin() + i,
+                                       vAddrNew.begin() + min(i + 1000, vAddrNew.size()));
                 pto->PushMessage("addr", vAddr);
+            }
         }
 
         //
@@ -2495,6 +2854,43 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
         if (!vInv.empty())
             pto->PushMessage("inv", vInv);
 
+        //
+        // Message: getheaders and getdata for the headers-first block download
+        //
+        if (HeadersFirst() && !pto->fClient && !pto->fOneShot && !fImporting) {
+            const int64_t nNowSeconds = GetTime();
+            if (blockDownloader.IsStalling(pto->nodeid, nNowSeconds)) {
+                printf("peer %s is stalling the block download, disconnecting\n",
+                       pto->addr.ToString().c_str());
+                pto->fDisconnect = true;
+                return true;
+            }
+
+            // the headers of a peer that left were dropped with the blocks it didn't deliver, so
+            // this peer is asked for the blocks it has past ours, whose headers it then sends
+            if (blockDownloader.TakeHeadersDropped())
+                pto->PushGetBlocks(pindexBest.get(), uint256(0));
+
+            const int nBestHeaderHeight =
+                std::max<int>(nBestHeight, blockDownloader.GetBestHeaderHeight());
+
+            // blocks are only requested from peers that have sent their headers, so the others are
+            // asked for the tip of the header chain
+            uint256 hashTip;
+            if (pto->nStartingHeight > nBestHeaderHeight &&
+                nBestHeaderHeight < nBestHeight + HEADERS_DOWNLOAD_AHEAD &&
+                blockDownloader.StartHeadersSync(pto->nodeid, nNowSeconds))
+                PushGetHeaders(pto);
+            else if (blockDownloader.StartTipCheck(pto->nodeid, hashTip))
+                PushGetHeaders(pto, hashTip);
+
+            vector<CInv> vBlocksToGet;
+            for (const uint256& hash : blockDownloader.RequestBlocks(pto->nodeid, nNowSeconds))
+                vBlocksToGet.push_back(CInv(MSG_BLOCK, hash));
+            if (!vBlocksToGet.empty())
+                pto->PushMessage("getdata", vBlocksToGet);
+        }
+
         //
         // Message: getdata
         //
@@ -2685,7 +3081,10 @@ void ExportBootstrapBlockchain(const filesystem::path& filename, std::atomic<boo
                 throw std::runtime_error("Operation was stopped.");
             }
             CBlock block;
-            block.ReadFromDisk(blockIndex, true);
+            if (!block.ReadFromDisk(blockIndex, true)) {
+                throw std::runtime_error("Failed to read block " + blockIndex->GetBlockHash().ToString() +
+                                         "; blocks that were pruned can't be exported.");
+            }
 
             // every block starts with pchMessageStart
             unsigned int nSize = block.GetSerializeSize(SER_DISK, CLIENT_VERSION);
@@ -2842,7 +3241,10 @@ void ExportBootstrapBlockchainWithOrphans(const filesystem::path& filename, std:
                 throw std::runtime_error("Operation was stopped.");
             }
             CBlock block;
-            block.ReadFromDisk(h, true);
+            if (!block.ReadFromDisk(h, true)) {
+                throw std::runtime_error("Failed to read block " + h.ToString() +
+                                         "; blocks that were pruned can't be exported.");
+            }
 
             // every block starts with pchMessageStart
             unsigned int nSize = block.GetSerializeSize(SER_DISK, CLIENT_VERSION);
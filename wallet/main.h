@@ -9,6 +9,7 @@
 #include "block.h"
 #include "blockindex.h"
 #include "blockindexcatalog.h"
+#include "checkqueue.h"
 #include "globals.h"
 #include "net.h"
 #include "outpoint.h"
@@ -82,6 +83,8 @@ extern CCriticalSection                             cs_setpwalletRegistered;
 extern std::set<std::shared_ptr<CWallet>>           setpwalletRegistered;
 extern std::unordered_map<uint256, CBlock*>         mapOrphanBlocks;
 extern boost::atomic<bool>                          fImporting;
+extern CCheckQueue<CScriptCheck>                    scriptcheckqueue;
+extern int                                          nScriptCheckThreads;
 
 // Settings
 extern CAmount      nTransactionFee;
@@ -109,7 +112,10 @@ bool               LoadBlockIndex(bool fAllowNew = true);
 void               PrintBlockTree();
 bool               ProcessMessages(CNode* pfrom);
 bool               SendMessages(CNode* pto, bool fSendTrickle);
+/** Drops what the block download keeps for a peer that disconnected */
+void               FinalizeNode(int64_t nodeid);
 void               ThreadImport(void* parg);
+void               ThreadScriptCheck(void* parg);
 bool               CheckProofOfWork(const uint256& hash, unsigned int nBits, bool silent = false);
 unsigned int       GetNextTargetRequired(const CBlockIndex* pindexLast, bool fProofOfStake);
 unsigned int       ComputeMinWork(unsigned int nBase, int64_t nTime);
@@ -120,6 +126,8 @@ bool               IsInitialBlockDownload_tolerant();
 bool               __IsInitialBlockDownload_internal();
 std::string        GetWarnings(std::string strFor);
 bool               GetTransaction(const uint256& hash, CTransaction& tx, uint256& hashBlock);
+/** Deletes old blocks whose outputs are all spent while the blocks db is larger than -prune */
+bool               PruneBlockStore(CTxDB& txdb);
 uint256            WantedByOrphan(const CBlock* pblockOrphan);
 const CBlockIndex* GetLastBlockIndex(const CBlockIndex* pindex, bool fProofOfStake);
 void               StakeMiner(CWallet* pwallet);
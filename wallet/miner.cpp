@@ -57,25 +57,18 @@ void SHA256Transform(void* pstate, void* pinput, const void* pinit)
         ((uint32_t*)pstate)[i] = ctx.h[i];
 }
 
-// Some explaining would be appreciated
+// A mempool transaction that waits for some of its in-pool parents to be added to the block first
 class COrphan
 {
 public:
-    CTransaction* ptx;
-    set<uint256>  setDependsOn;
-    double        dPriority;
-    double        dFeePerKb;
+    const CTxMemPoolEntry* pentry;
+    set<uint256>           setDependsOn;
 
-    COrphan(CTransaction* ptxIn)
-    {
-        ptx       = ptxIn;
-        dPriority = dFeePerKb = 0;
-    }
+    COrphan(const CTxMemPoolEntry* pentryIn) { pentry = pentryIn; }
 
     void print() const
     {
-        printf("COrphan(hash=%s, dPriority=%.1f, dFeePerKb=%.1f)\n",
-               ptx->GetHash().ToString().substr(0, 10).c_str(), dPriority, dFeePerKb);
+        printf("COrphan(hash=%s)\n", pentry->GetHash().ToString().substr(0, 10).c_str());
         for (uint256 hash : setDependsOn)
             printf("   setDependsOn %s\n", hash.ToString().substr(0, 10).c_str());
     }
@@ -85,28 +78,6 @@ uint64_t   nLastBlockTx   = 0;
 uint64_t   nLastBlockSize = 0;
 StakeMaker stakeMaker;
 
-// We want to sort transactions by priority and fee, so:
-typedef boost::tuple<double, double, CTransaction*> TxPriority;
-class TxPriorityCompare
-{
-    bool byFee;
-
-public:
-    TxPriorityCompare(bool _byFee) : byFee(_byFee) {}
-    bool operator()(const TxPriority& a, const TxPriority& b)
-    {
-        if (byFee) {
-            if (a.get<1>() == b.get<1>())
-                return a.get<0>() < b.get<0>();
-            return a.get<1>() < b.get<1>();
-        } else {
-            if (a.get<0>() == b.get<0>())
-                return a.get<1>() < b.get<1>();
-            return a.get<0>() < b.get<0>();
-        }
-    }
-};
-
 // CreateNewBlock: create new block (without proof-of-work/proof-of-stake)
 std::unique_ptr<CBlock> CreateNewBlock(CWallet* pwallet, bool fProofOfStake, int64_t* pFees,
                                        const boost::optional<CBitcoinAddress>& PoWDestination)
@@ -161,11 +132,6 @@ std::unique_ptr<CBlock> CreateNewBlock(CWallet* pwallet, bool fProofOfStake, int
     nBlockMaxSize =
         std::max(1000u, std::min(static_cast<unsigned int>(nSizeLimit - 1000), nBlockMaxSize));
 
-    // How much of the block should be dedicated to high-priority transactions,
-    // included regardless of the fees they pay
-    unsigned int nBlockPrioritySize = GetArg("-blockprioritysize", 27000);
-    nBlockPrioritySize              = std::min(nBlockMaxSize, nBlockPrioritySize);
-
     // Minimum block size you want to create; block will be filled with free transactions
     // until there are no more or the block reaches this size:
     unsigned int nBlockMinSize = GetArg("-blockminsize", 0);
@@ -194,127 +160,45 @@ std::unique_ptr<CBlock> CreateNewBlock(CWallet* pwallet, bool fProofOfStake, int
         LOCK2(cs_main, mempool.cs);
         CTxDB txdb("r");
 
-        // Priority order to process transactions
-        list<COrphan>                  vOrphan; // list memory doesn't move
-        map<uint256, vector<COrphan*>> mapDependers;
-
-        // This vector will be sorted into a priority queue:
-        vector<TxPriority> vecPriority;
-        vecPriority.reserve(mempool.mapTx.size());
-        for (map<uint256, CTransaction>::iterator mi = mempool.mapTx.begin(); mi != mempool.mapTx.end();
-             ++mi) {
-            CTransaction& tx = (*mi).second;
-            if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, pindexPrev->nHeight + 1))
-                continue;
-
-            COrphan* porphan        = nullptr;
-            double   dPriority      = 0;
-            int64_t  nTotalIn       = 0;
-            bool     fMissingInputs = false;
-            for (const CTxIn& txin : tx.vin) {
-                // Read prev transaction
-                CTransaction txPrev;
-                CTxIndex     txindex;
-                if (!txPrev.ReadFromDisk(txdb, txin.prevout, txindex)) {
-                    // This should never happen; all transactions in the memory
-                    // pool should connect to either transactions in the chain
-                    // or other transactions in the memory pool.
-                    if (!mempool.mapTx.count(txin.prevout.hash)) {
-                        printf("ERROR: mempool transaction missing input\n");
-                        if (fDebug)
-                            assert("mempool transaction missing input" == 0);
-                        fMissingInputs = true;
-                        if (porphan)
-                            vOrphan.pop_back();
-                        break;
-                    }
-
-                    // Has to wait for dependencies
-                    if (!porphan) {
-                        // Use list for automatic deletion
-                        vOrphan.push_back(COrphan(&tx));
-                        porphan = &vOrphan.back();
-                    }
-                    mapDependers[txin.prevout.hash].push_back(porphan);
-                    porphan->setDependsOn.insert(txin.prevout.hash);
-                    nTotalIn += mempool.mapTx[txin.prevout.hash].vout[txin.prevout.n].nValue;
-                    continue;
-                }
-                int64_t nValueIn = txPrev.vout[txin.prevout.n].nValue;
-                nTotalIn += nValueIn;
-
-                int nConf = txindex.GetDepthInMainChain();
-                dPriority += (double)nValueIn * nConf;
-            }
-            if (fMissingInputs)
-                continue;
-
-            // Priority is sum(valuein * age) / txsize
-            unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-            dPriority /= nTxSize;
-
-            // This is a more accurate fee-per-kilobyte than is used by the client code, because the
-            // client code rounds up the size to the nearest 1K. That's good, because it gives an
-            // incentive to create smaller transactions.
-            double dFeePerKb = double(nTotalIn - tx.GetValueOut()) / (double(nTxSize) / 1000.0);
-
-            if (porphan) {
-                porphan->dPriority = dPriority;
-                porphan->dFeePerKb = dFeePerKb;
-            } else
-                vecPriority.push_back(TxPriority(dPriority, dFeePerKb, &(*mi).second));
-        }
-
         // Collect transactions into block
         map<uint256, CTxIndex> mapTestPool;
         uint64_t               nBlockSize   = 1000;
         uint64_t               nBlockTx     = 0;
         int                    nBlockSigOps = 100;
-        bool                   fSortedByFee = (nBlockPrioritySize <= 0);
 
         map<uint256, std::vector<std::pair<CTransaction, NTP1Transaction>>> mapQueuedNTP1Inputs;
 
-        TxPriorityCompare comparer(fSortedByFee);
-        std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
-
-        while (!vecPriority.empty()) {
-            // Take highest priority transaction off the priority queue:
-            double        dPriority = vecPriority.front().get<0>();
-            double        dFeePerKb = vecPriority.front().get<1>();
-            CTransaction& tx        = *(vecPriority.front().get<2>());
-
-            std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
-            vecPriority.pop_back();
+        // Tries to add a mempool transaction to the block; returns true if it was added
+        auto addToBlock = [&](const CTxMemPoolEntry& entry) -> bool {
+            const CTransaction& tx = entry.GetTx();
 
             // Size limits
-            unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+            const unsigned int nTxSize = entry.GetTxSize();
             if (nBlockSize + nTxSize >= nBlockMaxSize)
-                continue;
+                return false;
 
             // Legacy limits on sigOps:
             unsigned int nTxSigOps = tx.GetLegacySigOpCount();
             if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS)
-                continue;
+                return false;
 
             // Timestamp limit
             if (tx.nTime > GetAdjustedTime() || (fProofOfStake && tx.nTime > pblock->vtx[0].nTime))
-                continue;
+                return false;
 
-            // Transaction fee
-            int64_t nMinFee = tx.GetMinFee(nBlockSize, GMF_BLOCK);
+            // This is a more accurate fee-per-kilobyte than is used by the client code, because the
+            // client code rounds up the size to the nearest 1K. That's good, because it gives an
+            // incentive to create smaller transactions.
+            const double dFeePerKb = double(entry.GetFee()) / (double(nTxSize) / 1000.0);
 
             // Skip free transactions if we're past the minimum block size:
-            if (fSortedByFee && (dFeePerKb < nMinTxFee) && (nBlockSize + nTxSize >= nBlockMinSize))
-                continue;
+            if ((dFeePerKb < nMinTxFee) && (nBlockSize + nTxSize >= nBlockMinSize))
+                return false;
 
-            // Prioritize by fee once past the priority size or we run out of high-priority
-            // transactions:
-            if (!fSortedByFee &&
-                ((nBlockSize + nTxSize >= nBlockPrioritySize) || (dPriority < COIN * 144 / 250))) {
-                fSortedByFee = true;
-                comparer     = TxPriorityCompare(fSortedByFee);
-                std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
-            }
+            // Transaction fee
+            int64_t nMinFee = tx.GetMinFee(nBlockSize, GMF_BLOCK);
+            if (entry.GetFee() < nMinFee)
+                return false;
 
             // Connecting shouldn't fail due to dependency on other memory pool transactions
             // because we're already processing them in order of dependency
@@ -327,15 +211,15 @@ std::unique_ptr<CBlock> CreateNewBlock(CWallet* pwallet, bool fProofOfStake, int
             MapPrevTx mapInputs;
             bool      fInvalid;
             if (!tx.FetchInputs(txdb, mapTestPoolTmp, false, true, mapInputs, fInvalid))
-                continue;
+                return false;
 
             int64_t nTxFees = tx.GetValueIn(mapInputs) - tx.GetValueOut();
             if (nTxFees < nMinFee)
-                continue;
+                return false;
 
             nTxSigOps += tx.GetP2SHSigOpCount(mapInputs);
             if (nBlockSigOps + nTxSigOps >= MAX_BLOCK_SIGOPS)
-                continue;
+                return false;
 
             try {
                 std::string opRet;
@@ -370,21 +254,21 @@ std::unique_ptr<CBlock> CreateNewBlock(CWallet* pwallet, bool fProofOfStake, int
                        "CreateNewBlock(): "
                        "%s\n",
                        ex.what());
-                continue;
+                return false;
             } catch (...) {
                 printf("Error while mining and verifying the uniqueness of issued token symbol in "
                        "CreateNewBlock(). "
                        "Unknown exception thrown\n");
-                continue;
+                return false;
             }
 
             if (tx.ConnectInputs(mapInputs, mapTestPoolTmp, CDiskTxPos(1, 1), pindexPrev, false, true)
                     .isErr())
-                continue;
+                return false;
 
-            mapTestPoolTmp[tx.GetHash()] = CTxIndex(CDiskTxPos(1, 1), tx.vout.size());
+            mapTestPoolTmp[entry.GetHash()] = CTxIndex(CDiskTxPos(1, 1), tx.vout.size());
             swap(mapTestPool, mapTestPoolTmp);
-            mapQueuedNTP1InputsTmp[tx.GetHash()] = inputsTxs;
+            mapQueuedNTP1InputsTmp[entry.GetHash()] = inputsTxs;
             swap(mapQueuedNTP1Inputs, mapQueuedNTP1InputsTmp);
 
             // Added
@@ -395,22 +279,55 @@ std::unique_ptr<CBlock> CreateNewBlock(CWallet* pwallet, bool fProofOfStake, int
             nFees += nTxFees;
 
             if (fDebug) {
-                printf("priority %.1f feeperkb %.1f txid %s\n", dPriority, dFeePerKb,
-                       tx.GetHash().ToString().c_str());
+                printf("feeperkb %.1f txid %s\n", dFeePerKb, entry.GetHash().ToString().c_str());
             }
+            return true;
+        };
 
-            // Add transactions that depend on this one to the priority queue
-            uint256 hash = tx.GetHash();
-            if (mapDependers.count(hash)) {
-                for (COrphan* porphan : mapDependers[hash]) {
-                    if (!porphan->setDependsOn.empty()) {
-                        porphan->setDependsOn.erase(hash);
-                        if (porphan->setDependsOn.empty()) {
-                            vecPriority.push_back(
-                                TxPriority(porphan->dPriority, porphan->dFeePerKb, porphan->ptx));
-                            std::push_heap(vecPriority.begin(), vecPriority.end(), comparer);
-                        }
-                    }
+        // Transactions whose in-pool parents aren't in the block yet wait here
+        list<COrphan>                  vOrphan; // list memory doesn't move
+        map<uint256, vector<COrphan*>> mapDependers;
+        std::set<uint256>              setInBlock;
+
+        // The pool keeps its transactions sorted by ancestor fee rate, so filling the block is a single
+        // walk over that index; a transaction that shows up before one of its parents waits for it.
+        const auto& byAncestorScore = mempool.mapTx.get<AncestorScoreTag>();
+        for (const CTxMemPoolEntry& entry : byAncestorScore) {
+            const CTransaction& tx = entry.GetTx();
+            if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, pindexPrev->nHeight + 1))
+                continue;
+
+            COrphan* porphan = nullptr;
+            for (const CTxIn& txin : tx.vin) {
+                const uint256& parentHash = txin.prevout.hash;
+                if (!mempool.mapTx.count(parentHash) || setInBlock.count(parentHash))
+                    continue;
+                if (!porphan) {
+                    vOrphan.push_back(COrphan(&entry));
+                    porphan = &vOrphan.back();
+                }
+                if (porphan->setDependsOn.insert(parentHash).second)
+                    mapDependers[parentHash].push_back(porphan);
+            }
+            if (porphan)
+                continue;
+
+            std::vector<const CTxMemPoolEntry*> vToAdd(1, &entry);
+            while (!vToAdd.empty()) {
+                const CTxMemPoolEntry* pentry = vToAdd.back();
+                vToAdd.pop_back();
+                if (!addToBlock(*pentry))
+                    continue;
+                setInBlock.insert(pentry->GetHash());
+
+                // Add transactions that depend on this one, now that nothing they need is missing
+                const auto itDependers = mapDependers.find(pentry->GetHash());
+                if (itDependers == mapDependers.end())
+                    continue;
+                for (COrphan* pdepender : itDependers->second) {
+                    pdepender->setDependsOn.erase(pentry->GetHash());
+                    if (pdepender->setDependsOn.empty())
+                        vToAdd.push_back(pdepender->pentry);
                 }
             }
         }
@@ -421,8 +338,10 @@ std::unique_ptr<CBlock> CreateNewBlock(CWallet* pwallet, bool fProofOfStake, int
         if (fDebug)
             printf("CreateNewBlock(): total size %" PRIu64 "\n", nBlockSize);
 
-        if (!fProofOfStake)
+        if (!fProofOfStake) {
             pblock->vtx[0].vout[0].nValue = GetProofOfWorkReward(nFees);
+            pblock->vtx[0].InvalidateHash();
+        }
 
         if (pFees)
             *pFees = nFees;
@@ -453,6 +372,7 @@ void IncrementExtraNonce(CBlock* pblock, CBlockIndex* pindexPrev, unsigned int&
         pindexPrev->nHeight + 1; // Height first in coinbase required for block.version=2
     pblock->vtx[0].vin[0].scriptSig = (CScript() << nHeight << CBigNum(nExtraNonce)) + COINBASE_FLAGS;
     assert(pblock->vtx[0].vin[0].scriptSig.size() <= 100);
+    pblock->vtx[0].InvalidateHash();
 
     pblock->hashMerkleRoot = pblock->GetMerkleRoot();
 }
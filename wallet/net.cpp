@@ -18,6 +18,11 @@
 #include <string.h>
 #endif
 
+#ifdef __linux__
+#define USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 #ifdef USE_UPNP
 #include <miniupnpc/miniupnpc.h>
 #include <miniupnpc/miniwget.h>
@@ -70,6 +75,11 @@ deque<pair<int64_t, CInv>>          vRelayExpiration;
 CCriticalSection                    cs_mapRelay;
 ThreadSafeHashMap<CInv, int64_t>    mapAlreadyAskedFor;
 
+#ifdef USE_EPOLL
+// nodes added to vNodes that the network thread didn't start watching yet, guarded by cs_vNodes
+static vector<CNode*> vNodesToWatch;
+#endif
+
 static deque<string> vOneShots;
 CCriticalSection     cs_vOneShots;
 
@@ -477,6 +487,9 @@ CNode* ConnectNode(CAddress addrConnect, const char* pszDest)
         {
             LOCK(cs_vNodes);
             vNodes.push_back(pnode);
+#ifdef USE_EPOLL
+            vNodesToWatch.push_back(pnode);
+#endif
         }
 
         pnode->nTimeConnected = GetTime();
@@ -715,75 +728,218 @@ void ThreadSocketHandler(void* parg)
     printf("ThreadSocketHandler exited\n");
 }
 
-void ThreadSocketHandler2(void* /*parg*/)
+// Removes the nodes that are done from vNodes, and deletes the removed ones no thread uses anymore.
+// The nodes removed now are added to pvRemoved.
+static void DisconnectNodes(list<CNode*>& vNodesDisconnected, vector<CNode*>* pvRemoved = nullptr)
 {
-    printf("ThreadSocketHandler started\n");
-    list<CNode*> vNodesDisconnected;
-    unsigned int nPrevNodeCount = 0;
+    LOCK(cs_vNodes);
+    // Disconnect unused nodes
+    for (vector<CNode*>::iterator it = vNodes.begin(); it != vNodes.end();) {
+        CNode* pnode = *it;
+        if (pnode->fDisconnect || (pnode->GetRefCount() <= 0 && pnode->vRecvMsg.empty() &&
+                                   pnode->nSendSize == 0 && pnode->ssSend.empty())) {
+            // remove from vNodes
+            it = vNodes.erase(it);
+#ifdef USE_EPOLL
+            vNodesToWatch.erase(remove(vNodesToWatch.begin(), vNodesToWatch.end(), pnode),
+                                vNodesToWatch.end());
+#endif
 
-    while (true) {
-        //
-        // Disconnect nodes
-        //
-        {
-            LOCK(cs_vNodes);
-            // Disconnect unused nodes
-            vector<CNode*> vNodesCopy = vNodes;
-            BOOST_FOREACH (CNode* pnode, vNodesCopy) {
-                if (pnode->fDisconnect || (pnode->GetRefCount() <= 0 && pnode->vRecvMsg.empty() &&
-                                           pnode->nSendSize == 0 && pnode->ssSend.empty())) {
-                    // remove from vNodes
-                    vNodes.erase(remove(vNodes.begin(), vNodes.end(), pnode), vNodes.end());
-
-                    // release outbound grant (if any)
-                    pnode->grantOutbound.Release();
-
-                    // close socket and cleanup
-                    pnode->CloseSocketDisconnect();
+            // release outbound grant (if any)
+            pnode->grantOutbound.Release();
 
-                    // hold in disconnected pool until all refs are released
-                    if (pnode->fNetworkNode || pnode->fInbound)
-                        pnode->Release();
-                    vNodesDisconnected.push_back(pnode);
-                }
-            }
+            // close socket and cleanup
+            pnode->CloseSocketDisconnect();
+            FinalizeNode(pnode->nodeid);
 
-            // Delete disconnected nodes
-            list<CNode*> vNodesDisconnectedCopy = vNodesDisconnected;
-            BOOST_FOREACH (CNode* pnode, vNodesDisconnectedCopy) {
-                // wait until threads are done using it
-                if (pnode->GetRefCount() <= 0) {
-                    bool fDelete = false;
-                    {
-                        TRY_LOCK(pnode->cs_vSend, lockSend);
-                        if (lockSend) {
-                            TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                            if (lockRecv) {
-                                TRY_LOCK(pnode->cs_mapRequests, lockReq);
-                                if (lockReq) {
-                                    TRY_LOCK(pnode->cs_inventory, lockInv);
-                                    if (lockInv)
-                                        fDelete = true;
-                                }
-                            }
-                        }
-                    }
-                    if (fDelete) {
-                        vNodesDisconnected.remove(pnode);
-                        delete pnode;
+            // hold in disconnected pool until all refs are released
+            if (pnode->fNetworkNode || pnode->fInbound)
+                pnode->Release();
+            vNodesDisconnected.push_back(pnode);
+            if (pvRemoved)
+                pvRemoved->push_back(pnode);
+        } else {
+            ++it;
+        }
+    }
+
+    // Delete disconnected nodes
+    for (list<CNode*>::iterator it = vNodesDisconnected.begin(); it != vNodesDisconnected.end();) {
+        CNode* pnode = *it;
+        // wait until threads are done using it
+        bool fDelete = false;
+        if (pnode->GetRefCount() <= 0) {
+            TRY_LOCK(pnode->cs_vSend, lockSend);
+            if (lockSend) {
+                TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+                if (lockRecv) {
+                    TRY_LOCK(pnode->cs_mapRequests, lockReq);
+                    if (lockReq) {
+                        TRY_LOCK(pnode->cs_inventory, lockInv);
+                        if (lockInv)
+                            fDelete = true;
                     }
                 }
             }
         }
-        std::size_t vNodesSize = 0;
+        if (fDelete) {
+            it = vNodesDisconnected.erase(it);
+            delete pnode;
+        } else {
+            ++it;
+        }
+    }
+}
+
+static void NotifyConnectionCount(unsigned int& nPrevNodeCount)
+{
+    std::size_t vNodesSize = 0;
+    {
+        LOCK(cs_vNodes);
+        vNodesSize = vNodes.size();
+    }
+    if (vNodesSize != nPrevNodeCount) {
+        nPrevNodeCount = vNodesSize;
+        uiInterface.NotifyNumConnectionsChanged(vNodesSize);
+    }
+}
+
+// Accepts a connection waiting on the listen socket; returns the new node, or nullptr
+static CNode* AcceptConnection(SOCKET hListenSocket)
+{
+    struct sockaddr_storage sockaddr;
+    socklen_t               len = sizeof(sockaddr);
+    SOCKET   hSocket            = accept(hListenSocket, (struct sockaddr*)&sockaddr, &len);
+    CAddress addr;
+    int      nInbound = 0;
+
+    if (hSocket != INVALID_SOCKET)
+        if (!addr.SetSockAddr((const struct sockaddr*)&sockaddr))
+            printf("Warning: Unknown socket family\n");
+
+    {
+        LOCK(cs_vNodes);
+        BOOST_FOREACH (CNode* pnode, vNodes)
+            if (pnode->fInbound)
+                nInbound++;
+    }
+
+    if (hSocket == INVALID_SOCKET) {
+        int nErr = WSAGetLastError();
+        if (nErr != WSAEWOULDBLOCK)
+            printf("socket error accept failed: %d\n", nErr);
+    } else if (nInbound >= GetArg("-maxconnections", 125) - MAX_OUTBOUND_CONNECTIONS) {
+        closesocket(hSocket);
+    } else if (CNode::IsBanned(addr)) {
+        printf("connection from %s dropped (banned)\n", addr.ToString().c_str());
+        closesocket(hSocket);
+    } else {
+        printf("accepted connection %s\n", addr.ToString().c_str());
+        CNode* pnode = new CNode(NodeIDCounter++, hSocket, addr, "", true);
+        pnode->AddRef();
         {
             LOCK(cs_vNodes);
-            vNodesSize = vNodes.size();
+            vNodes.push_back(pnode);
+#ifdef USE_EPOLL
+            vNodesToWatch.push_back(pnode);
+#endif
         }
-        if (vNodesSize != nPrevNodeCount) {
-            nPrevNodeCount = vNodesSize;
-            uiInterface.NotifyNumConnectionsChanged(vNodesSize);
+        return pnode;
+    }
+    return nullptr;
+}
+
+enum class SocketRecvResult
+{
+    Received,
+    WouldBlock, // nothing left to read for now
+    Busy,       // couldn't read now, try again later
+    Closed
+};
+
+// Reads once from the node's socket
+static SocketRecvResult ReceiveFromNode(CNode* pnode)
+{
+    TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
+    if (!lockRecv)
+        return SocketRecvResult::Busy;
+
+    if (pnode->GetTotalRecvSize() > ReceiveFloodSize()) {
+        if (!pnode->fDisconnect)
+            printf("socket recv flood control disconnect (%u bytes)\n", pnode->GetTotalRecvSize());
+        pnode->CloseSocketDisconnect();
+        return SocketRecvResult::Closed;
+    }
+
+    // typical socket buffer is 8K-64K
+    char pchBuf[0x10000];
+    int  nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
+    if (nBytes > 0) {
+        pnode->nLastRecv = GetTime();
+        if (!pnode->ReceiveMsgBytes(pchBuf, nBytes)) {
+            pnode->CloseSocketDisconnect();
+            return SocketRecvResult::Closed;
         }
+        return SocketRecvResult::Received;
+    } else if (nBytes == 0) {
+        // socket closed gracefully
+        if (!pnode->fDisconnect)
+            printf("socket closed\n");
+        pnode->CloseSocketDisconnect();
+        return SocketRecvResult::Closed;
+    }
+
+    // error
+    int nErr = WSAGetLastError();
+    if (nErr == WSAEWOULDBLOCK)
+        return SocketRecvResult::WouldBlock;
+    if (nErr != WSAEMSGSIZE && nErr != WSAEINTR && nErr != WSAEINPROGRESS) {
+        if (!pnode->fDisconnect)
+            printf("socket recv error %d\n", nErr);
+        pnode->CloseSocketDisconnect();
+        return SocketRecvResult::Closed;
+    }
+    return SocketRecvResult::Busy;
+}
+
+static void InactivityCheck(CNode* pnode)
+{
+    {
+        TRY_LOCK(pnode->cs_vSend, lockSend);
+        if (lockSend && pnode->vSendMsg.empty())
+            pnode->nLastSendEmpty = GetTime();
+    }
+    if (GetTime() - pnode->nTimeConnected > 60) {
+        if (pnode->nLastRecv == 0 || pnode->nLastSend == 0) {
+            printf("socket no message in first 60 seconds, %d %d\n", pnode->nLastRecv != 0,
+                   pnode->nLastSend != 0);
+            pnode->fDisconnect = true;
+        } else if (GetTime() - pnode->nLastSend > 90 * 60 &&
+                   GetTime() - pnode->nLastSendEmpty > 90 * 60) {
+            printf("socket not sending\n");
+            pnode->fDisconnect = true;
+        } else if (GetTime() - pnode->nLastRecv > 90 * 60) {
+            printf("socket inactivity timeout\n");
+            pnode->fDisconnect = true;
+        }
+    }
+}
+
+// Polls all the sockets with select() on every loop. The number of sockets is limited by FD_SETSIZE.
+static void SocketHandlerSelect()
+{
+    list<CNode*> vNodesDisconnected;
+    unsigned int nPrevNodeCount = 0;
+
+    while (true) {
+#ifdef USE_EPOLL
+        {
+            LOCK(cs_vNodes);
+            vNodesToWatch.clear();
+        }
+#endif
+        DisconnectNodes(vNodesDisconnected);
+        NotifyConnectionCount(nPrevNodeCount);
 
         //
         // Find which sockets have data to receive
@@ -849,43 +1005,8 @@ void ThreadSocketHandler2(void* /*parg*/)
         // Accept new connections
         //
         for (SOCKET hListenSocket : vhListenSocket)
-            if (hListenSocket != INVALID_SOCKET && FD_ISSET(hListenSocket, &fdsetRecv)) {
-                struct sockaddr_storage sockaddr;
-                socklen_t               len = sizeof(sockaddr);
-                SOCKET   hSocket            = accept(hListenSocket, (struct sockaddr*)&sockaddr, &len);
-                CAddress addr;
-                int      nInbound = 0;
-
-                if (hSocket != INVALID_SOCKET)
-                    if (!addr.SetSockAddr((const struct sockaddr*)&sockaddr))
-                        printf("Warning: Unknown socket family\n");
-
-                {
-                    LOCK(cs_vNodes);
-                    BOOST_FOREACH (CNode* pnode, vNodes)
-                        if (pnode->fInbound)
-                            nInbound++;
-                }
-
-                if (hSocket == INVALID_SOCKET) {
-                    int nErr = WSAGetLastError();
-                    if (nErr != WSAEWOULDBLOCK)
-                        printf("socket error accept failed: %d\n", nErr);
-                } else if (nInbound >= GetArg("-maxconnections", 125) - MAX_OUTBOUND_CONNECTIONS) {
-                    closesocket(hSocket);
-                } else if (CNode::IsBanned(addr)) {
-                    printf("connection from %s dropped (banned)\n", addr.ToString().c_str());
-                    closesocket(hSocket);
-                } else {
-                    printf("accepted connection %s\n", addr.ToString().c_str());
-                    CNode* pnode = new CNode(NodeIDCounter++, hSocket, addr, "", true);
-                    pnode->AddRef();
-                    {
-                        LOCK(cs_vNodes);
-                        vNodes.push_back(pnode);
-                    }
-                }
-            }
+            if (hListenSocket != INVALID_SOCKET && FD_ISSET(hListenSocket, &fdsetRecv))
+                AcceptConnection(hListenSocket);
 
         //
         // Service each socket
@@ -906,40 +1027,8 @@ void ThreadSocketHandler2(void* /*parg*/)
             //
             if (pnode->hSocket == INVALID_SOCKET)
                 continue;
-            if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError)) {
-                TRY_LOCK(pnode->cs_vRecvMsg, lockRecv);
-                if (lockRecv) {
-                    if (pnode->GetTotalRecvSize() > ReceiveFloodSize()) {
-                        if (!pnode->fDisconnect)
-                            printf("socket recv flood control disconnect (%u bytes)\n",
-                                   pnode->GetTotalRecvSize());
-                        pnode->CloseSocketDisconnect();
-                    } else {
-                        // typical socket buffer is 8K-64K
-                        char pchBuf[0x10000];
-                        int  nBytes = recv(pnode->hSocket, pchBuf, sizeof(pchBuf), MSG_DONTWAIT);
-                        if (nBytes > 0) {
-                            if (!pnode->ReceiveMsgBytes(pchBuf, nBytes))
-                                pnode->CloseSocketDisconnect();
-                            pnode->nLastRecv = GetTime();
-                        } else if (nBytes == 0) {
-                            // socket closed gracefully
-                            if (!pnode->fDisconnect)
-                                printf("socket closed\n");
-                            pnode->CloseSocketDisconnect();
-                        } else if (nBytes < 0) {
-                            // error
-                            int nErr = WSAGetLastError();
-                            if (nErr != WSAEWOULDBLOCK && nErr != WSAEMSGSIZE && nErr != WSAEINTR &&
-                                nErr != WSAEINPROGRESS) {
-                                if (!pnode->fDisconnect)
-                                    printf("socket recv error %d\n", nErr);
-                                pnode->CloseSocketDisconnect();
-                            }
-                        }
-                    }
-                }
-            }
+            if (FD_ISSET(pnode->hSocket, &fdsetRecv) || FD_ISSET(pnode->hSocket, &fdsetError))
+                ReceiveFromNode(pnode);
 
             //
             // Send
@@ -952,28 +1041,7 @@ void ThreadSocketHandler2(void* /*parg*/)
                     SocketSendData(pnode);
             }
 
-            //
-            // Inactivity checking
-            //
-            {
-                LOCK(pnode->cs_vSend);
-                if (pnode->vSendMsg.empty())
-                    pnode->nLastSendEmpty = GetTime();
-            }
-            if (GetTime() - pnode->nTimeConnected > 60) {
-                if (pnode->nLastRecv == 0 || pnode->nLastSend == 0) {
-                    printf("socket no message in first 60 seconds, %d %d\n", pnode->nLastRecv != 0,
-                           pnode->nLastSend != 0);
-                    pnode->fDisconnect = true;
-                } else if (GetTime() - pnode->nLastSend > 90 * 60 &&
-                           GetTime() - pnode->nLastSendEmpty > 90 * 60) {
-                    printf("socket not sending\n");
-                    pnode->fDisconnect = true;
-                } else if (GetTime() - pnode->nLastRecv > 90 * 60) {
-                    printf("socket inactivity timeout\n");
-                    pnode->fDisconnect = true;
-                }
-            }
+            InactivityCheck(pnode);
         }
         {
             LOCK(cs_vNodes);
@@ -985,6 +1053,184 @@ void ThreadSocketHandler2(void* /*parg*/)
     }
 }
 
+#ifdef USE_EPOLL
+// listen sockets are told from nodes, which are registered with their id, by this bit
+static const uint64_t EPOLL_LISTEN_SOCKET = 1ull << 63;
+// a node is read at most this many times in a row, so that busy peers don't starve the others
+static const int MAX_RECV_PER_LOOP = 4;
+// how often nodes are checked for disconnection and inactivity
+static const int64_t NODE_SWEEP_INTERVAL_MS = 1000;
+
+/**
+ * Waits for the sockets with epoll in edge-triggered mode, so that a wait doesn't depend on the
+ * number of connections and there's no FD_SETSIZE limit. A socket is reported once when it becomes
+ * readable or writable; nodes stay in setRecvReady until their socket would block, and in
+ * setSendReady until the send queue could be locked and written. Nodes get registered through
+ * vNodesToWatch, and are unregistered when they're removed from vNodes.
+ */
+static void SocketHandlerEpoll(int epollfd)
+{
+    list<CNode*>         vNodesDisconnected;
+    unsigned int         nPrevNodeCount = 0;
+    int64_t              nLastSweep     = 0;
+    map<int64_t, CNode*> mapWatched;
+    set<int64_t>         setRecvReady;
+    set<int64_t>         setSendReady;
+
+    for (SOCKET hListenSocket : vhListenSocket) {
+        struct epoll_event ev;
+        ev.events   = EPOLLIN;
+        ev.data.u64 = EPOLL_LISTEN_SOCKET | static_cast<uint64_t>(hListenSocket);
+        if (epoll_ctl(epollfd, EPOLL_CTL_ADD, hListenSocket, &ev) != 0)
+            printf("epoll_ctl failed to add listen socket: %d\n", errno);
+    }
+
+    vector<struct epoll_event> vEvents(256);
+    while (true) {
+        vector<CNode*> vNew;
+        {
+            LOCK(cs_vNodes);
+            vNew.swap(vNodesToWatch);
+        }
+        for (CNode* pnode : vNew) {
+            if (pnode->hSocket == INVALID_SOCKET)
+                continue;
+            struct epoll_event ev;
+            ev.events   = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+            ev.data.u64 = static_cast<uint64_t>(pnode->nodeid);
+            if (epoll_ctl(epollfd, EPOLL_CTL_ADD, pnode->hSocket, &ev) != 0) {
+                printf("epoll_ctl failed to add socket of node %s: %d\n",
+                       pnode->GetAddrName().c_str(), errno);
+                pnode->CloseSocketDisconnect();
+                continue;
+            }
+            mapWatched[pnode->nodeid] = pnode;
+            // whatever arrived before the registration isn't reported
+            setRecvReady.insert(pnode->nodeid);
+        }
+
+        //
+        // Disconnect and inactivity checks, and sending what the send buffer of a node kept
+        //
+        if (GetTimeMillis() - nLastSweep >= NODE_SWEEP_INTERVAL_MS) {
+            nLastSweep = GetTimeMillis();
+
+            // a socket closed by ourselves leaves the epoll set by itself
+            vector<CNode*> vRemoved;
+            DisconnectNodes(vNodesDisconnected, &vRemoved);
+            for (CNode* pnode : vRemoved) {
+                mapWatched.erase(pnode->nodeid);
+                setRecvReady.erase(pnode->nodeid);
+                setSendReady.erase(pnode->nodeid);
+            }
+            NotifyConnectionCount(nPrevNodeCount);
+
+            LOCK(cs_vNodes);
+            for (CNode* pnode : vNodes) {
+                InactivityCheck(pnode);
+                if (pnode->hSocket != INVALID_SOCKET && mapWatched.count(pnode->nodeid) > 0) {
+                    TRY_LOCK(pnode->cs_vSend, lockSend);
+                    if (lockSend && !pnode->vSendMsg.empty())
+                        SocketSendData(pnode);
+                }
+            }
+        }
+
+        //
+        // Wait for sockets to become ready; nodes that are still ready are serviced regularly
+        //
+        const bool fPending = !setRecvReady.empty() || !setSendReady.empty();
+        vnThreadsRunning[THREAD_SOCKETHANDLER]--;
+        int nEvents = epoll_wait(epollfd, vEvents.data(), (int)vEvents.size(), fPending ? 10 : 50);
+        vnThreadsRunning[THREAD_SOCKETHANDLER]++;
+        if (fShutdown)
+            return;
+        if (nEvents < 0) {
+            if (errno != EINTR) {
+                printf("socket epoll_wait error %d\n", errno);
+                MilliSleep(50);
+            }
+            nEvents = 0;
+        }
+
+        for (int i = 0; i < nEvents; i++) {
+            const struct epoll_event& ev = vEvents[i];
+            if (ev.data.u64 & EPOLL_LISTEN_SOCKET) {
+                AcceptConnection(static_cast<SOCKET>(ev.data.u64 & ~EPOLL_LISTEN_SOCKET));
+                continue;
+            }
+            const int64_t nodeid = static_cast<int64_t>(ev.data.u64);
+            if (mapWatched.count(nodeid) == 0)
+                continue;
+            // errors and hang-ups are found by reading
+            if (ev.events & (EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLRDHUP))
+                setRecvReady.insert(nodeid);
+            if (ev.events & EPOLLOUT)
+                setSendReady.insert(nodeid);
+        }
+
+        //
+        // Service the ready sockets
+        //
+        for (set<int64_t>::iterator it = setRecvReady.begin(); it != setRecvReady.end();) {
+            if (fShutdown)
+                return;
+            CNode* pnode  = mapWatched[*it];
+            bool   fReady = false;
+            for (int n = 0; n < MAX_RECV_PER_LOOP && pnode->hSocket != INVALID_SOCKET; n++) {
+                const SocketRecvResult result = ReceiveFromNode(pnode);
+                fReady = (result == SocketRecvResult::Received || result == SocketRecvResult::Busy);
+                if (result != SocketRecvResult::Received)
+                    break;
+            }
+            if (fReady)
+                ++it;
+            else
+                it = setRecvReady.erase(it);
+        }
+        for (set<int64_t>::iterator it = setSendReady.begin(); it != setSendReady.end();) {
+            CNode* pnode = mapWatched[*it];
+            bool   fDone = true;
+            if (pnode->hSocket != INVALID_SOCKET) {
+                TRY_LOCK(pnode->cs_vSend, lockSend);
+                if (lockSend) {
+                    if (!pnode->vSendMsg.empty())
+                        SocketSendData(pnode);
+                } else {
+                    fDone = false;
+                }
+            }
+            if (fDone)
+                it = setSendReady.erase(it);
+            else
+                ++it;
+        }
+    }
+}
+#endif
+
+void ThreadSocketHandler2(void* /*parg*/)
+{
+    printf("ThreadSocketHandler started\n");
+
+#ifdef USE_EPOLL
+    int epollfd = epoll_create1(EPOLL_CLOEXEC);
+    if (epollfd != -1) {
+        try {
+            SocketHandlerEpoll(epollfd);
+        } catch (...) {
+            close(epollfd);
+            throw;
+        }
+        close(epollfd);
+        return;
+    }
+    printf("epoll_create1 failed (%d), using select() for the network\n", errno);
+#endif
+
+    SocketHandlerSelect();
+}
+
 #ifdef USE_UPNP
 void ThreadMapPort(void* parg)
 {
@@ -1590,23 +1836,34 @@ void ThreadMessageHandler(void* parg)
     printf("ThreadMessageHandler exited\n");
 }
 
-void ThreadMessageHandler2(void* /*parg*/)
+static int nMessageHandlerThreads = 1;
+
+// the node that's trickled to, picked by thread 0 among all the nodes once per pass, so that there's a
+// single one however many threads there are
+static boost::atomic<int64_t> nTrickleNodeId(-1);
+
+// parg is the index of the thread; it handles the nodes whose id modulo the number of threads is
+// that index, so the messages of a node are processed in order, by a single thread
+void ThreadMessageHandler2(void* parg)
 {
-    printf("ThreadMessageHandler started\n");
+    const int64_t nThread = reinterpret_cast<intptr_t>(parg);
+    printf("ThreadMessageHandler %" PRId64 " started\n", nThread);
     SetThreadPriority(THREAD_PRIORITY_BELOW_NORMAL);
     while (!fShutdown) {
         vector<CNode*> vNodesCopy;
         {
             LOCK(cs_vNodes);
-            vNodesCopy = vNodes;
-            for (CNode* pnode : vNodesCopy)
-                pnode->AddRef();
+            if (nThread == 0)
+                nTrickleNodeId = (vNodes.empty() ? -1 : vNodes[GetRand(vNodes.size())]->nodeid);
+            for (CNode* pnode : vNodes) {
+                if (pnode->nodeid % nMessageHandlerThreads == nThread) {
+                    pnode->AddRef();
+                    vNodesCopy.push_back(pnode);
+                }
+            }
         }
 
         // Poll the connected nodes for messages
-        CNode* pnodeTrickle = nullptr;
-        if (!vNodesCopy.empty())
-            pnodeTrickle = vNodesCopy[GetRand(vNodesCopy.size())];
         for (CNode* pnode : vNodesCopy) {
             if (pnode->fDisconnect)
                 continue;
@@ -1625,7 +1882,7 @@ void ThreadMessageHandler2(void* /*parg*/)
             {
                 TRY_LOCK(pnode->cs_vSend, lockSend);
                 if (lockSend)
-                    SendMessages(pnode, pnode == pnodeTrickle);
+                    SendMessages(pnode, pnode->nodeid == nTrickleNodeId);
             }
             if (fShutdown)
                 return;
@@ -1642,7 +1899,7 @@ void ThreadMessageHandler2(void* /*parg*/)
         // we're sleeping, but we must always check fShutdown after doing this.
         vnThreadsRunning[THREAD_MESSAGEHANDLER]--;
         MilliSleep(100);
-        if (fRequestShutdown)
+        if (fRequestShutdown && nThread == 0)
             StartShutdown();
         vnThreadsRunning[THREAD_MESSAGEHANDLER]++;
         if (fShutdown)
@@ -1853,8 +2110,11 @@ void StartNode(void* /*parg*/)
         printf("Error: NewThread(ThreadOpenConnections) failed\n");
 
     // Process messages
-    if (!NewThread(ThreadMessageHandler, nullptr))
-        printf("Error: NewThread(ThreadMessageHandler) failed\n");
+    nMessageHandlerThreads = GetArg("-msghandlers", DEFAULT_MESSAGE_HANDLER_THREADS);
+    nMessageHandlerThreads = max(1, min(nMessageHandlerThreads, MAX_MESSAGE_HANDLER_THREADS));
+    for (intptr_t i = 0; i < nMessageHandlerThreads; i++)
+        if (!NewThread(ThreadMessageHandler, reinterpret_cast<void*>(i)))
+            printf("Error: NewThread(ThreadMessageHandler) failed\n");
 
     // Dump network addresses
     if (!NewThread(ThreadDumpAddress, nullptr))
@@ -1908,6 +2168,8 @@ bool StopNode()
         printf("ThreadDumpAddresses still running\n");
     if (vnThreadsRunning[THREAD_STAKE_MINER] > 0)
         printf("ThreadStakeMiner still running\n");
+    if (vnThreadsRunning[THREAD_SCRIPTCHECK] > 0)
+        printf("ThreadScriptCheck still running\n");
     while (vnThreadsRunning[THREAD_MESSAGEHANDLER] > 0 || vnThreadsRunning[THREAD_RPCHANDLER] > 0)
         MilliSleep(20);
 
@@ -32,6 +32,10 @@ extern boost::atomic<int> nBestHeight;
 inline unsigned int ReceiveFloodSize() { return 1000 * GetArg("-maxreceivebuffer", 5 * 1000); }
 inline unsigned int SendBufferSize() { return 1000 * GetArg("-maxsendbuffer", 1 * 1000); }
 
+/** Threads that process the messages of peers, each thread a share of the peers */
+static const int DEFAULT_MESSAGE_HANDLER_THREADS = 4;
+static const int MAX_MESSAGE_HANDLER_THREADS     = 16;
+
 void           AddOneShot(std::string strDest);
 bool           RecvLine(SOCKET hSocket, std::string& strLine);
 bool           GetMyExternalIP(CNetAddr& ipRet);
@@ -115,6 +119,7 @@ enum threadId
     THREAD_RPCHANDLER,
     THREAD_STAKE_MINER,
     THREAD_IMPORT,
+    THREAD_SCRIPTCHECK,
 
     THREAD_MAX
 };
@@ -247,9 +252,10 @@ public:
     uint256                            hashLastGetBlocksEnd;
     int                                nStartingHeight;
 
-    // flood relay
+    // flood relay; the addresses are guarded by cs_vAddrToSend, as other peers' messages add to them
     std::vector<CAddress> vAddrToSend;
     mruset<CAddress>      setAddrKnown;
+    CCriticalSection      cs_vAddrToSend;
     bool                  fGetAddr;
     std::set<uint256>     setKnown;
     uint256               hashCheckpointKnown; // ppcoin: known sent sync-checkpoint
@@ -351,13 +357,18 @@ public:
 
     void Release() { nRefCount--; }
 
-    void AddAddressKnown(const CAddress& addr) { setAddrKnown.insert(addr); }
+    void AddAddressKnown(const CAddress& addr)
+    {
+        LOCK(cs_vAddrToSend);
+        setAddrKnown.insert(addr);
+    }
 
     void PushAddress(const CAddress& addr)
     {
         // Known checking here is only to save space from duplicates.
         // SendMessages will filter it again for knowns that were added
         // after addresses were pushed.
+        LOCK(cs_vAddrToSend);
         if (addr.IsValid() && !setAddrKnown.count(addr))
             vAddrToSend.push_back(addr);
     }
@@ -0,0 +1,258 @@
+#include "ntp1index.h"
+
+#include "clientversion.h"
+#include "main.h"
+#include "ntp1/ntp1transaction.h"
+#include "txdb.h"
+#include "txdbcache.h"
+#include "util.h"
+
+template <typename T>
+static std::string SerializeRecord(const T& obj)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << obj;
+    return ss.str();
+}
+
+template <typename T>
+static void UnserializeRecord(const std::string& record, T& obj)
+{
+    CDataStream ss(record.data(), record.data() + record.size(), SER_DISK, CLIENT_VERSION);
+    ss >> obj;
+}
+
+std::string NTP1TokenIndexKey(const std::string& tokenId)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << static_cast<uint8_t>(NTP1_INDEX_TOKEN) << tokenId;
+    return ss.str();
+}
+
+std::string NTP1TokenStatsKey(const std::string& tokenId)
+{
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << static_cast<uint8_t>(NTP1_INDEX_TOKEN_STATS) << tokenId;
+    return ss.str();
+}
+
+// what the transactions of a block change in the supplies of tokens and the balances of addresses
+struct NTP1IndexDeltas
+{
+    std::map<std::string, NTP1Int>                             supplies;
+    std::map<std::pair<std::string, CIndexedAddress>, NTP1Int> balances;
+};
+
+// adds the token amounts of an output to the deltas, or subtracts them if fAdd isn't set
+static void AddNTP1OutputDeltas(const NTP1TxOut& ntp1out, bool fAdd, NTP1IndexDeltas& deltas)
+{
+    CIndexedAddress address;
+    const bool      fIndexed =
+        ntp1out.tokenCount() > 0 &&
+        CIndexedAddress::FromScript(CScript(ParseHex(ntp1out.getScriptPubKeyHex())), address);
+    for (unsigned int j = 0; j < ntp1out.tokenCount(); j++) {
+        const NTP1TokenTxData& token  = ntp1out.getToken(j);
+        const NTP1Int          amount = fAdd ? token.getAmount() : -token.getAmount();
+        deltas.supplies[token.getTokenId()] += amount;
+        if (fIndexed) {
+            deltas.balances[std::make_pair(token.getTokenId(), address)] += amount;
+        }
+    }
+}
+
+// reads a record of the NTP1 index from changes, or from the db if changes don't have it
+static bool ReadNTP1IndexRecord(CTxDB& txdb, const CTxDBChanges& changes, const std::string& key,
+                                boost::optional<std::string>& value)
+{
+    const CTxDBChanges::RecordMap& records = changes.GetNTP1IndexRecords();
+    const auto                     it      = records.find(key);
+    if (it != records.cend()) {
+        value = it->second;
+        return true;
+    }
+    return txdb.ReadNTP1IndexRecord(key, value);
+}
+
+// adds the deltas to the balance and supply records, and counts the holders that come and go
+static bool ApplyNTP1IndexDeltas(CTxDB& txdb, NTP1IndexDeltas& deltas, CTxDBChanges& changes)
+{
+    std::map<std::string, int64_t> holderDeltas;
+    for (const auto& delta : deltas.balances) {
+        if (delta.second == 0) {
+            continue;
+        }
+        const std::string& tokenId = delta.first.first;
+        const std::string  holderKey =
+            SerializeRecord(CNTP1BalanceKey(NTP1_INDEX_TOKEN_HOLDER, tokenId, delta.first.second));
+        boost::optional<std::string> value;
+        if (!ReadNTP1IndexRecord(txdb, changes, holderKey, value)) {
+            return false;
+        }
+        NTP1Int nBalance = 0;
+        if (value) {
+            UnserializeRecord(*value, nBalance);
+        }
+        const NTP1Int nNewBalance = nBalance + delta.second;
+        if (nNewBalance < 0) {
+            return error("ApplyNTP1IndexDeltas(): The balance of token %s of an address would be "
+                         "negative",
+                         tokenId.c_str());
+        }
+        holderDeltas[tokenId] += (nNewBalance != 0 ? 1 : 0) - (nBalance != 0 ? 1 : 0);
+
+        boost::optional<std::string> newValue;
+        if (nNewBalance != 0) {
+            newValue = SerializeRecord(nNewBalance);
+        }
+        changes.SetNTP1IndexRecord(holderKey, boost::optional<std::string>(newValue));
+        changes.SetNTP1IndexRecord(
+            SerializeRecord(CNTP1BalanceKey(NTP1_INDEX_ADDRESS_TOKEN, tokenId, delta.first.second)),
+            std::move(newValue));
+    }
+
+    // a transfer leaves the supply as it was, but may still change the number of holders
+    for (const auto& holderDelta : holderDeltas) {
+        deltas.supplies[holderDelta.first];
+    }
+    for (const auto& supplyDelta : deltas.supplies) {
+        const auto    it           = holderDeltas.find(supplyDelta.first);
+        const int64_t nHolderDelta = (it != holderDeltas.cend() ? it->second : 0);
+        if (supplyDelta.second == 0 && nHolderDelta == 0) {
+            continue;
+        }
+        const std::string            statsKey = NTP1TokenStatsKey(supplyDelta.first);
+        boost::optional<std::string> value;
+        if (!ReadNTP1IndexRecord(txdb, changes, statsKey, value)) {
+            return false;
+        }
+        CNTP1TokenStats stats;
+        if (value) {
+            UnserializeRecord(*value, stats);
+        }
+        stats.nSupply += supplyDelta.second;
+        if (stats.nSupply < 0 || static_cast<int64_t>(stats.nHolders) + nHolderDelta < 0) {
+            return error("ApplyNTP1IndexDeltas(): The supply or holders of token %s would be negative",
+                         supplyDelta.first.c_str());
+        }
+        stats.nHolders = static_cast<uint64_t>(static_cast<int64_t>(stats.nHolders) + nHolderDelta);
+        if (stats.nSupply == 0 && stats.nHolders == 0) {
+            changes.SetNTP1IndexRecord(statsKey, boost::none);
+        } else {
+            changes.SetNTP1IndexRecord(statsKey, SerializeRecord(stats));
+        }
+    }
+    return true;
+}
+
+// sets the issuance record of the token an issuance transaction creates, or erases it
+static void SetNTP1TokenRecord(const CTransaction& tx, const NTP1Transaction& ntp1tx, int nHeight,
+                               bool fSet, CTxDBChanges& changes)
+{
+    if (ntp1tx.getTxType() != NTP1TxType_ISSUANCE || tx.vin.empty()) {
+        return;
+    }
+    // the token id and symbol are parsed from the script of the issuance, which may not be parsable
+    std::string tokenId;
+    std::string tokenSymbol;
+    try {
+        const COutPoint& prevout0 = tx.vin[0].prevout;
+        tokenId                   = ntp1tx.getTokenIdIfIssuance(prevout0.hash.ToString(), prevout0.n);
+        tokenSymbol               = ntp1tx.getTokenSymbolIfIssuance();
+    } catch (std::exception& ex) {
+        printf("AddNTP1IndexChanges(): Failed to get the issued token of transaction %s: %s\n",
+               tx.GetHash().ToString().c_str(), ex.what());
+        return;
+    }
+    if (!fSet) {
+        changes.SetNTP1IndexRecord(NTP1TokenIndexKey(tokenId), boost::none);
+        return;
+    }
+
+    // the outputs carry the issued amount, and the properties of the token along with it
+    CNTP1TokenIndexEntry entry;
+    entry.issuanceTxHash = ntp1tx.getTxHash();
+    entry.nHeight        = nHeight;
+    entry.tokenSymbol    = tokenSymbol;
+    for (unsigned int n = 0; n < ntp1tx.getTxOutCount(); n++) {
+        const NTP1TxOut& ntp1out = ntp1tx.getTxOut(n);
+        for (unsigned int j = 0; j < ntp1out.tokenCount(); j++) {
+            const NTP1TokenTxData& token = ntp1out.getToken(j);
+            if (token.getTokenId() != tokenId) {
+                continue;
+            }
+            entry.nDivisibility     = token.getDivisibility();
+            entry.fLocked           = token.getLockStatus() ? 1 : 0;
+            entry.aggregationPolicy = token.getAggregationPolicy();
+            entry.nIssuedAmount += token.getAmount();
+        }
+    }
+    changes.SetNTP1IndexRecord(NTP1TokenIndexKey(tokenId), SerializeRecord(entry));
+}
+
+bool AddNTP1IndexChanges(CTxDB& txdb, const std::vector<CTransaction>& vtx, int nHeight,
+                         const std::map<uint256, NTP1Transaction>& ntp1txs, bool fConnect,
+                         CTxDBChanges& changes)
+{
+    // the deltas of the whole block are summed up before they're applied, so that tokens that are
+    // received and spent again in the block don't change any record
+    NTP1IndexDeltas deltas;
+    for (const CTransaction& tx : vtx) {
+        const uint256 hashTx = tx.GetHash();
+
+        // tokens of spent outputs leave the index, whether or not the spending transaction is NTP1
+        for (unsigned int i = 0; i < tx.vin.size() && !tx.IsCoinBase(); i++) {
+            const COutPoint& prevout = tx.vin[i].prevout;
+            const auto       it      = ntp1txs.find(prevout.hash);
+            if (it != ntp1txs.cend() && prevout.n < it->second.getTxOutCount()) {
+                AddNTP1OutputDeltas(it->second.getTxOut(prevout.n), !fConnect, deltas);
+            }
+        }
+
+        const auto it = ntp1txs.find(hashTx);
+        if (it == ntp1txs.cend()) {
+            continue;
+        }
+        for (unsigned int n = 0; n < it->second.getTxOutCount(); n++) {
+            AddNTP1OutputDeltas(it->second.getTxOut(n), fConnect, deltas);
+        }
+        SetNTP1TokenRecord(tx, it->second, nHeight, fConnect, changes);
+    }
+
+    try {
+        return ApplyNTP1IndexDeltas(txdb, deltas, changes);
+    } catch (std::exception& ex) {
+        return error("AddNTP1IndexChanges(): Failed to deserialize an NTP1 index record: %s",
+                     ex.what());
+    }
+}
+
+bool ReadNTP1IndexTxs(CTxDB& txdb, const std::vector<CTransaction>& vtx,
+                      std::map<uint256, NTP1Transaction>& ntp1txs)
+{
+    // most transactions have no NTP1 data, and the ones of the block are only looked for if they're
+    // NTP1 transactions themselves; the spent ones could be any
+    std::vector<uint256> hashes;
+    for (const CTransaction& tx : vtx) {
+        if (NTP1Transaction::IsTxNTP1(&tx)) {
+            hashes.push_back(tx.GetHash());
+        }
+        for (unsigned int i = 0; i < tx.vin.size() && !tx.IsCoinBase(); i++) {
+            hashes.push_back(tx.vin[i].prevout.hash);
+        }
+    }
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+
+    for (const uint256& hash : hashes) {
+        if (ntp1txs.count(hash) || !txdb.ContainsNTP1Tx(hash)) {
+            continue;
+        }
+        NTP1Transaction ntp1tx;
+        if (!txdb.ReadNTP1Tx(hash, ntp1tx)) {
+            return error("ReadNTP1IndexTxs(): Failed to read the NTP1 data of transaction %s",
+                         hash.ToString().c_str());
+        }
+        ntp1txs[hash] = std::move(ntp1tx);
+    }
+    return true;
+}
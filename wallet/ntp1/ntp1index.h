@@ -0,0 +1,145 @@
+#ifndef NTP1INDEX_H
+#define NTP1INDEX_H
+
+#include "addressindex.h"
+#include "ntp1/ntp1script.h"
+#include "serialize.h"
+#include "uint256.h"
+
+#include <map>
+#include <string>
+#include <vector>
+
+class CTransaction;
+class CTxDB;
+class CTxDBChanges;
+class NTP1Transaction;
+
+/**
+ * The NTP1 index keeps four kinds of records in one db, told apart by the first byte of their keys:
+ * the issuance of every token, the supply and number of holders of every token, and the balance of
+ * every address holding a token, once by token and once by address. Connecting and disconnecting a
+ * block adds what its transactions change to the supply and the balances, so they're never summed
+ * up from the unspent outputs when they're asked for.
+ */
+enum NTP1IndexRecordType : uint8_t
+{
+    NTP1_INDEX_TOKEN         = 't',
+    NTP1_INDEX_TOKEN_STATS   = 's',
+    NTP1_INDEX_TOKEN_HOLDER  = 'h',
+    NTP1_INDEX_ADDRESS_TOKEN = 'a'
+};
+
+/** The issuance of a token */
+class CNTP1TokenIndexEntry
+{
+public:
+    uint256       issuanceTxHash;
+    int           nHeight;
+    std::string   tokenSymbol;
+    NTP1Int       nIssuedAmount;
+    uint64_t      nDivisibility;
+    unsigned char fLocked;
+    std::string   aggregationPolicy;
+
+    CNTP1TokenIndexEntry()
+        : issuanceTxHash(0), nHeight(0), nIssuedAmount(0), nDivisibility(0), fLocked(0)
+    {
+    }
+
+    IMPLEMENT_SERIALIZE(READWRITE(issuanceTxHash); READWRITE(nHeight); READWRITE(tokenSymbol);
+                        READWRITE(nIssuedAmount); READWRITE(VARINT(nDivisibility)); READWRITE(fLocked);
+                        READWRITE(aggregationPolicy);)
+};
+
+/**
+ * The amount of a token in the unspent outputs, and the number of addresses holding some of it.
+ * Outputs whose scripts have no indexed address count in the supply, but have no holder.
+ */
+class CNTP1TokenStats
+{
+public:
+    NTP1Int  nSupply;
+    uint64_t nHolders;
+
+    CNTP1TokenStats() : nSupply(0), nHolders(0) {}
+
+    IMPLEMENT_SERIALIZE(READWRITE(nSupply); READWRITE(VARINT(nHolders));)
+};
+
+/**
+ * Key of the balance of a token of an address, by token or by address depending on nRecordType. The
+ * value of the record is the balance, and there's no record once it's zero.
+ */
+class CNTP1BalanceKey
+{
+public:
+    uint8_t         nRecordType;
+    std::string     tokenId;
+    CIndexedAddress address;
+
+    CNTP1BalanceKey() : nRecordType(NTP1_INDEX_TOKEN_HOLDER) {}
+    CNTP1BalanceKey(uint8_t nRecordTypeIn, const std::string& tokenIdIn,
+                    const CIndexedAddress& addressIn)
+        : nRecordType(nRecordTypeIn), tokenId(tokenIdIn), address(addressIn)
+    {
+    }
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return 1 + ::GetSerializeSize(tokenId, nType, nVersion) +
+               ::GetSerializeSize(address, nType, nVersion);
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        ::Serialize(s, nRecordType, nType, nVersion);
+        if (nRecordType == NTP1_INDEX_ADDRESS_TOKEN) {
+            ::Serialize(s, address, nType, nVersion);
+            ::Serialize(s, tokenId, nType, nVersion);
+        } else {
+            ::Serialize(s, tokenId, nType, nVersion);
+            ::Serialize(s, address, nType, nVersion);
+        }
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        ::Unserialize(s, nRecordType, nType, nVersion);
+        if (nRecordType == NTP1_INDEX_ADDRESS_TOKEN) {
+            ::Unserialize(s, address, nType, nVersion);
+            ::Unserialize(s, tokenId, nType, nVersion);
+        } else {
+            ::Unserialize(s, tokenId, nType, nVersion);
+            ::Unserialize(s, address, nType, nVersion);
+        }
+    }
+};
+
+/** The serialized key of the issuance record of a token */
+std::string NTP1TokenIndexKey(const std::string& tokenId);
+
+/** The serialized key of the supply and holders record of a token */
+std::string NTP1TokenStatsKey(const std::string& tokenId);
+
+/**
+ * Adds the changes of the NTP1 index that connecting the transactions of a block at nHeight makes to
+ * changes, or, unless fConnect is set, the changes that disconnecting them makes. ntp1txs has the NTP1
+ * data of the transactions and of the ones whose outputs they spend, if there's any. The balances and
+ * supplies they change are read from changes, or from txdb if they aren't there, so the changes of
+ * consecutive blocks can be added to the same changes.
+ */
+bool AddNTP1IndexChanges(CTxDB& txdb, const std::vector<CTransaction>& vtx, int nHeight,
+                         const std::map<uint256, NTP1Transaction>& ntp1txs, bool fConnect,
+                         CTxDBChanges& changes);
+
+/**
+ * Reads the NTP1 data of the transactions, and of the transactions whose outputs they spend, from the
+ * tx db. The NTP1 data of a block being connected is there once it was written for the block.
+ */
+bool ReadNTP1IndexTxs(CTxDB& txdb, const std::vector<CTransaction>& vtx,
+                      std::map<uint256, NTP1Transaction>& ntp1txs);
+
+#endif // NTP1INDEX_H
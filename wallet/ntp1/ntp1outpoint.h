@@ -31,7 +31,11 @@ public:
     // clang-format off
     IMPLEMENT_SERIALIZE(
                         READWRITE(hash);
-                        READWRITE(index);
+                        if (nType & SER_NTP1_COMPACT) {
+                            READWRITE(VARINT(index));
+                        } else {
+                            READWRITE(index);
+                        }
                        )
     // clang-format on
 };
@@ -44,10 +44,20 @@ public:
     // clang-format off
     IMPLEMENT_SERIALIZE(
                         READWRITE(tokenId);
-                        READWRITE(amount);
-                        READWRITE(issueTxId);
-                        READWRITE(divisibility);
-                        READWRITE(lockStatus);
+                        if (nType & SER_NTP1_COMPACT) {
+                            READWRITE(COMPACTNTP1INT(amount));
+                            READWRITE(issueTxId);
+                            READWRITE(VARINT(divisibility));
+                            unsigned char fLocked = (lockStatus ? 1 : 0);
+                            READWRITE(fLocked);
+                            if (fRead)
+                                REF(lockStatus) = fLocked;
+                        } else {
+                            READWRITE(amount);
+                            READWRITE(issueTxId);
+                            READWRITE(divisibility);
+                            READWRITE(lockStatus);
+                        }
                         READWRITE(aggregationPolicy);
                         READWRITE(tokenSymbol);
                        )
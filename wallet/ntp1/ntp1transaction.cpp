@@ -268,6 +268,7 @@ void NTP1Transaction::ReorderTokenInputsToGoFirst(
             }
         }
     }
+    tx.InvalidateHash();
 }
 
 unsigned int NTP1Transaction::CountTokenKindsInInputs(
@@ -483,6 +484,7 @@ void NTP1Transaction::AmendStdTxWithNTP1(
     }
 
     // copy the result to the input
+    tx_.InvalidateHash();
     tx = tx_;
 }
 
@@ -12,6 +12,7 @@
 #include "uint256.h"
 
 #include <boost/filesystem/path.hpp>
+#include <limits>
 #include <numeric>
 #include <string>
 #include <unordered_map>
@@ -38,6 +39,9 @@ struct TokenMinimalData
 class NTP1Transaction
 {
     static const int CURRENT_VERSION = 1;
+    /** First field of the compact (SER_NTP1_COMPACT) layout, in place of nVersion; no valid
+     *  transaction has this version */
+    static const int32_t COMPACT_FORMAT_MARKER = std::numeric_limits<int32_t>::min();
     int              nVersion;
     uint256          txHash = 0;
 #ifdef DEBUG__INCLUDE_STR_HASH
@@ -60,14 +64,41 @@ public:
 
     // clang-format off
     IMPLEMENT_SERIALIZE(
-                        READWRITE(this->nVersion);
-                        nVersion = this->nVersion;
-                        READWRITE(nTime);
-                        READWRITE(txHash);
-                        READWRITE(vin);
-                        READWRITE(vout);
-                        READWRITE(nLockTime);
-                        READWRITE(ntp1TransactionType);
+                        if (nType & SER_NTP1_COMPACT) {
+                            // Records written before the compact format start with nVersion instead of
+                            // the marker. These are read with the old layout, which keeps databases
+                            // that haven't been migrated yet readable.
+                            int32_t nHeader = COMPACT_FORMAT_MARKER;
+                            READWRITE(nHeader);
+                            if (fRead && nHeader != COMPACT_FORMAT_MARKER) {
+                                const int nTypeLegacy = nType & ~SER_NTP1_COMPACT;
+                                REF(this->nVersion) = nHeader;
+                                nVersion = this->nVersion;
+                                READWRITE(nTime);
+                                READWRITE(txHash);
+                                nSerSize += ::SerReadWrite(s, vin, nTypeLegacy, nVersion, ser_action);
+                                nSerSize += ::SerReadWrite(s, vout, nTypeLegacy, nVersion, ser_action);
+                                READWRITE(nLockTime);
+                                READWRITE(ntp1TransactionType);
+                            } else {
+                                READWRITE(this->nVersion);
+                                READWRITE(VARINT(nTime));
+                                READWRITE(txHash);
+                                READWRITE(vin);
+                                READWRITE(vout);
+                                READWRITE(VARINT(nLockTime));
+                                READWRITE(ntp1TransactionType);
+                            }
+                        } else {
+                            READWRITE(this->nVersion);
+                            nVersion = this->nVersion;
+                            READWRITE(nTime);
+                            READWRITE(txHash);
+                            READWRITE(vin);
+                            READWRITE(vout);
+                            READWRITE(nLockTime);
+                            READWRITE(ntp1TransactionType);
+                        }
                         )
     // clang-format on
 
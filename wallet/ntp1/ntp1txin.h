@@ -42,8 +42,13 @@ public:
     // clang-format off
     IMPLEMENT_SERIALIZE(
                         READWRITE(prevout);
-                        READWRITE(scriptSigHex);
-                        READWRITE(nSequence);
+                        if (nType & SER_NTP1_COMPACT) {
+                            READWRITE(COMPACTHEXSTR(scriptSigHex));
+                            READWRITE(VARINT(nSequence));
+                        } else {
+                            READWRITE(scriptSigHex);
+                            READWRITE(nSequence);
+                        }
                         READWRITE(tokens);
                        )
     // clang-format on
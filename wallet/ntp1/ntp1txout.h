@@ -58,8 +58,17 @@ public:
 
     // clang-format off
     IMPLEMENT_SERIALIZE(
-                        READWRITE(nValue);
-                        READWRITE(scriptPubKeyHex);
+                        if (nType & SER_NTP1_COMPACT) {
+                            // two's complement round trip, so negative values survive too
+                            uint64_t nValueU = static_cast<uint64_t>(nValue);
+                            READWRITE(VARINT(nValueU));
+                            if (fRead)
+                                REF(nValue) = static_cast<int64_t>(nValueU);
+                            READWRITE(COMPACTHEXSTR(scriptPubKeyHex));
+                        } else {
+                            READWRITE(nValue);
+                            READWRITE(scriptPubKeyHex);
+                        }
                         READWRITE(scriptPubKeyAsm);
                         READWRITE(tokens);
                         READWRITE(address);
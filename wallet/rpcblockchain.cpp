@@ -3,15 +3,19 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "addressindex.h"
 #include "amount.h"
 #include "bitcoinrpc.h"
 #include "main.h"
 #include "merkletx.h"
+#include "ntp1/ntp1index.h"
 #include "txdb.h"
 #include "txmempool.h"
 #include <algorithm>
 #include <atomic>
 #include <chrono>
+#include <limits>
+#include <set>
 #include <thread>
 
 using namespace json_spirit;
@@ -244,6 +248,16 @@ Value calculateblockhash(const Array& params, bool fHelp)
     return block.GetHash().GetHex();
 }
 
+// reads a block that's in the block index, which it is even if the block itself was pruned
+static void ReadBlockForRPC(CBlock& block, const CBlockIndex* pblockindex)
+{
+    if (block.ReadFromDisk(pblockindex, true))
+        return;
+    if (!CTxDB("r").ContainsBlock(pblockindex->blockKeyInDB))
+        throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
+    throw JSONRPCError(RPC_DATABASE_ERROR, "Can't read block from disk");
+}
+
 // Experimentally deprecated in an effort to support the getblock() call electrum requires
 // Value getblock(const Array& params, bool fHelp)
 // {
@@ -289,12 +303,17 @@ Value getblock(const Array& params, bool fHelp)
     if (params.size() > 2)
         fShowTxns = params[2].get_bool();
 
-    if (mapBlockIndex.count(hash) == 0)
-        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+    CBlockIndex* pblockindex;
+    {
+        LOCK(cs_main);
+        if (mapBlockIndex.count(hash) == 0)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+        pblockindex = boost::atomic_load(&mapBlockIndex.at(hash)).get();
+    }
 
-    CBlock       block;
-    CBlockIndex* pblockindex = boost::atomic_load(&mapBlockIndex.at(hash)).get();
-    block.ReadFromDisk(pblockindex, true);
+    // the block is read without cs_main, so that parallel requests don't queue up on the disk
+    CBlock block;
+    ReadBlockForRPC(block, pblockindex);
 
     if (!fVerbose) {
         CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
@@ -307,6 +326,7 @@ Value getblock(const Array& params, bool fHelp)
     if (params.size() > 3)
         fIgnoreNTP1 = params[3].get_bool();
 
+    LOCK(cs_main);
     return blockToJSON(block, pblockindex, fShowTxns, fIgnoreNTP1);
 }
 
@@ -331,7 +351,7 @@ Value getblockbynumber(const Array& params, bool fHelp)
     uint256 hash = *pblockindex->phashBlock;
 
     pblockindex = boost::atomic_load(&mapBlockIndex[hash]);
-    block.ReadFromDisk(pblockindex.get(), true);
+    ReadBlockForRPC(block, pblockindex.get());
 
     bool fIgnoreNTP1 = false;
     if (params.size() > 2)
@@ -349,7 +369,12 @@ Value exportblockchain(const Array& params, bool fHelp)
             "Exports the blockchain bootstrap.dat file to <path-dir>.\n"
             "<path-dir> must be a directory that exists. Ignoring the last parameter "
             "will export a linear version of the blockchain. If you need orphan chains, "
-            "you can choose whether traversal is going to be breadth-firsth or depth-first.");
+            "you can choose whether traversal is going to be breadth-firsth or depth-first. "
+            "Not available if blocks were pruned.");
+    }
+    if (CTxDB("r").HavePrunedBlocks()) {
+        throw JSONRPCError(RPC_MISC_ERROR,
+                           "Blocks were pruned (see -prune), so the blockchain can't be exported");
     }
     if (params.size() == 2 && params[1].get_str() != "breadth" && params[1].get_str() != "depth") {
         throw runtime_error("The second parameter can only be depth or breadth");
@@ -739,3 +764,429 @@ Value gettxout(const Array& params, bool fHelp)
 
     return ret;
 }
+
+// the addresses, heights and page that the getaddress* calls are asked for
+struct AddressIndexQuery
+{
+    std::vector<CIndexedAddress> addresses;
+    unsigned int                 nStart = 0;
+    unsigned int                 nEnd   = std::numeric_limits<unsigned int>::max();
+    std::size_t                  nSkip  = 0;
+    std::size_t                  nCount = std::numeric_limits<std::size_t>::max();
+};
+
+static unsigned int GetNonNegativeInt(const Object& obj, const std::string& name, unsigned int nDefault)
+{
+    const Value& value = find_value(obj, name);
+    if (value.type() == null_type)
+        return nDefault;
+    const int n = value.get_int();
+    if (n < 0)
+        throw JSONRPCError(RPC_INVALID_PARAMETER, "\"" + name + "\" can't be negative");
+    return static_cast<unsigned int>(n);
+}
+
+static AddressIndexQuery ParseAddressIndexQuery(const Value& param)
+{
+    if (!fAddressIndex)
+        throw JSONRPCError(RPC_MISC_ERROR,
+                           "The address index is disabled; restart with -addressindex to enable it");
+
+    AddressIndexQuery query;
+    Array             addresses;
+    if (param.type() == str_type) {
+        addresses.push_back(param);
+    } else {
+        const Object& obj = param.get_obj();
+        addresses         = find_value(obj, "addresses").get_array();
+        query.nStart      = GetNonNegativeInt(obj, "start", query.nStart);
+        query.nEnd        = GetNonNegativeInt(obj, "end", query.nEnd);
+        query.nSkip       = GetNonNegativeInt(obj, "skip", 0);
+        if (find_value(obj, "count").type() != null_type)
+            query.nCount = GetNonNegativeInt(obj, "count", 0);
+    }
+    for (const Value& value : addresses) {
+        const CBitcoinAddress address(value.get_str());
+        CIndexedAddress       indexed;
+        if (!address.IsValid())
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address: " + value.get_str());
+        if (!CIndexedAddress::FromDestination(address.Get(), indexed))
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
+                               "Address type isn't in the address index: " + value.get_str());
+        query.addresses.push_back(indexed);
+    }
+    return query;
+}
+
+// reads the records of the address index of all the addresses of the query, sorted by height
+static std::vector<std::pair<CAddressIndexKey, CAmount>> ReadAddressIndex(const AddressIndexQuery& query)
+{
+    LOCK(cs_main);
+    CTxDB txdb;
+
+    std::vector<std::pair<CAddressIndexKey, CAmount>> result;
+    std::vector<std::pair<CAddressIndexKey, CAmount>> records;
+    for (const CIndexedAddress& address : query.addresses) {
+        if (!txdb.ReadAddressIndex(address, query.nStart, query.nEnd, records))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read the address index");
+        result.insert(result.end(), records.cbegin(), records.cend());
+    }
+    std::stable_sort(result.begin(), result.end(),
+                     [](const std::pair<CAddressIndexKey, CAmount>& a,
+                        const std::pair<CAddressIndexKey, CAmount>& b) {
+                         return a.first.nHeight < b.first.nHeight;
+                     });
+    return result;
+}
+
+// the range of items that skip and count of the query leave
+template <typename T>
+static std::pair<typename std::vector<T>::const_iterator, typename std::vector<T>::const_iterator>
+GetPage(const std::vector<T>& items, const AddressIndexQuery& query)
+{
+    const std::size_t nBegin = std::min(query.nSkip, items.size());
+    const std::size_t nEnd   = nBegin + std::min(query.nCount, items.size() - nBegin);
+    return std::make_pair(items.cbegin() + nBegin, items.cbegin() + nEnd);
+}
+
+static const std::string ADDRESS_INDEX_QUERY_HELP =
+    "1. \"address\" or {          (string or json object, required) An address, or an object with:\n"
+    "     \"addresses\": [\"address\",...], (array of strings) The addresses\n"
+    "     \"start\": n,           (numeric, optional) The height to start at\n"
+    "     \"end\": n,             (numeric, optional) The height to end at\n"
+    "     \"skip\": n,            (numeric, optional) The number of results to skip\n"
+    "     \"count\": n            (numeric, optional) The maximum number of results\n"
+    "   }\n";
+
+Value getaddresstxids(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw std::runtime_error(
+            "getaddresstxids \"address\"|{\"addresses\":[...],...}\n"
+            "\nReturns the ids of the confirmed transactions of the addresses, sorted by height. Needs "
+            "-addressindex.\n"
+            "\nArguments:\n" +
+            ADDRESS_INDEX_QUERY_HELP +
+            "\nResult:\n"
+            "[\n"
+            "  \"txid\"                   (string) The id of a transaction\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            "getaddresstxids '{\"addresses\": [\"address\"], \"start\": 1000}'");
+
+    const AddressIndexQuery query = ParseAddressIndexQuery(params[0]);
+
+    // a transaction can have several records of an address, and of the addresses of the query
+    std::vector<uint256> txids;
+    std::set<uint256>    seen;
+    for (const std::pair<CAddressIndexKey, CAmount>& record : ReadAddressIndex(query)) {
+        if (seen.insert(record.first.txhash).second)
+            txids.push_back(record.first.txhash);
+    }
+
+    Array      result;
+    const auto page = GetPage(txids, query);
+    for (auto it = page.first; it != page.second; ++it)
+        result.push_back(it->GetHex());
+    return result;
+}
+
+Value getaddressdeltas(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw std::runtime_error(
+            "getaddressdeltas \"address\"|{\"addresses\":[...],...}\n"
+            "\nReturns the changes of the balances of the addresses by confirmed transactions, sorted "
+            "by height. Needs -addressindex.\n"
+            "\nArguments:\n" +
+            ADDRESS_INDEX_QUERY_HELP +
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"satoshis\": n,         (numeric) The change, negative for a spending input\n"
+            "    \"txid\": \"hash\",        (string) The id of the transaction\n"
+            "    \"index\": n,            (numeric) The input or output number\n"
+            "    \"height\": n,           (numeric) The height of the block\n"
+            "    \"address\": \"address\"   (string) The address\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            "getaddressdeltas '{\"addresses\": [\"address\"], \"skip\": 100, \"count\": 100}'");
+
+    const AddressIndexQuery                                 query   = ParseAddressIndexQuery(params[0]);
+    const std::vector<std::pair<CAddressIndexKey, CAmount>> records = ReadAddressIndex(query);
+
+    Array      result;
+    const auto page = GetPage(records, query);
+    for (auto it = page.first; it != page.second; ++it) {
+        Object delta;
+        delta.push_back(Pair("satoshis", it->second));
+        delta.push_back(Pair("txid", it->first.txhash.GetHex()));
+        delta.push_back(Pair("index", static_cast<int>(it->first.nIndex)));
+        delta.push_back(Pair("height", static_cast<int>(it->first.nHeight)));
+        delta.push_back(
+            Pair("address", CBitcoinAddress(it->first.address.GetDestination()).ToString()));
+        result.push_back(delta);
+    }
+    return result;
+}
+
+Value getaddressbalance(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw std::runtime_error(
+            "getaddressbalance \"address\"|{\"addresses\":[...],...}\n"
+            "\nReturns the confirmed balance of the addresses together. Needs -addressindex.\n"
+            "\nArguments:\n" +
+            ADDRESS_INDEX_QUERY_HELP +
+            "\nResult:\n"
+            "{\n"
+            "  \"balance\": n,            (numeric) The balance, in satoshis\n"
+            "  \"received\": n            (numeric) The total received, in satoshis\n"
+            "}\n"
+            "\nExamples:\n"
+            "getaddressbalance \"address\"");
+
+    const AddressIndexQuery query = ParseAddressIndexQuery(params[0]);
+
+    CAmount nBalance  = 0;
+    CAmount nReceived = 0;
+    for (const std::pair<CAddressIndexKey, CAmount>& record : ReadAddressIndex(query)) {
+        nBalance += record.second;
+        if (record.second > 0)
+            nReceived += record.second;
+    }
+
+    Object result;
+    result.push_back(Pair("balance", nBalance));
+    result.push_back(Pair("received", nReceived));
+    return result;
+}
+
+Value getaddressutxos(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw std::runtime_error(
+            "getaddressutxos \"address\"|{\"addresses\":[...],...}\n"
+            "\nReturns the confirmed unspent outputs of the addresses, sorted by height; \"start\" and "
+            "\"end\" are ignored. Needs -addressindex.\n"
+            "\nArguments:\n" +
+            ADDRESS_INDEX_QUERY_HELP +
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"address\": \"address\",  (string) The address\n"
+            "    \"txid\": \"hash\",        (string) The id of the transaction\n"
+            "    \"outputIndex\": n,      (numeric) The output number\n"
+            "    \"script\": \"hex\",       (string) The script of the output\n"
+            "    \"satoshis\": n,         (numeric) The value of the output\n"
+            "    \"height\": n            (numeric) The height of the block\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            "getaddressutxos \"address\"");
+
+    const AddressIndexQuery query = ParseAddressIndexQuery(params[0]);
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> outputs;
+    {
+        LOCK(cs_main);
+        CTxDB txdb;
+
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> records;
+        for (const CIndexedAddress& address : query.addresses) {
+            if (!txdb.ReadAddressUnspentIndex(address, records))
+                throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read the address index");
+            outputs.insert(outputs.end(), records.cbegin(), records.cend());
+        }
+    }
+    std::stable_sort(outputs.begin(), outputs.end(),
+                     [](const std::pair<CAddressUnspentKey, CAddressUnspentValue>& a,
+                        const std::pair<CAddressUnspentKey, CAddressUnspentValue>& b) {
+                         return a.second.nHeight < b.second.nHeight;
+                     });
+
+    Array      result;
+    const auto page = GetPage(outputs, query);
+    for (auto it = page.first; it != page.second; ++it) {
+        Object output;
+        output.push_back(
+            Pair("address", CBitcoinAddress(it->first.address.GetDestination()).ToString()));
+        output.push_back(Pair("txid", it->first.txhash.GetHex()));
+        output.push_back(Pair("outputIndex", static_cast<int>(it->first.nIndex)));
+        output.push_back(
+            Pair("script", HexStr(it->second.scriptPubKey.begin(), it->second.scriptPubKey.end())));
+        output.push_back(Pair("satoshis", it->second.nValue));
+        output.push_back(Pair("height", it->second.nHeight));
+        result.push_back(output);
+    }
+    return result;
+}
+
+static void EnsureNTP1Index()
+{
+    if (!fNTP1Index)
+        throw JSONRPCError(RPC_MISC_ERROR,
+                           "The NTP1 index is disabled; restart with -ntp1index to enable it");
+}
+
+Value getntp1tokeninfo(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw std::runtime_error(
+            "getntp1tokeninfo \"tokenid\"\n"
+            "\nReturns the issuance, supply and number of holders of an NTP1 token. Needs -ntp1index.\n"
+            "\nArguments:\n"
+            "1. \"tokenid\"                (string, required) The token id\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"tokenId\": \"id\",          (string) The token id\n"
+            "  \"symbol\": \"symbol\",       (string) The symbol of the token\n"
+            "  \"issuanceTxid\": \"hash\",   (string) The id of the issuance transaction\n"
+            "  \"height\": n,              (numeric) The height of the issuance\n"
+            "  \"issuedAmount\": \"n\",      (string) The amount issued\n"
+            "  \"divisibility\": n,        (numeric) The number of decimals of the amounts\n"
+            "  \"locked\": true|false,     (boolean) Whether no more of the token can be issued\n"
+            "  \"aggregationPolicy\": \"p\", (string) The aggregation policy of the token\n"
+            "  \"supply\": \"n\",            (string) The amount in unspent outputs\n"
+            "  \"holders\": n              (numeric) The number of addresses holding the token\n"
+            "}\n"
+            "\nExamples:\n"
+            "getntp1tokeninfo \"tokenid\"");
+
+    EnsureNTP1Index();
+    const std::string tokenId = params[0].get_str();
+
+    boost::optional<CNTP1TokenIndexEntry> entry;
+    CNTP1TokenStats                       stats;
+    {
+        LOCK(cs_main);
+        CTxDB txdb;
+
+        if (!txdb.ReadNTP1TokenIndexEntry(tokenId, entry) || !txdb.ReadNTP1TokenStats(tokenId, stats))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read the NTP1 index");
+    }
+    if (!entry)
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Token not found: " + tokenId);
+
+    Object result;
+    result.push_back(Pair("tokenId", tokenId));
+    result.push_back(Pair("symbol", entry->tokenSymbol));
+    result.push_back(Pair("issuanceTxid", entry->issuanceTxHash.GetHex()));
+    result.push_back(Pair("height", entry->nHeight));
+    result.push_back(Pair("issuedAmount", ToString(entry->nIssuedAmount)));
+    result.push_back(Pair("divisibility", static_cast<int64_t>(entry->nDivisibility)));
+    result.push_back(Pair("locked", entry->fLocked != 0));
+    result.push_back(Pair("aggregationPolicy", entry->aggregationPolicy));
+    result.push_back(Pair("supply", ToString(stats.nSupply)));
+    result.push_back(Pair("holders", static_cast<int64_t>(stats.nHolders)));
+    return result;
+}
+
+Value getntp1tokenholders(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() < 1 || params.size() > 3)
+        throw std::runtime_error(
+            "getntp1tokenholders \"tokenid\" ( skip count )\n"
+            "\nReturns the addresses holding an NTP1 token and their balances, sorted by address. "
+            "Needs -ntp1index.\n"
+            "\nArguments:\n"
+            "1. \"tokenid\"                (string, required) The token id\n"
+            "2. skip                     (numeric, optional) The number of holders to skip\n"
+            "3. count                    (numeric, optional) The maximum number of holders\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"address\": \"address\",   (string) The address\n"
+            "    \"balance\": \"n\"          (string) The balance of the token\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            "getntp1tokenholders \"tokenid\" 0 100");
+
+    EnsureNTP1Index();
+    AddressIndexQuery page;
+    if (params.size() > 1) {
+        if (params[1].get_int() < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "skip can't be negative");
+        page.nSkip = params[1].get_int();
+    }
+    if (params.size() > 2) {
+        if (params[2].get_int() < 0)
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "count can't be negative");
+        page.nCount = params[2].get_int();
+    }
+
+    std::vector<std::pair<CIndexedAddress, NTP1Int>> holders;
+    {
+        LOCK(cs_main);
+        CTxDB txdb;
+
+        if (!txdb.ReadNTP1TokenHolders(params[0].get_str(), holders))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read the NTP1 index");
+    }
+
+    Array      result;
+    const auto range = GetPage(holders, page);
+    for (auto it = range.first; it != range.second; ++it) {
+        Object holder;
+        holder.push_back(Pair("address", CBitcoinAddress(it->first.GetDestination()).ToString()));
+        holder.push_back(Pair("balance", ToString(it->second)));
+        result.push_back(holder);
+    }
+    return result;
+}
+
+Value getntp1addressbalances(const Array& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw std::runtime_error(
+            "getntp1addressbalances \"address\"\n"
+            "\nReturns the confirmed balances of the NTP1 tokens of an address. Needs -ntp1index.\n"
+            "\nArguments:\n"
+            "1. \"address\"                (string, required) The address\n"
+            "\nResult:\n"
+            "[\n"
+            "  {\n"
+            "    \"tokenId\": \"id\",        (string) The token id\n"
+            "    \"symbol\": \"symbol\",     (string) The symbol of the token\n"
+            "    \"balance\": \"n\"          (string) The balance of the token\n"
+            "  }\n"
+            "  ,...\n"
+            "]\n"
+            "\nExamples:\n"
+            "getntp1addressbalances \"address\"");
+
+    EnsureNTP1Index();
+    const CBitcoinAddress address(params[0].get_str());
+    CIndexedAddress       indexed;
+    if (!address.IsValid())
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid address: " + params[0].get_str());
+    if (!CIndexedAddress::FromDestination(address.Get(), indexed))
+        throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY,
+                           "Address type isn't in the NTP1 index: " + params[0].get_str());
+
+    LOCK(cs_main);
+    CTxDB txdb;
+
+    std::vector<std::pair<std::string, NTP1Int>> balances;
+    if (!txdb.ReadNTP1AddressBalances(indexed, balances))
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read the NTP1 index");
+
+    Array result;
+    for (const std::pair<std::string, NTP1Int>& balance : balances) {
+        boost::optional<CNTP1TokenIndexEntry> entry;
+        if (!txdb.ReadNTP1TokenIndexEntry(balance.first, entry))
+            throw JSONRPCError(RPC_DATABASE_ERROR, "Failed to read the NTP1 index");
+        Object token;
+        token.push_back(Pair("tokenId", balance.first));
+        token.push_back(Pair("symbol", entry ? entry->tokenSymbol : std::string()));
+        token.push_back(Pair("balance", ToString(balance.second)));
+        result.push_back(token);
+    }
+    return result;
+}
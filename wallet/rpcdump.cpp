@@ -151,11 +151,12 @@ Value importprivkey(const Array& params, bool fHelp)
 
         // whenever a key is imported, we need to scan the whole chain
         pwalletMain->nTimeFirstKey = 1; // 0 would be considered 'no value'
-
-        pwalletMain->ScanForWalletTransactions(boost::atomic_load(&pindexGenesisBlock).get(), true);
-        pwalletMain->ReacceptWalletTransactions();
     }
 
+    // the rescan locks the chain and the wallet only a batch of blocks at a time
+    pwalletMain->ScanForWalletTransactions(boost::atomic_load(&pindexGenesisBlock).get(), true);
+    pwalletMain->ReacceptWalletTransactions();
+
     return Value::null;
 }
 
@@ -196,11 +197,6 @@ Value importwallet(const Array& params, bool fHelp)
         key.SetSecret(secret, fCompressed);
         CKeyID keyid = key.GetPubKey().GetID();
 
-        if (pwalletMain->HaveKey(keyid)) {
-            printf("Skipping import of %s (key already present)\n",
-                   CBitcoinAddress(keyid).ToString().c_str());
-            continue;
-        }
         int64_t     nTime = DecodeDumpTime(vstr[1]);
         std::string strLabel;
         bool        fLabel = true;
@@ -216,25 +212,41 @@ Value importwallet(const Array& params, bool fHelp)
                 fLabel   = true;
             }
         }
-        printf("Importing %s...\n", CBitcoinAddress(keyid).ToString().c_str());
-        if (!pwalletMain->AddKey(key)) {
-            fGood = false;
-            continue;
+        {
+            LOCK2(cs_main, pwalletMain->cs_wallet);
+
+            if (pwalletMain->HaveKey(keyid)) {
+                printf("Skipping import of %s (key already present)\n",
+                       CBitcoinAddress(keyid).ToString().c_str());
+                continue;
+            }
+            printf("Importing %s...\n", CBitcoinAddress(keyid).ToString().c_str());
+            if (!pwalletMain->AddKey(key)) {
+                fGood = false;
+                continue;
+            }
+            pwalletMain->mapKeyMetadata[keyid].nCreateTime = nTime;
+            if (fLabel)
+                pwalletMain->SetAddressBookEntry(keyid, strLabel);
         }
-        pwalletMain->mapKeyMetadata[keyid].nCreateTime = nTime;
-        if (fLabel)
-            pwalletMain->SetAddressBookEntry(keyid, strLabel);
         nTimeBegin = std::min(nTimeBegin, nTime);
     }
     file.close();
 
-    CBlockIndexSmartPtr pindex = pindexBest;
-    while (pindex && pindex->pprev && pindex->nTime > nTimeBegin - 7200)
-        pindex = pindex->pprev;
+    CBlockIndexSmartPtr pindex;
+    {
+        LOCK2(cs_main, pwalletMain->cs_wallet);
+
+        pindex = pindexBest;
+        while (pindex && pindex->pprev && pindex->nTime > nTimeBegin - 7200)
+            pindex = pindex->pprev;
 
-    if (!pwalletMain->nTimeFirstKey || nTimeBegin < pwalletMain->nTimeFirstKey)
-        pwalletMain->nTimeFirstKey = nTimeBegin;
+        if (!pwalletMain->nTimeFirstKey || nTimeBegin < pwalletMain->nTimeFirstKey)
+            pwalletMain->nTimeFirstKey = nTimeBegin;
+    }
 
+    // the locks are only taken around the keys, so that the rescan takes them a batch of blocks at a
+    // time and the node keeps running meanwhile
     printf("Rescanning last %i blocks\n",
            boost::atomic_load(&pindexBest)->nHeight - pindex->nHeight + 1);
     pwalletMain->ScanForWalletTransactions(pindex.get());
@@ -235,9 +235,10 @@ Value getworkex(const Array& params, bool fHelp)
         pblock->nTime  = pdata->nTime;
         pblock->nNonce = pdata->nNonce;
 
-        if (coinbase.size() == 0)
+        if (coinbase.size() == 0) {
             pblock->vtx[0].vin[0].scriptSig = mapNewBlock[pdata->hashMerkleRoot].second;
-        else
+            pblock->vtx[0].InvalidateHash();
+        } else
             CDataStream(coinbase, SER_NETWORK, PROTOCOL_VERSION) >> pblock->vtx[0]; // FIXME - HACK!
 
         pblock->hashMerkleRoot = pblock->GetMerkleRoot();
@@ -351,7 +352,8 @@ Value getwork(const Array& params, bool fHelp)
         pblock->nTime                   = pdata->nTime;
         pblock->nNonce                  = pdata->nNonce;
         pblock->vtx[0].vin[0].scriptSig = mapNewBlock[pdata->hashMerkleRoot].second;
-        pblock->hashMerkleRoot          = pblock->GetMerkleRoot();
+        pblock->vtx[0].InvalidateHash();
+        pblock->hashMerkleRoot = pblock->GetMerkleRoot();
 
         return CheckWork(pblock, *pwalletMain, reservekey);
     }
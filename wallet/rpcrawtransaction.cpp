@@ -202,6 +202,8 @@ Value getrawtransaction(const Array& params, bool fHelp)
         CTxDB  txdb;
         CBlock block;
         if (!txdb.ReadBlock(hashBlock, block, true)) {
+            if (!txdb.ContainsBlock(hashBlock))
+                throw JSONRPCError(RPC_MISC_ERROR, "Block not available (pruned data)");
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block hash not found");
         }
         auto txIt = std::find_if(block.vtx.cbegin(), block.vtx.cend(),
@@ -214,8 +216,15 @@ Value getrawtransaction(const Array& params, bool fHelp)
         tx = *txIt;
     } else {
         // if no specific block was mentioned, then get the tx from the mempool, or the main chain
-        if (!GetTransaction(hash, tx, hashBlock))
+        if (!GetTransaction(hash, tx, hashBlock)) {
+            // the tx index is kept when the block of the transaction is pruned
+            CTxDB    txdb("r");
+            CTxIndex txindex;
+            if (txdb.ContainsTx(hash) && txdb.ReadTxIndex(hash, txindex) &&
+                !txdb.ContainsBlock(txindex.pos.nBlockPos))
+                throw JSONRPCError(RPC_MISC_ERROR, "Transaction not available (pruned data)");
             throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "No information available about transaction");
+        }
     }
 
     CDataStream ssTx(SER_NETWORK, PROTOCOL_VERSION);
@@ -773,6 +782,7 @@ Value signrawtransaction(const Array& params, bool fHelp)
                 CombineSignatures(prevPubKey, mergedTx, i, txin.scriptSig, txv.vin[i].scriptSig);
         }
     }
+    mergedTx.InvalidateHash();
 
     // verify sigs
     for (unsigned int i = 0; i < mergedTx.vin.size(); i++) {
@@ -4,13 +4,13 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include <boost/foreach.hpp>
-#include <boost/tuple/tuple.hpp>
-#include <boost/tuple/tuple_comparison.hpp>
 
 using namespace std;
 using namespace boost;
 
 #include "bignum.h"
+#include "cuckoocache.h"
+#include "hash.h"
 #include "key.h"
 #include "keystore.h"
 #include "main.h"
@@ -25,7 +25,7 @@ std::vector<unsigned char> ToByteVector(const T& in)
 }
 
 bool CheckSig(vector<unsigned char> vchSig, vector<unsigned char> vchPubKey, CScript scriptCode,
-              const CTransaction& txTo, unsigned int nIn, int nHashType);
+              const CTransaction& txTo, unsigned int nIn, int nHashType, bool fEraseCachedSig);
 
 namespace {
 
@@ -427,7 +427,7 @@ bool CheckSequence(const int64_t& nSequence, const CTransaction& txTo, unsigned
 
 Result<void, ScriptError> EvalScript(vector<vector<unsigned char>>& stack, const CScript& script,
                                      const CTransaction& txTo, unsigned int nIn, bool fStrictEncodings,
-                                     int nHashType, ScriptError* serror)
+                                     int nHashType, ScriptError* serror, bool fEraseCachedSigs)
 {
     CAutoBN_CTX             pctx;
     CScript::const_iterator pc             = script.begin();
@@ -1098,7 +1098,8 @@ Result<void, ScriptError> EvalScript(vector<vector<unsigned char>>& stack, const
                     bool fSuccess = (!fStrictEncodings ||
                                      (IsCanonicalSignature(vchSig) && IsCanonicalPubKey(vchPubKey)));
                     if (fSuccess)
-                        fSuccess = CheckSig(vchSig, vchPubKey, scriptCode, txTo, nIn, nHashType);
+                        fSuccess = CheckSig(vchSig, vchPubKey, scriptCode, txTo, nIn, nHashType,
+                                            fEraseCachedSigs);
 
                     popstack(stack);
                     popstack(stack);
@@ -1156,7 +1157,8 @@ Result<void, ScriptError> EvalScript(vector<vector<unsigned char>>& stack, const
                         bool fOk = (!fStrictEncodings ||
                                     (IsCanonicalSignature(vchSig) && IsCanonicalPubKey(vchPubKey)));
                         if (fOk)
-                            fOk = CheckSig(vchSig, vchPubKey, scriptCode, txTo, nIn, nHashType);
+                            fOk = CheckSig(vchSig, vchPubKey, scriptCode, txTo, nIn, nHashType,
+                                           fEraseCachedSigs);
 
                         if (fOk) {
                             isig++;
@@ -1216,6 +1218,7 @@ uint256 SignatureHash(CScript scriptCode, const CTransaction& txTo, unsigned int
         return 1;
     }
     CTransaction txTmp(txTo);
+    txTmp.InvalidateHash(); // changed below
 
     // In case concatenating two scripts ends up with two codeseparators,
     // or an extra one at the end, this prevents all those possible incompatibilities.
@@ -1271,58 +1274,84 @@ uint256 SignatureHash(CScript scriptCode, const CTransaction& txTo, unsigned int
 class CSignatureCache
 {
 private:
-    // sigdata_type is (signature hash, signature, public key):
-    typedef boost::tuple<uint256, std::vector<unsigned char>, std::vector<unsigned char>> sigdata_type;
-    std::set<sigdata_type>                                                                setValid;
-    CCriticalSection                                                                      cs_sigcache;
+    // keys of the two SipHash instances that make up the 128-bit cache entries; as they are random to
+    // every node, nobody can prepare signatures whose entries collide with others
+    uint64_t     salt[4];
+    bool         fEnabled;
+    CCuckooCache setValid;
+
+    static std::size_t GetCacheBytes()
+    {
+        // DoS prevention: the cache takes a fixed amount of memory; init rejects sizes out of range
+        std::size_t nBytes = 0;
+        if (!GetSignatureCacheBytes(nBytes))
+            nBytes = static_cast<std::size_t>(DEFAULT_MAX_SIG_CACHE_SIZE) << 20;
+        return nBytes;
+    }
+
+    CCuckooCache::Key ComputeEntry(const uint256& hash, const std::vector<unsigned char>& vchSig,
+                                   const std::vector<unsigned char>& pubKey) const
+    {
+        CSipHasher hasher0(salt[0], salt[1]);
+        CSipHasher hasher1(salt[2], salt[3]);
+        for (CSipHasher* hasher : {&hasher0, &hasher1}) {
+            hasher->Write(hash.begin(), hash.size());
+            hasher->Write(pubKey.size()).Write(vchSig.size());
+            hasher->Write(pubKey.data(), pubKey.size()).Write(vchSig.data(), vchSig.size());
+        }
+        return CCuckooCache::Key{hasher0.Finalize(), hasher1.Finalize()};
+    }
 
 public:
-    bool Get(uint256 hash, const std::vector<unsigned char>& vchSig,
-             const std::vector<unsigned char>& pubKey)
+    CSignatureCache()
+        : fEnabled(GetCacheBytes() > 0), setValid(GetCacheBytes())
     {
-        LOCK(cs_sigcache);
+        const uint256 randomSalt = GetRandHash();
+        for (int i = 0; i < 4; i++)
+            salt[i] = randomSalt.Get64(i);
+    }
 
-        sigdata_type                     k(hash, vchSig, pubKey);
-        std::set<sigdata_type>::iterator mi = setValid.find(k);
-        if (mi != setValid.end())
-            return true;
-        return false;
+    bool Get(const uint256& hash, const std::vector<unsigned char>& vchSig,
+             const std::vector<unsigned char>& pubKey, bool fErase)
+    {
+        if (!fEnabled)
+            return false;
+        return setValid.contains(ComputeEntry(hash, vchSig, pubKey), fErase);
     }
 
-    void Set(uint256 hash, const std::vector<unsigned char>& vchSig,
+    void Set(const uint256& hash, const std::vector<unsigned char>& vchSig,
              const std::vector<unsigned char>& pubKey)
     {
-        // DoS prevention: limit cache size to less than 10MB
-        // (~200 bytes per cache entry times 50,000 entries)
-        // Since there are a maximum of 20,000 signature operations per block
-        // 50,000 is a reasonable default.
-        int64_t nMaxCacheSize = GetArg("-maxsigcachesize", 50000);
-        if (nMaxCacheSize <= 0)
+        if (!fEnabled)
             return;
-
-        LOCK(cs_sigcache);
-
-        while (static_cast<int64_t>(setValid.size()) > nMaxCacheSize) {
-            // Evict a random entry. Random because that helps
-            // foil would-be DoS attackers who might try to pre-generate
-            // and re-use a set of valid signatures just-slightly-greater
-            // than our cache size.
-            uint256                          randomHash = GetRandHash();
-            std::vector<unsigned char>       unused;
-            std::set<sigdata_type>::iterator it =
-                setValid.lower_bound(sigdata_type(randomHash, unused, unused));
-            if (it == setValid.end())
-                it = setValid.begin();
-            setValid.erase(*it);
-        }
-
-        sigdata_type k(hash, vchSig, pubKey);
-        setValid.insert(k);
+        setValid.insert(ComputeEntry(hash, vchSig, pubKey));
     }
 };
 
+bool GetSignatureCacheBytes(std::size_t& nBytes)
+{
+    // every entry takes a 128-bit key and a flag
+    static const int64_t ENTRY_BYTES = sizeof(CCuckooCache::Key) + sizeof(std::atomic<bool>);
+    static const int64_t MAX_BYTES   = MAX_MAX_SIG_CACHE_SIZE << 20;
+
+    int64_t nSize = 0;
+    if (mapArgs.exists("-maxsigcachemb") || !mapArgs.exists("-maxsigcachesize")) {
+        nSize = GetArg("-maxsigcachemb", DEFAULT_MAX_SIG_CACHE_SIZE);
+        if (nSize < 0 || nSize > MAX_MAX_SIG_CACHE_SIZE)
+            return false;
+        nSize <<= 20;
+    } else {
+        nSize = GetArg("-maxsigcachesize", 0);
+        if (nSize < 0 || nSize > MAX_BYTES / ENTRY_BYTES)
+            return false;
+        nSize *= ENTRY_BYTES;
+    }
+    nBytes = static_cast<std::size_t>(nSize);
+    return true;
+}
+
 bool CheckSig(vector<unsigned char> vchSig, vector<unsigned char> vchPubKey, CScript scriptCode,
-              const CTransaction& txTo, unsigned int nIn, int nHashType)
+              const CTransaction& txTo, unsigned int nIn, int nHashType, bool fEraseCachedSig)
 {
     static CSignatureCache signatureCache;
 
@@ -1337,7 +1366,7 @@ bool CheckSig(vector<unsigned char> vchSig, vector<unsigned char> vchPubKey, CSc
 
     uint256 sighash = SignatureHash(scriptCode, txTo, nIn, nHashType);
 
-    if (signatureCache.Get(sighash, vchSig, vchPubKey))
+    if (signatureCache.Get(sighash, vchSig, vchPubKey, fEraseCachedSig))
         return true;
 
     CKey key;
@@ -1347,7 +1376,9 @@ bool CheckSig(vector<unsigned char> vchSig, vector<unsigned char> vchPubKey, CSc
     if (!key.Verify(sighash, vchSig))
         return false;
 
-    signatureCache.Set(sighash, vchSig, vchPubKey);
+    // a signature checked while connecting a block won't be needed again
+    if (!fEraseCachedSig)
+        signatureCache.Set(sighash, vchSig, vchPubKey);
     return true;
 }
 
@@ -1804,17 +1835,19 @@ bool ExtractDestinations(const CScript& scriptPubKey, txnouttype& typeRet,
 Result<void, ScriptError> VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey,
                                        const CTransaction& txTo, unsigned int nIn,
                                        bool fValidatePayToScriptHash, bool fStrictEncodings,
-                                       int nHashType)
+                                       int nHashType, bool fEraseCachedSigs)
 {
 
     vector<vector<unsigned char>> stack, stackCopy;
 
-    TRYV(EvalScript(stack, scriptSig, txTo, nIn, fStrictEncodings, nHashType));
+    TRYV(EvalScript(stack, scriptSig, txTo, nIn, fStrictEncodings, nHashType, nullptr,
+                    fEraseCachedSigs));
 
     if (fValidatePayToScriptHash)
         stackCopy = stack;
 
-    TRYV(EvalScript(stack, scriptPubKey, txTo, nIn, fStrictEncodings, nHashType));
+    TRYV(EvalScript(stack, scriptPubKey, txTo, nIn, fStrictEncodings, nHashType, nullptr,
+                    fEraseCachedSigs));
 
     if (stack.empty())
         return Err(SCRIPT_ERR_EVAL_FALSE);
@@ -1834,7 +1867,8 @@ Result<void, ScriptError> VerifyScript(const CScript& scriptSig, const CScript&
         CScript        pubKey2(pubKeySerialized.begin(), pubKeySerialized.end());
         popstack(stackCopy);
 
-        TRYV(EvalScript(stackCopy, pubKey2, txTo, nIn, fStrictEncodings, nHashType));
+        TRYV(EvalScript(stackCopy, pubKey2, txTo, nIn, fStrictEncodings, nHashType, nullptr,
+                        fEraseCachedSigs));
 
         if (stackCopy.empty())
             return Err(SCRIPT_ERR_EVAL_FALSE);
@@ -1858,7 +1892,9 @@ SignatureState SignSignature(const CKeyStore& keystore, const CScript& fromPubKe
     uint256 hash = SignatureHash(fromPubKey, txTo, nIn, nHashType);
 
     txnouttype whichType;
-    if (!Solver(keystore, fromPubKey, hash, nHashType, txin.scriptSig, whichType, fColdStake))
+    const bool fSolved = Solver(keystore, fromPubKey, hash, nHashType, txin.scriptSig, whichType, fColdStake);
+    txTo.InvalidateHash(); // the scriptSig changed
+    if (!fSolved)
         return SignatureState::Failed;
 
     if (whichType == TX_SCRIPTHASH) {
@@ -1871,11 +1907,12 @@ SignatureState SignSignature(const CKeyStore& keystore, const CScript& fromPubKe
         uint256 hash2 = SignatureHash(subscript, txTo, nIn, nHashType);
 
         txnouttype subType;
-        bool       fSolved = Solver(keystore, subscript, hash2, nHashType, txin.scriptSig, subType) &&
-                       subType != TX_SCRIPTHASH;
+        bool       fSubSolved = Solver(keystore, subscript, hash2, nHashType, txin.scriptSig, subType) &&
+                          subType != TX_SCRIPTHASH;
         // Append serialized subscript whether or not it is completely signed:
         txin.scriptSig << static_cast<valtype>(subscript);
-        if (!fSolved)
+        txTo.InvalidateHash();
+        if (!fSubSolved)
             return SignatureState::Failed;
     }
 
@@ -1903,7 +1940,7 @@ SignatureState SignSignature(const CKeyStore& keystore, const CTransaction& txFr
 
 Result<void, ScriptError> VerifySignature(const CTransaction& txFrom, const CTransaction& txTo,
                                           unsigned int nIn, bool fValidatePayToScriptHash,
-                                          bool fStrictEncodings, int nHashType)
+                                          bool fStrictEncodings, int nHashType, bool fEraseCachedSigs)
 {
     assert(nIn < txTo.vin.size());
     const CTxIn& txin = txTo.vin[nIn];
@@ -1915,10 +1952,22 @@ Result<void, ScriptError> VerifySignature(const CTransaction& txFrom, const CTra
         return Err(ScriptError::SCRIPT_ERR_UNKNOWN_ERROR);
 
     TRYV(VerifyScript(txin.scriptSig, txout.scriptPubKey, txTo, nIn, fValidatePayToScriptHash,
-                      fStrictEncodings, nHashType));
+                      fStrictEncodings, nHashType, fEraseCachedSigs));
     return Ok();
 }
 
+bool CScriptCheck::operator()()
+{
+    const CScript& scriptSig = ptxTo->vin[nIn].scriptSig;
+    const auto     res       = VerifyScript(scriptSig, scriptPubKey, *ptxTo, nIn, fValidatePayToScriptHash,
+                                            fStrictEncodings, nHashType, fEraseCachedSigs);
+    if (res.isErr()) {
+        error = res.unwrapErr();
+        return false;
+    }
+    return true;
+}
+
 static CScript PushAll(const vector<valtype>& values)
 {
     CScript result;
@@ -1953,7 +2002,7 @@ static CScript CombineMultisig(CScript scriptPubKey, const CTransaction& txTo, u
             if (sigs.count(pubkey))
                 continue; // Already got a sig for this pubkey
 
-            if (CheckSig(sig, pubkey, scriptPubKey, txTo, nIn, 0)) {
+            if (CheckSig(sig, pubkey, scriptPubKey, txTo, nIn, 0, false)) {
                 sigs[pubkey] = sig;
                 break;
             }
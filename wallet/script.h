@@ -674,6 +674,13 @@ enum class SignatureState : uint32_t
     Failed
 };
 
+/**
+ * The memory the signature cache takes, in bytes, from -maxsigcachemb; or from -maxsigcachesize, which
+ * counts entries, as it did before the cache was sized in megabytes. False if the option is negative
+ * or above MAX_MAX_SIG_CACHE_SIZE megabytes.
+ */
+bool GetSignatureCacheBytes(std::size_t& nBytes);
+
 bool IsCanonicalPubKey(const std::vector<unsigned char>& vchPubKey);
 bool IsCanonicalSignature(const std::vector<unsigned char>& vchSig);
 
@@ -682,7 +689,7 @@ CScript GetScriptForStakeDelegation(const CKeyID& stakingKey, const CKeyID& spen
 Result<void, ScriptError> EvalScript(std::vector<std::vector<unsigned char>>& stack,
                                      const CScript& script, const CTransaction& txTo, unsigned int nIn,
                                      bool fStrictEncodings, int nHashType,
-                                     ScriptError* serror = nullptr);
+                                     ScriptError* serror = nullptr, bool fEraseCachedSigs = false);
 bool                      Solver(const CScript& scriptPubKey, txnouttype& typeRet,
                                  std::vector<std::vector<unsigned char>>& vSolutionsRet);
 int  ScriptSigArgsExpected(txnouttype t, const std::vector<std::vector<unsigned char>>& vSolutions);
@@ -703,10 +710,62 @@ SignatureState SignSignature(const CKeyStore& keystore, const CTransaction& txFr
 Result<void, ScriptError> VerifyScript(const CScript& scriptSig, const CScript& scriptPubKey,
                                        const CTransaction& txTo, unsigned int nIn,
                                        bool fValidatePayToScriptHash, bool fStrictEncodings,
-                                       int nHashType);
+                                       int nHashType, bool fEraseCachedSigs = false);
 Result<void, ScriptError> VerifySignature(const CTransaction& txFrom, const CTransaction& txTo,
                                           unsigned int nIn, bool fValidatePayToScriptHash,
-                                          bool fStrictEncodings, int nHashType);
+                                          bool fStrictEncodings, int nHashType,
+                                          bool fEraseCachedSigs = false);
+
+/**
+ * Closure representing one script verification, to be run in CCheckQueue.
+ * The spent output's script is copied, so the previous transaction doesn't have to outlive the check;
+ * the spending transaction, however, must outlive it.
+ */
+class CScriptCheck
+{
+    CScript             scriptPubKey;
+    const CTransaction* ptxTo;
+    unsigned int        nIn;
+    bool                fValidatePayToScriptHash;
+    bool                fStrictEncodings;
+    int                 nHashType;
+    bool                fEraseCachedSigs;
+    ScriptError         error;
+
+public:
+    CScriptCheck()
+        : ptxTo(nullptr), nIn(0), fValidatePayToScriptHash(false), fStrictEncodings(false),
+          nHashType(0), fEraseCachedSigs(false), error(ScriptError::SCRIPT_ERR_UNKNOWN_ERROR)
+    {
+    }
+    CScriptCheck(const CScript& scriptPubKeyIn, const CTransaction& txToIn, unsigned int nInIn,
+                 bool fValidatePayToScriptHashIn, bool fStrictEncodingsIn, int nHashTypeIn,
+                 bool fEraseCachedSigsIn)
+        : scriptPubKey(scriptPubKeyIn), ptxTo(&txToIn), nIn(nInIn),
+          fValidatePayToScriptHash(fValidatePayToScriptHashIn), fStrictEncodings(fStrictEncodingsIn),
+          nHashType(nHashTypeIn), fEraseCachedSigs(fEraseCachedSigsIn),
+          error(ScriptError::SCRIPT_ERR_UNKNOWN_ERROR)
+    {
+    }
+
+    bool operator()();
+
+    void swap(CScriptCheck& check)
+    {
+        scriptPubKey.swap(check.scriptPubKey);
+        std::swap(ptxTo, check.ptxTo);
+        std::swap(nIn, check.nIn);
+        std::swap(fValidatePayToScriptHash, check.fValidatePayToScriptHash);
+        std::swap(fStrictEncodings, check.fStrictEncodings);
+        std::swap(nHashType, check.nHashType);
+        std::swap(fEraseCachedSigs, check.fEraseCachedSigs);
+        std::swap(error, check.error);
+    }
+
+    const CTransaction* GetTx() const { return ptxTo; }
+    unsigned int        GetInputIndex() const { return nIn; }
+    ScriptError         GetScriptError() const { return error; }
+};
 
 // Given two sets of signatures for scriptPubKey, possibly with OP_0 placeholders,
 // combine them intelligently and return the result.
@@ -36,6 +36,15 @@
 #include "util.h"
 #include "net.h"
 
+#include <algorithm>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__) &&                             \
+    (defined(__GNUC__) || defined(__clang__))
+#define SCRYPT_LANES_X86
+#include <immintrin.h>
+#include <memory>
+#endif
+
 #define SCRYPT_BUFFER_SIZE (131072 + 63)
 
 #if defined (OPTIMIZED_SALSA) && ( defined (__x86_64__) || defined (__i386__) || defined(__arm__) )
@@ -196,3 +205,225 @@ uint256 scrypt_blockhash(const void* input)
     return scrypt_nosalt(input, 80, scratchpad);
 }
 
+/* Batch hashing of block headers: on x86, the Salsa20/8 core of several headers is computed at
+   once, each header in its own 32-bit lane of the SIMD registers (4 lanes with SSE2, 8 with
+   AVX2, picked at runtime). The PBKDF2 steps before and after it are done one header at a time.
+ */
+
+#ifdef SCRYPT_LANES_X86
+
+/* words of the scratchpad V of a single lane */
+#define SCRYPT_LANE_WORDS (1024 * 32)
+
+/* One double round of Salsa20/8 on x[0..15], where QR(a, b, c, n) does a ^= rotl(b + c, n) */
+#define SALSA8_DOUBLE_ROUND(QR, x)                                                                   \
+    do {                                                                                           \
+        /* Operate on columns. */                                                                  \
+        QR(x[4], x[0], x[12], 7);  QR(x[9], x[5], x[1], 7);                                        \
+        QR(x[14], x[10], x[6], 7); QR(x[3], x[15], x[11], 7);                                      \
+        QR(x[8], x[4], x[0], 9);   QR(x[13], x[9], x[5], 9);                                       \
+        QR(x[2], x[14], x[10], 9); QR(x[7], x[3], x[15], 9);                                       \
+        QR(x[12], x[8], x[4], 13); QR(x[1], x[13], x[9], 13);                                      \
+        QR(x[6], x[2], x[14], 13); QR(x[11], x[7], x[3], 13);                                      \
+        QR(x[0], x[12], x[8], 18); QR(x[5], x[1], x[13], 18);                                      \
+        QR(x[10], x[6], x[2], 18); QR(x[15], x[11], x[7], 18);                                     \
+        /* Operate on rows. */                                                                     \
+        QR(x[1], x[0], x[3], 7);   QR(x[6], x[5], x[4], 7);                                        \
+        QR(x[11], x[10], x[9], 7); QR(x[12], x[15], x[14], 7);                                     \
+        QR(x[2], x[1], x[0], 9);   QR(x[7], x[6], x[5], 9);                                        \
+        QR(x[8], x[11], x[10], 9); QR(x[13], x[12], x[15], 9);                                     \
+        QR(x[3], x[2], x[1], 13);  QR(x[4], x[7], x[6], 13);                                       \
+        QR(x[9], x[8], x[11], 13); QR(x[14], x[13], x[12], 13);                                    \
+        QR(x[0], x[3], x[2], 18);  QR(x[5], x[4], x[7], 18);                                       \
+        QR(x[10], x[9], x[8], 18); QR(x[15], x[14], x[13], 18);                                    \
+    } while (0)
+
+/* PBKDF2 of every header into X, with word k of lane l at X[k * lanes + l] */
+static void scrypt_lanes_begin(const void* const* inputs, unsigned int* X, int lanes)
+{
+    for (int l = 0; l < lanes; l++) {
+        unsigned int Xl[32];
+        PBKDF2_SHA256((const uint8_t*)inputs[l], 80, (const uint8_t*)inputs[l], 80, 1, (uint8_t *)Xl,
+                      128);
+        for (int k = 0; k < 32; k++)
+            X[k * lanes + l] = Xl[k];
+    }
+}
+
+static void scrypt_lanes_end(const void* const* inputs, const unsigned int* X, uint256* outputs,
+                             int lanes)
+{
+    for (int l = 0; l < lanes; l++) {
+        unsigned int Xl[32];
+        for (int k = 0; k < 32; k++)
+            Xl[k] = X[k * lanes + l];
+        outputs[l] = 0;
+        PBKDF2_SHA256((const uint8_t*)inputs[l], 80, (uint8_t *)Xl, 128, 1, (uint8_t*)&outputs[l], 32);
+    }
+}
+
+/* SSE2, 4 lanes */
+
+static inline __m128i rotl_4x(__m128i a, int n)
+{
+    return _mm_or_si128(_mm_slli_epi32(a, n), _mm_srli_epi32(a, 32 - n));
+}
+
+#define SALSA8_QR_4X(a, b, c, n) a = _mm_xor_si128(a, rotl_4x(_mm_add_epi32(b, c), n))
+
+static inline void xor_salsa8_4x(__m128i B[16], const __m128i Bx[16])
+{
+    __m128i x[16];
+    int i;
+
+    for (i = 0; i < 16; i++)
+        x[i] = B[i] = _mm_xor_si128(B[i], Bx[i]);
+    for (i = 0; i < 8; i += 2)
+        SALSA8_DOUBLE_ROUND(SALSA8_QR_4X, x);
+    for (i = 0; i < 16; i++)
+        B[i] = _mm_add_epi32(B[i], x[i]);
+}
+
+/* V holds 4 interleaved scratchpads, word k of entry i of lane l at V[(i * 32 + k) * 4 + l] */
+static void scrypt_core_4x(__m128i X[32], unsigned int *V)
+{
+    unsigned int i, k;
+
+    for (i = 0; i < 1024; i++) {
+        for (k = 0; k < 32; k++)
+            _mm_storeu_si128((__m128i*)&V[(i * 32 + k) * 4], X[k]);
+        xor_salsa8_4x(&X[0], &X[16]);
+        xor_salsa8_4x(&X[16], &X[0]);
+    }
+    for (i = 0; i < 1024; i++) {
+        unsigned int j[4];
+        _mm_storeu_si128((__m128i*)j, X[16]);
+        for (k = 0; k < 4; k++)
+            j[k] = (j[k] & 1023) * 32 * 4 + k;
+        for (k = 0; k < 32; k++)
+            X[k] = _mm_xor_si128(X[k], _mm_set_epi32(V[j[3] + k * 4], V[j[2] + k * 4],
+                                                     V[j[1] + k * 4], V[j[0] + k * 4]));
+        xor_salsa8_4x(&X[0], &X[16]);
+        xor_salsa8_4x(&X[16], &X[0]);
+    }
+}
+
+static void scrypt_blockhash_4x(const void* const* inputs, uint256* outputs, unsigned int *V)
+{
+    unsigned int Xw[32 * 4];
+    __m128i X[32];
+    int k;
+
+    scrypt_lanes_begin(inputs, Xw, 4);
+    for (k = 0; k < 32; k++)
+        X[k] = _mm_loadu_si128((const __m128i*)&Xw[k * 4]);
+    scrypt_core_4x(X, V);
+    for (k = 0; k < 32; k++)
+        _mm_storeu_si128((__m128i*)&Xw[k * 4], X[k]);
+    scrypt_lanes_end(inputs, Xw, outputs, 4);
+}
+
+/* AVX2, 8 lanes; only called if the CPU supports it */
+
+#define SCRYPT_TARGET_AVX2 __attribute__((target("avx2")))
+
+SCRYPT_TARGET_AVX2 static inline __m256i rotl_8x(__m256i a, int n)
+{
+    return _mm256_or_si256(_mm256_slli_epi32(a, n), _mm256_srli_epi32(a, 32 - n));
+}
+
+#define SALSA8_QR_8X(a, b, c, n) a = _mm256_xor_si256(a, rotl_8x(_mm256_add_epi32(b, c), n))
+
+SCRYPT_TARGET_AVX2 static inline void xor_salsa8_8x(__m256i B[16], const __m256i Bx[16])
+{
+    __m256i x[16];
+    int i;
+
+    for (i = 0; i < 16; i++)
+        x[i] = B[i] = _mm256_xor_si256(B[i], Bx[i]);
+    for (i = 0; i < 8; i += 2)
+        SALSA8_DOUBLE_ROUND(SALSA8_QR_8X, x);
+    for (i = 0; i < 16; i++)
+        B[i] = _mm256_add_epi32(B[i], x[i]);
+}
+
+/* V holds 8 interleaved scratchpads, word k of entry i of lane l at V[(i * 32 + k) * 8 + l] */
+SCRYPT_TARGET_AVX2 static void scrypt_core_8x(__m256i X[32], unsigned int *V)
+{
+    const __m256i laneOffsets = _mm256_set_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+    const __m256i entryMask   = _mm256_set1_epi32(1023);
+    unsigned int i, k;
+
+    for (i = 0; i < 1024; i++) {
+        for (k = 0; k < 32; k++)
+            _mm256_storeu_si256((__m256i*)&V[(i * 32 + k) * 8], X[k]);
+        xor_salsa8_8x(&X[0], &X[16]);
+        xor_salsa8_8x(&X[16], &X[0]);
+    }
+    for (i = 0; i < 1024; i++) {
+        /* every lane reads its own entry of its scratchpad */
+        const __m256i j = _mm256_add_epi32(
+            _mm256_slli_epi32(_mm256_and_si256(X[16], entryMask), 8), laneOffsets);
+        for (k = 0; k < 32; k++)
+            X[k] = _mm256_xor_si256(X[k], _mm256_i32gather_epi32(
+                (const int*)V, _mm256_add_epi32(j, _mm256_set1_epi32(k * 8)), 4));
+        xor_salsa8_8x(&X[0], &X[16]);
+        xor_salsa8_8x(&X[16], &X[0]);
+    }
+}
+
+SCRYPT_TARGET_AVX2 static void scrypt_blockhash_8x(const void* const* inputs, uint256* outputs,
+                                                   unsigned int *V)
+{
+    unsigned int Xw[32 * 8];
+    __m256i X[32];
+    int k;
+
+    scrypt_lanes_begin(inputs, Xw, 8);
+    for (k = 0; k < 32; k++)
+        X[k] = _mm256_loadu_si256((const __m256i*)&Xw[k * 8]);
+    scrypt_core_8x(X, V);
+    for (k = 0; k < 32; k++)
+        _mm256_storeu_si256((__m256i*)&Xw[k * 8], X[k]);
+    scrypt_lanes_end(inputs, Xw, outputs, 8);
+}
+
+static bool scrypt_cpu_has_avx2()
+{
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+}
+
+#endif // SCRYPT_LANES_X86
+
+void scrypt_blockhash_batch(const void* const* inputs, uint256* outputs, size_t count)
+{
+    size_t i = 0;
+
+#ifdef SCRYPT_LANES_X86
+    static const bool fAVX2 = scrypt_cpu_has_avx2();
+
+    const int lanes = fAVX2 ? 8 : 4;
+    if (count >= 2) {
+        std::unique_ptr<unsigned int[]> V(new unsigned int[SCRYPT_LANE_WORDS * lanes]);
+        while (count - i >= 2) {
+            /* a last group of fewer headers than lanes is filled up with copies of its last one */
+            const void* laneInputs[8];
+            uint256     laneOutputs[8];
+            const size_t nHeaders = std::min<size_t>(count - i, lanes);
+            for (int l = 0; l < lanes; l++)
+                laneInputs[l] = inputs[i + std::min<size_t>(l, nHeaders - 1)];
+            if (fAVX2)
+                scrypt_blockhash_8x(laneInputs, laneOutputs, V.get());
+            else
+                scrypt_blockhash_4x(laneInputs, laneOutputs, V.get());
+            for (size_t l = 0; l < nHeaders; l++)
+                outputs[i + l] = laneOutputs[l];
+            i += nHeaders;
+        }
+    }
+#endif
+
+    for (; i < count; i++)
+        outputs[i] = scrypt_blockhash(inputs[i]);
+}
@@ -12,4 +12,10 @@ uint256 scrypt_salted_hash(const void* input, size_t inputlen, const void* salt,
 uint256 scrypt_hash(const void* input, size_t inputlen);
 uint256 scrypt_blockhash(const void* input);
 
+/**
+ * Hashes count block headers of 80 bytes each, giving the same results as scrypt_blockhash() on
+ * every one of them, but several at once with SIMD instructions where the CPU has them
+ */
+void scrypt_blockhash_batch(const void* const* inputs, uint256* outputs, size_t count);
+
 #endif // SCRYPT_MINE_H
@@ -53,6 +53,7 @@ enum
     // modifiers
     SER_SKIPSIG         = (1 << 16),
     SER_BLOCKHEADERONLY = (1 << 17),
+    SER_NTP1_COMPACT    = (1 << 18), // compact layout of NTP1 transactions, used in the tx db
 };
 
 #define IMPLEMENT_SERIALIZE(statements)    \
@@ -383,6 +384,92 @@ public:
 template<typename I>
 CVarInt<I> WrapVarInt(I& n) { return CVarInt<I>(n); }
 
+#define COMPACTHEXSTR(obj)   REF(CCompactHexStr(REF(obj)))
+#define COMPACTNTP1INT(obj)  REF(CCompactNTP1Int(REF(obj)))
+
+/** Wrapper for serializing a hex string as the bytes it encodes.
+ *  Strings that don't come back identical from lower-case hex encoding (odd length, upper case,
+ *  non-hex characters) are stored verbatim, so the round trip is always exact.
+ */
+class CCompactHexStr
+{
+protected:
+    std::string& str;
+
+    static int HexDigitValue(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        return -1;
+    }
+
+    bool IsLowerHex() const
+    {
+        if (str.size() % 2 != 0)
+            return false;
+        for (char c : str)
+            if (HexDigitValue(c) < 0)
+                return false;
+        return true;
+    }
+
+    std::vector<unsigned char> ToBytes() const
+    {
+        std::vector<unsigned char> vch(str.size() / 2);
+        for (unsigned int i = 0; i < vch.size(); i++)
+            vch[i] = (HexDigitValue(str[2 * i]) << 4) | HexDigitValue(str[2 * i + 1]);
+        return vch;
+    }
+
+    void FromBytes(const std::vector<unsigned char>& vch)
+    {
+        static const char hexmap[] = "0123456789abcdef";
+        str.resize(vch.size() * 2);
+        for (unsigned int i = 0; i < vch.size(); i++) {
+            str[2 * i]     = hexmap[vch[i] >> 4];
+            str[2 * i + 1] = hexmap[vch[i] & 0x0f];
+        }
+    }
+
+public:
+    CCompactHexStr(std::string& strIn) : str(strIn) { }
+
+    unsigned int GetSerializeSize(int, int=0) const;
+
+    template<typename Stream>
+    void Serialize(Stream& s, int, int=0) const;
+
+    template<typename Stream>
+    void Unserialize(Stream& s, int, int=0);
+};
+
+/** Wrapper for serializing an NTP1Int as a VARINT when it fits in 64 bits (which is always the case
+ *  for valid token amounts), and as its decimal string otherwise.
+ */
+class CCompactNTP1Int
+{
+protected:
+    NTP1Int& num;
+
+    bool FitsInUint64() const
+    {
+        return num >= 0 && num <= std::numeric_limits<uint64_t>::max();
+    }
+
+public:
+    CCompactNTP1Int(NTP1Int& numIn) : num(numIn) { }
+
+    unsigned int GetSerializeSize(int, int=0) const;
+
+    template<typename Stream>
+    void Serialize(Stream& s, int, int=0) const;
+
+    template<typename Stream>
+    void Unserialize(Stream& s, int, int=0);
+};
+
 //
 // Forward declarations
 //
@@ -528,6 +615,84 @@ void Unserialize(Stream& is, NTP1Int& num, int, int)
 
 
 
+//
+// CCompactHexStr
+//
+inline unsigned int CCompactHexStr::GetSerializeSize(int, int) const
+{
+    if (IsLowerHex())
+        return 1 + GetSizeOfCompactSize(str.size() / 2) + str.size() / 2;
+    return 1 + ::GetSerializeSize(str, 0, 0);
+}
+
+template<typename Stream>
+void CCompactHexStr::Serialize(Stream& s, int, int) const
+{
+    // the first byte tells which of the two encodings follows
+    unsigned char chEncoding = (IsLowerHex() ? 0 : 1);
+    WRITEDATA(s, chEncoding);
+    if (chEncoding == 0)
+        ::Serialize(s, ToBytes(), 0, 0);
+    else
+        ::Serialize(s, str, 0, 0);
+}
+
+template<typename Stream>
+void CCompactHexStr::Unserialize(Stream& s, int, int)
+{
+    unsigned char chEncoding;
+    READDATA(s, chEncoding);
+    if (chEncoding == 0) {
+        std::vector<unsigned char> vch;
+        ::Unserialize(s, vch, 0, 0);
+        FromBytes(vch);
+    } else if (chEncoding == 1) {
+        ::Unserialize(s, str, 0, 0);
+    } else {
+        throw std::ios_base::failure("CCompactHexStr::Unserialize() : unknown encoding");
+    }
+}
+
+
+
+//
+// CCompactNTP1Int
+//
+inline unsigned int CCompactNTP1Int::GetSerializeSize(int, int) const
+{
+    if (FitsInUint64())
+        return 1 + GetSizeOfVarInt<uint64_t>(num.convert_to<uint64_t>());
+    return 1 + ::GetSerializeSize(num, 0, 0);
+}
+
+template<typename Stream>
+void CCompactNTP1Int::Serialize(Stream& s, int, int) const
+{
+    // the first byte tells which of the two encodings follows
+    unsigned char chEncoding = (FitsInUint64() ? 0 : 1);
+    WRITEDATA(s, chEncoding);
+    if (chEncoding == 0)
+        WriteVarInt<Stream, uint64_t>(s, num.convert_to<uint64_t>());
+    else
+        ::Serialize(s, num, 0, 0);
+}
+
+template<typename Stream>
+void CCompactNTP1Int::Unserialize(Stream& s, int, int)
+{
+    unsigned char chEncoding;
+    READDATA(s, chEncoding);
+    if (chEncoding == 0) {
+        num = NTP1Int(ReadVarInt<Stream, uint64_t>(s));
+    } else if (chEncoding == 1) {
+        ::Unserialize(s, num, 0, 0);
+    } else {
+        throw std::ios_base::failure("CCompactNTP1Int::Unserialize() : unknown encoding");
+    }
+}
+
+
+
 //
 // vector
 //
@@ -1145,6 +1310,110 @@ public:
 
 
 
+/** Read-only stream over memory that is owned by someone else.
+ *
+ * Unlike CDataStream, nothing is copied on construction, so this can be used to unserialize
+ * directly from memory mapped data (e.g., an lmdb value while its transaction is alive).
+ * The viewed memory must outlive the view.
+ */
+class CDataStreamView
+{
+protected:
+    const char* pbegin;
+    const char* pend;
+    const char* pread;
+    short state;
+    short exceptmask;
+public:
+    int nType;
+    int nVersion;
+
+    CDataStreamView(const char* pbeginIn, const char* pendIn, int nTypeIn, int nVersionIn)
+        : pbegin(pbeginIn), pend(pendIn), pread(pbeginIn)
+    {
+        assert(pendIn >= pbeginIn);
+        nType = nTypeIn;
+        nVersion = nVersionIn;
+        state = 0;
+        exceptmask = std::ios::badbit | std::ios::failbit;
+    }
+
+    std::string str() const
+    {
+        return (std::string(pread, pend));
+    }
+
+    const char* data() const     { return pread; }
+    size_t size() const          { return pend - pread; }
+    bool empty() const           { return pread == pend; }
+
+
+    //
+    // Stream subset
+    //
+    void setstate(short bits, const char* psz)
+    {
+        state |= bits;
+        if (state & exceptmask)
+            throw std::ios_base::failure(psz);
+    }
+
+    bool eof() const             { return size() == 0; }
+    bool fail() const            { return state & (std::ios::badbit | std::ios::failbit); }
+    bool good() const            { return !eof() && (state == 0); }
+    void clear(short n)          { state = n; }
+    short exceptions()           { return exceptmask; }
+    short exceptions(short mask) { short prev = exceptmask; exceptmask = mask; setstate(0, "CDataStreamView"); return prev; }
+    int in_avail()               { return size(); }
+
+    void SetType(int n)          { nType = n; }
+    int GetType()                { return nType; }
+    void SetVersion(int n)       { nVersion = n; }
+    int GetVersion()             { return nVersion; }
+    void ReadVersion()           { *this >> nVersion; }
+
+    CDataStreamView& read(char* pch, size_t nSize)
+    {
+        if (nSize > size())
+        {
+            setstate(std::ios::failbit, "CDataStreamView::read() : end of data");
+            memset(pch, 0, nSize);
+            nSize = size();
+        }
+        memcpy(pch, pread, nSize);
+        pread += nSize;
+        return (*this);
+    }
+
+    CDataStreamView& ignore(size_t nSize)
+    {
+        if (nSize > size())
+        {
+            setstate(std::ios::failbit, "CDataStreamView::ignore() : end of data");
+            nSize = size();
+        }
+        pread += nSize;
+        return (*this);
+    }
+
+    template<typename T>
+    unsigned int GetSerializeSize(const T& obj)
+    {
+        // Tells the size of the object if serialized to this stream
+        return ::GetSerializeSize(obj, nType, nVersion);
+    }
+
+    template<typename T>
+    CDataStreamView& operator>>(T& obj)
+    {
+        // Unserialize from this stream
+        ::Unserialize(*this, obj, nType, nVersion);
+        return (*this);
+    }
+};
+
+
+
 
 
 
@@ -30,75 +30,76 @@ bool IsStakeTxSizeValid(const CTransaction& stakeTx)
     return true;
 }
 
-boost::optional<StakeKernelData>
-TestAndCreateStakeKernel(CTxDB& txdb, const StakeMaker::KeyGetterFunctorType& keyGetter,
-                         const unsigned int nBits, const int64_t nCoinstakeInitialTxTime,
-                         const int64_t                                       lastCoinStakeSearchTime,
-                         const ConstCBlockIndexSmartPtr&                     pindexPrev,
-                         const std::pair<const CTransaction*, unsigned int>& pcoin)
+// needs cs_main
+static boost::optional<CStakeKernelPrefix> ReadStakeKernelPrefix(CTxDB& txdb, const CTransaction& tx,
+                                                                 unsigned int n)
 {
     CTxIndex txindex;
-    CBlock   kernelBlock;
-    {
-        LOCK(cs_main);
+    if (!txdb.ReadTxIndex(tx.GetHash(), txindex))
+        return boost::none;
 
-        if (!txdb.ReadTxIndex(pcoin.first->GetHash(), txindex))
-            return boost::none;
+    // Read block header
+    CBlock kernelBlock;
+    if (!kernelBlock.ReadFromDisk(txindex.pos.nBlockPos, false))
+        return boost::none;
 
-        // Read block header
-        if (!kernelBlock.ReadFromDisk(txindex.pos.nBlockPos, false))
-            return boost::none;
-    }
+    CStakeKernelPrefix prefix;
+    if (!GetStakeKernelPrefix(kernelBlock, txindex.pos.nTxPos, tx, COutPoint(tx.GetHash(), n), prefix))
+        return boost::none;
+    return prefix;
+}
 
+boost::optional<StakeKernelData>
+TestAndCreateStakeKernel(const StakeMaker::KeyGetterFunctorType& keyGetter, const unsigned int nBits,
+                         const int64_t nCoinstakeInitialTxTime, const int64_t lastCoinStakeSearchTime,
+                         const CStakeKernelPrefix&                           prefix,
+                         const std::pair<const CTransaction*, unsigned int>& pcoin)
+{
     const int64_t nSearchInterval = nCoinstakeInitialTxTime - lastCoinStakeSearchTime;
 
     const int          nMaxStakeSearchInterval = Params().MaxStakeSearchInterval();
     const unsigned int nSMA                    = Params().StakeMinAge();
-    if (kernelBlock.GetBlockTime() + nSMA > nCoinstakeInitialTxTime - nMaxStakeSearchInterval)
+    if (prefix.nTimeBlockFrom + nSMA > nCoinstakeInitialTxTime - nMaxStakeSearchInterval)
         return boost::none; // only count coins meeting min age requirement
 
-    for (unsigned int n = 0; n < std::min(nSearchInterval, (int64_t)nMaxStakeSearchInterval) &&
-                             !fShutdown && pindexPrev == pindexBest;
-         n++) {
-        // Search backward in time from the given tx timestamp
-        // Search nSearchInterval seconds back up to nMaxStakeSearchInterval
-        uint256       hashProofOfStake = 0, targetProofOfStake = 0;
-        COutPoint     prevoutStake    = COutPoint(pcoin.first->GetHash(), pcoin.second);
-        const int64_t txCoinstakeTime = nCoinstakeInitialTxTime - n;
-        if (!CheckStakeKernelHash(nBits, kernelBlock, txindex.pos.nTxPos, *pcoin.first, prevoutStake,
-                                  txCoinstakeTime, hashProofOfStake, targetProofOfStake)) {
-            continue;
-        }
+    // Search backward in time from the given tx timestamp
+    // Search nSearchInterval seconds back up to nMaxStakeSearchInterval
+    const int64_t nSearch = std::min(nSearchInterval, (int64_t)nMaxStakeSearchInterval);
+    if (nSearch <= 0)
+        return boost::none;
+    unsigned int txCoinstakeTime = 0;
+    if (!FindStakeKernelTime(nBits, prefix, nCoinstakeInitialTxTime - nSearch + 1,
+                             nCoinstakeInitialTxTime, txCoinstakeTime)) {
+        return boost::none;
+    }
 
-        // Found a kernel
-        if (fDebug)
-            printf("FindStakeKernel : kernel found\n");
+    // Found a kernel
+    if (fDebug)
+        printf("FindStakeKernel : kernel found\n");
 
-        const CScript& kernelScriptPubKey = pcoin.first->vout[pcoin.second].scriptPubKey;
+    const CScript& kernelScriptPubKey = pcoin.first->vout[pcoin.second].scriptPubKey;
 
-        const boost::optional<CScript> spkKernel =
-            StakeMaker::CalculateScriptPubKeyForStakeOutput(keyGetter, kernelScriptPubKey);
+    const boost::optional<CScript> spkKernel =
+        StakeMaker::CalculateScriptPubKeyForStakeOutput(keyGetter, kernelScriptPubKey);
 
-        if (!spkKernel) {
-            if (fDebug)
-                printf("FindStakeKernel : failed to get scriptPubKey for kernel");
-            continue;
-        }
+    if (!spkKernel) {
+        if (fDebug)
+            printf("FindStakeKernel : failed to get scriptPubKey for kernel");
+        return boost::none;
+    }
 
-        StakeKernelData coinStake;
+    StakeKernelData coinStake;
 
-        // Fill coin stake transaction
-        coinStake.kernelScriptPubKey      = kernelScriptPubKey;
-        coinStake.credit                  = pcoin.first->vout[pcoin.second].nValue;
-        coinStake.kernelTx                = pcoin.first;
-        coinStake.kernelBlockTime         = kernelBlock.GetBlockTime();
-        coinStake.kernelInput             = CTxIn(pcoin.first->GetHash(), pcoin.second);
-        coinStake.stakeTxTime             = txCoinstakeTime;
-        coinStake.stakeOutputScriptPubKey = *spkKernel;
+    // Fill coin stake transaction
+    coinStake.kernelScriptPubKey      = kernelScriptPubKey;
+    coinStake.credit                  = pcoin.first->vout[pcoin.second].nValue;
+    coinStake.kernelTx                = pcoin.first;
+    coinStake.kernelBlockTime         = prefix.nTimeBlockFrom;
+    coinStake.kernelInput             = CTxIn(pcoin.first->GetHash(), pcoin.second);
+    coinStake.stakeTxTime             = txCoinstakeTime;
+    coinStake.stakeOutputScriptPubKey = *spkKernel;
 
-        return coinStake;
-    }
-    return boost::none;
+    return coinStake;
 }
 
 boost::optional<CAmount> CalculateStakeReward(const CTransaction& stakeTx, CAmount nFees,
@@ -211,6 +212,7 @@ StakeMaker::CreateCoinStake(const CWallet& wallet, const unsigned int nBits, con
     nFinalCredit += *oReward;
 
     stakeTx.vout = MakeStakeOutputs(kernelData->stakeOutputScriptPubKey, nFinalCredit, splitStake);
+    stakeTx.InvalidateHash();
 
     if (!SignAndVerify(wallet, inputs, stakeTx)) {
         printf("CreateCoinStake : SignAndVerify() failed");
@@ -269,9 +271,17 @@ boost::optional<CTransaction> StakeMaker::CreateCoinStakeFromSpecificOutput(cons
         return boost::none;
     }
 
-    const boost::optional<StakeKernelData> kernelData = TestAndCreateStakeKernel(
-        txdb, keyGetter, nBits, nCoinstakeInitialTxTime, nLastCoinStakeSearchTime, pindexPrev,
-        std::make_pair(&outputTx, output.n));
+    boost::optional<CStakeKernelPrefix> prefix;
+    {
+        LOCK(cs_main);
+        prefix = ReadStakeKernelPrefix(txdb, outputTx, output.n);
+    }
+    if (!prefix || fShutdown || pindexPrev != pindexBest)
+        return boost::none;
+
+    const boost::optional<StakeKernelData> kernelData =
+        TestAndCreateStakeKernel(keyGetter, nBits, nCoinstakeInitialTxTime, nLastCoinStakeSearchTime,
+                                 *prefix, std::make_pair(&outputTx, output.n));
 
     // stake was not found
     if (!kernelData) {
@@ -298,6 +308,7 @@ boost::optional<CTransaction> StakeMaker::CreateCoinStakeFromSpecificOutput(cons
     nFinalCredit += *oReward;
 
     stakeTx.vout = MakeStakeOutputs(kernelData->stakeOutputScriptPubKey, nFinalCredit, splitStake);
+    stakeTx.InvalidateHash();
 
     // create a temporary key store and store our key in it
     CBasicKeyStore keyStore;
@@ -439,18 +450,58 @@ StakeMaker::FindStakeKernel(const CKeyStore& keystore, const unsigned int nBits,
 {
     CBlockIndexSmartPtr pindexPrev = boost::atomic_load(&pindexBest);
 
-    CTxDB txdb("r");
+    const std::map<COutPoint, CStakeKernelPrefix> mapKernels =
+        GetStakeKernelPrefixes(setCoins, pindexPrev->GetBlockHash());
 
+    // no disk access nor lock from here on
     for (const auto& pcoin : setCoins) {
+        if (fShutdown || pindexPrev != pindexBest)
+            break;
+        const auto it = mapKernels.find(COutPoint(pcoin.first->GetHash(), pcoin.second));
+        if (it == mapKernels.end())
+            continue;
         if (boost::optional<StakeKernelData> res = TestAndCreateStakeKernel(
-                txdb, StakeMaker::DefaultKeyGetter(keystore), nBits, nCoinstakeInitialTxTime,
-                nLastCoinStakeSearchTime, pindexPrev, pcoin)) {
+                StakeMaker::DefaultKeyGetter(keystore), nBits, nCoinstakeInitialTxTime,
+                nLastCoinStakeSearchTime, it->second, pcoin)) {
             return res;
         }
     }
     return boost::none;
 }
 
+std::map<COutPoint, CStakeKernelPrefix>
+StakeMaker::GetStakeKernelPrefixes(const std::set<std::pair<const CWalletTx*, unsigned int>>& setCoins,
+                                   const uint256& hashBestBlock)
+{
+    CTxDB txdb("r");
+
+    LOCK(cs_main);
+    std::lock_guard<std::mutex> lock(kernelCacheMutex);
+
+    // the kernels only change if the blocks they were taken from leave the main chain
+    if (hashBestBlock != hashKernelCacheBestBlock) {
+        BlockIndexMapType::const_iterator mi = mapBlockIndex.find(hashKernelCacheBestBlock);
+        if (mi == mapBlockIndex.end() || !mi->second->IsInMainChain())
+            mapKernelCache.clear();
+        hashKernelCacheBestBlock = hashBestBlock;
+    }
+
+    // only the coins that are staked now are kept
+    std::map<COutPoint, CStakeKernelPrefix> mapKernels;
+    for (const auto& pcoin : setCoins) {
+        const COutPoint outpoint(pcoin.first->GetHash(), pcoin.second);
+        const auto      it = mapKernelCache.find(outpoint);
+        if (it != mapKernelCache.end()) {
+            mapKernels.insert(*it);
+        } else if (boost::optional<CStakeKernelPrefix> prefix =
+                       ReadStakeKernelPrefix(txdb, *pcoin.first, pcoin.second)) {
+            mapKernels.insert(std::make_pair(outpoint, *prefix));
+        }
+    }
+    mapKernelCache = mapKernels;
+    return mapKernels;
+}
+
 CoinStakeInputsResult
 StakeMaker::CollectInputsForStake(const StakeKernelData&                                     kernelData,
                                   const std::set<std::pair<const CWalletTx*, unsigned int>>& setCoins,
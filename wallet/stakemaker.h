@@ -3,6 +3,7 @@
 
 #include "amount.h"
 #include "key.h"
+#include "kernel.h"
 #include "script.h"
 #include "transaction.h"
 #include "txin.h"
@@ -38,6 +39,15 @@ class StakeMaker
     boost::atomic_int64_t nLastCoinStakeSearchInterval{0};
     std::once_flag        timeSetterOnceFlag;
 
+    // the kernel prefixes of the staking coins, as of the best block they were last checked against
+    std::mutex                              kernelCacheMutex;
+    std::map<COutPoint, CStakeKernelPrefix> mapKernelCache;
+    uint256                                 hashKernelCacheBestBlock;
+
+    std::map<COutPoint, CStakeKernelPrefix>
+    GetStakeKernelPrefixes(const std::set<std::pair<const CWalletTx*, unsigned int>>& setCoins,
+                           const uint256&                                             hashBestBlock);
+
 public:
     StakeMaker() = default;
 
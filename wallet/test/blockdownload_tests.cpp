@@ -0,0 +1,352 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "blockdownload.h"
+
+#include <map>
+#include <memory>
+#include <set>
+
+namespace {
+/** The easiest target the test headers are counted at when their proof isn't checked */
+static const unsigned int TEST_EASIEST_BITS = 0x1e0fffff;
+
+/** A block index made of a map of hashes to heights, starting with a genesis block */
+class DownloadTestChain
+{
+public:
+    std::map<uint256, int>     mapIndex;
+    std::map<uint256, uint256> mapChainTrust; // 0 for blocks that aren't in it
+    std::set<int>              setRejectedHeights;
+    bool                       fProofChecked = true;
+    uint256                    hashGenesis;
+
+    DownloadTestChain()
+    {
+        hashGenesis           = uint256(1);
+        mapIndex[hashGenesis] = 0;
+    }
+
+    bool Lookup(const uint256& hash, int& nHeight, uint256& nChainTrust) const
+    {
+        auto it = mapIndex.find(hash);
+        if (it == mapIndex.end())
+            return false;
+        nHeight     = it->second;
+        auto itTrust = mapChainTrust.find(hash);
+        nChainTrust  = itTrust == mapChainTrust.end() ? uint256(0) : itTrust->second;
+        return true;
+    }
+
+    bool Check(const CBlock& header, int nHeight, unsigned int& nTrustBits) const
+    {
+        nTrustBits = fProofChecked ? header.nBits : TEST_EASIEST_BITS;
+        return setRejectedHeights.count(nHeight) == 0;
+    }
+
+    std::unique_ptr<CBlockDownloader> MakeDownloader() const
+    {
+        using namespace std::placeholders;
+        return std::unique_ptr<CBlockDownloader>(new CBlockDownloader(
+            std::bind(&DownloadTestChain::Lookup, this, _1, _2, _3),
+            std::bind(&DownloadTestChain::Check, this, _1, _2, _3)));
+    }
+};
+
+std::vector<CBlock> MakeHeaders(const uint256& hashPrev, int nCount, unsigned int nNonce = 0,
+                                unsigned int nBits = TEST_EASIEST_BITS)
+{
+    std::vector<CBlock> vHeaders;
+    uint256             hashLast = hashPrev;
+    for (int i = 0; i < nCount; i++) {
+        CBlock header;
+        header.nVersion      = 2;
+        header.hashPrevBlock = hashLast;
+        header.nTime         = 1500000000 + i;
+        header.nBits         = nBits;
+        header.nNonce        = nNonce;
+        vHeaders.push_back(header);
+        hashLast = header.GetHash();
+    }
+    return vHeaders;
+}
+} // namespace
+
+TEST(blockdownload_tests, headers_are_linked)
+{
+    DownloadTestChain                 chain;
+    std::unique_ptr<CBlockDownloader> downloader = chain.MakeDownloader();
+    downloader->AddPeer(1);
+    EXPECT_EQ(downloader->GetBestHeaderHeight(), -1);
+
+    std::vector<CBlock> vHeaders = MakeHeaders(chain.hashGenesis, 10);
+    EXPECT_EQ(downloader->AcceptHeaders(1, vHeaders), CBlockDownloader::HeadersResult::Accepted);
+    EXPECT_EQ(downloader->GetBestHeaderHeight(), 10);
+
+    // continuing from the tip of the header chain
+    std::vector<CBlock> vMore = MakeHeaders(vHeaders.back().GetHash(), 5);
+    EXPECT_EQ(downloader->AcceptHeaders(1, vMore), CBlockDownloader::HeadersResult::Accepted);
+    EXPECT_EQ(downloader->GetBestHeaderHeight(), 15);
+
+    uint256              hashBase;
+    std::vector<uint256> vLocator = downloader->GetLocatorHashes(hashBase);
+    EXPECT_EQ(hashBase, chain.hashGenesis);
+    ASSERT_FALSE(vLocator.empty());
+    EXPECT_EQ(vLocator.front(), vMore.back().GetHash());
+
+    // a shorter fork doesn't replace the header chain, a longer one does
+    std::vector<CBlock> vShortFork = MakeHeaders(vHeaders[4].GetHash(), 3, 1);
+    EXPECT_EQ(downloader->AcceptHeaders(1, vShortFork), CBlockDownloader::HeadersResult::Accepted);
+    EXPECT_EQ(downloader->GetBestHeaderHeight(), 15);
+    std::vector<CBlock> vLongFork = MakeHeaders(vHeaders[4].GetHash(), 20, 2);
+    EXPECT_EQ(downloader->AcceptHeaders(1, vLongFork), CBlockDownloader::HeadersResult::Accepted);
+    EXPECT_EQ(downloader->GetBestHeaderHeight(), 25);
+
+    // headers that don't build on each other, or on anything we know
+    std::vector<CBlock> vBroken = MakeHeaders(chain.hashGenesis, 3);
+    vBroken[2].hashPrevBlock    = uint256(5);
+    EXPECT_EQ(downloader->AcceptHeaders(1, vBroken), CBlockDownloader::HeadersResult::Invalid);
+    EXPECT_EQ(downloader->AcceptHeaders(1, MakeHeaders(uint256(5), 3)),
+              CBlockDownloader::HeadersResult::Unconnected);
+
+    // headers the checks reject
+    chain.setRejectedHeights.insert(27);
+    EXPECT_EQ(downloader->AcceptHeaders(1, MakeHeaders(vLongFork.back().GetHash(), 5)),
+              CBlockDownloader::HeadersResult::Invalid);
+    EXPECT_EQ(downloader->GetBestHeaderHeight(), 25);
+}
+
+TEST(blockdownload_tests, blocks_are_spread_over_peers)
+{
+    DownloadTestChain                 chain;
+    std::unique_ptr<CBlockDownloader> downloader = chain.MakeDownloader();
+    downloader->AddPeer(1);
+    downloader->AddPeer(2);
+    downloader->AddPeer(3);
+
+    std::vector<CBlock> vHeaders = MakeHeaders(chain.hashGenesis, 100);
+    ASSERT_EQ(downloader->AcceptHeaders(1, vHeaders), CBlockDownloader::HeadersResult::Accepted);
+    ASSERT_EQ(downloader->AcceptHeaders(2, vHeaders), CBlockDownloader::HeadersResult::Accepted);
+
+    // peer 3 only has the first 10 blocks
+    std::vector<CBlock> vFirst10(vHeaders.begin(), vHeaders.begin() + 10);
+    ASSERT_EQ(downloader->AcceptHeaders(3, vFirst10), CBlockDownloader::HeadersResult::Accepted);
+    std::vector<uint256> vFrom3 = downloader->RequestBlocks(3, 1000);
+    ASSERT_EQ(vFrom3.size(), 10u);
+    EXPECT_EQ(vFrom3.front(), vHeaders[0].GetHash());
+
+    std::vector<uint256> vFrom1 = downloader->RequestBlocks(1, 1000);
+    std::vector<uint256> vFrom2 = downloader->RequestBlocks(2, 1000);
+    ASSERT_EQ(vFrom1.size(), static_cast<std::size_t>(MAX_BLOCKS_IN_TRANSIT_PER_PEER));
+    ASSERT_EQ(vFrom2.size(), static_cast<std::size_t>(MAX_BLOCKS_IN_TRANSIT_PER_PEER));
+    EXPECT_EQ(vFrom1.front(), vHeaders[10].GetHash());
+    EXPECT_EQ(vFrom2.front(), vHeaders[10 + MAX_BLOCKS_IN_TRANSIT_PER_PEER].GetHash());
+    EXPECT_TRUE(downloader->RequestBlocks(1, 1000).empty());
+
+    // a disconnected peer's blocks go to others
+    downloader->RemovePeer(3);
+    EXPECT_TRUE(downloader->RequestBlocks(1, 1000).empty());
+    EXPECT_TRUE(downloader->BlockReceived(vFrom1[0]));
+    EXPECT_FALSE(downloader->BlockReceived(vFrom1[0]));
+    std::vector<uint256> vAgain = downloader->RequestBlocks(1, 1000);
+    ASSERT_EQ(vAgain.size(), 1u);
+    EXPECT_EQ(vAgain.front(), vHeaders[0].GetHash());
+}
+
+TEST(blockdownload_tests, early_blocks_are_held)
+{
+    DownloadTestChain                 chain;
+    std::unique_ptr<CBlockDownloader> downloader = chain.MakeDownloader();
+    downloader->AddPeer(1);
+
+    std::vector<CBlock> vHeaders = MakeHeaders(chain.hashGenesis, 3);
+    ASSERT_EQ(downloader->AcceptHeaders(1, vHeaders), CBlockDownloader::HeadersResult::Accepted);
+    ASSERT_EQ(downloader->RequestBlocks(1, 1000).size(), 3u);
+
+    // the last two arrive first
+    EXPECT_TRUE(downloader->BlockReceived(vHeaders[2].GetHash()));
+    EXPECT_TRUE(downloader->HoldBlock(vHeaders[2]));
+    EXPECT_TRUE(downloader->BlockReceived(vHeaders[1].GetHash()));
+    EXPECT_TRUE(downloader->HoldBlock(vHeaders[1]));
+    EXPECT_EQ(downloader->GetHeldBlocksCount(), 2u);
+    EXPECT_FALSE(downloader->HoldBlock(MakeHeaders(uint256(5), 1)[0]));
+
+    CBlock block;
+    EXPECT_FALSE(downloader->TakeConnectableBlock(block));
+
+    // their parent gets connected, and then them in order
+    chain.mapIndex[vHeaders[0].GetHash()] = 1;
+    ASSERT_TRUE(downloader->TakeConnectableBlock(block));
+    EXPECT_EQ(block.GetHash(), vHeaders[1].GetHash());
+    EXPECT_FALSE(downloader->TakeConnectableBlock(block));
+    chain.mapIndex[vHeaders[1].GetHash()] = 2;
+    ASSERT_TRUE(downloader->TakeConnectableBlock(block));
+    EXPECT_EQ(block.GetHash(), vHeaders[2].GetHash());
+    EXPECT_EQ(downloader->GetHeldBlocksCount(), 0u);
+}
+
+TEST(blockdownload_tests, failed_blocks_cut_the_header_chain)
+{
+    DownloadTestChain                 chain;
+    std::unique_ptr<CBlockDownloader> downloader = chain.MakeDownloader();
+    downloader->AddPeer(1);
+
+    std::vector<CBlock> vHeaders = MakeHeaders(chain.hashGenesis, 10);
+    ASSERT_EQ(downloader->AcceptHeaders(1, vHeaders), CBlockDownloader::HeadersResult::Accepted);
+    downloader->BlockFailed(vHeaders[5].GetHash());
+    EXPECT_EQ(downloader->GetBestHeaderHeight(), 5);
+    EXPECT_EQ(downloader->AcceptHeaders(1, vHeaders), CBlockDownloader::HeadersResult::Invalid);
+    EXPECT_EQ(downloader->GetBestHeaderHeight(), 5);
+}
+
+TEST(blockdownload_tests, stalling_peers)
+{
+    DownloadTestChain                 chain;
+    std::unique_ptr<CBlockDownloader> downloader = chain.MakeDownloader();
+
+    std::vector<CBlock> vHeaders = MakeHeaders(chain.hashGenesis, BLOCK_DOWNLOAD_WINDOW + 10);
+    const int nPeers = BLOCK_DOWNLOAD_WINDOW / MAX_BLOCKS_IN_TRANSIT_PER_PEER;
+    for (int node = 0; node <= nPeers; node++) {
+        downloader->AddPeer(node);
+        ASSERT_EQ(downloader->AcceptHeaders(node, vHeaders), CBlockDownloader::HeadersResult::Accepted);
+    }
+
+    // fill the whole window
+    for (int node = 0; node < nPeers; node++)
+        ASSERT_EQ(downloader->RequestBlocks(node, 1000).size(),
+                  static_cast<std::size_t>(MAX_BLOCKS_IN_TRANSIT_PER_PEER));
+
+    // the last peer gets nothing, because peer 0 has the first block of the window
+    EXPECT_TRUE(downloader->RequestBlocks(nPeers, 1000).empty());
+    EXPECT_FALSE(downloader->IsStalling(0, 1000 + BLOCK_STALLING_TIMEOUT));
+    EXPECT_TRUE(downloader->IsStalling(0, 1001 + BLOCK_STALLING_TIMEOUT));
+    EXPECT_FALSE(downloader->IsStalling(1, 1001 + BLOCK_STALLING_TIMEOUT));
+
+    // delivering a block ends it
+    EXPECT_TRUE(downloader->BlockReceived(vHeaders[0].GetHash()));
+    EXPECT_FALSE(downloader->IsStalling(0, 1001 + BLOCK_STALLING_TIMEOUT));
+
+    // blocks that don't arrive in time make every peer stall
+    EXPECT_TRUE(downloader->IsStalling(1, 1001 + BLOCK_DOWNLOAD_TIMEOUT));
+    EXPECT_EQ(downloader->GetBlocksInFlight(0),
+              static_cast<std::size_t>(MAX_BLOCKS_IN_TRANSIT_PER_PEER - 1));
+}
+
+TEST(blockdownload_tests, header_chain_follows_chain_trust)
+{
+    DownloadTestChain                 chain;
+    std::unique_ptr<CBlockDownloader> downloader = chain.MakeDownloader();
+    downloader->AddPeer(1);
+
+    std::vector<CBlock> vHeaders = MakeHeaders(chain.hashGenesis, 100);
+    ASSERT_EQ(downloader->AcceptHeaders(1, vHeaders), CBlockDownloader::HeadersResult::Accepted);
+    ASSERT_EQ(downloader->GetBestHeaderHeight(), 100);
+
+    // a few headers with a harder target have more trust than many easy ones
+    std::vector<CBlock> vHardFork = MakeHeaders(vHeaders[9].GetHash(), 5, 1, 0x1d00ffff);
+    EXPECT_EQ(downloader->AcceptHeaders(1, vHardFork), CBlockDownloader::HeadersResult::Accepted);
+    EXPECT_EQ(downloader->GetBestHeaderHeight(), 15);
+
+    // and a taller chain of easy ones doesn't take it back
+    std::vector<CBlock> vEasyFork = MakeHeaders(vHeaders[9].GetHash(), 200, 2);
+    EXPECT_EQ(downloader->AcceptHeaders(1, vEasyFork), CBlockDownloader::HeadersResult::Accepted);
+    EXPECT_EQ(downloader->GetBestHeaderHeight(), 15);
+
+    uint256 hashBase;
+    ASSERT_FALSE(downloader->GetLocatorHashes(hashBase).empty());
+    EXPECT_EQ(downloader->GetLocatorHashes(hashBase).front(), vHardFork.back().GetHash());
+}
+
+TEST(blockdownload_tests, unchecked_targets_dont_add_trust)
+{
+    DownloadTestChain chain;
+    chain.fProofChecked                          = false;
+    std::unique_ptr<CBlockDownloader> downloader = chain.MakeDownloader();
+    downloader->AddPeer(1);
+
+    std::vector<CBlock> vHeaders = MakeHeaders(chain.hashGenesis, 100);
+    ASSERT_EQ(downloader->AcceptHeaders(1, vHeaders), CBlockDownloader::HeadersResult::Accepted);
+
+    // a harder target nobody checked is worth no more than the easiest one
+    std::vector<CBlock> vHardFork = MakeHeaders(vHeaders[9].GetHash(), 5, 1, 0x1d00ffff);
+    EXPECT_EQ(downloader->AcceptHeaders(1, vHardFork), CBlockDownloader::HeadersResult::Accepted);
+    EXPECT_EQ(downloader->GetBestHeaderHeight(), 100);
+
+    // once the first blocks are connected with their real trust, the rest of the header chain keeps
+    // its place above them, and a short fork on top of them doesn't take over
+    uint256 nChainTrust = 0;
+    for (int i = 0; i < 5; i++) {
+        nChainTrust += uint256(1) << 40;
+        chain.mapIndex[vHeaders[i].GetHash()]      = i + 1;
+        chain.mapChainTrust[vHeaders[i].GetHash()] = nChainTrust;
+    }
+    downloader->RequestBlocks(1, 1000);
+    std::vector<CBlock> vShortFork = MakeHeaders(vHeaders[4].GetHash(), 2, 2);
+    EXPECT_EQ(downloader->AcceptHeaders(1, vShortFork), CBlockDownloader::HeadersResult::Accepted);
+    EXPECT_EQ(downloader->GetBestHeaderHeight(), 100);
+}
+
+TEST(blockdownload_tests, headers_leave_with_their_only_peer)
+{
+    DownloadTestChain                 chain;
+    std::unique_ptr<CBlockDownloader> downloader = chain.MakeDownloader();
+    downloader->AddPeer(1);
+    downloader->AddPeer(2);
+    downloader->AddPeer(3);
+
+    std::vector<CBlock> vHeaders = MakeHeaders(chain.hashGenesis, 20);
+    ASSERT_EQ(downloader->AcceptHeaders(1, vHeaders), CBlockDownloader::HeadersResult::Accepted);
+    std::vector<CBlock> vFirst10(vHeaders.begin(), vHeaders.begin() + 10);
+    ASSERT_EQ(downloader->AcceptHeaders(2, vFirst10), CBlockDownloader::HeadersResult::Accepted);
+
+    // a peer without headers leaving changes nothing
+    downloader->RemovePeer(3);
+    EXPECT_EQ(downloader->GetBestHeaderHeight(), 20);
+    EXPECT_FALSE(downloader->TakeHeadersDropped());
+
+    // only peer 1 has the last 10, which go with it
+    ASSERT_EQ(downloader->RequestBlocks(1, 1000).size(),
+              static_cast<std::size_t>(MAX_BLOCKS_IN_TRANSIT_PER_PEER));
+    downloader->RemovePeer(1);
+    EXPECT_EQ(downloader->GetBestHeaderHeight(), 10);
+    EXPECT_TRUE(downloader->TakeHeadersDropped());
+    EXPECT_FALSE(downloader->TakeHeadersDropped());
+    EXPECT_EQ(downloader->RequestBlocks(2, 1000).size(), 10u);
+
+    // they can be sent again by another peer
+    ASSERT_EQ(downloader->AcceptHeaders(2, vHeaders), CBlockDownloader::HeadersResult::Accepted);
+    EXPECT_EQ(downloader->GetBestHeaderHeight(), 20);
+}
+
+TEST(blockdownload_tests, blocks_come_from_peers_that_sent_their_headers)
+{
+    DownloadTestChain                 chain;
+    std::unique_ptr<CBlockDownloader> downloader = chain.MakeDownloader();
+    downloader->AddPeer(1);
+    downloader->AddPeer(2);
+
+    std::vector<CBlock> vHeaders = MakeHeaders(chain.hashGenesis, 10);
+    ASSERT_EQ(downloader->AcceptHeaders(1, vHeaders), CBlockDownloader::HeadersResult::Accepted);
+
+    // peer 2 hasn't sent any headers, so it's asked for the tip once instead of for blocks
+    EXPECT_TRUE(downloader->RequestBlocks(2, 1000).empty());
+    uint256 hashTip;
+    ASSERT_TRUE(downloader->StartTipCheck(2, hashTip));
+    EXPECT_EQ(hashTip, vHeaders.back().GetHash());
+    EXPECT_FALSE(downloader->StartTipCheck(2, hashTip));
+    EXPECT_FALSE(downloader->StartTipCheck(1, hashTip));
+
+    // it answers with the tip
+    std::vector<CBlock> vTip(1, vHeaders.back());
+    ASSERT_EQ(downloader->AcceptHeaders(2, vTip), CBlockDownloader::HeadersResult::Accepted);
+    std::vector<uint256> vFrom2 = downloader->RequestBlocks(2, 1000);
+    ASSERT_EQ(vFrom2.size(), 10u);
+
+    // a block it doesn't have after all goes to peer 1, without peer 2 stalling
+    downloader->BlockNotFound(2, vFrom2[4]);
+    EXPECT_FALSE(downloader->IsStalling(2, 1001 + BLOCK_DOWNLOAD_TIMEOUT - 1));
+    EXPECT_EQ(downloader->GetBlocksInFlight(2), 9u);
+    EXPECT_TRUE(downloader->RequestBlocks(2, 1000).empty());
+    std::vector<uint256> vFrom1 = downloader->RequestBlocks(1, 1000);
+    ASSERT_EQ(vFrom1.size(), 1u);
+    EXPECT_EQ(vFrom1.front(), vFrom2[4]);
+}
@@ -0,0 +1,86 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "activechain.h"
+#include "blockindex.h"
+#include "blockindexpool.h"
+
+#include <vector>
+
+namespace {
+std::vector<CBlockIndexSmartPtr> MakeChain(CBlockIndexPool&            pool,
+                                           const CBlockIndexSmartPtr& pindexFrom, int nBlocks)
+{
+    std::vector<CBlockIndexSmartPtr> vChain;
+    CBlockIndexSmartPtr              pprev = pindexFrom;
+    for (int i = 0; i < nBlocks; i++) {
+        CBlockIndexSmartPtr pindex = pool.Make();
+        pindex->pprev              = pprev;
+        pindex->nHeight            = pprev ? pprev->nHeight + 1 : 0;
+        vChain.push_back(pindex);
+        pprev = pindex;
+    }
+    return vChain;
+}
+} // namespace
+
+TEST(blockindexpool_tests, entries_are_packed)
+{
+    CBlockIndexPool                  pool;
+    std::vector<CBlockIndexSmartPtr> vEntries = MakeChain(pool, nullptr, 1000);
+
+    // consecutive entries are at most an entry and a reference count apart
+    for (unsigned i = 1; i < vEntries.size(); i++) {
+        const char* pprev = reinterpret_cast<const char*>(vEntries[i - 1].get());
+        const char* p     = reinterpret_cast<const char*>(vEntries[i].get());
+        if (p > pprev) // else a new chunk was started
+            EXPECT_LT(static_cast<std::size_t>(p - pprev), 2 * sizeof(CBlockIndex));
+        EXPECT_EQ(vEntries[i]->pprev, vEntries[i - 1]);
+        EXPECT_EQ(vEntries[i]->nHeight, static_cast<int>(i));
+    }
+    EXPECT_GT(pool.GetMemoryUsage(), 1000 * sizeof(CBlockIndex));
+    EXPECT_LT(pool.GetMemoryUsage(), 2000 * sizeof(CBlockIndex) + (2 << 20));
+
+    // entries are still reference counted one by one
+    CBlockIndexSmartPtr pindexKept = vEntries[500];
+    vEntries.clear();
+    EXPECT_EQ(pindexKept->nHeight, 500);
+    EXPECT_EQ(pindexKept.use_count(), 1);
+    EXPECT_EQ(pindexKept->pprev->nHeight, 499);
+}
+
+TEST(blockindexpool_tests, active_chain_by_height)
+{
+    CBlockIndexPool pool;
+    CActiveChain    chain;
+    EXPECT_EQ(chain.Height(), -1);
+    EXPECT_EQ(chain.AtHeight(0), nullptr);
+
+    std::vector<CBlockIndexSmartPtr> vMain = MakeChain(pool, nullptr, 100);
+    chain.SetTip(vMain.back());
+    EXPECT_EQ(chain.Height(), 99);
+    for (int i = 0; i < 100; i++) {
+        EXPECT_EQ(chain.AtHeight(i), vMain[i]);
+        EXPECT_TRUE(chain.Contains(vMain[i].get()));
+    }
+    EXPECT_EQ(chain.AtHeight(100), nullptr);
+    EXPECT_EQ(chain.AtHeight(-1), nullptr);
+
+    // reorganize to a longer fork from height 79
+    std::vector<CBlockIndexSmartPtr> vFork = MakeChain(pool, vMain[79], 30);
+    chain.SetTip(vFork.back());
+    EXPECT_EQ(chain.Height(), 109);
+    for (int i = 0; i < 80; i++)
+        EXPECT_EQ(chain.AtHeight(i), vMain[i]);
+    for (int i = 80; i < 110; i++)
+        EXPECT_EQ(chain.AtHeight(i), vFork[i - 80]);
+    EXPECT_FALSE(chain.Contains(vMain[80].get()));
+
+    // and back to a shorter tip of the original chain
+    chain.SetTip(vMain[90]);
+    EXPECT_EQ(chain.Height(), 90);
+    EXPECT_EQ(chain.AtHeight(85), vMain[85]);
+    EXPECT_FALSE(chain.Contains(vFork[0].get()));
+
+    chain.SetTip(nullptr);
+    EXPECT_EQ(chain.Height(), -1);
+}
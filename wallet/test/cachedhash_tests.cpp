@@ -0,0 +1,155 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "block.h"
+#include "cachedhash.h"
+#include "hash.h"
+#include "scrypt.h"
+#include "transaction.h"
+#include "util.h"
+
+namespace {
+CTransaction MakeTx()
+{
+    CTransaction tx;
+    tx.nTime = 1000000;
+    tx.vin.resize(1);
+    tx.vin[0].prevout   = COutPoint(uint256(1), 0);
+    tx.vin[0].scriptSig = CScript() << OP_1;
+    tx.vout.resize(1);
+    tx.vout[0].nValue       = 1000;
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    return tx;
+}
+
+uint256 FreshBlockHash(const CBlock& block) { return scrypt_blockhash(CVOIDBEGIN(block.nVersion)); }
+} // namespace
+
+TEST(cachedhash_tests, cached_hash_basics)
+{
+    CCachedHash cached;
+    uint256     hash;
+    EXPECT_FALSE(cached.Get(hash));
+
+    cached.Set(uint256(5));
+    ASSERT_TRUE(cached.Get(hash));
+    EXPECT_EQ(hash, uint256(5));
+
+    // a known hash isn't replaced
+    cached.Set(uint256(6));
+    ASSERT_TRUE(cached.Get(hash));
+    EXPECT_EQ(hash, uint256(5));
+
+    CCachedHash copy(cached);
+    ASSERT_TRUE(copy.Get(hash));
+    EXPECT_EQ(hash, uint256(5));
+
+    cached.Invalidate();
+    EXPECT_FALSE(cached.Get(hash));
+    EXPECT_TRUE(copy.Get(hash));
+
+    copy = cached;
+    EXPECT_FALSE(copy.Get(hash));
+}
+
+TEST(cachedhash_tests, tx_hash_follows_invalidation)
+{
+    CTransaction tx = MakeTx();
+    EXPECT_EQ(tx.GetHash(), SerializeHash(tx));
+
+    tx.vout[0].nValue = 2000;
+    tx.InvalidateHash();
+    EXPECT_EQ(tx.GetHash(), SerializeHash(tx));
+
+    // copies keep the hash, and are invalidated on their own
+    CTransaction copy = tx;
+    EXPECT_EQ(copy.GetHash(), tx.GetHash());
+    copy.nTime += 1;
+    copy.InvalidateHash();
+    EXPECT_EQ(copy.GetHash(), SerializeHash(copy));
+    EXPECT_NE(copy.GetHash(), tx.GetHash());
+    EXPECT_EQ(tx.GetHash(), SerializeHash(tx));
+
+    tx.SetNull();
+    EXPECT_EQ(tx.GetHash(), SerializeHash(tx));
+}
+
+TEST(cachedhash_tests, tx_hash_after_unserialize)
+{
+    const CTransaction source = MakeTx();
+    CTransaction       tx     = MakeTx();
+    tx.vout[0].nValue         = 5;
+    tx.InvalidateHash();
+    const uint256 hashBefore = tx.GetHash();
+
+    // reading into a transaction that already has a hash must drop it
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << source;
+    ss >> tx;
+    EXPECT_NE(tx.GetHash(), hashBefore);
+    EXPECT_EQ(tx.GetHash(), source.GetHash());
+}
+
+TEST(cachedhash_tests, block_hash_follows_header)
+{
+    CBlock block;
+    block.nVersion       = 2;
+    block.hashPrevBlock  = uint256(7);
+    block.hashMerkleRoot = uint256(8);
+    block.nTime          = 1500000000;
+    block.nBits          = 0x1e0fffff;
+    block.nNonce         = 0;
+
+    EXPECT_EQ(block.GetHash(), FreshBlockHash(block));
+
+    // header changes don't need an explicit invalidation
+    for (unsigned i = 1; i < 5; i++) {
+        const uint256 hashBefore = block.GetHash();
+        block.nNonce             = i;
+        EXPECT_NE(block.GetHash(), hashBefore);
+        EXPECT_EQ(block.GetHash(), FreshBlockHash(block));
+    }
+
+    block.vtx.push_back(MakeTx());
+    block.hashMerkleRoot = block.GetMerkleRoot();
+    EXPECT_EQ(block.GetHash(), FreshBlockHash(block));
+
+    const CBlock copy = block;
+    EXPECT_EQ(copy.GetHash(), block.GetHash());
+    block.nTime += 1;
+    EXPECT_EQ(block.GetHash(), FreshBlockHash(block));
+    EXPECT_EQ(copy.GetHash(), FreshBlockHash(copy));
+    EXPECT_NE(copy.GetHash(), block.GetHash());
+}
+
+TEST(cachedhash_tests, batch_block_hashes)
+{
+    // every way of splitting a batch into SIMD lanes, and the ones that don't fill all lanes
+    for (std::size_t nCount : {0, 1, 2, 3, 4, 5, 7, 8, 9, 13, 16, 17}) {
+        std::vector<CBlock> vBlocks(nCount);
+        for (std::size_t i = 0; i < nCount; i++) {
+            vBlocks[i].nVersion      = 2;
+            vBlocks[i].hashPrevBlock = uint256(i);
+            vBlocks[i].nTime         = 1500000000;
+            vBlocks[i].nBits         = 0x1e0fffff;
+            vBlocks[i].nNonce        = static_cast<unsigned>(nCount);
+        }
+
+        std::vector<const void*> vHeaders;
+        for (const CBlock& block : vBlocks) {
+            vHeaders.push_back(CVOIDBEGIN(block.nVersion));
+        }
+        std::vector<uint256> vHashes(nCount);
+        scrypt_blockhash_batch(vHeaders.data(), vHashes.data(), nCount);
+        for (std::size_t i = 0; i < nCount; i++) {
+            EXPECT_EQ(vHashes[i], FreshBlockHash(vBlocks[i]));
+        }
+
+        // precomputed hashes are kept, and recomputed when the header changes
+        CBlock::PrecomputeHashes(vBlocks);
+        for (std::size_t i = 0; i < nCount; i++) {
+            EXPECT_EQ(vBlocks[i].GetHash(), vHashes[i]);
+            vBlocks[i].nNonce++;
+            EXPECT_EQ(vBlocks[i].GetHash(), FreshBlockHash(vBlocks[i]));
+        }
+    }
+}
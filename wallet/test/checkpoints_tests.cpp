@@ -14,7 +14,7 @@ using namespace std;
 static CBlockIndexSmartPtr InsertBlockIndex(const uint256& hash, BlockIndexMapType& mapBlockIndexIn)
 {
     // Return existing
-    map<uint256, CBlockIndexSmartPtr>::iterator mi = mapBlockIndexIn.find(hash);
+    BlockIndexMapType::iterator mi = mapBlockIndexIn.find(hash);
     if (mi != mapBlockIndexIn.end())
         return mi->second;
 
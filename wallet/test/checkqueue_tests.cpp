@@ -0,0 +1,102 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "checkqueue.h"
+
+#include <atomic>
+#include <thread>
+
+namespace {
+struct FakeCheck
+{
+    static std::atomic<unsigned> nCalls;
+
+    bool     fResult = true;
+    unsigned nId     = 0;
+
+    FakeCheck() = default;
+    explicit FakeCheck(bool fResultIn, unsigned nIdIn = 0) : fResult(fResultIn), nId(nIdIn) {}
+
+    bool operator()()
+    {
+        nCalls++;
+        return fResult;
+    }
+    void swap(FakeCheck& other)
+    {
+        std::swap(fResult, other.fResult);
+        std::swap(nId, other.nId);
+    }
+};
+std::atomic<unsigned> FakeCheck::nCalls{0};
+
+void RunChecks(CCheckQueue<FakeCheck>& queue, unsigned nChecks, unsigned nFailAt, bool& fResult,
+               FakeCheck* pFailedCheck = nullptr)
+{
+    CCheckQueueControl<FakeCheck> control(&queue);
+    for (unsigned i = 0; i < nChecks;) {
+        std::vector<FakeCheck> vChecks;
+        for (unsigned j = 0; j < 7 && i < nChecks; j++, i++)
+            vChecks.emplace_back(i != nFailAt, i);
+        control.Add(vChecks);
+    }
+    fResult = control.Wait(pFailedCheck);
+}
+} // namespace
+
+TEST(checkqueue_tests, all_checks_pass)
+{
+    CCheckQueue<FakeCheck>   queue(16);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < 3; i++)
+        workers.emplace_back([&queue]() { queue.Thread(); });
+
+    for (unsigned n : {0u, 1u, 10u, 1000u, 10000u}) {
+        FakeCheck::nCalls = 0;
+        bool fResult      = false;
+        RunChecks(queue, n, n, fResult);
+        EXPECT_TRUE(fResult);
+        EXPECT_EQ(FakeCheck::nCalls.load(), n);
+    }
+
+    queue.Quit();
+    for (std::thread& t : workers)
+        t.join();
+}
+
+TEST(checkqueue_tests, failure_is_reported_and_queue_is_reusable)
+{
+    CCheckQueue<FakeCheck>   queue(16);
+    std::vector<std::thread> workers;
+    for (int i = 0; i < 3; i++)
+        workers.emplace_back([&queue]() { queue.Thread(); });
+
+    for (unsigned nFailAt : {0u, 500u, 999u}) {
+        bool      fResult = true;
+        FakeCheck failedCheck;
+        RunChecks(queue, 1000, nFailAt, fResult, &failedCheck);
+        EXPECT_FALSE(fResult);
+        // the failing check is handed back so the caller can say which one it was
+        EXPECT_FALSE(failedCheck.fResult);
+        EXPECT_EQ(failedCheck.nId, nFailAt);
+    }
+
+    // a failure must not leak into the next batch
+    bool      fResult = false;
+    FakeCheck failedCheck;
+    RunChecks(queue, 1000, 1000, fResult, &failedCheck);
+    EXPECT_TRUE(fResult);
+    EXPECT_TRUE(failedCheck.fResult);
+
+    queue.Quit();
+    for (std::thread& t : workers)
+        t.join();
+}
+
+TEST(checkqueue_tests, no_queue)
+{
+    // without a queue the control object is a no-op; the caller runs the checks inline
+    CCheckQueueControl<FakeCheck> control(nullptr);
+    std::vector<FakeCheck>        vChecks(1, FakeCheck(false));
+    control.Add(vChecks);
+    EXPECT_TRUE(control.Wait());
+}
@@ -0,0 +1,100 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "cuckoocache.h"
+
+#include <atomic>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+std::vector<CCuckooCache::Key> RandomKeys(std::size_t n, uint64_t seed)
+{
+    std::mt19937_64                gen(seed);
+    std::vector<CCuckooCache::Key> keys(n);
+    for (CCuckooCache::Key& key : keys)
+        key = CCuckooCache::Key{gen(), gen()};
+    return keys;
+}
+} // namespace
+
+TEST(cuckoocache_tests, insert_and_contains)
+{
+    CCuckooCache cache(1 << 20);
+    // well below capacity, so nothing should be dropped
+    const std::vector<CCuckooCache::Key> keys = RandomKeys(cache.GetSlotCount() / 4, 1);
+    for (const CCuckooCache::Key& key : keys)
+        cache.insert(key);
+    for (const CCuckooCache::Key& key : keys)
+        EXPECT_TRUE(cache.contains(key, false));
+
+    for (const CCuckooCache::Key& key : RandomKeys(1000, 2))
+        EXPECT_FALSE(cache.contains(key, false));
+}
+
+TEST(cuckoocache_tests, erase)
+{
+    CCuckooCache                         cache(1 << 16);
+    const std::vector<CCuckooCache::Key> keys = RandomKeys(100, 3);
+    for (const CCuckooCache::Key& key : keys)
+        cache.insert(key);
+
+    for (std::size_t i = 0; i < keys.size(); i += 2)
+        EXPECT_TRUE(cache.contains(keys[i], true));
+    for (std::size_t i = 0; i < keys.size(); i++)
+        EXPECT_EQ(cache.contains(keys[i], false), i % 2 == 1);
+
+    // erased slots are reused
+    for (std::size_t i = 0; i < keys.size(); i += 2)
+        cache.insert(keys[i]);
+    for (const CCuckooCache::Key& key : keys)
+        EXPECT_TRUE(cache.contains(key, false));
+}
+
+TEST(cuckoocache_tests, memory_stays_fixed_when_full)
+{
+    CCuckooCache      cache(1 << 16);
+    const std::size_t nSlots = cache.GetSlotCount();
+    EXPECT_LE(nSlots * (2 * sizeof(uint64_t) + sizeof(bool)), std::size_t(1 << 16));
+
+    // inserting twice the capacity must drop keys, but recent ones should mostly survive
+    const std::vector<CCuckooCache::Key> keys = RandomKeys(2 * nSlots, 4);
+    for (const CCuckooCache::Key& key : keys)
+        cache.insert(key);
+    std::size_t nFound = 0;
+    for (const CCuckooCache::Key& key : keys)
+        nFound += cache.contains(key, false);
+    EXPECT_LE(nFound, nSlots);
+    EXPECT_GT(nFound, nSlots / 2);
+}
+
+TEST(cuckoocache_tests, concurrent_readers_and_writers)
+{
+    CCuckooCache                         cache(1 << 20);
+    const std::vector<CCuckooCache::Key> keys = RandomKeys(cache.GetSlotCount() / 4, 5);
+    const std::size_t                    nHalf = keys.size() / 2;
+    for (std::size_t i = 0; i < nHalf; i++)
+        cache.insert(keys[i]);
+
+    std::atomic<unsigned>    nMissing{0};
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < 4; t++) {
+        threads.emplace_back([&, t]() {
+            // two threads insert the second half while two others keep reading the first
+            if (t % 2 == 0) {
+                for (std::size_t i = nHalf + t / 2; i < keys.size(); i += 2)
+                    cache.insert(keys[i]);
+            } else {
+                for (std::size_t i = 0; i < nHalf; i++)
+                    if (!cache.contains(keys[i], false))
+                        nMissing++;
+            }
+        });
+    }
+    for (std::thread& thread : threads)
+        thread.join();
+
+    EXPECT_EQ(nMissing.load(), 0u);
+    for (const CCuckooCache::Key& key : keys)
+        EXPECT_TRUE(cache.contains(key, false));
+}
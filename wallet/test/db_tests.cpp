@@ -27,6 +27,10 @@ std::string RandomString(const int len)
 
 #define CUSTOM_LMDB_DB_SIZE (1 << 14)
 #include "../txdb-lmdb.h"
+#include "addressindex.h"
+#include "ntp1/ntp1index.h"
+#include "ntp1/ntp1transaction.h"
+#include "main.h"
 
 TEST(lmdb_tests, basic)
 {
@@ -172,6 +176,58 @@ TEST(lmdb_tests, many_inputs_one_tx)
     db.Close();
 }
 
+TEST(lmdb_tests, batch_read)
+{
+    CTxDB::DB_DIR = "test-txdb"; // avoid writing to the main database
+
+    CTxDB::__deleteDb(); // clean up
+
+    CTxDB::QuickSyncHigherControl_Enabled = false;
+    CTxDB db;
+
+    std::vector<std::string> keys;
+    std::vector<std::string> vals;
+
+    const uint64_t entriesCount = 50;
+    for (uint64_t i = 0; i < entriesCount; i++) {
+        keys.push_back("key" + std::to_string(i));
+        vals.push_back(RandomString(1000));
+        EXPECT_TRUE(db.test1_WriteStrKeyVal(keys.back(), vals.back()));
+    }
+
+    // a key that doesn't exist should be reported as missing without failing the whole batch
+    std::vector<std::string> keysToRead = keys;
+    keysToRead.insert(keysToRead.begin() + 10, "missing_key");
+
+    std::vector<boost::optional<std::string>> out;
+    EXPECT_TRUE(db.test1_ReadStrKeyValBatch(keysToRead, out));
+    ASSERT_EQ(out.size(), keysToRead.size());
+    for (unsigned i = 0; i < keysToRead.size(); i++) {
+        if (i == 10) {
+            EXPECT_FALSE(out[i]);
+            continue;
+        }
+        unsigned valIdx = (i < 10 ? i : i - 1);
+        ASSERT_TRUE(out[i]);
+        EXPECT_EQ(*out[i], vals[valIdx]);
+    }
+
+    // batch reads should see uncommitted data in the active batch
+    db.TxnBegin();
+    EXPECT_TRUE(db.test1_WriteStrKeyVal("missing_key", "now_exists"));
+    EXPECT_TRUE(db.test1_ReadStrKeyValBatch(keysToRead, out));
+    ASSERT_EQ(out.size(), keysToRead.size());
+    ASSERT_TRUE(out[10]);
+    EXPECT_EQ(*out[10], "now_exists");
+    db.TxnAbort();
+
+    std::vector<boost::optional<std::string>> emptyOut;
+    EXPECT_TRUE(db.test1_ReadStrKeyValBatch(std::vector<std::string>(), emptyOut));
+    EXPECT_TRUE(emptyOut.empty());
+
+    db.Close();
+}
+
 TEST(lmdb_tests, basic_multiple_read)
 {
     CTxDB::DB_DIR = "test-txdb"; // avoid writing to the main database
@@ -281,6 +337,306 @@ TEST(lmdb_tests, basic_multiple_many_inputs)
     db.Close();
 }
 
+TEST(lmdb_tests, prune_blocks)
+{
+    CTxDB::DB_DIR = "test-txdb"; // avoid writing to the main database
+
+    CTxDB::__deleteDb(); // clean up
+
+    CTxDB::QuickSyncHigherControl_Enabled = false;
+    CTxDB db;
+
+    EXPECT_FALSE(db.HavePrunedBlocks());
+    int nScanHeight = -1;
+    EXPECT_TRUE(db.ReadPruneScanHeight(nScanHeight));
+    EXPECT_EQ(nScanHeight, 0);
+    EXPECT_EQ(db.GetBlocksDbSize(), 0u);
+
+    std::vector<uint256> hashes;
+    for (int i = 0; i < 3; i++) {
+        CBlock block;
+        block.nTime = 1500000000 + i;
+        CTransaction tx;
+        tx.vout.push_back(CTxOut(COIN, CScript() << OP_TRUE));
+        block.vtx.push_back(tx);
+        hashes.push_back(block.GetHash());
+        EXPECT_TRUE(db.WriteBlock(hashes.back(), block));
+    }
+    const uint64_t nSize = db.GetBlocksDbSize();
+    EXPECT_GT(nSize, 0u);
+
+    // an empty prune is a no-op, and a pruned block is gone while the others are kept
+    EXPECT_TRUE(db.PruneBlocks(std::vector<uint256>()));
+    EXPECT_FALSE(db.HavePrunedBlocks());
+    EXPECT_TRUE(db.PruneBlocks(std::vector<uint256>(hashes.begin(), hashes.begin() + 2)));
+    EXPECT_TRUE(db.HavePrunedBlocks());
+    EXPECT_FALSE(db.ContainsBlock(hashes[0]));
+    EXPECT_FALSE(db.ContainsBlock(hashes[1]));
+    EXPECT_TRUE(db.ContainsBlock(hashes[2]));
+    CBlock block;
+    EXPECT_FALSE(db.ReadBlock(hashes[0], block));
+    EXPECT_TRUE(db.ReadBlock(hashes[2], block));
+    EXPECT_EQ(block.GetHash(), hashes[2]);
+    EXPECT_LE(db.GetBlocksDbSize(), nSize);
+
+    // pruning a block that isn't there fails without erasing anything
+    EXPECT_FALSE(db.PruneBlocks({hashes[1], hashes[2]}));
+    EXPECT_TRUE(db.ContainsBlock(hashes[2]));
+
+    EXPECT_TRUE(db.WritePruneScanHeight(1234));
+    EXPECT_TRUE(db.ReadPruneScanHeight(nScanHeight));
+    EXPECT_EQ(nScanHeight, 1234);
+
+    db.Close();
+}
+
+TEST(lmdb_tests, address_index)
+{
+    CTxDB::DB_DIR = "test-txdb"; // avoid writing to the main database
+
+    CTxDB::__deleteDb(); // clean up
+
+    CTxDB::QuickSyncHigherControl_Enabled = false;
+    CTxDB db;
+
+    const CIndexedAddress address1(CIndexedAddress::PUBKEYHASH, uint160(1));
+    const CIndexedAddress address2(CIndexedAddress::SCRIPTHASH, uint160(2));
+    const CScript         script1 = GetScriptForDestination(address1.GetDestination());
+    const CScript         script2 = GetScriptForDestination(address2.GetDestination());
+
+    // a transaction at height 5 pays to both addresses, and one at height 7 spends the output of
+    // address1 to address2, which spends it again in the same block
+    CTransaction tx1;
+    tx1.vin.resize(1);
+    tx1.vin[0].prevout = COutPoint(uint256(1), 0);
+    tx1.vout.push_back(CTxOut(3 * COIN, script1));
+    tx1.vout.push_back(CTxOut(4 * COIN, script2));
+    tx1.vout.push_back(CTxOut(0, CScript() << OP_RETURN));
+    CTransaction tx2;
+    tx2.vin.resize(1);
+    tx2.vin[0].prevout = COutPoint(tx1.GetHash(), 0);
+    tx2.vout.push_back(CTxOut(2 * COIN, script2));
+    CTransaction tx3;
+    tx3.vin.resize(1);
+    tx3.vin[0].prevout = COutPoint(tx2.GetHash(), 0);
+    tx3.vout.push_back(CTxOut(COIN, script1));
+
+    std::map<COutPoint, CSpentOutput> spent1;
+    std::map<COutPoint, CSpentOutput> spent2;
+    spent2[tx2.vin[0].prevout] = CSpentOutput(tx1.vout[0], 5);
+    spent2[tx3.vin[0].prevout] = CSpentOutput(tx2.vout[0], 7);
+
+    CTxDBChanges connect1;
+    CTxDBChanges connect2;
+    AddAddressIndexChanges({tx1}, 5, spent1, true, connect1);
+    AddAddressIndexChanges({tx2, tx3}, 7, spent2, true, connect2);
+    db.AddAddressIndexChanges(std::move(connect1));
+    db.AddAddressIndexChanges(std::move(connect2));
+
+    // the records that weren't flushed yet are read from the cache
+    std::vector<std::pair<CAddressIndexKey, CAmount>> records;
+    EXPECT_TRUE(db.ReadAddressIndex(address1, 0, 100, records));
+    ASSERT_EQ(records.size(), 3u);
+    EXPECT_EQ(records[0].first.nHeight, 5u);
+    EXPECT_EQ(records[0].second, 3 * COIN);
+    EXPECT_EQ(records[1].first.nHeight, 7u);
+    EXPECT_EQ(records[2].first.nHeight, 7u);
+    CAmount nBalance = 0;
+    for (const auto& record : records) {
+        EXPECT_TRUE(record.first.address == address1);
+        nBalance += record.second;
+    }
+    EXPECT_EQ(nBalance, COIN);
+    EXPECT_TRUE(TxDBCache().HasUnflushedChanges());
+
+    // and the same ones from the db once they are
+    EXPECT_TRUE(db.FlushCache(true));
+    EXPECT_TRUE(db.ReadAddressIndex(address1, 0, 100, records));
+    ASSERT_EQ(records.size(), 3u);
+    EXPECT_EQ(records[0].first.nHeight, 5u);
+    EXPECT_EQ(records[2].first.nHeight, 7u);
+
+    // the heights are a range
+    EXPECT_TRUE(db.ReadAddressIndex(address1, 6, 100, records));
+    EXPECT_EQ(records.size(), 2u);
+    EXPECT_TRUE(db.ReadAddressIndex(address1, 0, 6, records));
+    EXPECT_EQ(records.size(), 1u);
+    EXPECT_TRUE(db.ReadAddressIndex(address2, 8, 100, records));
+    EXPECT_EQ(records.size(), 0u);
+
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>> unspent;
+    EXPECT_TRUE(db.ReadAddressUnspentIndex(address1, unspent));
+    ASSERT_EQ(unspent.size(), 1u);
+    EXPECT_EQ(unspent[0].first.txhash, tx3.GetHash());
+    EXPECT_EQ(unspent[0].second.nValue, COIN);
+    EXPECT_EQ(unspent[0].second.nHeight, 7);
+    EXPECT_TRUE(db.ReadAddressUnspentIndex(address2, unspent));
+    ASSERT_EQ(unspent.size(), 1u);
+    EXPECT_EQ(unspent[0].first.txhash, tx1.GetHash());
+    EXPECT_EQ(unspent[0].first.nIndex, 1u);
+    EXPECT_TRUE(unspent[0].second.scriptPubKey == script2);
+
+    // disconnecting the block at 7 brings back the output it spent, and nothing of the block; the
+    // records it erases are still in the db until the next flush
+    CTxDBChanges disconnect2;
+    AddAddressIndexChanges({tx2, tx3}, 7, spent2, false, disconnect2);
+    db.AddAddressIndexChanges(std::move(disconnect2));
+    EXPECT_TRUE(db.ReadAddressIndex(address1, 0, 100, records));
+    ASSERT_EQ(records.size(), 1u);
+    EXPECT_EQ(records[0].first.txhash, tx1.GetHash());
+    EXPECT_TRUE(db.ReadAddressIndex(address2, 0, 100, records));
+    EXPECT_EQ(records.size(), 1u);
+    EXPECT_TRUE(db.ReadAddressUnspentIndex(address1, unspent));
+    ASSERT_EQ(unspent.size(), 1u);
+    EXPECT_EQ(unspent[0].first.txhash, tx1.GetHash());
+    EXPECT_EQ(unspent[0].first.nIndex, 0u);
+    EXPECT_EQ(unspent[0].second.nHeight, 5);
+
+    EXPECT_TRUE(db.ReadAddressIndex(CIndexedAddress(CIndexedAddress::PUBKEYHASH, uint160(2)), 0, 100,
+                                    records));
+    EXPECT_EQ(records.size(), 0u);
+
+    db.Close();
+}
+
+namespace {
+NTP1TxOut MakeNTP1TxOut(const CScript& script, const std::string& tokenId, const NTP1Int& amount)
+{
+    NTP1TokenTxData token;
+    token.setTokenId(tokenId);
+    token.setAmount(amount);
+    NTP1TxOut ntp1out;
+    ntp1out.__manualSet(0, HexStr(script.begin(), script.end()), "", {token}, "");
+    return ntp1out;
+}
+
+NTP1Transaction MakeNTP1Tx(const CTransaction& tx, const std::vector<NTP1TxOut>& vout)
+{
+    NTP1Transaction ntp1tx;
+    ntp1tx.__manualSet(1, tx.GetHash(), {}, {}, vout, 0, 0, NTP1TxType_TRANSFER);
+    return ntp1tx;
+}
+} // namespace
+
+TEST(lmdb_tests, ntp1_index)
+{
+    CTxDB::DB_DIR = "test-txdb"; // avoid writing to the main database
+
+    CTxDB::__deleteDb(); // clean up
+
+    CTxDB::QuickSyncHigherControl_Enabled = false;
+    CTxDB db;
+
+    const CIndexedAddress address1(CIndexedAddress::PUBKEYHASH, uint160(1));
+    const CIndexedAddress address2(CIndexedAddress::PUBKEYHASH, uint160(2));
+    const CScript         script1 = GetScriptForDestination(address1.GetDestination());
+    const CScript         script2 = GetScriptForDestination(address2.GetDestination());
+
+    // the issuance record is written like any other one
+    CNTP1TokenIndexEntry issuance;
+    issuance.issuanceTxHash = uint256(3);
+    issuance.nHeight        = 4;
+    issuance.tokenSymbol    = "TOK";
+    issuance.nIssuedAmount  = 1000;
+    CDataStream  ss(SER_DISK, CLIENT_VERSION);
+    CTxDBChanges issue;
+    ss << issuance;
+    issue.SetNTP1IndexRecord(NTP1TokenIndexKey("La1"), ss.str());
+    db.AddNTP1IndexChanges(std::move(issue));
+
+    // a transaction at height 5 sends tokens to both addresses, and one at height 7 sends the tokens
+    // of address1 to address2, together with tokens of another token
+    CTransaction tx1;
+    tx1.vin.resize(1);
+    tx1.vin[0].prevout = COutPoint(uint256(1), 0);
+    tx1.vout.resize(2);
+    CTransaction tx2;
+    tx2.vin.resize(1);
+    tx2.vin[0].prevout = COutPoint(tx1.GetHash(), 0);
+    tx2.vout.resize(2);
+
+    std::map<uint256, NTP1Transaction> ntp1txs;
+    ntp1txs[tx1.GetHash()] =
+        MakeNTP1Tx(tx1, {MakeNTP1TxOut(script1, "La1", 300), MakeNTP1TxOut(script2, "La1", 700)});
+    ntp1txs[tx2.GetHash()] =
+        MakeNTP1Tx(tx2, {MakeNTP1TxOut(script2, "La1", 300), MakeNTP1TxOut(script2, "La2", 5)});
+
+    // the balances the block at 7 changes are read from the ones the block at 5 wrote
+    CTxDBChanges connect1;
+    CTxDBChanges connect2;
+    EXPECT_TRUE(AddNTP1IndexChanges(db, {tx1}, 5, ntp1txs, true, connect1));
+    db.AddNTP1IndexChanges(std::move(connect1));
+    EXPECT_TRUE(AddNTP1IndexChanges(db, {tx2}, 7, ntp1txs, true, connect2));
+    db.AddNTP1IndexChanges(std::move(connect2));
+
+    boost::optional<CNTP1TokenIndexEntry> entry;
+    EXPECT_TRUE(db.ReadNTP1TokenIndexEntry("La1", entry));
+    ASSERT_TRUE(!!entry);
+    EXPECT_EQ(entry->tokenSymbol, "TOK");
+    EXPECT_EQ(entry->nHeight, 4);
+    EXPECT_EQ(entry->nIssuedAmount, NTP1Int(1000));
+    EXPECT_TRUE(db.ReadNTP1TokenIndexEntry("La2", entry));
+    EXPECT_FALSE(entry);
+
+    CNTP1TokenStats stats;
+    EXPECT_TRUE(db.ReadNTP1TokenStats("La1", stats));
+    EXPECT_EQ(stats.nSupply, NTP1Int(1000));
+    EXPECT_EQ(stats.nHolders, 1u);
+    EXPECT_TRUE(db.ReadNTP1TokenStats("La2", stats));
+    EXPECT_EQ(stats.nSupply, NTP1Int(5));
+    EXPECT_EQ(stats.nHolders, 1u);
+
+    std::vector<std::pair<CIndexedAddress, NTP1Int>> holders;
+    EXPECT_TRUE(db.ReadNTP1TokenHolders("La1", holders));
+    ASSERT_EQ(holders.size(), 1u);
+    EXPECT_TRUE(holders[0].first == address2);
+    EXPECT_EQ(holders[0].second, NTP1Int(1000));
+
+    // the balances of an address are sorted by token, and there are none once they're all spent
+    std::vector<std::pair<std::string, NTP1Int>> balances;
+    EXPECT_TRUE(db.ReadNTP1AddressBalances(address1, balances));
+    EXPECT_EQ(balances.size(), 0u);
+    EXPECT_TRUE(db.ReadNTP1AddressBalances(address2, balances));
+    ASSERT_EQ(balances.size(), 2u);
+    EXPECT_EQ(balances[0].first, "La1");
+    EXPECT_EQ(balances[0].second, NTP1Int(1000));
+    EXPECT_EQ(balances[1].first, "La2");
+    EXPECT_EQ(balances[1].second, NTP1Int(5));
+
+    // disconnecting the block at 7 brings back the tokens it spent
+    CTxDBChanges disconnect2;
+    EXPECT_TRUE(AddNTP1IndexChanges(db, {tx2}, 7, ntp1txs, false, disconnect2));
+    db.AddNTP1IndexChanges(std::move(disconnect2));
+    EXPECT_TRUE(db.ReadNTP1AddressBalances(address1, balances));
+    ASSERT_EQ(balances.size(), 1u);
+    EXPECT_EQ(balances[0].second, NTP1Int(300));
+    EXPECT_TRUE(db.ReadNTP1AddressBalances(address2, balances));
+    ASSERT_EQ(balances.size(), 1u);
+    EXPECT_EQ(balances[0].second, NTP1Int(700));
+    EXPECT_TRUE(db.ReadNTP1TokenStats("La1", stats));
+    EXPECT_EQ(stats.nSupply, NTP1Int(1000));
+    EXPECT_EQ(stats.nHolders, 2u);
+    EXPECT_TRUE(db.ReadNTP1TokenHolders("La2", holders));
+    EXPECT_EQ(holders.size(), 0u);
+    EXPECT_TRUE(db.ReadNTP1TokenStats("La2", stats));
+    EXPECT_EQ(stats.nSupply, NTP1Int(0));
+    EXPECT_EQ(stats.nHolders, 0u);
+
+    // the changes of several blocks can go into the same changes, like when the index is built
+    CTxDBChanges connect;
+    EXPECT_TRUE(AddNTP1IndexChanges(db, {tx2}, 7, ntp1txs, true, connect));
+    EXPECT_TRUE(AddNTP1IndexChanges(db, {tx2}, 7, ntp1txs, false, connect));
+    EXPECT_TRUE(AddNTP1IndexChanges(db, {tx1}, 5, ntp1txs, false, connect));
+    db.AddNTP1IndexChanges(std::move(connect));
+    EXPECT_TRUE(db.ReadNTP1TokenHolders("La1", holders));
+    EXPECT_EQ(holders.size(), 0u);
+    EXPECT_TRUE(db.ReadNTP1TokenStats("La1", stats));
+    EXPECT_EQ(stats.nSupply, NTP1Int(0));
+    EXPECT_EQ(stats.nHolders, 0u);
+
+    db.Close();
+}
+
 TEST(quicksync_tests, download_index_file)
 {
     std::string        s = cURLTools::GetFileFromHTTPS(QuickSyncDataLink, 30, false);
@@ -2,6 +2,8 @@
 #include <boost/foreach.hpp>
 #include "googletest/googletest/include/gtest/gtest.h"
 
+#include "globals.h"
+#include "script.h"
 #include "util.h"
 
 static void
@@ -161,3 +163,34 @@ TEST(getarg_tests, boolargno)
     ResetArgs("-nofoo -foo"); // foo always wins:
     EXPECT_TRUE(GetBoolArg("-foo"));
 }
+
+TEST(getarg_tests, sigcache_size)
+{
+    std::size_t nBytes = 0;
+    ResetArgs("");
+    EXPECT_TRUE(GetSignatureCacheBytes(nBytes));
+    EXPECT_EQ(nBytes, static_cast<std::size_t>(DEFAULT_MAX_SIG_CACHE_SIZE) << 20);
+
+    ResetArgs("-maxsigcachemb=0");
+    EXPECT_TRUE(GetSignatureCacheBytes(nBytes));
+    EXPECT_EQ(nBytes, 0u);
+
+    // -maxsigcachesize counts signatures, as it did when it was the only option
+    ResetArgs("-maxsigcachesize=50000");
+    EXPECT_TRUE(GetSignatureCacheBytes(nBytes));
+    EXPECT_GT(nBytes, 50000u * 16);
+    EXPECT_LT(nBytes, 50000u * 32);
+    ResetArgs("-maxsigcachesize=50000 -maxsigcachemb=8");
+    EXPECT_TRUE(GetSignatureCacheBytes(nBytes));
+    EXPECT_EQ(nBytes, 8u << 20);
+
+    ResetArgs("-maxsigcachemb=-1");
+    EXPECT_FALSE(GetSignatureCacheBytes(nBytes));
+    ResetArgs("-maxsigcachemb=50000");
+    EXPECT_FALSE(GetSignatureCacheBytes(nBytes));
+    ResetArgs("-maxsigcachesize=-1");
+    EXPECT_FALSE(GetSignatureCacheBytes(nBytes));
+    ResetArgs("-maxsigcachesize=100000000000");
+    EXPECT_FALSE(GetSignatureCacheBytes(nBytes));
+    ResetArgs("");
+}
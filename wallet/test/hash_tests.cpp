@@ -43,3 +43,34 @@ TEST(hash_tests, murmurhash3)
 
 #undef T
 }
+
+TEST(hash_tests, siphash)
+{
+    // test vectors from the SipHash reference implementation, with key 00 01 02 ... 0f
+    CSipHasher hasher(0x0706050403020100ULL, 0x0F0E0D0C0B0A0908ULL);
+    EXPECT_EQ(hasher.Finalize(), 0x726fdb47dd0e0e31ull);
+    static const unsigned char t0[1] = {0};
+    hasher.Write(t0, 1);
+    EXPECT_EQ(hasher.Finalize(), 0x74f839c593dc67fdull);
+    static const unsigned char t1[7] = {1, 2, 3, 4, 5, 6, 7};
+    hasher.Write(t1, 7);
+    EXPECT_EQ(hasher.Finalize(), 0x93f5f5799a932462ull);
+    hasher.Write(0x0F0E0D0C0B0A0908ULL);
+    EXPECT_EQ(hasher.Finalize(), 0x3f2acc7f57c29bdbull);
+    static const unsigned char t2[2] = {16, 17};
+    hasher.Write(t2, 2);
+    EXPECT_EQ(hasher.Finalize(), 0x4bc1b3f0968dd39cull);
+    static const unsigned char t3[9] = {18, 19, 20, 21, 22, 23, 24, 25, 26};
+    hasher.Write(t3, 9);
+    EXPECT_EQ(hasher.Finalize(), 0x2f2e6163076bcfadull);
+    static const unsigned char t4[5] = {27, 28, 29, 30, 31};
+    hasher.Write(t4, 5);
+    EXPECT_EQ(hasher.Finalize(), 0x7127512f72f27cceull);
+
+    // writing 8 bytes at once is the same as writing them as a 64-bit integer
+    CSipHasher hasherBytes(1, 2), hasherInt(1, 2);
+    static const unsigned char t5[8] = {8, 9, 10, 11, 12, 13, 14, 15};
+    hasherBytes.Write(t5, 8);
+    hasherInt.Write(0x0F0E0D0C0B0A0908ULL);
+    EXPECT_EQ(hasherBytes.Finalize(), hasherInt.Finalize());
+}
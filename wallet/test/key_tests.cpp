@@ -106,3 +106,189 @@ TEST(key_tests, key_test1)
         EXPECT_TRUE(rkey2C.GetPubKey() == key2C.GetPubKey());
     }
 }
+
+#ifdef USE_SECP256K1
+namespace {
+// Order of secp256k1's generator
+const unsigned char vchOrder[32] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFE,
+    0xBA, 0xAE, 0xDC, 0xE6, 0xAF, 0x48, 0xA0, 0x3B, 0xBF, 0xD2, 0x5E, 0x8C, 0xD0, 0x36, 0x41, 0x41};
+
+// splits a strict DER signature into its r and s integers, as encoded (with any leading 0x00)
+void SplitDER(const vector<unsigned char>& vchSig, vector<unsigned char>& r,
+              vector<unsigned char>& s)
+{
+    ASSERT_GE(vchSig.size(), 8u);
+    const unsigned char nLenR = vchSig[3];
+    r.assign(vchSig.begin() + 4, vchSig.begin() + 4 + nLenR);
+    const unsigned char nLenS = vchSig[5 + nLenR];
+    s.assign(vchSig.begin() + 6 + nLenR, vchSig.begin() + 6 + nLenR + nLenS);
+}
+
+vector<unsigned char> JoinDER(const vector<unsigned char>& r, const vector<unsigned char>& s)
+{
+    vector<unsigned char> vchSig = {0x30, static_cast<unsigned char>(4 + r.size() + s.size())};
+    vchSig.push_back(0x02);
+    vchSig.push_back(static_cast<unsigned char>(r.size()));
+    vchSig.insert(vchSig.end(), r.begin(), r.end());
+    vchSig.push_back(0x02);
+    vchSig.push_back(static_cast<unsigned char>(s.size()));
+    vchSig.insert(vchSig.end(), s.begin(), s.end());
+    return vchSig;
+}
+
+// the order minus s, encoded as a positive DER integer
+vector<unsigned char> NegateModOrder(const vector<unsigned char>& s)
+{
+    unsigned char vchS[32] = {};
+    const size_t  nLen     = std::min<size_t>(s.size(), 32);
+    std::copy(s.end() - nLen, s.end(), vchS + 32 - nLen);
+    vector<unsigned char> result(33, 0);
+    int                   borrow = 0;
+    for (int i = 31; i >= 0; i--) {
+        int d         = vchOrder[i] - vchS[i] - borrow;
+        borrow        = d < 0;
+        result[i + 1] = static_cast<unsigned char>(d + (borrow ? 256 : 0));
+    }
+    while (result.size() > 1 && result[0] == 0 && !(result[1] & 0x80))
+        result.erase(result.begin());
+    return result;
+}
+
+CKey MakeKey(bool fCompressed)
+{
+    CKey key;
+    key.MakeNewKey(fCompressed);
+    return key;
+}
+} // namespace
+
+TEST(key_tests, secp256k1_matches_openssl_signatures)
+{
+    for (int n = 0; n < 32; n++) {
+        const bool fCompressed = n % 2 == 0;
+        CKey       key         = MakeKey(fCompressed);
+        CKey       otherKey    = MakeKey(fCompressed);
+        string     strMsg      = strprintf("Differential message %i", n);
+        uint256    hashMsg     = Hash(strMsg.begin(), strMsg.end());
+
+        vector<unsigned char> sigSecp, sigOpenSSL;
+        ASSERT_TRUE(key.Sign(hashMsg, sigSecp));
+        ASSERT_TRUE(key.SignOpenSSL(hashMsg, sigOpenSSL));
+
+        // both make low-S signatures that both verify
+        vector<unsigned char> r, s;
+        SplitDER(sigSecp, r, s);
+        EXPECT_TRUE(CKey::CheckSignatureElement(&s[0], s.size(), true));
+        for (const vector<unsigned char>* sig : {&sigSecp, &sigOpenSSL}) {
+            EXPECT_TRUE(key.Verify(hashMsg, *sig));
+            EXPECT_TRUE(key.VerifyOpenSSL(hashMsg, *sig));
+            EXPECT_FALSE(otherKey.Verify(hashMsg, *sig));
+            EXPECT_FALSE(otherKey.VerifyOpenSSL(hashMsg, *sig));
+            EXPECT_FALSE(key.Verify(Hash(hashMsg.begin(), hashMsg.end()), *sig));
+        }
+
+        // a key without a public key verifies nothing
+        CKey emptyKey;
+        EXPECT_FALSE(emptyKey.Verify(hashMsg, sigSecp));
+        EXPECT_FALSE(emptyKey.VerifyOpenSSL(hashMsg, sigSecp));
+        vector<unsigned char> sigEmpty;
+        EXPECT_FALSE(emptyKey.Sign(hashMsg, sigEmpty));
+    }
+}
+
+TEST(key_tests, secp256k1_matches_openssl_lax_der)
+{
+    for (int n = 0; n < 32; n++) {
+        CKey                  key     = MakeKey(n % 2 == 0);
+        string                strMsg  = strprintf("Lax DER message %i", n);
+        uint256               hashMsg = Hash(strMsg.begin(), strMsg.end());
+        vector<unsigned char> vchSig;
+        ASSERT_TRUE(key.Sign(hashMsg, vchSig));
+        vector<unsigned char> r, s;
+        SplitDER(vchSig, r, s);
+
+        vector<vector<unsigned char>> variants;
+        // high S
+        variants.push_back(JoinDER(r, NegateModOrder(s)));
+        // excess zero padding of r and s
+        vector<unsigned char> rPadded(r), sPadded(s);
+        rPadded.insert(rPadded.begin(), 0x00);
+        sPadded.insert(sPadded.begin(), {0x00, 0x00});
+        variants.push_back(JoinDER(rPadded, s));
+        variants.push_back(JoinDER(r, sPadded));
+        // negative r, when r needs a padding byte that is left out
+        if (r[0] == 0x00)
+            variants.push_back(JoinDER(vector<unsigned char>(r.begin() + 1, r.end()), s));
+        // long form sequence lengths, with and without too many length bytes
+        vector<unsigned char> longLen(vchSig);
+        longLen.insert(longLen.begin() + 1, 0x81);
+        variants.push_back(longLen);
+        vector<unsigned char> longerLen(vchSig);
+        longerLen.insert(longerLen.begin() + 1, {0x86, 0x00, 0x00, 0x00, 0x00, 0x00});
+        variants.push_back(longerLen);
+        // garbage after the signature, and truncation
+        vector<unsigned char> garbage(vchSig);
+        garbage.insert(garbage.end(), {0x01, 0x02, 0x03});
+        variants.push_back(garbage);
+        variants.push_back(vector<unsigned char>(vchSig.begin(), vchSig.end() - 1));
+        variants.push_back(vector<unsigned char>());
+        // r or s out of range, or zero
+        variants.push_back(JoinDER(vector<unsigned char>(vchOrder, vchOrder + 32), s));
+        variants.push_back(JoinDER(r, {0x00}));
+        // single flipped bits anywhere
+        for (size_t i = 0; i < vchSig.size(); i++) {
+            vector<unsigned char> flipped(vchSig);
+            flipped[i] ^= 1 << (i % 8);
+            variants.push_back(flipped);
+        }
+
+        for (const vector<unsigned char>& variant : variants)
+            EXPECT_EQ(key.Verify(hashMsg, variant), key.VerifyOpenSSL(hashMsg, variant))
+                << "signature: " << HexStr(variant);
+    }
+}
+
+TEST(key_tests, secp256k1_matches_openssl_hybrid_pubkeys)
+{
+    CKey                  key       = MakeKey(false);
+    vector<unsigned char> vchPubKey = key.GetPubKey().Raw();
+    ASSERT_EQ(vchPubKey.size(), 65u);
+    vchPubKey[0] = 0x06 | (vchPubKey[64] & 1);
+
+    CKey hybridKey;
+    ASSERT_TRUE(hybridKey.SetPubKey(CPubKey(vchPubKey)));
+    uint256               hashMsg = GetRandHash();
+    vector<unsigned char> vchSig;
+    ASSERT_TRUE(key.Sign(hashMsg, vchSig));
+    EXPECT_EQ(hybridKey.Verify(hashMsg, vchSig), hybridKey.VerifyOpenSSL(hashMsg, vchSig));
+}
+
+TEST(key_tests, secp256k1_matches_openssl_compact_signatures)
+{
+    for (int n = 0; n < 32; n++) {
+        CKey    key     = MakeKey(n % 2 == 0);
+        string  strMsg  = strprintf("Compact message %i", n);
+        uint256 hashMsg = Hash(strMsg.begin(), strMsg.end());
+
+        vector<unsigned char> sigSecp, sigOpenSSL;
+        ASSERT_TRUE(key.SignCompact(hashMsg, sigSecp));
+        ASSERT_TRUE(key.SignCompactOpenSSL(hashMsg, sigOpenSSL));
+        EXPECT_EQ(sigSecp[0] >= 31, key.IsCompressed());
+
+        for (const vector<unsigned char>* sig : {&sigSecp, &sigOpenSSL}) {
+            CKey recSecp, recOpenSSL;
+            ASSERT_TRUE(recSecp.SetCompactSignature(hashMsg, *sig));
+            ASSERT_TRUE(recOpenSSL.SetCompactSignatureOpenSSL(hashMsg, *sig));
+            EXPECT_TRUE(recSecp.GetPubKey() == key.GetPubKey());
+            EXPECT_TRUE(recOpenSSL.GetPubKey() == key.GetPubKey());
+
+            // a different message recovers a different key
+            CKey    recOther;
+            uint256 hashOther = Hash(hashMsg.begin(), hashMsg.end());
+            if (recOther.SetCompactSignature(hashOther, *sig))
+                EXPECT_FALSE(recOther.GetPubKey() == key.GetPubKey());
+        }
+    }
+}
+#endif
@@ -0,0 +1,182 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "txmempool.h"
+
+namespace {
+// a transaction with a single input and a single output; n makes the transaction unique
+CTransaction MakeTx(const uint256& prevHash, unsigned int prevN, int n)
+{
+    CTransaction tx;
+    tx.nTime = 1000000;
+    tx.vin.resize(1);
+    tx.vin[0].prevout   = COutPoint(prevHash, prevN);
+    tx.vin[0].scriptSig = CScript() << n;
+    tx.vout.resize(1);
+    tx.vout[0].nValue       = 1000;
+    tx.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    return tx;
+}
+} // namespace
+
+TEST(mempool_tests, ancestor_state)
+{
+    CTxMemPool pool;
+
+    CTransaction parent = MakeTx(uint256(1), 0, 1);
+    CTransaction child  = MakeTx(parent.GetHash(), 0, 2);
+    CTransaction grand  = MakeTx(child.GetHash(), 0, 3);
+
+    LOCK(pool.cs);
+    EXPECT_TRUE(pool.addUnchecked(CTxMemPoolEntry(parent, 1000, 1)));
+    EXPECT_TRUE(pool.addUnchecked(CTxMemPoolEntry(child, 2000, 2)));
+    EXPECT_TRUE(pool.addUnchecked(CTxMemPoolEntry(grand, 4000, 3)));
+    EXPECT_EQ(pool.size(), 3u);
+
+    const CTxMemPoolEntry& g = *pool.mapTx.find(grand.GetHash());
+    EXPECT_EQ(g.GetCountWithAncestors(), 3u);
+    EXPECT_EQ(g.GetFeesWithAncestors(), 7000);
+    EXPECT_EQ(g.GetSizeWithAncestors(), 3u * g.GetTxSize());
+
+    // as happens when the parent is mined, its descendants stay but lose it from their packages
+    pool.remove(parent);
+    EXPECT_EQ(pool.size(), 2u);
+    EXPECT_FALSE(pool.isSpent(parent.vin[0].prevout));
+    EXPECT_EQ(pool.mapTx.find(child.GetHash())->GetCountWithAncestors(), 1u);
+    EXPECT_EQ(pool.mapTx.find(child.GetHash())->GetFeesWithAncestors(), 2000);
+    EXPECT_EQ(pool.mapTx.find(grand.GetHash())->GetCountWithAncestors(), 2u);
+    EXPECT_EQ(pool.mapTx.find(grand.GetHash())->GetFeesWithAncestors(), 6000);
+
+    pool.remove(child, true);
+    EXPECT_EQ(pool.size(), 0u);
+    EXPECT_TRUE(pool.mapNextTx.empty());
+    EXPECT_EQ(pool.DynamicMemoryUsage(), 0u);
+}
+
+TEST(mempool_tests, ancestors_readded_under_descendant)
+{
+    CTxMemPool pool;
+
+    CTransaction grandparent = MakeTx(uint256(1), 0, 1);
+    CTransaction parent      = MakeTx(grandparent.GetHash(), 0, 2);
+    CTransaction child       = MakeTx(parent.GetHash(), 0, 3);
+
+    LOCK(pool.cs);
+    // as in a reorganization, the disconnected transactions are put back under a child that stayed,
+    // in the order of the block; the grandparent only becomes an ancestor once the parent is back
+    EXPECT_TRUE(pool.addUnchecked(CTxMemPoolEntry(child, 4000, 1)));
+    EXPECT_TRUE(pool.addUnchecked(CTxMemPoolEntry(grandparent, 1000, 2)));
+    EXPECT_EQ(pool.mapTx.find(child.GetHash())->GetCountWithAncestors(), 1u);
+    EXPECT_TRUE(pool.addUnchecked(CTxMemPoolEntry(parent, 2000, 3)));
+
+    const CTxMemPoolEntry& c = *pool.mapTx.find(child.GetHash());
+    EXPECT_EQ(c.GetCountWithAncestors(), 3u);
+    EXPECT_EQ(c.GetFeesWithAncestors(), 7000);
+    EXPECT_EQ(c.GetSizeWithAncestors(), 3u * c.GetTxSize());
+    EXPECT_EQ(pool.mapTx.find(parent.GetHash())->GetCountWithAncestors(), 2u);
+
+    // and mined again, in the order of the block
+    pool.remove(grandparent);
+    EXPECT_EQ(pool.mapTx.find(parent.GetHash())->GetCountWithAncestors(), 1u);
+    EXPECT_EQ(pool.mapTx.find(child.GetHash())->GetCountWithAncestors(), 2u);
+    EXPECT_EQ(pool.mapTx.find(child.GetHash())->GetFeesWithAncestors(), 6000);
+    pool.remove(parent);
+    EXPECT_EQ(pool.mapTx.find(child.GetHash())->GetCountWithAncestors(), 1u);
+    EXPECT_EQ(pool.mapTx.find(child.GetHash())->GetFeesWithAncestors(), 4000);
+    EXPECT_EQ(pool.mapTx.find(child.GetHash())->GetSizeWithAncestors(),
+              pool.mapTx.find(child.GetHash())->GetTxSize());
+}
+
+TEST(mempool_tests, ancestor_state_over_two_paths)
+{
+    CTxMemPool pool;
+
+    // root has two outputs, each spent by one side of a diamond that joins again in bottom
+    CTransaction root = MakeTx(uint256(1), 0, 1);
+    root.vout.push_back(root.vout[0]);
+    CTransaction left   = MakeTx(root.GetHash(), 0, 2);
+    CTransaction right  = MakeTx(root.GetHash(), 1, 3);
+    CTransaction bottom = MakeTx(left.GetHash(), 0, 4);
+    bottom.vin.push_back(CTxIn(COutPoint(right.GetHash(), 0)));
+
+    LOCK(pool.cs);
+    EXPECT_TRUE(pool.addUnchecked(CTxMemPoolEntry(left, 2000, 1)));
+    EXPECT_TRUE(pool.addUnchecked(CTxMemPoolEntry(right, 4000, 2)));
+    EXPECT_TRUE(pool.addUnchecked(CTxMemPoolEntry(bottom, 8000, 3)));
+    EXPECT_EQ(pool.mapTx.find(bottom.GetHash())->GetCountWithAncestors(), 3u);
+
+    // the root reaches bottom along both sides, but counts once
+    EXPECT_TRUE(pool.addUnchecked(CTxMemPoolEntry(root, 1000, 4)));
+    EXPECT_EQ(pool.mapTx.find(bottom.GetHash())->GetCountWithAncestors(), 4u);
+    EXPECT_EQ(pool.mapTx.find(bottom.GetHash())->GetFeesWithAncestors(), 15000);
+    EXPECT_EQ(pool.mapTx.find(left.GetHash())->GetCountWithAncestors(), 2u);
+
+    // and leaves once when mined
+    pool.remove(root);
+    EXPECT_EQ(pool.mapTx.find(bottom.GetHash())->GetCountWithAncestors(), 3u);
+    EXPECT_EQ(pool.mapTx.find(bottom.GetHash())->GetFeesWithAncestors(), 14000);
+    EXPECT_EQ(pool.mapTx.find(right.GetHash())->GetCountWithAncestors(), 1u);
+
+    // a side with an ancestor of its own leaving alone takes nothing else from bottom's package
+    EXPECT_TRUE(pool.addUnchecked(CTxMemPoolEntry(root, 1000, 5)));
+    pool.remove(left);
+    EXPECT_EQ(pool.mapTx.find(bottom.GetHash())->GetCountWithAncestors(), 3u);
+    EXPECT_EQ(pool.mapTx.find(bottom.GetHash())->GetFeesWithAncestors(), 13000);
+}
+
+TEST(mempool_tests, sort_orders)
+{
+    CTxMemPool pool;
+
+    CTransaction low   = MakeTx(uint256(1), 0, 1);
+    CTransaction child = MakeTx(low.GetHash(), 0, 2);
+    CTransaction mid   = MakeTx(uint256(2), 0, 3);
+
+    LOCK(pool.cs);
+    pool.addUnchecked(CTxMemPoolEntry(low, 100, 3));
+    pool.addUnchecked(CTxMemPoolEntry(child, 100000, 1));
+    pool.addUnchecked(CTxMemPoolEntry(mid, 5000, 2));
+
+    std::vector<uint256> byFeeRate;
+    for (const CTxMemPoolEntry& e : pool.mapTx.get<FeeRateTag>())
+        byFeeRate.push_back(e.GetHash());
+    EXPECT_EQ(byFeeRate, std::vector<uint256>({child.GetHash(), mid.GetHash(), low.GetHash()}));
+
+    // the child's package, made of itself and its parent, still pays more than mid
+    std::vector<uint256> byAncestorScore;
+    for (const CTxMemPoolEntry& e : pool.mapTx.get<AncestorScoreTag>())
+        byAncestorScore.push_back(e.GetHash());
+    EXPECT_EQ(byAncestorScore, std::vector<uint256>({child.GetHash(), mid.GetHash(), low.GetHash()}));
+
+    std::vector<uint256> byTime;
+    for (const CTxMemPoolEntry& e : pool.mapTx.get<EntryTimeTag>())
+        byTime.push_back(e.GetHash());
+    EXPECT_EQ(byTime, std::vector<uint256>({child.GetHash(), mid.GetHash(), low.GetHash()}));
+}
+
+TEST(mempool_tests, trim_to_size)
+{
+    CTxMemPool pool;
+
+    CTransaction low   = MakeTx(uint256(1), 0, 1);
+    CTransaction child = MakeTx(low.GetHash(), 0, 2);
+    CTransaction high  = MakeTx(uint256(2), 0, 3);
+
+    LOCK(pool.cs);
+    pool.addUnchecked(CTxMemPoolEntry(low, 100, 1));
+    pool.addUnchecked(CTxMemPoolEntry(child, 100000, 2));
+    pool.addUnchecked(CTxMemPoolEntry(high, 5000, 3));
+
+    const std::size_t usageAll = pool.DynamicMemoryUsage();
+    pool.TrimToSize(usageAll);
+    EXPECT_EQ(pool.size(), 3u);
+
+    // evicting the lowest fee rate transaction takes whatever spends it along
+    pool.TrimToSize(usageAll - 1);
+    EXPECT_EQ(pool.size(), 1u);
+    EXPECT_TRUE(pool.exists(high.GetHash()));
+    EXPECT_TRUE(pool.mapNextTx.count(high.vin[0].prevout));
+    EXPECT_EQ(pool.DynamicMemoryUsage(), pool.mapTx.find(high.GetHash())->GetUsageSize());
+
+    pool.TrimToSize(0);
+    EXPECT_EQ(pool.size(), 0u);
+}
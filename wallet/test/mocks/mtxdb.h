@@ -9,6 +9,13 @@ struct mTxDB : public ITxDB
     MOCK_METHOD(bool, ReadTxIndex, (const uint256& hash, CTxIndex& txindex), (override));
     MOCK_METHOD(bool, UpdateTxIndex, (const uint256& hash, const CTxIndex& txindex), (override));
     MOCK_METHOD(bool, ReadTx, (const CDiskTxPos& txPos, CTransaction& tx), (override));
+    MOCK_METHOD(bool, ReadTxIndexMany,
+                (const std::vector<uint256>& hashes, std::vector<boost::optional<CTxIndex>>& txindexes),
+                (override));
+    MOCK_METHOD(bool, ReadTxMany,
+                (const std::vector<CDiskTxPos>& txPositions,
+                 std::vector<boost::optional<CTransaction>>& txs),
+                (override));
     MOCK_METHOD(bool, ReadNTP1Tx, (const uint256& hash, NTP1Transaction& ntp1tx), (override));
     MOCK_METHOD(bool, WriteNTP1Tx, (const uint256& hash, const NTP1Transaction& ntp1tx), (override));
     MOCK_METHOD(bool, ReadAllIssuanceTxs, (std::vector<uint256> & txs), (override));
@@ -29,6 +36,10 @@ struct mTxDB : public ITxDB
     MOCK_METHOD(bool, ReadDiskTx, (const COutPoint& outpoint, CTransaction& tx, CTxIndex& txindex),
                 (override));
     MOCK_METHOD(bool, ReadDiskTx, (const COutPoint& outpoint, CTransaction& tx), (override));
+    MOCK_METHOD(bool, ReadDiskTxMany,
+                (const std::vector<uint256>& hashes, std::vector<boost::optional<CTxIndex>>& txindexes,
+                 std::vector<boost::optional<CTransaction>>& txs),
+                (override));
     MOCK_METHOD(bool, ReadBlock, (const uint256& hash, CBlock& blk, bool fReadTransactions), (override));
     MOCK_METHOD(bool, WriteBlock, (const uint256& hash, const CBlock& blk), (override));
     MOCK_METHOD(bool, WriteBlockIndex, (const CDiskBlockIndex& blockindex), (override));
@@ -282,6 +282,31 @@ TEST(ntp1_tests, parse_NTP1Transaction)
     NTP1Transaction    t;
     t.importDatabaseJsonData(v);
     EXPECT_EQ(t, tx_good);
+
+    // the compact db format round-trips and is smaller than the original one
+    CDataStream ssCompact(SER_DISK | SER_NTP1_COMPACT, CLIENT_VERSION);
+    ssCompact << tx_good;
+    CDataStream ssLegacy(SER_DISK, CLIENT_VERSION);
+    ssLegacy << tx_good;
+    EXPECT_LT(ssCompact.size(), ssLegacy.size());
+    EXPECT_EQ(ssCompact.size(), ::GetSerializeSize(tx_good, SER_DISK | SER_NTP1_COMPACT, CLIENT_VERSION));
+
+    // the hex string of the tx isn't part of either format
+    NTP1Transaction expected = tx_good;
+    expected.setHex("");
+
+    NTP1Transaction fromCompact;
+    ssCompact >> fromCompact;
+    EXPECT_EQ(fromCompact, expected);
+    EXPECT_TRUE(ssCompact.empty());
+
+    // records written in the original format are still readable as compact ones
+    NTP1Transaction fromLegacy;
+    CDataStream     ssLegacyAsCompact(ssLegacy.begin(), ssLegacy.end(), SER_DISK | SER_NTP1_COMPACT,
+                                      CLIENT_VERSION);
+    ssLegacyAsCompact >> fromLegacy;
+    EXPECT_EQ(fromLegacy, expected);
+    EXPECT_TRUE(ssLegacyAsCompact.empty());
 }
 
 TEST(ntp1_tests, token_meta_data)
@@ -628,3 +628,59 @@ TEST(PoS_tests, scripts_p2cs_scriptSig_test)
         EXPECT_EQ(pubKeyReturned, boost::none);
     }
 }
+
+TEST(PoS_tests, kernel_hash_from_prefix)
+{
+    CStakeKernelPrefix prefix;
+    prefix.nStakeModifier = 0x0123456789abcdefULL;
+    prefix.nTimeBlockFrom = 1500000000;
+    prefix.nTxPrevOffset  = 81;
+    prefix.nTimeTxPrev    = 1499999990;
+    prefix.nPrevout       = 2;
+    prefix.nValueIn       = 1000 * COIN;
+
+    const unsigned int nTimeTx = 1510000000;
+    CDataStream        ss(SER_GETHASH, 0);
+    ss << prefix.nStakeModifier << prefix.nTimeBlockFrom << prefix.nTxPrevOffset << prefix.nTimeTxPrev
+       << prefix.nPrevout << nTimeTx;
+    EXPECT_EQ(GetStakeKernelHash(prefix, nTimeTx), Hash(ss.begin(), ss.end()));
+}
+
+TEST(PoS_tests, kernel_time_search_matches_every_time_checked)
+{
+    CStakeKernelPrefix prefix;
+    prefix.nStakeModifier = 0xfedcba9876543210ULL;
+    prefix.nTimeBlockFrom = 1500000000;
+    prefix.nTxPrevOffset  = 181;
+    prefix.nTimeTxPrev    = 1499999950;
+    prefix.nPrevout       = 1;
+    prefix.nValueIn       = 5000 * COIN;
+
+    const unsigned int nTimeTxFirst = prefix.nTimeBlockFrom + Params().StakeMinAge() - 30;
+    const unsigned int nTimeTxLast  = nTimeTxFirst + 600;
+
+    for (unsigned int nBits : {0x1c00ffffu, 0x1d00ffffu, 0x1e00ffffu, 0x1f00ffffu}) {
+        CBigNum bnTargetPerCoinDay;
+        bnTargetPerCoinDay.SetCompact(nBits);
+
+        // what checking every time the way CheckStakeKernelHash() does finds
+        boost::optional<unsigned int> expected;
+        for (unsigned int nTimeTx = nTimeTxLast; nTimeTx >= nTimeTxFirst && !expected; nTimeTx--) {
+            if (nTimeTx < prefix.nTimeTxPrev ||
+                prefix.nTimeBlockFrom + Params().StakeMinAge() > nTimeTx)
+                continue;
+            const int64_t nWeight         = GetWeight(prefix.nTimeTxPrev, nTimeTx);
+            const CBigNum bnCoinDayWeight = CBigNum(prefix.nValueIn) * nWeight / COIN / (24 * 60 * 60);
+            if (CBigNum(GetStakeKernelHash(prefix, nTimeTx)) <= bnCoinDayWeight * bnTargetPerCoinDay)
+                expected = nTimeTx;
+        }
+
+        unsigned int nTimeTxFound = 0;
+        const bool   fFound =
+            FindStakeKernelTime(nBits, prefix, nTimeTxFirst, nTimeTxLast, nTimeTxFound);
+        EXPECT_EQ(fFound, static_cast<bool>(expected));
+        if (fFound && expected) {
+            EXPECT_EQ(nTimeTxFound, *expected);
+        }
+    }
+}
@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 
+#include "diskblockindex.h"
 #include "serialize.h"
 
 TEST(serialize_tests, varints)
@@ -41,3 +42,122 @@ TEST(serialize_tests, varints)
 #include "SerializationTester.h"
 
 TEST(serialize_tests, cross_platform_consistency) { RunCrossPlatformSerializationTests(); }
+
+TEST(serialize_tests, stream_view)
+{
+    CDataStream ss(SER_DISK, 0);
+    for (int i = 0; i < 1000; i++) {
+        ss << VARINT(i);
+    }
+    const std::string              str = "Hello, world!";
+    const std::vector<std::string> vec = {"abc", "", "defghi"};
+    ss << str << vec << uint64_t(0x0102030405060708ULL);
+
+    const std::string buffer = ss.str();
+
+    CDataStreamView view(buffer.data(), buffer.data() + buffer.size(), SER_DISK, 0);
+    // nothing is copied; the view points to the original buffer
+    EXPECT_EQ(view.data(), buffer.data());
+    EXPECT_EQ(view.size(), buffer.size());
+
+    for (int i = 0; i < 1000; i++) {
+        int j = 0;
+        view >> VARINT(j);
+        EXPECT_EQ(i, j);
+    }
+    std::string              strOut;
+    std::vector<std::string> vecOut;
+    uint64_t                 intOut = 0;
+    view >> strOut >> vecOut >> intOut;
+    EXPECT_EQ(strOut, str);
+    EXPECT_EQ(vecOut, vec);
+    EXPECT_EQ(intOut, 0x0102030405060708ULL);
+    EXPECT_TRUE(view.empty());
+
+    // the results should be identical to CDataStream
+    CDataStream ssCopy(buffer.data(), buffer.data() + buffer.size(), SER_DISK, 0);
+    CDataStreamView view2(buffer.data(), buffer.data() + buffer.size(), SER_DISK, 0);
+    for (int i = 0; i < 1000; i++) {
+        int a = 0;
+        int b = 0;
+        ssCopy >> VARINT(a);
+        view2 >> VARINT(b);
+        EXPECT_EQ(a, b);
+    }
+
+    // reading beyond the end should fail the same way CDataStream does
+    uint32_t beyond = 0;
+    EXPECT_THROW(view >> beyond, std::ios_base::failure);
+}
+
+TEST(serialize_tests, compact_hex_and_ntp1int)
+{
+    // lower-case hex strings are stored as their bytes; anything else verbatim, all round-tripping
+    const std::vector<std::string> hexStrings = {"",    "00",    "76a914930b31797c0e6f0d4239909b0488ac",
+                                                 "abc", "ABCD", "not hex at all"};
+    for (const std::string& hexIn : hexStrings) {
+        CDataStream ss(SER_DISK, 0);
+        ss << COMPACTHEXSTR(hexIn);
+        EXPECT_EQ(ss.size(), COMPACTHEXSTR(hexIn).GetSerializeSize(SER_DISK, 0));
+        std::string hexOut = "garbage";
+        ss >> COMPACTHEXSTR(hexOut);
+        EXPECT_EQ(hexIn, hexOut);
+        EXPECT_TRUE(ss.empty());
+    }
+    {
+        std::string hexIn = "76a914930b31797c0e6f0d4239909b0488ac";
+        CDataStream ss(SER_DISK, 0);
+        ss << COMPACTHEXSTR(hexIn);
+        EXPECT_EQ(ss.size(), 1 + 1 + hexIn.size() / 2);
+    }
+
+    const std::vector<NTP1Int> nums = {0, 1, 127, 128, 997000, NTP1Int(std::numeric_limits<int64_t>::max()),
+                                       NTP1Int(std::numeric_limits<uint64_t>::max()),
+                                       NTP1Int(std::numeric_limits<uint64_t>::max()) * 1000, -5};
+    for (const NTP1Int& numIn : nums) {
+        CDataStream ss(SER_DISK, 0);
+        ss << COMPACTNTP1INT(numIn);
+        EXPECT_EQ(ss.size(), COMPACTNTP1INT(numIn).GetSerializeSize(SER_DISK, 0));
+        NTP1Int numOut = 12345;
+        ss >> COMPACTNTP1INT(numOut);
+        EXPECT_EQ(numIn, numOut);
+        EXPECT_TRUE(ss.empty());
+    }
+
+    // unknown encodings are rejected
+    {
+        CDataStream ss(SER_DISK, 0);
+        ss << (unsigned char)7 << std::string("x");
+        std::string hexOut;
+        EXPECT_THROW(ss >> COMPACTHEXSTR(hexOut), std::ios_base::failure);
+    }
+}
+
+TEST(serialize_tests, disk_block_index_trust)
+{
+    CDiskBlockIndex diskindex;
+    diskindex.nHeight                = 1234;
+    diskindex.nStakeModifier         = 0x1122334455667788;
+    diskindex.nChainTrust            = 987654321;
+    diskindex.nStakeModifierChecksum = 0xdeadbeef;
+
+    CDataStream ssIndexOnly(SER_DISK, 0);
+    ssIndexOnly << diskindex;
+
+    // the trust is appended after the index, which serializes exactly as before
+    CDataStream ss(SER_DISK, 0);
+    ss << std::make_pair(diskindex, CDiskBlockIndexTrust(diskindex));
+    ASSERT_GT(ss.size(), ssIndexOnly.size());
+    EXPECT_EQ(ss.str().substr(0, ssIndexOnly.size()), ssIndexOnly.str());
+
+    CDiskBlockIndex diskindexOut;
+    ss >> diskindexOut;
+    EXPECT_EQ(diskindexOut.nHeight, 1234);
+    EXPECT_EQ(diskindexOut.nStakeModifier, 0x1122334455667788u);
+    ASSERT_FALSE(ss.empty());
+    CDiskBlockIndexTrust trust;
+    ss >> trust;
+    EXPECT_EQ(trust.nChainTrust, uint256(987654321));
+    EXPECT_EQ(trust.nStakeModifierChecksum, 0xdeadbeefu);
+    EXPECT_TRUE(ss.empty());
+}
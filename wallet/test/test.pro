@@ -40,14 +40,22 @@ SOURCES += \
     base58_tests.cpp      \
     base64_tests.cpp      \
     bignum_tests.cpp      \
+    blockindexpool_tests.cpp \
+    cachedhash_tests.cpp \
+    blockdownload_tests.cpp \
+    txdbcache_tests.cpp \
     bloom_tests.cpp       \
     canonical_tests.cpp   \
+    checkqueue_tests.cpp  \
+    workqueue_tests.cpp   \
     compress_tests.cpp    \
     crypter_tests.cpp     \
+    cuckoocache_tests.cpp \
     db_tests.cpp          \
     getarg_tests.cpp      \
     hash_tests.cpp        \
     key_tests.cpp         \
+    mempool_tests.cpp     \
     merkle_tests.cpp      \
     miner_tests.cpp       \
     mruset_tests.cpp      \
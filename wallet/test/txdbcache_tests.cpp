@@ -0,0 +1,198 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "globals.h"
+#include "txdbcache.h"
+#include "util.h"
+
+namespace {
+CTxIndex MakeTxIndex(unsigned nTxPos, unsigned nOutputs)
+{
+    return CTxIndex(CDiskTxPos(uint256(12345), nTxPos), nOutputs);
+}
+} // namespace
+
+TEST(txdbcache_tests, changes_lookup_and_merge)
+{
+    CTxDBChanges changes;
+    EXPECT_TRUE(changes.IsEmpty());
+
+    CTxIndex txindex;
+    changes.SetTxIndex(1, MakeTxIndex(10, 2));
+    changes.EraseTxIndex(2);
+    EXPECT_EQ(changes.LookupTxIndex(1, txindex), CTxDBChanges::Lookup::Found);
+    EXPECT_EQ(txindex, MakeTxIndex(10, 2));
+    EXPECT_EQ(changes.LookupTxIndex(2, txindex), CTxDBChanges::Lookup::Erased);
+    EXPECT_EQ(changes.LookupTxIndex(3, txindex), CTxDBChanges::Lookup::Unknown);
+
+    // later changes replace earlier ones
+    CTxDBChanges later;
+    later.EraseTxIndex(1);
+    later.SetTxIndex(2, MakeTxIndex(20, 1));
+    later.SetBlockIndex(5, std::string("index"));
+    later.SetHashBestChain(5);
+    changes.MergeFrom(std::move(later));
+    EXPECT_TRUE(later.IsEmpty());
+    EXPECT_EQ(later.GetMemoryUsage(), 0u);
+
+    EXPECT_EQ(changes.LookupTxIndex(1, txindex), CTxDBChanges::Lookup::Erased);
+    EXPECT_EQ(changes.LookupTxIndex(2, txindex), CTxDBChanges::Lookup::Found);
+    EXPECT_EQ(txindex, MakeTxIndex(20, 1));
+    EXPECT_EQ(changes.GetBlockIndexes().at(5), "index");
+    ASSERT_TRUE(changes.GetHashBestChain());
+    EXPECT_EQ(*changes.GetHashBestChain(), uint256(5));
+
+    changes.Clear();
+    EXPECT_TRUE(changes.IsEmpty());
+    EXPECT_EQ(changes.GetMemoryUsage(), 0u);
+}
+
+TEST(txdbcache_tests, address_index_records)
+{
+    CTxDBChanges changes;
+    changes.SetAddressIndexRecord("a", std::string("1"));
+    changes.SetAddressUnspentRecord("b", std::string("2"));
+    changes.SetNTP1IndexRecord("d", std::string("4"));
+    EXPECT_FALSE(changes.IsEmpty());
+    EXPECT_GT(changes.GetMemoryUsage(), 0u);
+
+    // a later erase replaces the record, and is kept so that it's erased from the db too
+    CTxDBChanges later;
+    later.SetAddressIndexRecord("a", boost::none);
+    later.SetAddressUnspentRecord("c", std::string("3"));
+    later.SetNTP1IndexRecord("d", boost::none);
+    changes.MergeFrom(std::move(later));
+    EXPECT_TRUE(later.IsEmpty());
+    ASSERT_EQ(changes.GetAddressIndexRecords().size(), 1u);
+    EXPECT_FALSE(changes.GetAddressIndexRecords().at("a"));
+    ASSERT_EQ(changes.GetAddressUnspentRecords().size(), 2u);
+    EXPECT_EQ(*changes.GetAddressUnspentRecords().at("b"), "2");
+    EXPECT_EQ(*changes.GetAddressUnspentRecords().at("c"), "3");
+    ASSERT_EQ(changes.GetNTP1IndexRecords().size(), 1u);
+    EXPECT_FALSE(changes.GetNTP1IndexRecords().at("d"));
+
+    changes.Clear();
+    EXPECT_TRUE(changes.IsEmpty());
+    EXPECT_EQ(changes.GetMemoryUsage(), 0u);
+}
+
+TEST(txdbcache_tests, records_with_prefix)
+{
+    CTxDBChanges changes;
+    changes.SetNTP1IndexRecord("a1", std::string("1"));
+    changes.SetNTP1IndexRecord("b1", std::string("2"));
+    changes.SetNTP1IndexRecord("b2", boost::none);
+    changes.SetNTP1IndexRecord("b3", std::string("3"));
+    changes.SetNTP1IndexRecord("c1", std::string("4"));
+    changes.SetAddressIndexRecord("b4", std::string("5"));
+
+    // erased records are taken too, and replace the ones of the same keys
+    CTxDBChanges::RecordMap records;
+    records["b3"] = std::string("old");
+    changes.GetRecordsWithPrefix(&CTxDBChanges::GetNTP1IndexRecords, "b", "b2", records);
+    ASSERT_EQ(records.size(), 2u);
+    EXPECT_FALSE(records.at("b2"));
+    EXPECT_EQ(*records.at("b3"), "3");
+
+    CTxDBCache cache(1 << 20);
+    cache.Commit(std::move(changes));
+    records.clear();
+    const uint64_t nFlushCount =
+        cache.GetRecordsWithPrefix(&CTxDBChanges::GetNTP1IndexRecords, "b", "b", records);
+    EXPECT_EQ(records.size(), 3u);
+    EXPECT_EQ(nFlushCount, cache.GetFlushCount());
+    EXPECT_TRUE(cache.Flush([](const CTxDBChanges&) { return true; }));
+    records.clear();
+    EXPECT_EQ(cache.GetRecordsWithPrefix(&CTxDBChanges::GetNTP1IndexRecords, "b", "b", records),
+              nFlushCount + 1);
+    EXPECT_TRUE(records.empty());
+}
+
+TEST(txdbcache_tests, changes_memory_usage)
+{
+    CTxDBChanges changes;
+    changes.SetTxIndex(1, MakeTxIndex(10, 100));
+    const std::size_t nWithSpent = changes.GetMemoryUsage();
+    EXPECT_GE(nWithSpent, 100 * sizeof(CDiskTxPos));
+
+    // replacing a record accounts for the old one
+    changes.EraseTxIndex(1);
+    EXPECT_LT(changes.GetMemoryUsage(), nWithSpent);
+    changes.SetTxIndex(1, MakeTxIndex(10, 100));
+    EXPECT_EQ(changes.GetMemoryUsage(), nWithSpent);
+
+    // as does merging
+    CTxDBChanges other;
+    other.SetTxIndex(1, MakeTxIndex(10, 100));
+    changes.MergeFrom(std::move(other));
+    EXPECT_EQ(changes.GetMemoryUsage(), nWithSpent);
+}
+
+TEST(txdbcache_tests, read_tx_indexes)
+{
+    CTxDBCache cache(1 << 20);
+    CTxIndex   txindex;
+
+    cache.AddReadTxIndex(1, MakeTxIndex(10, 1), cache.GetFlushCount());
+    EXPECT_EQ(cache.LookupTxIndex(1, txindex), CTxDBChanges::Lookup::Found);
+    EXPECT_EQ(txindex, MakeTxIndex(10, 1));
+
+    // a committed change replaces what was read, and a later read of the old value is ignored
+    const uint64_t nFlushCount = cache.GetFlushCount();
+    CTxDBChanges   changes;
+    changes.SetTxIndex(1, MakeTxIndex(11, 1));
+    cache.Commit(std::move(changes));
+    cache.AddReadTxIndex(1, MakeTxIndex(10, 1), nFlushCount);
+    EXPECT_EQ(cache.LookupTxIndex(1, txindex), CTxDBChanges::Lookup::Found);
+    EXPECT_EQ(txindex, MakeTxIndex(11, 1));
+
+    // values read before a flush may be outdated
+    EXPECT_TRUE(cache.Flush([](const CTxDBChanges&) { return true; }));
+    cache.AddReadTxIndex(2, MakeTxIndex(20, 1), nFlushCount);
+    EXPECT_EQ(cache.LookupTxIndex(2, txindex), CTxDBChanges::Lookup::Unknown);
+}
+
+TEST(txdbcache_tests, flush)
+{
+    CTxDBCache   cache(1 << 20);
+    CTxDBChanges changes;
+    changes.SetTxIndex(1, MakeTxIndex(10, 1));
+    changes.EraseTxIndex(2);
+    changes.SetHashBestChain(7);
+    cache.Commit(std::move(changes));
+    EXPECT_FALSE(cache.ShouldFlush(GetTime(), DB_CACHE_FLUSH_INTERVAL));
+    EXPECT_TRUE(cache.ShouldFlush(GetTime() + DB_CACHE_FLUSH_INTERVAL, DB_CACHE_FLUSH_INTERVAL));
+
+    // a failed write keeps everything
+    EXPECT_FALSE(cache.Flush([](const CTxDBChanges&) { return false; }));
+    ASSERT_TRUE(cache.GetHashBestChain());
+    EXPECT_EQ(*cache.GetHashBestChain(), uint256(7));
+
+    std::size_t nWritten = 0;
+    EXPECT_TRUE(cache.Flush([&](const CTxDBChanges& toWrite) {
+        nWritten = toWrite.GetTxIndexes().size();
+        return true;
+    }));
+    EXPECT_EQ(nWritten, 2u);
+    EXPECT_FALSE(cache.GetHashBestChain());
+    EXPECT_EQ(cache.GetMemoryUsage(), 0u);
+    CTxIndex txindex;
+    EXPECT_EQ(cache.LookupTxIndex(1, txindex), CTxDBChanges::Lookup::Unknown);
+    EXPECT_FALSE(cache.ShouldFlush(GetTime() + DB_CACHE_FLUSH_INTERVAL, DB_CACHE_FLUSH_INTERVAL));
+}
+
+TEST(txdbcache_tests, memory_limit)
+{
+    CTxDBCache cache(64 * 1024);
+    for (unsigned i = 0; !cache.ShouldFlush(GetTime(), DB_CACHE_FLUSH_INTERVAL); i++) {
+        ASSERT_LT(i, 100000u);
+        CTxDBChanges changes;
+        changes.SetTxIndex(i, MakeTxIndex(i, 10));
+        cache.Commit(std::move(changes));
+    }
+    EXPECT_GT(cache.GetMemoryUsage(), cache.GetMaxMemoryUsage());
+
+    // reads alone don't grow the cache beyond its limit
+    const std::size_t nUsage = cache.GetMemoryUsage();
+    cache.AddReadTxIndex(1000000, MakeTxIndex(1, 10), cache.GetFlushCount());
+    EXPECT_EQ(cache.GetMemoryUsage(), nUsage);
+}
@@ -335,6 +335,226 @@ TEST(wallet_tests, coin_selection_tests)
     }
 }
 
+TEST(wallet_tests, scan_filter)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CKey otherKey;
+    otherKey.MakeNewKey(true);
+
+    CWalletScanFilter filter;
+    filter.setIDs.insert(key.GetPubKey().GetID());
+
+    CTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(uint256(1), 0);
+    tx.vout.resize(1);
+    tx.vout[0].nValue = COIN;
+
+    // paying to someone else's key
+    tx.vout[0].scriptPubKey.SetDestination(otherKey.GetPubKey().GetID());
+    tx.InvalidateHash();
+    EXPECT_FALSE(filter.IsRelevant(tx));
+
+    // paying to our key, by its hash or the key itself
+    tx.vout[0].scriptPubKey.SetDestination(key.GetPubKey().GetID());
+    tx.InvalidateHash();
+    EXPECT_TRUE(filter.IsRelevant(tx));
+    tx.vout[0].scriptPubKey = CScript() << key.GetPubKey() << OP_CHECKSIG;
+    tx.InvalidateHash();
+    EXPECT_TRUE(filter.IsRelevant(tx));
+
+    // paying to someone else from a wallet transaction
+    tx.vout[0].scriptPubKey.SetDestination(otherKey.GetPubKey().GetID());
+    tx.InvalidateHash();
+    filter.setTxHashes.insert(uint256(1));
+    EXPECT_TRUE(filter.IsRelevant(tx));
+
+    // a wallet transaction itself
+    filter.setTxHashes.clear();
+    EXPECT_FALSE(filter.IsRelevant(tx));
+    filter.setTxHashes.insert(tx.GetHash());
+    EXPECT_TRUE(filter.IsRelevant(tx));
+}
+
+// block indexes for a main chain of nBlocks, with no blocks behind them
+static std::vector<CBlockIndexSmartPtr> MakeBlockIndexChain(int nBlocks)
+{
+    std::vector<CBlockIndexSmartPtr> chain;
+    for (int h = 0; h < nBlocks; h++) {
+        CBlockIndexSmartPtr pindex = boost::make_shared<CBlockIndex>();
+        const auto mi = mapBlockIndex.insert(make_pair(uint256(0xba1a0000 + h), pindex)).first;
+        pindex->phashBlock = &mi->first;
+        pindex->nHeight    = h;
+        pindex->pprev      = (h > 0 ? chain.back() : nullptr);
+        chain.push_back(pindex);
+    }
+    return chain;
+}
+
+// makes the block at nHeight the tip; like with a reorg, the wallet isn't told about the blocks above
+static void SetChainTip(const std::vector<CBlockIndexSmartPtr>& chain, int nHeight)
+{
+    for (int h = 0; h < static_cast<int>(chain.size()); h++)
+        chain[h]->pnext = (h < nHeight ? chain[h + 1] : nullptr);
+    pindexBest    = chain[nHeight];
+    nBestHeight   = nHeight;
+    hashBestChain = chain[nHeight]->GetBlockHash();
+}
+
+// adds tx to the wallet as in the block at nHeight of chain
+static void AddWalletTx(CWallet& w, const CTransaction& tx,
+                        const std::vector<CBlockIndexSmartPtr>& chain, int nHeight)
+{
+    CWalletTx wtx(&w, tx);
+    wtx.hashBlock = chain[nHeight]->GetBlockHash();
+    wtx.nIndex    = 0;
+
+    LOCK2(cs_main, w.cs_wallet);
+    w.AddToWallet(wtx, true, nullptr);
+}
+
+// the balances, the way they were computed before they were cached: from every wallet transaction
+static void ExpectUncachedBalances(const CWallet& w)
+{
+    CAmount nBalance     = 0;
+    CAmount nUnconfirmed = 0;
+    CAmount nImmature    = 0;
+    CAmount nStake       = 0;
+    CAmount nNewMint     = 0;
+    {
+        LOCK2(cs_main, w.cs_wallet);
+        for (const auto& p : w.mapWallet) {
+            const CWalletTx& pcoin = p.second;
+            if (pcoin.IsTrusted())
+                nBalance += pcoin.GetAvailableCredit(false);
+            else if (pcoin.GetDepthInMainChain() == 0 && pcoin.InMempool())
+                nUnconfirmed += pcoin.GetAvailableCredit(false);
+            if (pcoin.GetBlocksToMaturity() == 0 || pcoin.GetDepthInMainChain() <= 0)
+                continue;
+            if (pcoin.IsCoinBase()) {
+                nImmature += pcoin.GetImmatureCredit(false);
+                nNewMint += w.GetCredit(pcoin, ISMINE_SPENDABLE_ALL, true);
+            } else if (pcoin.IsCoinStake()) {
+                nStake += w.GetCredit(pcoin, ISMINE_SPENDABLE_ALL, true);
+            }
+        }
+    }
+    EXPECT_EQ(w.GetBalance(), nBalance);
+    EXPECT_EQ(w.GetUnconfirmedBalance(), nUnconfirmed);
+    EXPECT_EQ(w.GetImmatureBalance(), nImmature);
+    EXPECT_EQ(w.GetStake(), nStake);
+    EXPECT_EQ(w.GetNewMint(), nNewMint);
+}
+
+TEST(wallet_tests, cached_balances)
+{
+    CKey key;
+    key.MakeNewKey(true);
+    CKey otherKey;
+    otherKey.MakeNewKey(true);
+    const CScript script      = GetScriptForDestination(key.GetPubKey().GetID());
+    const CScript otherScript = GetScriptForDestination(otherKey.GetPubKey().GetID());
+
+    CWallet w;
+    w.LoadKey(key);
+
+    const CBlockIndexSmartPtr pindexBestBefore    = pindexBest;
+    const int                 nBestHeightBefore   = nBestHeight;
+    const uint256             hashBestChainBefore = hashBestChain;
+
+    const std::vector<CBlockIndexSmartPtr> chain = MakeBlockIndexChain(300);
+    SetChainTip(chain, 9);
+    ExpectUncachedBalances(w);
+    EXPECT_EQ(w.GetBalance(), 0);
+
+    // receiving coins
+    CTransaction tx1;
+    tx1.vin.resize(1);
+    tx1.vin[0].prevout = COutPoint(uint256(1), 0);
+    tx1.vout.resize(1);
+    tx1.vout[0].nValue       = 10 * COIN;
+    tx1.vout[0].scriptPubKey = script;
+    AddWalletTx(w, tx1, chain, 2);
+    ExpectUncachedBalances(w);
+    EXPECT_EQ(w.GetBalance(), 10 * COIN);
+
+    // spending them, with change
+    CTransaction tx2;
+    tx2.vin.resize(1);
+    tx2.vin[0].prevout = COutPoint(tx1.GetHash(), 0);
+    tx2.vout.resize(2);
+    tx2.vout[0].nValue       = 3 * COIN;
+    tx2.vout[0].scriptPubKey = script;
+    tx2.vout[1].nValue       = 7 * COIN;
+    tx2.vout[1].scriptPubKey = otherScript;
+    AddWalletTx(w, tx2, chain, 3);
+    ExpectUncachedBalances(w);
+    EXPECT_EQ(w.GetBalance(), 3 * COIN);
+
+    // the spend leaves the main chain, but it still spends the coins, and isn't in the mempool
+    SetChainTip(chain, 2);
+    ExpectUncachedBalances(w);
+    EXPECT_EQ(w.GetBalance(), 0);
+    SetChainTip(chain, 9);
+    ExpectUncachedBalances(w);
+    EXPECT_EQ(w.GetBalance(), 3 * COIN);
+
+    // coins locked until height 12 only count once the chain is past it
+    CTransaction tx3;
+    tx3.nLockTime = 12;
+    tx3.vin.resize(1);
+    tx3.vin[0].prevout   = COutPoint(uint256(2), 0);
+    tx3.vin[0].nSequence = 0;
+    tx3.vout.resize(1);
+    tx3.vout[0].nValue       = COIN;
+    tx3.vout[0].scriptPubKey = script;
+    AddWalletTx(w, tx3, chain, 9);
+    ExpectUncachedBalances(w);
+    EXPECT_EQ(w.GetBalance(), 3 * COIN);
+    SetChainTip(chain, 12);
+    ExpectUncachedBalances(w);
+    EXPECT_EQ(w.GetBalance(), 3 * COIN);
+    SetChainTip(chain, 13);
+    ExpectUncachedBalances(w);
+    EXPECT_EQ(w.GetBalance(), 4 * COIN);
+
+    // a coinbase is immature until it's deep enough, and the wallet isn't told when it gets there
+    CTransaction tx4;
+    tx4.vin.resize(1);
+    tx4.vin[0].prevout.SetNull();
+    tx4.vout.resize(1);
+    tx4.vout[0].nValue       = 5 * COIN;
+    tx4.vout[0].scriptPubKey = script;
+    AddWalletTx(w, tx4, chain, 13);
+    ExpectUncachedBalances(w);
+    EXPECT_EQ(w.GetImmatureBalance(), 5 * COIN);
+    EXPECT_EQ(w.GetBalance(), 4 * COIN);
+    int nHeight = 13;
+    for (;;) {
+        {
+            LOCK(cs_main);
+            if (w.GetWalletTx(tx4.GetHash())->GetBlocksToMaturity() == 0)
+                break;
+        }
+        ASSERT_LT(nHeight + 1, static_cast<int>(chain.size()));
+        SetChainTip(chain, ++nHeight);
+        ExpectUncachedBalances(w);
+    }
+    EXPECT_EQ(w.GetImmatureBalance(), 0);
+    EXPECT_EQ(w.GetBalance(), 9 * COIN);
+
+    // the chain is left as it was found
+    for (const CBlockIndexSmartPtr& pindex : chain) {
+        pindex->pprev = nullptr;
+        pindex->pnext = nullptr;
+        mapBlockIndex.erase(uint256(*pindex->phashBlock));
+    }
+    pindexBest    = pindexBestBefore;
+    nBestHeight   = nBestHeightBefore;
+    hashBestChain = hashBestChainBefore;
+}
+
 #include "main.h"
 #include "txdb.h"
 
@@ -352,7 +572,7 @@ static CBlockIndexSmartPtr InsertBlockIndex(uint256 hash)
         return nullptr;
 
     // Return existing
-    map<uint256, CBlockIndexSmartPtr>::iterator mi = mapBlockIndex.find(hash);
+    BlockIndexMapType::iterator mi = mapBlockIndex.find(hash);
     if (mi != mapBlockIndex.end())
         return mi->second;
 
@@ -0,0 +1,63 @@
+#include "googletest/googletest/include/gtest/gtest.h"
+
+#include "workqueue.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+TEST(workqueue_tests, items_are_run_by_workers)
+{
+    CWorkQueue               queue(100);
+    std::vector<std::thread> vWorkers;
+    for (int i = 0; i < 4; i++)
+        vWorkers.emplace_back([&queue]() { queue.Run(); });
+
+    std::atomic<int> nRun{0};
+    for (int i = 0; i < 50; i++)
+        EXPECT_TRUE(queue.Enqueue([&nRun]() { nRun++; }));
+
+    for (int i = 0; i < 1000 && nRun < 50; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_EQ(nRun.load(), 50);
+    EXPECT_EQ(queue.Depth(), 0u);
+
+    queue.Interrupt();
+    for (std::thread& worker : vWorkers)
+        worker.join();
+}
+
+TEST(workqueue_tests, full_queue_refuses_items)
+{
+    CWorkQueue queue(3);
+    int        nRun = 0;
+    for (int i = 0; i < 3; i++)
+        EXPECT_TRUE(queue.Enqueue([&nRun]() { nRun++; }));
+    EXPECT_FALSE(queue.Enqueue([&nRun]() { nRun++; }));
+    EXPECT_EQ(queue.Depth(), 3u);
+
+    // a worker makes room again
+    std::thread worker([&queue]() { queue.Run(); });
+    for (int i = 0; i < 1000 && queue.Depth() > 0; i++)
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    EXPECT_TRUE(queue.Enqueue([]() {}));
+
+    queue.Interrupt();
+    worker.join();
+    EXPECT_GE(nRun, 3);
+}
+
+TEST(workqueue_tests, interrupt_drops_queued_items)
+{
+    CWorkQueue queue(10);
+    int        nRun = 0;
+    EXPECT_TRUE(queue.Enqueue([&nRun]() { nRun++; }));
+    queue.Interrupt();
+    EXPECT_EQ(queue.Depth(), 0u);
+    EXPECT_FALSE(queue.Enqueue([&nRun]() { nRun++; }));
+
+    // Run() returns right away
+    queue.Run();
+    EXPECT_EQ(nRun, 0);
+}
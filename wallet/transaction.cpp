@@ -19,9 +19,18 @@ void CTransaction::SetNull()
     vout.clear();
     nLockTime = 0;
     nDoS      = 0; // Denial-of-service prevention
+    InvalidateHash();
 }
 
-uint256 CTransaction::GetHash() const { return SerializeHash(*this); }
+uint256 CTransaction::GetHash() const
+{
+    uint256 hash;
+    if (!cachedHash.Get(hash)) {
+        hash = SerializeHash(*this);
+        cachedHash.Set(hash);
+    }
+    return hash;
+}
 
 bool CTransaction::IsNewerThan(const CTransaction& old) const
 {
@@ -380,20 +389,105 @@ bool CTransaction::DisconnectInputs(CTxDB& txdb)
     return true;
 }
 
-bool CTransaction::FetchInputs(CTxDB& txdb, const std::map<uint256, CTxIndex>& mapTestPool, bool fBlock,
-                               bool fMiner, MapPrevTx& inputsRet, bool& fInvalid) const
+// reads the prev txs of the inputs of tx, and their tx indexes, in one batch of each. fBatchFailed is
+// set if a batch couldn't be read, in which case inputsRet is left as it was.
+static bool FetchInputsBatched(const CTransaction& tx, CTxDB& txdb,
+                               const std::map<uint256, CTxIndex>& mapTestPool, bool fBlock, bool fMiner,
+                               MapPrevTx& inputsRet, bool& fBatchFailed)
 {
-    // FetchInputs can return false either because we just haven't seen some inputs
-    // (in which case the transaction should be stored as an orphan)
-    // or because the transaction is malformed (in which case the transaction should
-    // be dropped).  If tx is definitely invalid, fInvalid will be set to true.
-    fInvalid = false;
+    fBatchFailed = false;
+
+    // Collect the tx indices that are not available in memory, so that all of them are read from the
+    // database in one batch
+    std::vector<uint256>        txIndexHashesToRead;
+    std::map<uint256, unsigned> txIndexBatchPositions;
+    for (const CTxIn& txin : tx.vin) {
+        const uint256& prevHash = txin.prevout.hash;
+        if (inputsRet.count(prevHash) || txIndexBatchPositions.count(prevHash))
+            continue;
+        if ((fBlock || fMiner) && mapTestPool.count(prevHash))
+            continue;
+        txIndexBatchPositions[prevHash] = txIndexHashesToRead.size();
+        txIndexHashesToRead.push_back(prevHash);
+    }
 
-    if (IsCoinBase())
-        return true; // Coinbase transactions have no inputs to fetch.
+    std::vector<boost::optional<CTxIndex>> fetchedTxIndexes;
+    if (!txdb.ReadTxIndexMany(txIndexHashesToRead, fetchedTxIndexes)) {
+        fBatchFailed = true;
+        return false;
+    }
 
-    for (unsigned int i = 0; i < vin.size(); i++) {
-        COutPoint prevout = vin[i].prevout;
+    // Resolve the tx index of every prev tx, then read all the prev txs on disk in one batch
+    std::map<uint256, boost::optional<CTxIndex>> resolvedTxIndexes;
+    std::vector<CDiskTxPos>                      txPositionsToRead;
+    std::map<uint256, unsigned>                  txBatchPositions;
+    for (const CTxIn& txin : tx.vin) {
+        const uint256& prevHash = txin.prevout.hash;
+        if (inputsRet.count(prevHash) || resolvedTxIndexes.count(prevHash))
+            continue;
+        boost::optional<CTxIndex>& txindex = resolvedTxIndexes[prevHash];
+        if ((fBlock || fMiner) && mapTestPool.count(prevHash)) {
+            txindex = mapTestPool.find(prevHash)->second;
+        } else {
+            txindex = fetchedTxIndexes[txIndexBatchPositions.at(prevHash)];
+        }
+        if (txindex && txindex->pos != CDiskTxPos(1, 1)) {
+            txBatchPositions[prevHash] = txPositionsToRead.size();
+            txPositionsToRead.push_back(txindex->pos);
+        }
+    }
+
+    std::vector<boost::optional<CTransaction>> fetchedTxs;
+    if (!txdb.ReadTxMany(txPositionsToRead, fetchedTxs)) {
+        fBatchFailed = true;
+        return false;
+    }
+
+    for (unsigned int i = 0; i < tx.vin.size(); i++) {
+        COutPoint prevout = tx.vin[i].prevout;
+        if (inputsRet.count(prevout.hash))
+            continue; // Got it already
+
+        // Read txindex
+        CTxIndex&                        txindex       = inputsRet[prevout.hash].first;
+        const boost::optional<CTxIndex>& resolvedIndex = resolvedTxIndexes.at(prevout.hash);
+        bool                             fFound        = static_cast<bool>(resolvedIndex);
+        if (fFound)
+            txindex = *resolvedIndex;
+        if (!fFound && (fBlock || fMiner))
+            return fMiner ? false
+                          : error("FetchInputs() : %s prev tx %s index entry not found",
+                                  tx.GetHash().ToString().c_str(), prevout.hash.ToString().c_str());
+
+        // Read txPrev
+        CTransaction& txPrev = inputsRet[prevout.hash].second;
+        if (!fFound || txindex.pos == CDiskTxPos(1, 1)) {
+            // Get prev tx from single transactions in memory
+            if (!mempool.lookup(prevout.hash, txPrev))
+                return error("FetchInputs() : %s mempool Tx prev not found %s",
+                             tx.GetHash().ToString().c_str(), prevout.hash.ToString().c_str());
+            if (!fFound)
+                txindex.vSpent.resize(txPrev.vout.size());
+        } else {
+            // Get prev tx from the disk batch
+            boost::optional<CTransaction>& fetchedTx = fetchedTxs[txBatchPositions.at(prevout.hash)];
+            if (!fetchedTx)
+                return error("FetchInputs() : %s ReadFromDisk prev tx %s failed",
+                             tx.GetHash().ToString().c_str(), prevout.hash.ToString().c_str());
+            txPrev = std::move(*fetchedTx);
+        }
+    }
+
+    return true;
+}
+
+// reads the prev txs of the inputs of tx, and their tx indexes, one at a time
+static bool FetchInputsOneByOne(const CTransaction& tx, CTxDB& txdb,
+                                const std::map<uint256, CTxIndex>& mapTestPool, bool fBlock, bool fMiner,
+                                MapPrevTx& inputsRet)
+{
+    for (unsigned int i = 0; i < tx.vin.size(); i++) {
+        COutPoint prevout = tx.vin[i].prevout;
         if (inputsRet.count(prevout.hash))
             continue; // Got it already
 
@@ -410,7 +504,7 @@ bool CTransaction::FetchInputs(CTxDB& txdb, const std::map<uint256, CTxIndex>& m
         if (!fFound && (fBlock || fMiner))
             return fMiner ? false
                           : error("FetchInputs() : %s prev tx %s index entry not found",
-                                  GetHash().ToString().c_str(), prevout.hash.ToString().c_str());
+                                  tx.GetHash().ToString().c_str(), prevout.hash.ToString().c_str());
 
         // Read txPrev
         CTransaction& txPrev = inputsRet[prevout.hash].second;
@@ -418,16 +512,42 @@ bool CTransaction::FetchInputs(CTxDB& txdb, const std::map<uint256, CTxIndex>& m
             // Get prev tx from single transactions in memory
             if (!mempool.lookup(prevout.hash, txPrev))
                 return error("FetchInputs() : %s mempool Tx prev not found %s",
-                             GetHash().ToString().c_str(), prevout.hash.ToString().c_str());
+                             tx.GetHash().ToString().c_str(), prevout.hash.ToString().c_str());
             if (!fFound)
                 txindex.vSpent.resize(txPrev.vout.size());
         } else {
             // Get prev tx from disk
             if (!txPrev.ReadFromDisk(txindex.pos, txdb))
                 return error("FetchInputs() : %s ReadFromDisk prev tx %s failed",
-                             GetHash().ToString().c_str(), prevout.hash.ToString().c_str());
+                             tx.GetHash().ToString().c_str(), prevout.hash.ToString().c_str());
         }
     }
+    return true;
+}
+
+bool CTransaction::FetchInputs(CTxDB& txdb, const std::map<uint256, CTxIndex>& mapTestPool, bool fBlock,
+                               bool fMiner, MapPrevTx& inputsRet, bool& fInvalid) const
+{
+    // FetchInputs can return false either because we just haven't seen some inputs
+    // (in which case the transaction should be stored as an orphan)
+    // or because the transaction is malformed (in which case the transaction should
+    // be dropped).  If tx is definitely invalid, fInvalid will be set to true.
+    fInvalid = false;
+
+    if (IsCoinBase())
+        return true; // Coinbase transactions have no inputs to fetch.
+
+    // a batch fails as a whole, e.g. if one of its records can't be deserialized, so the inputs are read
+    // again one by one then, for each of them to get the outcome of a single read
+    bool fBatchFailed = false;
+    if (!FetchInputsBatched(*this, txdb, mapTestPool, fBlock, fMiner, inputsRet, fBatchFailed)) {
+        if (!fBatchFailed)
+            return false;
+        printf("FetchInputs() : %s failed to batch-read its inputs, reading them one by one\n",
+               GetHash().ToString().c_str());
+        if (!FetchInputsOneByOne(*this, txdb, mapTestPool, fBlock, fMiner, inputsRet))
+            return false;
+    }
 
     // Make sure all prevout.n indexes are valid:
     for (unsigned int i = 0; i < vin.size(); i++) {
@@ -492,7 +612,8 @@ unsigned int CTransaction::GetP2SHSigOpCount(const MapPrevTx& inputs) const
 Result<void, TxValidationState>
 CTransaction::ConnectInputs(MapPrevTx inputs, std::map<uint256, CTxIndex>& mapTestPool,
                             const CDiskTxPos& posThisTx, const ConstCBlockIndexSmartPtr& pindexBlock,
-                            bool fBlock, bool fMiner, CBlock* sourceBlockPtr) const
+                            bool fBlock, bool fMiner, CBlock* sourceBlockPtr,
+                            std::vector<CScriptCheck>* pvChecks) const
 {
     // Take over previous transactions' spent pointers
     // fBlock is true when this is called from AcceptBlock when a new best-block is added to the
@@ -590,38 +711,59 @@ CTransaction::ConnectInputs(MapPrevTx inputs, std::map<uint256, CTxIndex>& mapTe
             // before the last blockchain checkpoint. This is safe because block merkle hashes are
             // still computed and checked, and any change will be caught at the next checkpoint.
             if (!(fBlock && (nBestHeight < Checkpoints::GetTotalBlocksEstimate()))) {
-                // Verify signature
-                bool       fStrictPayToScriptHash = true;
-                const auto verifyRes =
-                    VerifySignature(txPrev, *this, i, fStrictPayToScriptHash, false, 0);
-                if (verifyRes.isErr()) {
-                    // only during transition phase for P2SH: do not invoke anti-DoS code for
-                    // potentially old clients relaying bad P2SH transactions
-                    if (fStrictPayToScriptHash) {
-                        const auto verifyResP2SH = VerifySignature(txPrev, *this, i, false, false, 0);
-                        if (verifyResP2SH.isOk()) {
-                            return Err(MakeInvalidTxState(
-                                TxValidationResult::TX_NOT_STANDARD,
-                                strprintf("non-mandatory-script-verify-flag (%s)",
-                                          ScriptErrorString(verifyResP2SH.unwrapErr())),
-                                strprintf("ConnectInputs() : %s P2SH VerifySignature failed",
-                                          GetHash().ToString().c_str())));
-                        }
+                // Signatures cached on mempool acceptance are looked up for the last time when the
+                // block that includes them is connected, so they're dropped from the cache then
+                const bool fEraseCachedSigs = fBlock && !fMiner;
+                if (pvChecks) {
+                    // Defer the script evaluation to the caller's check queue; the inexpensive
+                    // structural checks VerifySignature() would do are still done here
+                    if (prevout.n >= txPrev.vout.size() || prevout.hash != txPrev.GetHash()) {
+                        DoS(100, false);
+                        return Err(MakeInvalidTxState(
+                            TxValidationResult::TX_CONSENSUS, "bad-txns-inputs-prevout-mismatch",
+                            strprintf("ConnectInputs() : %s prevout doesn't match previous tx",
+                                      GetHash().ToString().c_str())));
                     }
+                    pvChecks->push_back(CScriptCheck());
+                    CScriptCheck check(txPrev.vout[prevout.n].scriptPubKey, *this, i, true, false, 0,
+                                       fEraseCachedSigs);
+                    check.swap(pvChecks->back());
+                } else {
+                    // Verify signature
+                    bool       fStrictPayToScriptHash = true;
+                    const auto verifyRes = VerifySignature(txPrev, *this, i, fStrictPayToScriptHash,
+                                                           false, 0, fEraseCachedSigs);
+                    if (verifyRes.isErr()) {
+                        // only during transition phase for P2SH: do not invoke anti-DoS code for
+                        // potentially old clients relaying bad P2SH transactions
+                        if (fStrictPayToScriptHash) {
+                            const auto verifyResP2SH =
+                                VerifySignature(txPrev, *this, i, false, false, 0);
+                            if (verifyResP2SH.isOk()) {
+                                return Err(MakeInvalidTxState(
+                                    TxValidationResult::TX_NOT_STANDARD,
+                                    strprintf("non-mandatory-script-verify-flag (%s)",
+                                              ScriptErrorString(verifyResP2SH.unwrapErr())),
+                                    strprintf("ConnectInputs() : %s P2SH VerifySignature failed",
+                                              GetHash().ToString().c_str())));
+                            }
+                        }
 
-                    const std::string msg = strprintf("mandatory-script-verify-flag-failed (%s)",
-                                                      ScriptErrorString(verifyRes.unwrapErr()));
+                        const std::string msg =
+                            strprintf("mandatory-script-verify-flag-failed (%s)",
+                                      ScriptErrorString(verifyRes.unwrapErr()));
 
-                    if (sourceBlockPtr) {
-                        sourceBlockPtr->reject =
-                            CBlock::CBlockReject(REJECT_INVALID, msg, sourceBlockPtr->GetHash());
+                        if (sourceBlockPtr) {
+                            sourceBlockPtr->reject =
+                                CBlock::CBlockReject(REJECT_INVALID, msg, sourceBlockPtr->GetHash());
+                        }
+                        this->reject = CTransaction::CTxReject(REJECT_INVALID, msg, GetHash());
+                        DoS(100, false);
+                        return Err(MakeInvalidTxState(
+                            TxValidationResult::TX_CONSENSUS, msg,
+                            strprintf("ConnectInputs() : %s VerifySignature failed",
+                                      GetHash().ToString().c_str())));
                     }
-                    this->reject = CTransaction::CTxReject(REJECT_INVALID, msg, GetHash());
-                    DoS(100, false);
-                    return Err(
-                        MakeInvalidTxState(TxValidationResult::TX_CONSENSUS, msg,
-                                           strprintf("ConnectInputs() : %s VerifySignature failed",
-                                                     GetHash().ToString().c_str())));
                 }
             }
 
@@ -1,6 +1,7 @@
 #ifndef TRANSACTION_H
 #define TRANSACTION_H
 
+#include "cachedhash.h"
 #include "globals.h"
 #include "inpoint.h"
 #include "outpoint.h"
@@ -14,6 +15,7 @@
 #include <vector>
 
 class CTransaction;
+class CScriptCheck;
 
 enum GetMinFee_mode
 {
@@ -69,6 +71,8 @@ public:
                         READWRITE(vin);
                         READWRITE(vout);
                         READWRITE(nLockTime);
+                        if (fRead)
+                            const_cast<CTransaction*>(this)->InvalidateHash();
                         )
     // clang-format on
 
@@ -76,8 +80,11 @@ public:
 
     bool IsNull() const { return (vin.empty() && vout.empty()); }
 
+    /** The hash is computed once; whoever changes the transaction must call InvalidateHash() */
     uint256 GetHash() const;
 
+    void InvalidateHash() { cachedHash.Invalidate(); }
+
     bool IsNewerThan(const CTransaction& old) const;
 
     bool IsCoinBase() const { return (vin.size() == 1 && vin[0].prevout.IsNull() && vout.size() >= 1); }
@@ -169,12 +176,14 @@ public:
         @param[in] pindexBlock
         @param[in] fBlock	true if called from ConnectBlock
         @param[in] fMiner	true if called from CreateNewBlock
+        @param[out] pvChecks	If given, script checks are appended here instead of being run inline
         @return Returns true if all checks succeed
         */
     Result<void, TxValidationState>
                                     ConnectInputs(MapPrevTx inputs, std::map<uint256, CTxIndex>& mapTestPool,
                                                   const CDiskTxPos& posThisTx, const ConstCBlockIndexSmartPtr& pindexBlock, bool fBlock,
-                                                  bool fMiner, CBlock* sourceBlockPtr = nullptr) const;
+                                                  bool fMiner, CBlock* sourceBlockPtr = nullptr,
+                                                  std::vector<CScriptCheck>* pvChecks = nullptr) const;
     Result<void, TxValidationState> CheckTransaction(CBlock* sourceBlock = nullptr) const;
     bool GetCoinAge(CTxDB& txdb, uint64_t& nCoinAge) const; // ppcoin: get transaction coin age
 
@@ -192,6 +201,9 @@ public:
 
 protected:
     const CTxOut& GetOutputFor(const CTxIn& input, const MapPrevTx& inputs) const;
+
+private:
+    CCachedHash cachedHash;
 };
 
 #endif // TRANSACTION_H
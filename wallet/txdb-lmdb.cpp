@@ -11,11 +11,21 @@
 #include <boost/scope_exit.hpp>
 #include <boost/thread/future.hpp>
 #include <boost/version.hpp>
+#include <cstring>
+#include <deque>
+#include <functional>
 #include <future>
+#include <numeric>
 #include <random>
+#include <unordered_set>
 
+#include "activechain.h"
+#include "addressindex.h"
+#include "blockindexpool.h"
 #include "kernel.h"
 #include "main.h"
+#include "ntp1/ntp1index.h"
+#include "ntp1/ntp1transaction.h"
 #include "txdb.h"
 #include "util.h"
 
@@ -30,6 +40,9 @@ DbSmartPtrType glob_db_tx(nullptr, [](MDB_dbi*) {});
 DbSmartPtrType glob_db_ntp1Tx(nullptr, [](MDB_dbi*) {});
 DbSmartPtrType glob_db_ntp1tokenNames(nullptr, [](MDB_dbi*) {});
 DbSmartPtrType glob_db_addrsVsPubKeys(nullptr, [](MDB_dbi*) {});
+DbSmartPtrType glob_db_addressIndex(nullptr, [](MDB_dbi*) {});
+DbSmartPtrType glob_db_addressUnspent(nullptr, [](MDB_dbi*) {});
+DbSmartPtrType glob_db_ntp1Index(nullptr, [](MDB_dbi*) {});
 
 using namespace std;
 using namespace boost;
@@ -547,6 +560,9 @@ void CTxDB::init_blockindex(bool fRemoveOld)
     glob_db_ntp1Tx         = DbSmartPtrType(new MDB_dbi, dbDeleter);
     glob_db_ntp1tokenNames = DbSmartPtrType(new MDB_dbi, dbDeleter);
     glob_db_addrsVsPubKeys = DbSmartPtrType(new MDB_dbi, dbDeleter);
+    glob_db_addressIndex   = DbSmartPtrType(new MDB_dbi, dbDeleter);
+    glob_db_addressUnspent = DbSmartPtrType(new MDB_dbi, dbDeleter);
+    glob_db_ntp1Index      = DbSmartPtrType(new MDB_dbi, dbDeleter);
 
     // MDB_CREATE: Create the named database if it doesn't exist.
     CTxDB::lmdb_db_open(txn, LMDB_MAINDB.c_str(), MDB_CREATE, *glob_db_main,
@@ -563,6 +579,12 @@ void CTxDB::init_blockindex(bool fRemoveOld)
                         *glob_db_ntp1tokenNames, "Failed to open db handle for glob_db_ntp1Tx");
     CTxDB::lmdb_db_open(txn, LMDB_ADDRSVSPUBKEYSDB.c_str(), MDB_CREATE, *glob_db_addrsVsPubKeys,
                         "Failed to open db handle for glob_db_ntp1Tx");
+    CTxDB::lmdb_db_open(txn, LMDB_ADDRESSINDEXDB.c_str(), MDB_CREATE, *glob_db_addressIndex,
+                        "Failed to open db handle for glob_db_addressIndex");
+    CTxDB::lmdb_db_open(txn, LMDB_ADDRESSUNSPENTDB.c_str(), MDB_CREATE, *glob_db_addressUnspent,
+                        "Failed to open db handle for glob_db_addressUnspent");
+    CTxDB::lmdb_db_open(txn, LMDB_NTP1INDEXDB.c_str(), MDB_CREATE, *glob_db_ntp1Index,
+                        "Failed to open db handle for glob_db_ntp1Index");
 
     // commit the transaction
     txn.commit();
@@ -588,6 +610,15 @@ void CTxDB::init_blockindex(bool fRemoveOld)
     if (!glob_db_addrsVsPubKeys) {
         throw std::runtime_error("LMDB nullptr after opening the db_addrsVsPubKeys database.");
     }
+    if (!glob_db_addressIndex) {
+        throw std::runtime_error("LMDB nullptr after opening the db_addressIndex database.");
+    }
+    if (!glob_db_addressUnspent) {
+        throw std::runtime_error("LMDB nullptr after opening the db_addressUnspent database.");
+    }
+    if (!glob_db_ntp1Index) {
+        throw std::runtime_error("LMDB nullptr after opening the db_ntp1Index database.");
+    }
 
     printf("Done opening the database\n");
     uiInterface.InitMessage("Done opening the database");
@@ -641,6 +672,17 @@ CTxDB::CTxDB(const char* pszMode)
         fReadOnly = fTmp;
     }
 
+    {
+        bool fTmp = fReadOnly;
+        fReadOnly = false;
+        if (!MigrateNTP1TxDbToCompactFormat()) {
+            // not fatal; records in the old format are still readable, and migration is retried on
+            // the next start
+            printf("Failed to migrate the NTP1 transactions database to the compact format\n");
+        }
+        fReadOnly = fTmp;
+    }
+
     printf("Opened LMDB successfully\n");
 }
 
@@ -650,6 +692,10 @@ void CTxDB::Close()
         activeBatch->abort();
         activeBatch.reset();
     }
+    batchChanges.Clear();
+    if (!fReadOnly && db_main) {
+        FlushCache(true);
+    }
     resetDbPointers();
     resetGlobalDbPointers();
 }
@@ -665,6 +711,7 @@ void CTxDB::__deleteDb()
 bool CTxDB::TxnBegin(size_t required_size)
 {
     assert(activeBatch == nullptr);
+    batchChanges.Clear();
     if (CTxDB::need_resize(required_size)) {
         printf("LMDB memory map needs to be resized, doing that now.\n");
         CTxDB::do_resize(required_size);
@@ -685,6 +732,8 @@ bool CTxDB::TxnCommit()
         activeBatch->commit();
         activeBatch.reset();
     }
+    // the cached records of the batch become visible only now that the rest of it is in the db
+    TxDBCache().Commit(std::move(batchChanges));
     return true;
 }
 
@@ -695,6 +744,7 @@ bool CTxDB::TxnAbort()
         activeBatch->abort();
         activeBatch.reset();
     }
+    batchChanges.Clear();
     return true;
 }
 
@@ -706,6 +756,11 @@ bool CTxDB::test1_WriteStrKeyVal(const string& key, const string& val)
 bool CTxDB::test1_ReadStrKeyVal(const string& key, string& val) { return Read(key, val, db_main); }
 bool CTxDB::test1_ExistsStrKeyVal(const string& key) { return Exists(key, db_main); }
 bool CTxDB::test1_EraseStrKeyVal(const string& key) { return Erase(key, db_main); }
+bool CTxDB::test1_ReadStrKeyValBatch(const std::vector<string>&                 keys,
+                                     std::vector<boost::optional<std::string>>& vals)
+{
+    return ReadBatch(keys, vals, db_main);
+}
 
 bool CTxDB::test2_ReadMultipleStr1KeyVal(const string& key, std::vector<string>& val)
 {
@@ -728,15 +783,80 @@ boost::optional<int> CTxDB::ReadVersion()
 
 bool CTxDB::WriteVersion(int nVersion) { return Write(std::string("version"), nVersion, db_main); }
 
+void CTxDB::CommitCacheChanges(CTxDBChanges&& changes)
+{
+    // outside of a batch, a change is committed right away, like a write to the db would be
+    if (activeBatch) {
+        batchChanges.MergeFrom(std::move(changes));
+    } else {
+        TxDBCache().Commit(std::move(changes));
+    }
+}
+
+CTxDBChanges::Lookup CTxDB::LookupCachedTxIndex(const uint256& hash, CTxIndex& txindex) const
+{
+    const CTxDBChanges::Lookup res = batchChanges.LookupTxIndex(hash, txindex);
+    if (res != CTxDBChanges::Lookup::Unknown) {
+        return res;
+    }
+    return TxDBCache().LookupTxIndex(hash, txindex);
+}
+
+void CTxDB::LookupCachedTxIndexMany(const std::vector<uint256>&              hashes,
+                                    std::vector<boost::optional<CTxIndex>>& txindexes,
+                                    std::vector<uint256>&                   missingHashes,
+                                    std::vector<std::size_t>&               missingPositions)
+{
+    txindexes.clear();
+    txindexes.resize(hashes.size());
+    missingHashes.clear();
+    missingPositions.clear();
+    for (unsigned i = 0; i < hashes.size(); i++) {
+        CTxIndex txindex;
+        switch (LookupCachedTxIndex(hashes[i], txindex)) {
+        case CTxDBChanges::Lookup::Found:
+            txindexes[i] = std::move(txindex);
+            break;
+        case CTxDBChanges::Lookup::Erased:
+            break;
+        case CTxDBChanges::Lookup::Unknown:
+            missingHashes.push_back(hashes[i]);
+            missingPositions.push_back(i);
+            break;
+        }
+    }
+}
+
 bool CTxDB::ReadTxIndex(const uint256& hash, CTxIndex& txindex)
 {
     txindex.SetNull();
-    return Read(hash, txindex, db_tx);
+    switch (LookupCachedTxIndex(hash, txindex)) {
+    case CTxDBChanges::Lookup::Found:
+        return true;
+    case CTxDBChanges::Lookup::Erased:
+        return false;
+    case CTxDBChanges::Lookup::Unknown:
+        break;
+    }
+
+    const uint64_t nFlushCount = TxDBCache().GetFlushCount();
+    if (!Read(hash, txindex, db_tx)) {
+        return false;
+    }
+    TxDBCache().AddReadTxIndex(hash, txindex, nFlushCount);
+    return true;
 }
 
 bool CTxDB::UpdateTxIndex(const uint256& hash, const CTxIndex& txindex)
 {
-    return Write(hash, txindex, db_tx);
+    if (fReadOnly) {
+        printf("Accessing lmdb write function in read only mode");
+        return false;
+    }
+    CTxDBChanges changes;
+    changes.SetTxIndex(hash, txindex);
+    CommitCacheChanges(std::move(changes));
+    return true;
 }
 
 bool CTxDB::ReadTx(const CDiskTxPos& txPos, CTransaction& tx)
@@ -745,10 +865,57 @@ bool CTxDB::ReadTx(const CDiskTxPos& txPos, CTransaction& tx)
     return Read(txPos.nBlockPos, tx, db_blocks, 0, txPos.nTxPos);
 }
 
+bool CTxDB::ReadTxIndexMany(const std::vector<uint256>&              hashes,
+                            std::vector<boost::optional<CTxIndex>>& txindexes)
+{
+    std::vector<uint256>     missingHashes;
+    std::vector<std::size_t> missingPositions;
+    LookupCachedTxIndexMany(hashes, txindexes, missingHashes, missingPositions);
+    if (missingHashes.empty()) {
+        return true;
+    }
+
+    const uint64_t                         nFlushCount = TxDBCache().GetFlushCount();
+    std::vector<boost::optional<CTxIndex>> readTxIndexes;
+    if (!ReadBatch(missingHashes, readTxIndexes, db_tx)) {
+        return false;
+    }
+    for (unsigned i = 0; i < readTxIndexes.size(); i++) {
+        if (readTxIndexes[i]) {
+            TxDBCache().AddReadTxIndex(missingHashes[i], *readTxIndexes[i], nFlushCount);
+            txindexes[missingPositions[i]] = std::move(readTxIndexes[i]);
+        }
+    }
+    return true;
+}
+
+static void SplitTxPositions(const std::vector<CDiskTxPos>& txPositions, std::vector<uint256>& blockKeys,
+                             std::vector<size_t>& offsets)
+{
+    blockKeys.clear();
+    offsets.clear();
+    blockKeys.reserve(txPositions.size());
+    offsets.reserve(txPositions.size());
+    for (const CDiskTxPos& pos : txPositions) {
+        blockKeys.push_back(pos.nBlockPos);
+        offsets.push_back(pos.nTxPos);
+    }
+}
+
+bool CTxDB::ReadTxMany(const std::vector<CDiskTxPos>&             txPositions,
+                       std::vector<boost::optional<CTransaction>>& txs)
+{
+    std::vector<uint256> blockKeys;
+    std::vector<size_t>  offsets;
+    SplitTxPositions(txPositions, blockKeys, offsets);
+    return ReadBatch(blockKeys, txs, db_blocks, 0, offsets);
+}
+
 bool CTxDB::ReadNTP1Tx(const uint256& hash, NTP1Transaction& ntp1tx)
 {
     ntp1tx.setNull();
-    return Read(hash, ntp1tx, db_ntp1Tx);
+    // records that weren't migrated to the compact format yet are still read correctly
+    return Read(hash, ntp1tx, db_ntp1Tx, SER_NTP1_COMPACT);
 }
 
 bool CTxDB::ReadNTP1TxsWithTokenSymbol(const std::string& tokenName, std::vector<uint256>& txs)
@@ -797,7 +964,117 @@ bool CTxDB::WriteAddressPubKey(const CBitcoinAddress& address, const std::vector
 
 bool CTxDB::WriteNTP1Tx(const uint256& hash, const NTP1Transaction& ntp1tx)
 {
-    return Write(hash, ntp1tx, db_ntp1Tx);
+    return Write(hash, ntp1tx, db_ntp1Tx, SER_NTP1_COMPACT);
+}
+
+bool CTxDB::MigrateNTP1TxDbToCompactFormat()
+{
+    int nFormat = 1;
+    if (Exists(NTP1TX_DB_FORMAT_KEY, db_main) && !Read(NTP1TX_DB_FORMAT_KEY, nFormat, db_main)) {
+        return error("MigrateNTP1TxDbToCompactFormat(): failed to read the NTP1 db format version");
+    }
+    if (nFormat >= NTP1TX_DB_FORMAT_VERSION) {
+        return true;
+    }
+
+    printf("Migrating the NTP1 transactions database to the compact format...\n");
+    uiInterface.InitMessage(_("Migrating NTP1 transactions database..."));
+    const int64_t nStart = GetTimeMillis();
+
+    // records are converted in chunks, each committed in its own db transaction, to keep memory use
+    // bounded; the cursor of every chunk continues after the last key of the previous one
+    static const std::size_t MIGRATION_CHUNK_SIZE = 10000;
+    std::string              lastKey;
+    uint64_t                 nMigrated = 0;
+    std::vector<std::string> keys;
+    std::vector<CDataStream> values;
+    while (true) {
+        keys.clear();
+        values.clear();
+        std::size_t nChunkBytes = 0;
+        {
+            mdb_txn_safe localTxn;
+            if (auto res = lmdb_txn_begin(dbEnv.get(), nullptr, MDB_RDONLY, localTxn)) {
+                return error("MigrateNTP1TxDbToCompactFormat(): Failed to begin transaction with error "
+                             "code %i; and error: %s\n",
+                             res, mdb_strerror(res));
+            }
+            MDB_cursor* cursorRawPtr = nullptr;
+            if (auto rc = mdb_cursor_open(localTxn, *db_ntp1Tx, &cursorRawPtr)) {
+                return error("MigrateNTP1TxDbToCompactFormat(): Failed to open lmdb cursor with error "
+                             "code %d; and error: %s\n",
+                             rc, mdb_strerror(rc));
+            }
+            std::unique_ptr<MDB_cursor, void (*)(MDB_cursor*)> cursorPtr(
+                cursorRawPtr, [](MDB_cursor* p) {
+                    if (p)
+                        mdb_cursor_close(p);
+                });
+
+            MDB_val kS      = {lastKey.size(), (void*)lastKey.data()};
+            MDB_val vS      = {0, nullptr};
+            int     itemRes = mdb_cursor_get(cursorPtr.get(), &kS, &vS,
+                                             lastKey.empty() ? MDB_FIRST : MDB_SET_RANGE);
+            if (itemRes == 0 && !lastKey.empty() &&
+                std::string(static_cast<const char*>(kS.mv_data), kS.mv_size) == lastKey) {
+                itemRes = mdb_cursor_get(cursorPtr.get(), &kS, &vS, MDB_NEXT);
+            }
+            while (itemRes == 0 && keys.size() < MIGRATION_CHUNK_SIZE) {
+                keys.push_back(std::string(static_cast<const char*>(kS.mv_data), kS.mv_size));
+                try {
+                    NTP1Transaction ntp1tx;
+                    CDataStreamView ssValue(static_cast<const char*>(vS.mv_data),
+                                            static_cast<const char*>(vS.mv_data) + vS.mv_size,
+                                            SER_DISK | SER_NTP1_COMPACT, CLIENT_VERSION);
+                    ssValue >> ntp1tx;
+                    values.push_back(CDataStream(SER_DISK | SER_NTP1_COMPACT, CLIENT_VERSION));
+                    values.back() << ntp1tx;
+                    nChunkBytes += kS.mv_size + values.back().size();
+                } catch (std::exception& ex) {
+                    return error("MigrateNTP1TxDbToCompactFormat(): Failed to deserialize NTP1 "
+                                 "transaction record: %s\n",
+                                 ex.what());
+                }
+                itemRes = mdb_cursor_get(cursorPtr.get(), &kS, &vS, MDB_NEXT);
+            }
+            if (itemRes != 0 && itemRes != MDB_NOTFOUND) {
+                return error("MigrateNTP1TxDbToCompactFormat(): Failed to iterate the NTP1 db with "
+                             "error code %i; and error: %s\n",
+                             itemRes, mdb_strerror(itemRes));
+            }
+        }
+
+        if (keys.empty()) {
+            break;
+        }
+
+        // the values are replaced with (smaller) compact ones, but the size is reserved conservatively
+        if (!TxnBegin(nChunkBytes * 2) || !activeBatch) {
+            return error("MigrateNTP1TxDbToCompactFormat(): Failed to begin write transaction\n");
+        }
+        for (unsigned i = 0; i < keys.size(); i++) {
+            MDB_val kS = {keys[i].size(), (void*)keys[i].data()};
+            MDB_val vS = {values[i].size(), (void*)&values[i][0]};
+            if (auto ret = mdb_put(*activeBatch, *db_ntp1Tx, &kS, &vS, 0)) {
+                TxnAbort();
+                return error("MigrateNTP1TxDbToCompactFormat(): Failed to write migrated record with "
+                             "error code %i; and error: %s\n",
+                             ret, mdb_strerror(ret));
+            }
+        }
+        TxnCommit();
+
+        nMigrated += keys.size();
+        lastKey = keys.back();
+        printf("Migrated %" PRIu64 " NTP1 transactions\n", nMigrated);
+    }
+
+    if (!Write(NTP1TX_DB_FORMAT_KEY, NTP1TX_DB_FORMAT_VERSION, db_main)) {
+        return error("MigrateNTP1TxDbToCompactFormat(): failed to write the NTP1 db format version");
+    }
+    printf("Migrated %" PRIu64 " NTP1 transactions to the compact format in %" PRId64 "ms\n",
+           nMigrated, GetTimeMillis() - nStart);
+    return true;
 }
 
 bool CTxDB::ReadAllIssuanceTxs(std::vector<uint256>& txs)
@@ -819,9 +1096,91 @@ bool CTxDB::WriteBlock(const uint256& hash, const CBlock& blk)
     return Write(hash, blk, db_blocks);
 }
 
-bool CTxDB::EraseTxIndex(const uint256& hash) { return Erase(hash, db_tx); }
+uint64_t CTxDB::GetBlocksDbSize()
+{
+    mdb_txn_safe localTxn(false);
+    if (!activeBatch) {
+        localTxn = mdb_txn_safe();
+        if (auto res = lmdb_txn_begin(dbEnv.get(), nullptr, MDB_RDONLY, localTxn)) {
+            printf("Failed to begin transaction at read with error code %i; and error code: %s\n", res,
+                   mdb_strerror(res));
+            return 0;
+        }
+    }
+    BOOST_SCOPE_EXIT(&localTxn) { localTxn.abortIfValid(); }
+    BOOST_SCOPE_EXIT_END
 
-bool CTxDB::ContainsTx(const uint256& hash) { return Exists(hash, db_tx); }
+    MDB_stat mst;
+    if (auto rc = mdb_stat((!activeBatch ? localTxn : *activeBatch), *db_blocks, &mst)) {
+        printf("Failed to get the stats of the blocks db with error code %i; and error: %s\n", rc,
+               mdb_strerror(rc));
+        return 0;
+    }
+    return static_cast<uint64_t>(mst.ms_psize) *
+           (mst.ms_branch_pages + mst.ms_leaf_pages + mst.ms_overflow_pages);
+}
+
+bool CTxDB::ContainsBlock(const uint256& hash) { return Exists(hash, db_blocks); }
+
+bool CTxDB::PruneBlocks(const std::vector<uint256>& hashes)
+{
+    if (hashes.empty()) {
+        return true;
+    }
+    if (!TxnBegin() || !activeBatch) {
+        return error("PruneBlocks(): Failed to begin write transaction");
+    }
+    for (const uint256& hash : hashes) {
+        if (!Erase(hash, db_blocks)) {
+            TxnAbort();
+            return error("PruneBlocks(): Failed to erase block %s", hash.ToString().c_str());
+        }
+    }
+    if (!Write(PRUNED_BLOCKS_KEY, 1, db_main)) {
+        TxnAbort();
+        return error("PruneBlocks(): Failed to write the pruned blocks flag");
+    }
+    return TxnCommit();
+}
+
+bool CTxDB::HavePrunedBlocks() { return Exists(PRUNED_BLOCKS_KEY, db_main); }
+
+bool CTxDB::ReadPruneScanHeight(int& nHeight)
+{
+    nHeight = 0;
+    if (!Exists(PRUNE_SCAN_HEIGHT_KEY, db_main)) {
+        return true;
+    }
+    return Read(PRUNE_SCAN_HEIGHT_KEY, nHeight, db_main);
+}
+
+bool CTxDB::WritePruneScanHeight(int nHeight) { return Write(PRUNE_SCAN_HEIGHT_KEY, nHeight, db_main); }
+
+bool CTxDB::EraseTxIndex(const uint256& hash)
+{
+    if (fReadOnly) {
+        printf("Accessing lmdb erase function in read-only mode.");
+        return false;
+    }
+    CTxDBChanges changes;
+    changes.EraseTxIndex(hash);
+    CommitCacheChanges(std::move(changes));
+    return true;
+}
+
+bool CTxDB::ContainsTx(const uint256& hash)
+{
+    CTxIndex txindex;
+    switch (LookupCachedTxIndex(hash, txindex)) {
+    case CTxDBChanges::Lookup::Found:
+        return true;
+    case CTxDBChanges::Lookup::Erased:
+        return false;
+    case CTxDBChanges::Lookup::Unknown:
+        break;
+    }
+    return Exists(hash, db_tx);
+}
 
 bool CTxDB::ContainsNTP1Tx(const uint256& hash) { return Exists(hash, db_ntp1Tx); }
 
@@ -850,19 +1209,634 @@ bool CTxDB::ReadDiskTx(const COutPoint& outpoint, CTransaction& tx)
     return ReadDiskTx(outpoint.hash, tx, txindex);
 }
 
+bool CTxDB::ReadDiskTxMany(const std::vector<uint256>&                  hashes,
+                           std::vector<boost::optional<CTxIndex>>&     txindexes,
+                           std::vector<boost::optional<CTransaction>>& txs)
+{
+    txs.clear();
+    txs.resize(hashes.size());
+
+    // both the tx indices and the transactions are read in the same transaction
+    mdb_txn_safe localTxn(false);
+    if (!activeBatch) {
+        localTxn = mdb_txn_safe();
+        if (auto res = lmdb_txn_begin(dbEnv.get(), nullptr, MDB_RDONLY, localTxn)) {
+            return error("ReadDiskTxMany: Failed to begin transaction with error code %i; and error: %s\n",
+                         res, mdb_strerror(res));
+        }
+    }
+    MDB_txn* txn = (!activeBatch ? localTxn : *activeBatch);
+
+    BOOST_SCOPE_EXIT(&localTxn) { localTxn.abortIfValid(); }
+    BOOST_SCOPE_EXIT_END
+
+    std::vector<uint256>     missingHashes;
+    std::vector<std::size_t> missingPositions;
+    LookupCachedTxIndexMany(hashes, txindexes, missingHashes, missingPositions);
+    std::vector<boost::optional<CTxIndex>> readTxIndexes;
+    if (!ReadBatchInTxn(txn, missingHashes, readTxIndexes, db_tx)) {
+        return false;
+    }
+    for (unsigned i = 0; i < readTxIndexes.size(); i++) {
+        txindexes[missingPositions[i]] = std::move(readTxIndexes[i]);
+    }
+
+    // only the transactions with a tx index can be read
+    std::vector<CDiskTxPos> txPositions;
+    std::vector<unsigned>   txPositionsIndices;
+    for (unsigned i = 0; i < txindexes.size(); i++) {
+        if (txindexes[i]) {
+            txPositions.push_back(txindexes[i]->pos);
+            txPositionsIndices.push_back(i);
+        }
+    }
+
+    std::vector<uint256>                       blockKeys;
+    std::vector<size_t>                        offsets;
+    std::vector<boost::optional<CTransaction>> foundTxs;
+    SplitTxPositions(txPositions, blockKeys, offsets);
+    if (!ReadBatchInTxn(txn, blockKeys, foundTxs, db_blocks, 0, offsets)) {
+        return false;
+    }
+    for (unsigned i = 0; i < foundTxs.size(); i++) {
+        txs[txPositionsIndices[i]] = std::move(foundTxs[i]);
+    }
+    return true;
+}
+
 bool CTxDB::WriteBlockIndex(const CDiskBlockIndex& blockindex)
 {
-    return Write(blockindex.GetBlockHash(), blockindex, db_blockIndex);
+    if (fReadOnly) {
+        printf("Accessing lmdb write function in read only mode");
+        return false;
+    }
+    // block index entries go through the cache so that the hashNext links in the db always match
+    // the best chain hash written with them
+    CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+    ssValue << blockindex << CDiskBlockIndexTrust(blockindex);
+    CTxDBChanges changes;
+    changes.SetBlockIndex(blockindex.GetBlockHash(), ssValue.str());
+    CommitCacheChanges(std::move(changes));
+    return true;
 }
 
 bool CTxDB::ReadHashBestChain(uint256& hashBestChain)
 {
+    const boost::optional<uint256>& batchHash = batchChanges.GetHashBestChain();
+    if (batchHash) {
+        hashBestChain = *batchHash;
+        return true;
+    }
+    const boost::optional<uint256> cachedHash = TxDBCache().GetHashBestChain();
+    if (cachedHash) {
+        hashBestChain = *cachedHash;
+        return true;
+    }
     return Read(string("hashBestChain"), hashBestChain, db_main);
 }
 
 bool CTxDB::WriteHashBestChain(const uint256& hashBestChain)
 {
-    return Write(string("hashBestChain"), hashBestChain, db_main);
+    if (fReadOnly) {
+        printf("Accessing lmdb write function in read only mode");
+        return false;
+    }
+    CTxDBChanges changes;
+    changes.SetHashBestChain(hashBestChain);
+    CommitCacheChanges(std::move(changes));
+    return true;
+}
+
+// writes records in the order of their keys; none marks a deleted record
+static bool WriteRecordsInTxn(MDB_txn* txn, MDB_dbi* dbPtr,
+                              const std::map<std::string, boost::optional<std::string>>& records)
+{
+    for (const auto& record : records) {
+        MDB_val kS = {record.first.size(), (void*)record.first.data()};
+        int     ret;
+        if (record.second) {
+            MDB_val vS = {record.second->size(), (void*)record.second->data()};
+            ret        = mdb_put(txn, *dbPtr, &kS, &vS, 0);
+        } else {
+            ret = mdb_del(txn, *dbPtr, &kS, nullptr);
+            ret = (ret == MDB_NOTFOUND ? 0 : ret);
+        }
+        if (ret) {
+            return error("WriteRecordsInTxn(): Failed to write a record with error code %i; and "
+                         "error: %s\n",
+                         ret, mdb_strerror(ret));
+        }
+    }
+    return true;
+}
+
+bool CTxDB::WriteIndexRecords(const CTxDBChanges& changes)
+{
+    assert(activeBatch);
+    return WriteRecordsInTxn(*activeBatch, db_addressIndex, changes.GetAddressIndexRecords()) &&
+           WriteRecordsInTxn(*activeBatch, db_addressUnspent, changes.GetAddressUnspentRecords()) &&
+           WriteRecordsInTxn(*activeBatch, db_ntp1Index, changes.GetNTP1IndexRecords());
+}
+
+bool CTxDB::WriteCacheChanges(const CTxDBChanges& changes)
+{
+    assert(activeBatch);
+
+    // records are written in the order of their serialized keys, which is the order lmdb keeps them
+    // in, so that neighbouring records are written together
+    typedef std::pair<std::string, const std::string*> SortedRecord;
+
+    std::vector<SortedRecord> records;
+    // serialized tx indexes; a deque, as records point into it
+    std::deque<std::string> values;
+
+    auto serializedKey = [](const uint256& hash) {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey << hash;
+        return ssKey.str();
+    };
+    auto writeSorted = [&](MDB_dbi* dbPtr) {
+        std::sort(records.begin(), records.end(),
+                  [](const SortedRecord& a, const SortedRecord& b) { return a.first < b.first; });
+        for (const SortedRecord& record : records) {
+            MDB_val kS = {record.first.size(), (void*)record.first.data()};
+            int     ret;
+            if (record.second) {
+                MDB_val vS = {record.second->size(), (void*)record.second->data()};
+                ret        = mdb_put(*activeBatch, *dbPtr, &kS, &vS, 0);
+            } else {
+                ret = mdb_del(*activeBatch, *dbPtr, &kS, nullptr);
+                ret = (ret == MDB_NOTFOUND ? 0 : ret);
+            }
+            if (ret) {
+                return error("WriteCacheChanges(): Failed to write a cached record with error code "
+                             "%i; and error: %s\n",
+                             ret, mdb_strerror(ret));
+            }
+        }
+        return true;
+    };
+
+    for (const CTxDBChanges::TxIndexMap::value_type& item : changes.GetTxIndexes()) {
+        if (item.second) {
+            CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+            ssValue << *item.second;
+            values.push_back(ssValue.str());
+            records.push_back(SortedRecord(serializedKey(item.first), &values.back()));
+        } else {
+            records.push_back(SortedRecord(serializedKey(item.first), nullptr));
+        }
+    }
+    if (!writeSorted(db_tx)) {
+        return false;
+    }
+
+    records.clear();
+    for (const CTxDBChanges::BlockIndexMap::value_type& item : changes.GetBlockIndexes()) {
+        records.push_back(SortedRecord(serializedKey(item.first), &item.second));
+    }
+    if (!writeSorted(db_blockIndex)) {
+        return false;
+    }
+
+    if (!WriteIndexRecords(changes)) {
+        return false;
+    }
+
+    if (changes.GetHashBestChain() &&
+        !Write(string("hashBestChain"), *changes.GetHashBestChain(), db_main)) {
+        return false;
+    }
+    return true;
+}
+
+bool CTxDB::FlushCache(bool fForce)
+{
+    CTxDBCache& cache = TxDBCache();
+    if (!fForce && !cache.ShouldFlush(GetTime(), DB_CACHE_FLUSH_INTERVAL)) {
+        return true;
+    }
+    assert(!activeBatch);
+
+    const int64_t     nStart       = GetTimeMillis();
+    const std::size_t nCacheMemory = cache.GetMemoryUsage();
+
+    // the write transaction is started before the cache is locked, in the same order committing a
+    // batch takes them
+    if (!TxnBegin(nCacheMemory) || !activeBatch) {
+        return error("FlushCache(): Failed to begin write transaction");
+    }
+    std::size_t nRecords = 0;
+    const bool  fFlushed = cache.Flush([&](const CTxDBChanges& changes) {
+        if (changes.IsEmpty()) {
+            TxnAbort();
+            return true;
+        }
+        if (!WriteCacheChanges(changes)) {
+            TxnAbort();
+            return false;
+        }
+        try {
+            activeBatch->commit("Failed to flush the tx db cache");
+        } catch (std::exception& ex) {
+            activeBatch.reset();
+            return error("FlushCache(): %s", ex.what());
+        }
+        activeBatch.reset();
+        nRecords = changes.GetTxIndexes().size() + changes.GetBlockIndexes().size();
+        return true;
+    });
+    if (fFlushed && nRecords > 0) {
+        printf("Flushed %" PRIszu " records (%" PRIszu " kB) of the tx db cache in %" PRId64 "ms\n",
+               nRecords, nCacheMemory / 1024, GetTimeMillis() - nStart);
+    }
+    return fFlushed;
+}
+
+void CTxDB::AddAddressIndexChanges(CTxDBChanges&& changes)
+{
+    if (fReadOnly) {
+        printf("Accessing lmdb write function in read only mode");
+        return;
+    }
+    CommitCacheChanges(std::move(changes));
+}
+
+// reads the records from startKey on that start with prefix, until fn returns false
+static bool ReadRecordsWithPrefix(MDB_txn* txn, MDB_dbi* dbPtr, const std::string& prefix,
+                                  const std::string&                                    startKey,
+                                  const std::function<bool(const MDB_val&, const MDB_val&)>& fn)
+{
+    MDB_cursor* cursorRawPtr = nullptr;
+    if (auto rc = mdb_cursor_open(txn, *dbPtr, &cursorRawPtr)) {
+        return error("ReadRecordsWithPrefix(): Failed to open lmdb cursor with error code %d; and "
+                     "error: %s\n",
+                     rc, mdb_strerror(rc));
+    }
+    std::unique_ptr<MDB_cursor, void (*)(MDB_cursor*)> cursorPtr(cursorRawPtr, [](MDB_cursor* p) {
+        if (p)
+            mdb_cursor_close(p);
+    });
+
+    MDB_val kS      = {startKey.size(), (void*)startKey.data()};
+    MDB_val vS      = {0, nullptr};
+    int     itemRes = mdb_cursor_get(cursorPtr.get(), &kS, &vS, MDB_SET_RANGE);
+    while (itemRes == 0 && kS.mv_size >= prefix.size() &&
+           std::memcmp(kS.mv_data, prefix.data(), prefix.size()) == 0) {
+        if (!fn(kS, vS)) {
+            break;
+        }
+        itemRes = mdb_cursor_get(cursorPtr.get(), &kS, &vS, MDB_NEXT);
+    }
+    if (itemRes != 0 && itemRes != MDB_NOTFOUND) {
+        return error("ReadRecordsWithPrefix(): Failed to iterate the db with error code %i; and error: "
+                     "%s\n",
+                     itemRes, mdb_strerror(itemRes));
+    }
+    return true;
+}
+
+bool CTxDB::ReadIndexRecords(MDB_dbi* dbPtr, CTxDBChanges::RecordMapGetter getRecords,
+                             const std::string& prefix, const std::string& startKey,
+                             const std::function<bool(const MDB_val&, const MDB_val&)>& fn)
+{
+    // The records of the latest blocks may still be in the tx db cache. They're taken together with
+    // a read transaction that sees the db as it was before the next flush, which writes them.
+    CTxDBChanges::RecordMap cached;
+    mdb_txn_safe            localTxn(false);
+    BOOST_SCOPE_EXIT(&localTxn) { localTxn.abortIfValid(); }
+    BOOST_SCOPE_EXIT_END
+    for (;;) {
+        cached.clear();
+        const uint64_t nFlushCount =
+            TxDBCache().GetRecordsWithPrefix(getRecords, prefix, startKey, cached);
+        if (activeBatch) {
+            // nothing is flushed while this batch is open, and its changes come after the cache's
+            batchChanges.GetRecordsWithPrefix(getRecords, prefix, startKey, cached);
+            break;
+        }
+        localTxn = mdb_txn_safe();
+        if (auto res = lmdb_txn_begin(dbEnv.get(), nullptr, MDB_RDONLY, localTxn)) {
+            return error("ReadIndexRecords(): Failed to begin transaction with error code %i; and "
+                         "error: %s\n",
+                         res, mdb_strerror(res));
+        }
+        if (TxDBCache().GetFlushCount() == nFlushCount) {
+            break;
+        }
+        localTxn.abortIfValid();
+    }
+
+    // a cached record replaces the one of the same key in the db, and an erased one hides it
+    CTxDBChanges::RecordMap::const_iterator itCached  = cached.begin();
+    bool                                    fContinue = true;
+    auto passCached = [&](const CTxDBChanges::RecordMap::value_type& record) {
+        if (record.second) {
+            MDB_val kS = {record.first.size(), (void*)record.first.data()};
+            MDB_val vS = {record.second->size(), (void*)record.second->data()};
+            fContinue  = fn(kS, vS);
+        }
+        return fContinue;
+    };
+    auto mergedFn = [&](const MDB_val& kS, const MDB_val& vS) {
+        const std::string key(static_cast<const char*>(kS.mv_data), kS.mv_size);
+        for (; itCached != cached.end() && itCached->first < key; ++itCached) {
+            if (!passCached(*itCached)) {
+                return false;
+            }
+        }
+        if (itCached != cached.end() && itCached->first == key) {
+            return passCached(*itCached++);
+        }
+        fContinue = fn(kS, vS);
+        return fContinue;
+    };
+
+    try {
+        MDB_txn* txn = (!activeBatch ? localTxn : *activeBatch);
+        if (cached.empty()) {
+            return ReadRecordsWithPrefix(txn, dbPtr, prefix, startKey, fn);
+        }
+        if (!ReadRecordsWithPrefix(txn, dbPtr, prefix, startKey, mergedFn)) {
+            return false;
+        }
+        // the cached records past the last one of the db
+        for (; fContinue && itCached != cached.end(); ++itCached) {
+            passCached(*itCached);
+        }
+        return true;
+    } catch (std::exception& ex) {
+        return error("ReadIndexRecords(): Failed to deserialize an index record: %s", ex.what());
+    }
+}
+
+template <typename K, typename V>
+static void UnserializeRecord(const MDB_val& kS, const MDB_val& vS, K& key, V& value)
+{
+    CDataStreamView ssKey(static_cast<const char*>(kS.mv_data),
+                          static_cast<const char*>(kS.mv_data) + kS.mv_size, SER_DISK, CLIENT_VERSION);
+    CDataStreamView ssValue(static_cast<const char*>(vS.mv_data),
+                            static_cast<const char*>(vS.mv_data) + vS.mv_size, SER_DISK, CLIENT_VERSION);
+    ssKey >> key;
+    ssValue >> value;
+}
+
+bool CTxDB::ReadAddressIndex(const CIndexedAddress& address, unsigned int nStart, unsigned int nEnd,
+                             std::vector<std::pair<CAddressIndexKey, CAmount>>& records)
+{
+    records.clear();
+
+    CDataStream ssPrefix(SER_DISK, CLIENT_VERSION);
+    ssPrefix << address;
+    const std::string prefix = ssPrefix.str();
+    SerializeBigEndian32(ssPrefix, nStart);
+
+    return ReadIndexRecords(db_addressIndex, &CTxDBChanges::GetAddressIndexRecords, prefix,
+                            ssPrefix.str(), [&](const MDB_val& kS, const MDB_val& vS) {
+                                CAddressIndexKey key;
+                                CAmount          nDelta = 0;
+                                UnserializeRecord(kS, vS, key, nDelta);
+                                if (key.nHeight > nEnd) {
+                                    return false;
+                                }
+                                records.push_back(std::make_pair(key, nDelta));
+                                return true;
+                            });
+}
+
+bool CTxDB::ReadAddressUnspentIndex(
+    const CIndexedAddress&                                            address,
+    std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& records)
+{
+    records.clear();
+
+    CDataStream ssPrefix(SER_DISK, CLIENT_VERSION);
+    ssPrefix << address;
+
+    return ReadIndexRecords(db_addressUnspent, &CTxDBChanges::GetAddressUnspentRecords,
+                            ssPrefix.str(), ssPrefix.str(), [&](const MDB_val& kS, const MDB_val& vS) {
+                                CAddressUnspentKey   key;
+                                CAddressUnspentValue value;
+                                UnserializeRecord(kS, vS, key, value);
+                                records.push_back(std::make_pair(key, value));
+                                return true;
+                            });
+}
+
+bool CTxDB::SyncIndex(const std::string& name, const std::string& flagKey,
+                      const std::vector<MDB_dbi*>& dbs, bool fEnabled,
+                      const std::function<bool(const CBlock&, int, CTxDBChanges&)>& addBlockChanges)
+{
+    const bool fBuilt = Exists(flagKey, db_main);
+    if (fBuilt == fEnabled) {
+        return true;
+    }
+
+    if (fEnabled && HavePrunedBlocks()) {
+        return error("SyncIndex(): The %s can't be built, because blocks were pruned", name.c_str());
+    }
+
+    if (!FlushCache(true)) {
+        return error("SyncIndex(): Failed to flush the tx db cache");
+    }
+    // either way, the index is emptied first; it's either not wanted anymore, or it's left from an
+    // attempt to build it that didn't finish
+    if (!TxnBegin() || !activeBatch) {
+        return error("SyncIndex(): Failed to begin write transaction");
+    }
+    for (MDB_dbi* dbPtr : dbs) {
+        if (auto ret = mdb_drop(*activeBatch, *dbPtr, 0)) {
+            TxnAbort();
+            return error("SyncIndex(): Failed to empty the %s with error code %i; and error: %s\n",
+                         name.c_str(), ret, mdb_strerror(ret));
+        }
+    }
+    if (fBuilt && !Erase(flagKey, db_main)) {
+        TxnAbort();
+        return error("SyncIndex(): Failed to erase the %s flag", name.c_str());
+    }
+    if (!TxnCommit()) {
+        return error("SyncIndex(): Failed to commit the emptied %s", name.c_str());
+    }
+    if (!fEnabled) {
+        printf("Dropped the %s, as it's disabled\n", name.c_str());
+        return true;
+    }
+
+    printf("Building the %s from the blocks of the main chain...\n", name.c_str());
+    const std::string message = strprintf(_("Building %s..."), name.c_str());
+    uiInterface.InitMessage(message);
+    const int64_t nStart = GetTimeMillis();
+
+    // blocks are read in chunks, and the changes of every chunk are written in a db transaction of
+    // their own; the genesis block is never connected, so its outputs aren't indexed
+    static const int BUILD_CHUNK_BLOCKS = 1000;
+    const int        nBestHeight        = activeChain.Height();
+    for (int nChunkStart = 1; nChunkStart <= nBestHeight; nChunkStart += BUILD_CHUNK_BLOCKS) {
+        const int    nChunkEnd = std::min(nChunkStart + BUILD_CHUNK_BLOCKS - 1, nBestHeight);
+        CTxDBChanges changes;
+        for (int nHeight = nChunkStart; nHeight <= nChunkEnd; nHeight++) {
+            const CBlockIndexSmartPtr pindex = activeChain.AtHeight(nHeight);
+            CBlock                    block;
+            if (!pindex || !block.ReadFromDisk(pindex.get(), *this)) {
+                return error("SyncIndex(): Failed to read the block at height %i", nHeight);
+            }
+            if (!addBlockChanges(block, nHeight, changes)) {
+                return error("SyncIndex(): Failed to index the block at height %i", nHeight);
+            }
+        }
+
+        if (!TxnBegin(changes.GetMemoryUsage() * 2) || !activeBatch) {
+            return error("SyncIndex(): Failed to begin write transaction");
+        }
+        if (!WriteIndexRecords(changes)) {
+            TxnAbort();
+            return false;
+        }
+        if (!TxnCommit()) {
+            return error("SyncIndex(): Failed to commit the %s of blocks %i to %i", name.c_str(),
+                         nChunkStart, nChunkEnd);
+        }
+
+        printf("Built the %s up to height %i of %i\n", name.c_str(), nChunkEnd, nBestHeight);
+        uiInterface.InitMessage(message + " " +
+                                std::to_string(nChunkEnd * 100 / std::max(nBestHeight, 1)) + "%");
+    }
+
+    if (!Write(flagKey, 1, db_main)) {
+        return error("SyncIndex(): Failed to write the %s flag", name.c_str());
+    }
+    printf("Built the %s of %i blocks in %" PRId64 "ms\n", name.c_str(), nBestHeight,
+           GetTimeMillis() - nStart);
+    return true;
+}
+
+bool CTxDB::SyncAddressIndex(bool fEnabled)
+{
+    return SyncIndex("address index", ADDRESS_INDEX_KEY, {db_addressIndex, db_addressUnspent}, fEnabled,
+                     [this](const CBlock& block, int nHeight, CTxDBChanges& changes) {
+                         std::map<COutPoint, CSpentOutput> spentOutputs;
+                         if (!ReadSpentOutputs(*this, block.vtx, spentOutputs)) {
+                             return false;
+                         }
+                         ::AddAddressIndexChanges(block.vtx, nHeight, spentOutputs, true, changes);
+                         return true;
+                     });
+}
+
+bool CTxDB::SyncNTP1Index(bool fEnabled)
+{
+    // the NTP1 data of the transactions of the main chain is always in the db, as it's written when
+    // their blocks are connected
+    return SyncIndex("NTP1 index", NTP1_INDEX_KEY, {db_ntp1Index}, fEnabled,
+                     [this](const CBlock& block, int nHeight, CTxDBChanges& changes) {
+                         std::map<uint256, NTP1Transaction> ntp1txs;
+                         if (!ReadNTP1IndexTxs(*this, block.vtx, ntp1txs)) {
+                             return false;
+                         }
+                         return ::AddNTP1IndexChanges(*this, block.vtx, nHeight, ntp1txs, true,
+                                                      changes);
+                     });
+}
+
+void CTxDB::AddNTP1IndexChanges(CTxDBChanges&& changes)
+{
+    if (fReadOnly) {
+        printf("Accessing lmdb write function in read only mode");
+        return;
+    }
+    CommitCacheChanges(std::move(changes));
+}
+
+bool CTxDB::ReadNTP1TokenIndexEntry(const std::string&                     tokenId,
+                                    boost::optional<CNTP1TokenIndexEntry>& entry)
+{
+    entry = boost::none;
+
+    // the prefix of an issuance record is its whole key, but the keys of the outputs of the token
+    // start with other bytes
+    const std::string key = NTP1TokenIndexKey(tokenId);
+    return ReadIndexRecords(db_ntp1Index, &CTxDBChanges::GetNTP1IndexRecords, key, key,
+                            [&](const MDB_val& kS, const MDB_val& vS) {
+                                if (kS.mv_size == key.size()) {
+                                    CDataStreamView ssValue(
+                                        static_cast<const char*>(vS.mv_data),
+                                        static_cast<const char*>(vS.mv_data) + vS.mv_size, SER_DISK,
+                                        CLIENT_VERSION);
+                                    entry = CNTP1TokenIndexEntry();
+                                    ssValue >> *entry;
+                                }
+                                return false;
+                            });
+}
+
+bool CTxDB::ReadNTP1TokenStats(const std::string& tokenId, CNTP1TokenStats& stats)
+{
+    stats = CNTP1TokenStats();
+
+    const std::string key = NTP1TokenStatsKey(tokenId);
+    return ReadIndexRecords(db_ntp1Index, &CTxDBChanges::GetNTP1IndexRecords, key, key,
+                            [&](const MDB_val& kS, const MDB_val& vS) {
+                                if (kS.mv_size == key.size()) {
+                                    CDataStreamView ssValue(
+                                        static_cast<const char*>(vS.mv_data),
+                                        static_cast<const char*>(vS.mv_data) + vS.mv_size, SER_DISK,
+                                        CLIENT_VERSION);
+                                    ssValue >> stats;
+                                }
+                                return false;
+                            });
+}
+
+bool CTxDB::ReadNTP1TokenHolders(const std::string&                                tokenId,
+                                 std::vector<std::pair<CIndexedAddress, NTP1Int>>& holders)
+{
+    holders.clear();
+
+    CDataStream ssPrefix(SER_DISK, CLIENT_VERSION);
+    ssPrefix << static_cast<uint8_t>(NTP1_INDEX_TOKEN_HOLDER) << tokenId;
+
+    return ReadIndexRecords(db_ntp1Index, &CTxDBChanges::GetNTP1IndexRecords, ssPrefix.str(),
+                            ssPrefix.str(), [&](const MDB_val& kS, const MDB_val& vS) {
+                                CNTP1BalanceKey key;
+                                NTP1Int         nBalance = 0;
+                                UnserializeRecord(kS, vS, key, nBalance);
+                                holders.push_back(std::make_pair(key.address, nBalance));
+                                return true;
+                            });
+}
+
+bool CTxDB::ReadNTP1AddressBalances(const CIndexedAddress&                        address,
+                                    std::vector<std::pair<std::string, NTP1Int>>& balances)
+{
+    balances.clear();
+
+    CDataStream ssPrefix(SER_DISK, CLIENT_VERSION);
+    ssPrefix << static_cast<uint8_t>(NTP1_INDEX_ADDRESS_TOKEN) << address;
+
+    return ReadIndexRecords(db_ntp1Index, &CTxDBChanges::GetNTP1IndexRecords, ssPrefix.str(),
+                            ssPrefix.str(), [&](const MDB_val& kS, const MDB_val& vS) {
+                                CNTP1BalanceKey key;
+                                NTP1Int         nBalance = 0;
+                                UnserializeRecord(kS, vS, key, nBalance);
+                                balances.push_back(std::make_pair(key.tokenId, nBalance));
+                                return true;
+                            });
+}
+
+bool CTxDB::ReadNTP1IndexRecord(const std::string& key, boost::optional<std::string>& value)
+{
+    value = boost::none;
+
+    // the first record the key is a prefix of is its own, if it has one
+    return ReadIndexRecords(db_ntp1Index, &CTxDBChanges::GetNTP1IndexRecords, key, key,
+                            [&](const MDB_val& kS, const MDB_val& vS) {
+                                if (kS.mv_size == key.size()) {
+                                    value = std::string(static_cast<const char*>(vS.mv_data),
+                                                        vS.mv_size);
+                                }
+                                return false;
+                            });
 }
 
 bool CTxDB::ReadBestInvalidTrust(CBigNum& bnBestInvalidTrust)
@@ -875,6 +1849,33 @@ bool CTxDB::WriteBestInvalidTrust(const CBigNum& bnBestInvalidTrust)
     return Write(string("bnBestInvalidTrust"), bnBestInvalidTrust, db_main);
 }
 
+bool CTxDB::ReadBlockIndexTrustHeight(int& nHeight)
+{
+    return Read(string("blockIndexTrustHeight"), nHeight, db_main);
+}
+
+bool CTxDB::WriteBlockIndexTrustHeight(int nHeight)
+{
+    return Write(string("blockIndexTrustHeight"), nHeight, db_main);
+}
+
+bool CTxDB::WriteBlockIndexTrustMany(const std::vector<CBlockIndex*>& vIndexes)
+{
+    for (CBlockIndex* pindex : vIndexes) {
+        CDiskBlockIndex diskindex(pindex);
+        diskindex.SetBlockHash(pindex->GetBlockHash());
+        if (!WriteBlockIndex(diskindex)) {
+            return error("WriteBlockIndexTrustMany(): Failed to write block index at height %d",
+                         pindex->nHeight);
+        }
+        // the entries go through the tx db cache, which is written out whenever it's full
+        if (!FlushCache(false)) {
+            return false;
+        }
+    }
+    return FlushCache(true);
+}
+
 static CBlockIndexSmartPtr InsertBlockIndex(const uint256& hash)
 {
     if (hash == 0)
@@ -886,7 +1887,7 @@ static CBlockIndexSmartPtr InsertBlockIndex(const uint256& hash)
         return mi->second;
 
     // Create new
-    CBlockIndexSmartPtr pindexNew = boost::make_shared<CBlockIndex>();
+    CBlockIndexSmartPtr pindexNew = BlockIndexPool().Make();
     if (!pindexNew)
         throw runtime_error("LoadBlockIndex() : new CBlockIndex failed");
     mi                    = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
@@ -895,11 +1896,60 @@ static CBlockIndexSmartPtr InsertBlockIndex(const uint256& hash)
     return pindexNew;
 }
 
-std::string LmdbValToString(const MDB_val& val)
+CDataStreamView LmdbValToStreamView(const MDB_val& val)
 {
-    return std::string((const char*)val.mv_data, val.mv_size);
+    return CDataStreamView(static_cast<const char*>(val.mv_data),
+                           static_cast<const char*>(val.mv_data) + val.mv_size, SER_DISK,
+                           CLIENT_VERSION);
 }
 
+namespace {
+/** A block index entry unserialized from the db, not linked into mapBlockIndex yet */
+struct LoadedBlockIndexEntry
+{
+    uint256              blockHash;
+    CDiskBlockIndex      diskindex;
+    CDiskBlockIndexTrust trust;
+    bool                 fHasTrust = false;
+};
+
+void UnserializeBlockIndexEntries(const std::vector<std::pair<MDB_val, MDB_val>>& rawEntries,
+                                  std::vector<LoadedBlockIndexEntry>&             entries)
+{
+    entries.clear();
+    entries.resize(rawEntries.size());
+
+    const std::size_t nThreads  = std::max(1u, boost::thread::hardware_concurrency());
+    const std::size_t nPerChunk =
+        std::max<std::size_t>(1000, (rawEntries.size() + nThreads - 1) / nThreads);
+
+    std::vector<std::future<void>> workers;
+    for (std::size_t begin = 0; begin < rawEntries.size(); begin += nPerChunk) {
+        const std::size_t end = std::min(begin + nPerChunk, rawEntries.size());
+        workers.push_back(std::async(std::launch::async, [&rawEntries, &entries, begin, end]() {
+            for (std::size_t i = begin; i < end; i++) {
+                CDataStreamView        ssKey   = LmdbValToStreamView(rawEntries[i].first);
+                CDataStreamView        ssValue = LmdbValToStreamView(rawEntries[i].second);
+                LoadedBlockIndexEntry& entry   = entries[i];
+
+                ssKey >> entry.blockHash;
+                ssValue >> entry.diskindex;
+                entry.diskindex.SetBlockHash(entry.blockHash);
+
+                // entries written by older clients end after the index itself
+                entry.fHasTrust = !ssValue.empty();
+                if (entry.fHasTrust)
+                    ssValue >> entry.trust;
+            }
+        }));
+    }
+    // get() rethrows any unserialization error of the workers
+    for (std::future<void>& worker : workers) {
+        worker.get();
+    }
+}
+} // namespace
+
 bool CTxDB::LoadBlockIndex()
 {
     if (mapBlockIndex.size() > 0) {
@@ -941,81 +1991,82 @@ bool CTxDB::LoadBlockIndex()
                      mdb_strerror(itemRes));
     }
 
-    uint64_t loadedCount = 0;
-
-    // Now read each entry.
-    do {
-        // if the first item is empty, break immediately
-        if (itemRes) {
-            break;
+    // Entries are read in batches; each batch is unserialized in parallel, then linked into
+    // mapBlockIndex by this thread. The raw values point into the memory map and stay valid until
+    // the read transaction is committed.
+    static const std::size_t                 LOAD_BATCH_SIZE = 50000;
+    std::vector<std::pair<MDB_val, MDB_val>> rawEntries;
+    std::vector<LoadedBlockIndexEntry>       entries;
+    std::unordered_set<CBlockIndex*>         setWithoutTrust;
+    uint64_t                                 loadedCount = 0;
+    rawEntries.reserve(LOAD_BATCH_SIZE);
+
+    while (itemRes == 0 && !fRequestShutdown) {
+        rawEntries.clear();
+        while (itemRes == 0 && rawEntries.size() < LOAD_BATCH_SIZE) {
+            rawEntries.push_back(std::make_pair(key, data));
+            itemRes = mdb_cursor_get(cursorRawPtr, &key, &data, MDB_NEXT);
+        }
+        if (itemRes != 0 && itemRes != MDB_NOTFOUND) {
+            return error("Error while reading the block index. Error code %i, and error: %s\n",
+                         itemRes, mdb_strerror(itemRes));
         }
 
-        std::string keyStr = LmdbValToString(key);
-        std::string valStr = LmdbValToString(data);
+        UnserializeBlockIndexEntries(rawEntries, entries);
+
+        for (const LoadedBlockIndexEntry& entry : entries) {
+            const CDiskBlockIndex& diskindex = entry.diskindex;
+
+            // Construct block index object
+            CBlockIndexSmartPtr pindexNew = InsertBlockIndex(entry.blockHash);
+            pindexNew->pprev              = InsertBlockIndex(diskindex.hashPrev);
+            pindexNew->pnext              = InsertBlockIndex(diskindex.hashNext);
+            pindexNew->blockKeyInDB       = diskindex.blockKeyInDB;
+            pindexNew->nHeight            = diskindex.nHeight;
+            pindexNew->nMint              = diskindex.nMint;
+            pindexNew->nMoneySupply       = diskindex.nMoneySupply;
+            pindexNew->nFlags             = diskindex.nFlags;
+            pindexNew->nStakeModifier     = diskindex.nStakeModifier;
+            pindexNew->prevoutStake       = diskindex.prevoutStake;
+            pindexNew->nStakeTime         = diskindex.nStakeTime;
+            pindexNew->hashProof          = diskindex.hashProof;
+            pindexNew->nVersion           = diskindex.nVersion;
+            pindexNew->hashMerkleRoot     = diskindex.hashMerkleRoot;
+            pindexNew->nTime              = diskindex.nTime;
+            pindexNew->nBits              = diskindex.nBits;
+            pindexNew->nNonce             = diskindex.nNonce;
+
+            if (entry.fHasTrust) {
+                pindexNew->nChainTrust            = entry.trust.nChainTrust;
+                pindexNew->nStakeModifierChecksum = entry.trust.nStakeModifierChecksum;
+            } else {
+                setWithoutTrust.insert(pindexNew.get());
+            }
 
-        // Unpack keys and values.
-        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
-        ssKey.write(keyStr.data(), keyStr.size());
-        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
-        ssValue.write(valStr.data(), valStr.size());
+            // Watch for genesis block
+            if (pindexGenesisBlock == nullptr && entry.blockHash == Params().GenesisBlockHash())
+                pindexGenesisBlock = pindexNew;
 
-        if (fRequestShutdown)
-            break;
+            if (!pindexNew->CheckIndex() || pindexNew->nHeight < 0) {
+                cursorPtr.reset();
+                return error("LoadBlockIndex() : CheckIndex failed at %d", pindexNew->nHeight);
+            }
 
-        uint256 blockHash;
-        ssKey >> blockHash;
-
-        CDiskBlockIndex diskindex;
-        ssValue >> diskindex;
-
-        // (Changed by Sam) previously, using diskindex.GetBlockHash retrieved the block hash AND set it
-        // inside the diskindex object with a const_cast. Now this is fixed to be correct
-        diskindex.SetBlockHash(blockHash);
-
-        // Construct block index object
-        CBlockIndexSmartPtr pindexNew = InsertBlockIndex(blockHash);
-        pindexNew->pprev              = InsertBlockIndex(diskindex.hashPrev);
-        pindexNew->pnext              = InsertBlockIndex(diskindex.hashNext);
-        pindexNew->blockKeyInDB       = diskindex.blockKeyInDB;
-        pindexNew->nHeight            = diskindex.nHeight;
-        pindexNew->nMint              = diskindex.nMint;
-        pindexNew->nMoneySupply       = diskindex.nMoneySupply;
-        pindexNew->nFlags             = diskindex.nFlags;
-        pindexNew->nStakeModifier     = diskindex.nStakeModifier;
-        pindexNew->prevoutStake       = diskindex.prevoutStake;
-        pindexNew->nStakeTime         = diskindex.nStakeTime;
-        pindexNew->hashProof          = diskindex.hashProof;
-        pindexNew->nVersion           = diskindex.nVersion;
-        pindexNew->hashMerkleRoot     = diskindex.hashMerkleRoot;
-        pindexNew->nTime              = diskindex.nTime;
-        pindexNew->nBits              = diskindex.nBits;
-        pindexNew->nNonce             = diskindex.nNonce;
-
-        // Watch for genesis block
-        if (pindexGenesisBlock == nullptr && blockHash == Params().GenesisBlockHash())
-            pindexGenesisBlock = pindexNew;
-
-        if (!pindexNew->CheckIndex()) {
-            cursorPtr.reset();
-            return error("LoadBlockIndex() : CheckIndex failed at %d", pindexNew->nHeight);
+            // NovaCoin: build setStakeSeen
+            if (pindexNew->IsProofOfStake())
+                setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
         }
 
-        // NovaCoin: build setStakeSeen
-        if (pindexNew->IsProofOfStake())
-            setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
-
-        itemRes = mdb_cursor_get(cursorRawPtr, &key, &data, MDB_NEXT);
-
-        loadedCount++;
-        if (loadedCount % 10000 == 0) {
-            uiInterface.InitMessage(_("Loading block index...") +
-                                    " (block: " + std::to_string(loadedCount) + ")");
-        }
-        //        std::cout << "Read status: " << itemRes << "\t" << mdb_strerror(itemRes) << std::endl;
-    } while (itemRes == 0);
+        loadedCount += entries.size();
+        uiInterface.InitMessage(_("Loading block index...") +
+                                " (block: " + std::to_string(loadedCount) + ")");
+    }
     printf("Done reading block index\n");
     uiInterface.InitMessage(_("Loading block index...") + " (done reading block index)");
 
+    entries.clear();
+    entries.shrink_to_fit();
+    rawEntries.clear();
     cursorPtr.reset();
     localTxn.commit();
 
@@ -1023,34 +2074,69 @@ bool CTxDB::LoadBlockIndex()
         return true;
 
     // Calculate nChainTrust
-    vector<pair<int, CBlockIndex*>> vSortedByHeight;
-    vSortedByHeight.reserve(mapBlockIndex.size());
-    uiInterface.InitMessage("Building chain trust... (allocating memory...)");
-    for (const PAIRTYPE(uint256, CBlockIndexSmartPtr) & item : mapBlockIndex) {
-        CBlockIndex* pindex = item.second.get();
-        vSortedByHeight.push_back(make_pair(pindex->nHeight, pindex));
-    }
-    // use heap-sort to guarantee O(n*log(n)) performance, since std::sort() can have O(n^2) complexity
+    // Entries at or below the trust height were all verified by an earlier run and their persisted
+    // trust is used as is. Everything above it, and any entry written without trust (e.g. by an
+    // older client), is recomputed and written back if it differs.
+    int nTrustHeight = -1;
+    if (!ReadBlockIndexTrustHeight(nTrustHeight))
+        nTrustHeight = -1;
+
+    // heights are dense, so a counting sort is linear in the size of the index
     uiInterface.InitMessage("Building chain trust... (sorting...)");
-    std::make_heap(vSortedByHeight.begin(), vSortedByHeight.end());
-    std::sort_heap(vSortedByHeight.begin(), vSortedByHeight.end());
-    loadedCount = 0;
-    for (const PAIRTYPE(int, CBlockIndex*) & item : vSortedByHeight) {
+    int nMaxHeight = -1;
+    for (const auto& item : mapBlockIndex) {
+        nMaxHeight = std::max(nMaxHeight, item.second->nHeight);
+    }
+    std::vector<std::size_t> vHeightOffsets(nMaxHeight + 2, 0);
+    for (const auto& item : mapBlockIndex) {
+        vHeightOffsets[item.second->nHeight + 1]++;
+    }
+    std::partial_sum(vHeightOffsets.begin(), vHeightOffsets.end(), vHeightOffsets.begin());
+    std::vector<CBlockIndex*> vSortedByHeight(mapBlockIndex.size());
+    for (const auto& item : mapBlockIndex) {
+        vSortedByHeight[vHeightOffsets[item.second->nHeight]++] = item.second.get();
+    }
+
+    std::vector<CBlockIndex*> vToRewrite;
+    uint64_t                  recomputedCount = 0;
+    loadedCount                               = 0;
+    for (CBlockIndex* pindex : vSortedByHeight) {
         loadedCount++;
         if (loadedCount % 50000 == 0) {
             uiInterface.InitMessage(
                 "Building chain trust... (chaining block: " + std::to_string(loadedCount) + "/" +
                 std::to_string(vSortedByHeight.size()) + ")");
         }
-        CBlockIndex* pindex = item.second;
-        pindex->nChainTrust = (pindex->pprev ? pindex->pprev->nChainTrust : 0) + pindex->GetBlockTrust();
-        // NovaCoin: calculate stake modifier checksum
-        pindex->nStakeModifierChecksum = GetStakeModifierChecksum(pindex);
+        const bool fMissingTrust = setWithoutTrust.count(pindex) > 0;
+        if (fMissingTrust || pindex->nHeight > nTrustHeight) {
+            const uint256 nChainTrust =
+                (pindex->pprev ? pindex->pprev->nChainTrust : 0) + pindex->GetBlockTrust();
+            // NovaCoin: calculate stake modifier checksum
+            const unsigned int nStakeModifierChecksum = GetStakeModifierChecksum(pindex);
+            if (fMissingTrust || nChainTrust != pindex->nChainTrust ||
+                nStakeModifierChecksum != pindex->nStakeModifierChecksum) {
+                vToRewrite.push_back(pindex);
+            }
+            pindex->nChainTrust            = nChainTrust;
+            pindex->nStakeModifierChecksum = nStakeModifierChecksum;
+            recomputedCount++;
+        }
         if (!CheckStakeModifierCheckpoints(pindex->nHeight, pindex->nStakeModifierChecksum))
             return error("CTxDB::LoadBlockIndex() : Failed stake modifier checkpoint height=%d, "
                          "modifier=0x%016" PRIx64,
                          pindex->nHeight, pindex->nStakeModifier);
     }
+    printf("Computed chain trust of %" PRIu64 " block index entries above height %d\n",
+           recomputedCount, nTrustHeight);
+
+    if (!vToRewrite.empty()) {
+        uiInterface.InitMessage("Building chain trust... (saving " +
+                                std::to_string(vToRewrite.size()) + " entries...)");
+        if (!WriteBlockIndexTrustMany(vToRewrite))
+            return error("CTxDB::LoadBlockIndex() : Failed to persist chain trust");
+    }
+    if (nMaxHeight != nTrustHeight && !WriteBlockIndexTrustHeight(nMaxHeight))
+        return error("CTxDB::LoadBlockIndex() : Failed to write the chain trust height");
 
     // Load hashBestChain pointer to end of best chain
     if (!ReadHashBestChain(hashBestChain)) {
@@ -1062,6 +2148,7 @@ bool CTxDB::LoadBlockIndex()
         return error("CTxDB::LoadBlockIndex() : hashBestChain not found in the block index");
     pindexBest      = mapBlockIndex[hashBestChain];
     nBestHeight     = pindexBest->nHeight;
+    activeChain.SetTip(pindexBest);
     nBestChainTrust = pindexBest->nChainTrust;
 
     printf("LoadBlockIndex(): hashBestChain=%s  height=%d  trust=%s  date=%s\n",
@@ -1085,7 +2172,10 @@ bool CTxDB::LoadBlockIndex()
     printf("Verifying last %i blocks at level %i\n", nCheckDepth, nCheckLevel);
     CBlockIndexSmartPtr        pindexFork = nullptr;
     map<uint256, CBlockIndex*> mapBlockPos;
-    loadedCount = 0;
+    // pruned blocks can't be verified, and neither can transactions that spend from them
+    const bool fPruned        = HavePrunedBlocks();
+    int        nPrunedSkipped = 0;
+    loadedCount               = 0;
     for (CBlockIndexSmartPtr pindex = pindexBest; pindex && pindex->pprev; pindex = pindex->pprev) {
 
         if (loadedCount % 100 == 0) {
@@ -1097,8 +2187,13 @@ bool CTxDB::LoadBlockIndex()
         if (fRequestShutdown || pindex->nHeight < nBestHeight - nCheckDepth)
             break;
         CBlock block;
-        if (!block.ReadFromDisk(pindex.get()))
+        if (!block.ReadFromDisk(pindex.get())) {
+            if (fPruned && !ContainsBlock(pindex->blockKeyInDB)) {
+                nPrunedSkipped++;
+                continue;
+            }
             return error("LoadBlockIndex() : block.ReadFromDisk failed");
+        }
         // check level 1: verify block validity
         // check level 7: verify block signature too
         if (nCheckLevel > 0 && !block.CheckBlock(true, true, (nCheckLevel > 6))) {
@@ -1147,6 +2242,10 @@ bool CTxDB::LoadBlockIndex()
                                 if (nCheckLevel > 5) {
                                     CTransaction txSpend;
                                     if (!txSpend.ReadFromDisk(txpos, txdb)) {
+                                        if (fPruned && !ContainsBlock(txpos.nBlockPos)) {
+                                            nOutput++;
+                                            continue;
+                                        }
                                         printf("LoadBlockIndex(): *** cannot read spending transaction "
                                                "of %s:%i from disk\n",
                                                hashTx.ToString().c_str(), nOutput);
@@ -1192,6 +2291,9 @@ bool CTxDB::LoadBlockIndex()
         }
     }
 
+    if (nPrunedSkipped > 0) {
+        printf("LoadBlockIndex() : skipped verifying %d pruned blocks\n", nPrunedSkipped);
+    }
     printf("Verifying latest blocks done.\n");
     uiInterface.InitMessage("Verifying latest blocks done");
 
@@ -1204,6 +2306,7 @@ bool CTxDB::LoadBlockIndex()
             return error("LoadBlockIndex() : block.ReadFromDisk failed");
         CTxDB txdb;
         block.SetBestChain(txdb, pindexFork);
+        txdb.FlushCache();
     }
 
     return true;
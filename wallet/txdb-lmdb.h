@@ -10,6 +10,7 @@
 
 #include <atomic>
 #include <boost/filesystem.hpp>
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -18,10 +19,13 @@
 
 #include "liblmdb/lmdb.h"
 
+#include "amount.h"
 #include "diskblockindex.h"
 #include "disktxpos.h"
 #include "itxdb.h"
+#include "ntp1/ntp1script.h"
 #include "outpoint.h"
+#include "txdbcache.h"
 #include "txindex.h"
 #include "util.h"
 
@@ -30,6 +34,12 @@ class CBigNum;
 class CBlock;
 class CTransaction;
 class CBitcoinAddress;
+class CIndexedAddress;
+class CAddressIndexKey;
+class CAddressUnspentKey;
+class CAddressUnspentValue;
+class CNTP1TokenIndexEntry;
+class CNTP1TokenStats;
 
 #define ENABLE_AUTO_RESIZE
 
@@ -44,6 +54,9 @@ extern DbSmartPtrType glob_db_tx;
 extern DbSmartPtrType glob_db_ntp1Tx;
 extern DbSmartPtrType glob_db_ntp1tokenNames;
 extern DbSmartPtrType glob_db_addrsVsPubKeys;
+extern DbSmartPtrType glob_db_addressIndex;
+extern DbSmartPtrType glob_db_addressUnspent;
+extern DbSmartPtrType glob_db_ntp1Index;
 
 const std::string LMDB_MAINDB           = "MainDb";
 const std::string LMDB_BLOCKINDEXDB     = "BlockIndexDb";
@@ -52,6 +65,25 @@ const std::string LMDB_TXDB             = "TxDb";
 const std::string LMDB_NTP1TXDB         = "Ntp1txDb";
 const std::string LMDB_NTP1TOKENNAMESDB = "Ntp1NamesDb";
 const std::string LMDB_ADDRSVSPUBKEYSDB = "AddrsVsPubKeysDb";
+const std::string LMDB_ADDRESSINDEXDB   = "AddressIndexDb";
+const std::string LMDB_ADDRESSUNSPENTDB = "AddressUnspentDb";
+const std::string LMDB_NTP1INDEXDB      = "Ntp1IndexDb";
+
+// layout of the records in LMDB_NTP1TXDB; 1 is the original one, 2 is SER_NTP1_COMPACT
+const std::string NTP1TX_DB_FORMAT_KEY     = "ntp1txformat";
+const int         NTP1TX_DB_FORMAT_VERSION = 2;
+
+
+// written once a block was pruned from LMDB_BLOCKSDB, and the height the next search for prunable blocks
+// starts at
+const std::string PRUNED_BLOCKS_KEY     = "prunedblocks";
+const std::string PRUNE_SCAN_HEIGHT_KEY = "prunescanheight";
+
+// written once LMDB_ADDRESSINDEXDB and LMDB_ADDRESSUNSPENTDB were built for the whole chain; they're
+// only kept up to date while -addressindex is set, and are dropped when it's not
+const std::string ADDRESS_INDEX_KEY = "addressindex";
+// the same for LMDB_NTP1INDEXDB and -ntp1index
+const std::string NTP1_INDEX_KEY = "ntp1index";
 
 constexpr static float    DB_RESIZE_PERCENT     = 0.9f;
 constexpr static uint64_t MIN_MAP_SIZE_INCREASE = UINT64_C(1) << 28; // ~256 MiB
@@ -234,6 +266,9 @@ private:
     MDB_dbi* db_ntp1Tx;
     MDB_dbi* db_ntp1tokenNames;
     MDB_dbi* db_addrsVsPubKeys;
+    MDB_dbi* db_addressIndex;
+    MDB_dbi* db_addressUnspent;
+    MDB_dbi* db_ntp1Index;
 
     // A batch stores up writes and deletes for atomic application. When this
     // field is non-NULL, writes/deletes go there instead of directly to disk.
@@ -241,6 +276,10 @@ private:
     bool                          fReadOnly;
     int                           nVersion;
 
+    // Changes of cached records made in the active batch; they're committed to the tx db cache
+    // together with the batch, or dropped if it's aborted.
+    CTxDBChanges batchChanges;
+
     void (*dbDeleter)(MDB_dbi*) = [](MDB_dbi* p) {
         if (p) {
             mdb_close(dbEnv.get(), *p);
@@ -274,9 +313,8 @@ protected:
         // only one of them should be active
         assert(localTxn.rawPtr() == nullptr || activeBatch == nullptr);
 
-        std::string&& keyBin = ssKey.str();
-        MDB_val       kS     = {keyBin.size(), (void*)(keyBin.c_str())};
-        MDB_val       vS     = {0, nullptr};
+        MDB_val kS = {ssKey.size(), (void*)&ssKey[0]};
+        MDB_val vS = {0, nullptr};
         if (auto ret = mdb_get((!activeBatch ? localTxn : *activeBatch), *dbPtr, &kS, &vS)) {
             std::string dbgKey = KeyAsString(key, ssKey.str());
 
@@ -295,9 +333,10 @@ protected:
         assert(offset <= vS.mv_size);
         assert(vS.mv_data != nullptr);
         try {
-            CDataStream ssValue(static_cast<const char*>(vS.mv_data) + offset,
-                                static_cast<const char*>(vS.mv_data) + vS.mv_size,
-                                SER_DISK | serializationTypeModifiers, CLIENT_VERSION);
+            // the value is unserialized directly from the memory map while the transaction is alive
+            CDataStreamView ssValue(static_cast<const char*>(vS.mv_data) + offset,
+                                    static_cast<const char*>(vS.mv_data) + vS.mv_size,
+                                    SER_DISK | serializationTypeModifiers, CLIENT_VERSION);
             ssValue >> value;
         } catch (std::exception& e) {
             printf("Failed to deserialized data when reading for key %s\n", ssKey.str().c_str());
@@ -309,6 +348,85 @@ protected:
         return true;
     }
 
+    /**
+     * Reads a list of keys from a database using the given transaction. The same key buffer is reused
+     * for all keys. Keys that don't exist in the database are left as boost::none in values; false is
+     * returned only on lmdb/deserialization errors. If offsets is not empty, it must have the same size
+     * as keys, and every value is deserialized starting from its corresponding offset.
+     */
+    template <typename K, typename T>
+    bool ReadBatchInTxn(MDB_txn* txn, const std::vector<K>& keys, std::vector<boost::optional<T>>& values,
+                        MDB_dbi* dbPtr, int serializationTypeModifiers = 0,
+                        const std::vector<size_t>& offsets = std::vector<size_t>())
+    {
+        assert(txn != nullptr);
+        assert(offsets.empty() || offsets.size() == keys.size());
+
+        values.clear();
+        values.resize(keys.size());
+
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey.reserve(1000);
+        for (unsigned i = 0; i < keys.size(); i++) {
+            ssKey.clear();
+            ssKey << keys[i];
+
+            MDB_val kS = {ssKey.size(), (void*)&ssKey[0]};
+            MDB_val vS = {0, nullptr};
+            if (auto ret = mdb_get(txn, *dbPtr, &kS, &vS)) {
+                if (ret == MDB_NOTFOUND) {
+                    continue;
+                }
+                std::string dbgKey = KeyAsString(keys[i], ssKey.str());
+                printf("Failed to batch-read lmdb key %s with an unknown error of code %i; and error: "
+                       "%s\n",
+                       dbgKey.c_str(), ret, mdb_strerror(ret));
+                return false;
+            }
+
+            const size_t offset = (offsets.empty() ? 0 : offsets[i]);
+            assert(offset <= vS.mv_size);
+            assert(vS.mv_data != nullptr);
+            try {
+                CDataStreamView ssValue(static_cast<const char*>(vS.mv_data) + offset,
+                                        static_cast<const char*>(vS.mv_data) + vS.mv_size,
+                                        SER_DISK | serializationTypeModifiers, CLIENT_VERSION);
+                values[i] = T();
+                ssValue >> *values[i];
+            } catch (std::exception& e) {
+                printf("Failed to deserialized data when batch-reading for key %s\n",
+                       ssKey.str().c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Same as ReadBatchInTxn(), but uses the active batch if there's one, or otherwise starts a single
+     * read transaction for all the keys.
+     */
+    template <typename K, typename T>
+    bool ReadBatch(const std::vector<K>& keys, std::vector<boost::optional<T>>& values, MDB_dbi* dbPtr,
+                   int                        serializationTypeModifiers = 0,
+                   const std::vector<size_t>& offsets                    = std::vector<size_t>())
+    {
+        if (activeBatch) {
+            return ReadBatchInTxn(*activeBatch, keys, values, dbPtr, serializationTypeModifiers,
+                                  offsets);
+        }
+
+        mdb_txn_safe localTxn;
+        if (auto res = lmdb_txn_begin(dbEnv.get(), nullptr, MDB_RDONLY, localTxn)) {
+            return error("Failed to begin transaction at batch-read with error code %i; and error: %s\n",
+                         res, mdb_strerror(res));
+        }
+        bool result =
+            ReadBatchInTxn(localTxn, keys, values, dbPtr, serializationTypeModifiers, offsets);
+        localTxn.abort();
+        return result;
+    }
+
     /**
      * ReadMultiple key/value pairs, either starting at "key" or just all the keys in the db. If readAll
      * is true, everything in the db will be read
@@ -377,10 +495,10 @@ protected:
             // Unserialize value
             assert(vS.mv_data != nullptr);
             try {
-                CDataStream ssValue(static_cast<const char*>(vS.mv_data),
-                                    static_cast<const char*>(vS.mv_data) + vS.mv_size, SER_DISK,
-                                    CLIENT_VERSION);
-                T           value;
+                CDataStreamView ssValue(static_cast<const char*>(vS.mv_data),
+                                        static_cast<const char*>(vS.mv_data) + vS.mv_size, SER_DISK,
+                                        CLIENT_VERSION);
+                T               value;
                 ssValue >> value;
                 values.insert(values.end(), value);
             } catch (std::exception& e) {
@@ -402,7 +520,7 @@ protected:
     }
 
     template <typename K, typename T>
-    bool Write(const K& key, const T& value, MDB_dbi* dbPtr)
+    bool Write(const K& key, const T& value, MDB_dbi* dbPtr, int serializationTypeModifiers = 0)
     {
         if (fReadOnly) {
             printf("Accessing lmdb write function in read only mode");
@@ -413,7 +531,7 @@ protected:
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(1000);
         ssKey << key;
-        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        CDataStream ssValue(SER_DISK | serializationTypeModifiers, CLIENT_VERSION);
         ssValue.reserve(10000);
         ssValue << value;
 
@@ -714,6 +832,8 @@ public:
     bool test1_ReadStrKeyVal(const std::string& key, std::string& val);
     bool test1_ExistsStrKeyVal(const std::string& key);
     bool test1_EraseStrKeyVal(const std::string& key);
+    bool test1_ReadStrKeyValBatch(const std::vector<std::string>&              keys,
+                                  std::vector<boost::optional<std::string>>& vals);
 
     bool test2_ReadMultipleStr1KeyVal(const std::string& key, std::vector<std::string>& val);
     bool test2_WriteStrKeyVal(const std::string& key, const std::string& val);
@@ -726,6 +846,10 @@ public:
     bool ReadTxIndex(const uint256& hash, CTxIndex& txindex) override;
     bool UpdateTxIndex(const uint256& hash, const CTxIndex& txindex) override;
     bool ReadTx(const CDiskTxPos& txPos, CTransaction& tx) override;
+    bool ReadTxIndexMany(const std::vector<uint256>&              hashes,
+                         std::vector<boost::optional<CTxIndex>>& txindexes) override;
+    bool ReadTxMany(const std::vector<CDiskTxPos>&             txPositions,
+                    std::vector<boost::optional<CTransaction>>& txs) override;
     bool ReadNTP1Tx(const uint256& hash, NTP1Transaction& ntp1tx) override;
     bool WriteNTP1Tx(const uint256& hash, const NTP1Transaction& ntp1tx) override;
     bool ReadAllIssuanceTxs(std::vector<uint256>& txs) override;
@@ -740,6 +864,8 @@ public:
     bool ReadDiskTx(const uint256& hash, CTransaction& tx) override;
     bool ReadDiskTx(const COutPoint& outpoint, CTransaction& tx, CTxIndex& txindex) override;
     bool ReadDiskTx(const COutPoint& outpoint, CTransaction& tx) override;
+    bool ReadDiskTxMany(const std::vector<uint256>& hashes, std::vector<boost::optional<CTxIndex>>& txindexes,
+                        std::vector<boost::optional<CTransaction>>& txs) override;
     bool ReadBlock(const uint256& hash, CBlock& blk, bool fReadTransactions = true) override;
     bool WriteBlock(const uint256& hash, const CBlock& blk) override;
     bool WriteBlockIndex(const CDiskBlockIndex& blockindex) override;
@@ -747,14 +873,103 @@ public:
     bool WriteHashBestChain(const uint256& hashBestChain) override;
     bool ReadBestInvalidTrust(CBigNum& bnBestInvalidTrust) override;
     bool WriteBestInvalidTrust(const CBigNum& bnBestInvalidTrust) override;
+    bool ReadBlockIndexTrustHeight(int& nHeight);
+    bool WriteBlockIndexTrustHeight(int nHeight);
     bool LoadBlockIndex() override;
 
+    /** The size of the blocks in the db, in bytes, from the number of pages they take */
+    uint64_t GetBlocksDbSize();
+
+    /** Whether the block itself is in the db; it's not if it was pruned, while its index still is */
+    bool ContainsBlock(const uint256& hash);
+
+    /** Deletes the blocks from the db in a single transaction, keeping their indexes */
+    bool PruneBlocks(const std::vector<uint256>& hashes);
+
+    /** Whether any block was ever pruned from the db */
+    bool HavePrunedBlocks();
+
+    bool ReadPruneScanHeight(int& nHeight);
+    bool WritePruneScanHeight(int nHeight);
+
+    /** Adds changes of the address index, which are written to the db together with the tx indexes */
+    void AddAddressIndexChanges(CTxDBChanges&& changes);
+
+    /** Reads the records of the address index of address, from the blocks at nStart to nEnd */
+    bool ReadAddressIndex(const CIndexedAddress& address, unsigned int nStart, unsigned int nEnd,
+                          std::vector<std::pair<CAddressIndexKey, CAmount>>& records);
+
+    bool ReadAddressUnspentIndex(
+        const CIndexedAddress&                                            address,
+        std::vector<std::pair<CAddressUnspentKey, CAddressUnspentValue>>& records);
+
+    /**
+     * Builds the address index for the whole main chain if fEnabled and it wasn't built yet, or drops
+     * it if not fEnabled. The blocks are needed to build it, so that fails if any were pruned.
+     */
+    bool SyncAddressIndex(bool fEnabled);
+
+    /** Adds changes of the NTP1 index, which are written to the db together with the tx indexes */
+    void AddNTP1IndexChanges(CTxDBChanges&& changes);
+
+    /** Reads the issuance of a token from the NTP1 index; entry is none if the token isn't there */
+    bool ReadNTP1TokenIndexEntry(const std::string&                     tokenId,
+                                 boost::optional<CNTP1TokenIndexEntry>& entry);
+
+    /** Reads the supply and holders of a token from the NTP1 index; they're zero if it has none */
+    bool ReadNTP1TokenStats(const std::string& tokenId, CNTP1TokenStats& stats);
+
+    /** Reads the addresses holding a token from the NTP1 index with their balances, by address */
+    bool ReadNTP1TokenHolders(const std::string&                                tokenId,
+                              std::vector<std::pair<CIndexedAddress, NTP1Int>>& holders);
+
+    /** Reads the balances of the tokens of an address from the NTP1 index, by token id */
+    bool ReadNTP1AddressBalances(const CIndexedAddress&                        address,
+                                 std::vector<std::pair<std::string, NTP1Int>>& balances);
+
+    /** Reads a record of the NTP1 index by its serialized key; value is none if it isn't there */
+    bool ReadNTP1IndexRecord(const std::string& key, boost::optional<std::string>& value);
+
+    /** Builds or drops the NTP1 index like SyncAddressIndex does the address index */
+    bool SyncNTP1Index(bool fEnabled);
+
+    /**
+     * Writes the changes of the tx db cache to the db in a single transaction, and empties the
+     * cache. Unless fForce is set, that's only done if the cache outgrew -dbcache or has changes
+     * older than DB_CACHE_FLUSH_INTERVAL. Must not be called with an active batch.
+     */
+    bool FlushCache(bool fForce = true);
+
     static uintmax_t GetCurrentDiskUsage();
 
     void init_blockindex(bool fRemoveOld = false);
 
 private:
     bool LoadBlockIndexGuts();
+    bool WriteBlockIndexTrustMany(const std::vector<CBlockIndex*>& vIndexes);
+    bool WriteCacheChanges(const CTxDBChanges& changes);
+    bool WriteIndexRecords(const CTxDBChanges& changes);
+    /**
+     * Reads the records of an index db that start with prefix, from startKey on, until fn returns
+     * false. The records of the index in the tx db cache, which getRecords returns, are merged in.
+     */
+    bool ReadIndexRecords(MDB_dbi* dbPtr, CTxDBChanges::RecordMapGetter getRecords,
+                          const std::string& prefix, const std::string& startKey,
+                          const std::function<bool(const MDB_val&, const MDB_val&)>& fn);
+    /**
+     * Builds the index with the changes addBlockChanges adds for every block of the main chain, if
+     * fEnabled and flagKey isn't in the db yet, or empties its dbs if not fEnabled
+     */
+    bool SyncIndex(const std::string& name, const std::string& flagKey,
+                   const std::vector<MDB_dbi*>& dbs, bool fEnabled,
+                   const std::function<bool(const CBlock&, int, CTxDBChanges&)>& addBlockChanges);
+    void CommitCacheChanges(CTxDBChanges&& changes);
+    CTxDBChanges::Lookup LookupCachedTxIndex(const uint256& hash, CTxIndex& txindex) const;
+    void                 LookupCachedTxIndexMany(const std::vector<uint256>&              hashes,
+                                                 std::vector<boost::optional<CTxIndex>>& txindexes,
+                                                 std::vector<uint256>&                   missingHashes,
+                                                 std::vector<std::size_t>&               missingPositions);
+    bool MigrateNTP1TxDbToCompactFormat();
 
     inline void        loadDbPointers();
     inline void        resetDbPointers();
@@ -770,6 +985,9 @@ void CTxDB::loadDbPointers()
     db_ntp1Tx         = glob_db_ntp1Tx.get();
     db_ntp1tokenNames = glob_db_ntp1tokenNames.get();
     db_addrsVsPubKeys = glob_db_addrsVsPubKeys.get();
+    db_addressIndex   = glob_db_addressIndex.get();
+    db_addressUnspent = glob_db_addressUnspent.get();
+    db_ntp1Index      = glob_db_ntp1Index.get();
 }
 
 void CTxDB::resetDbPointers()
@@ -781,6 +999,9 @@ void CTxDB::resetDbPointers()
     db_ntp1Tx         = nullptr;
     db_ntp1tokenNames = nullptr;
     db_addrsVsPubKeys = nullptr;
+    db_addressIndex   = nullptr;
+    db_addressUnspent = nullptr;
+    db_ntp1Index      = nullptr;
 }
 
 void CTxDB::resetGlobalDbPointers()
@@ -792,8 +1013,14 @@ void CTxDB::resetGlobalDbPointers()
     glob_db_ntp1Tx.reset();
     glob_db_ntp1tokenNames.reset();
     glob_db_addrsVsPubKeys.reset();
+    glob_db_addressIndex.reset();
+    glob_db_addressUnspent.reset();
+    glob_db_ntp1Index.reset();
 
     dbEnv.reset();
+
+    // whatever wasn't flushed belongs to the db that's gone
+    TxDBCache().Clear();
 }
 
 #endif // BITCOIN_LMDB_H
@@ -0,0 +1,280 @@
+#include "txdbcache.h"
+
+#include "globals.h"
+#include "util.h"
+
+namespace {
+// rough heap overhead of a node of a std::map, besides its value
+const std::size_t MAP_NODE_OVERHEAD = 4 * sizeof(void*);
+
+std::size_t TxIndexEntryMemoryUsage(const boost::optional<CTxIndex>& entry)
+{
+    return MAP_NODE_OVERHEAD + sizeof(CTxDBChanges::TxIndexMap::value_type) +
+           (entry ? entry->vSpent.capacity() * sizeof(CDiskTxPos) : 0);
+}
+} // namespace
+
+std::size_t CTxDBChanges::TxIndexMemoryUsage(const CTxIndex& txindex)
+{
+    return MAP_NODE_OVERHEAD + sizeof(std::pair<const uint256, CTxIndex>) +
+           txindex.vSpent.capacity() * sizeof(CDiskTxPos);
+}
+
+void CTxDBChanges::SetTxIndex(const uint256& hash, const CTxIndex& txindex)
+{
+    SetTxIndexEntry(hash, boost::make_optional(txindex));
+}
+
+void CTxDBChanges::EraseTxIndex(const uint256& hash) { SetTxIndexEntry(hash, boost::none); }
+
+void CTxDBChanges::SetTxIndexEntry(const uint256& hash, boost::optional<CTxIndex>&& entry)
+{
+    std::pair<TxIndexMap::iterator, bool> res =
+        txIndexes.insert(std::make_pair(hash, boost::optional<CTxIndex>()));
+    if (!res.second) {
+        nMemoryUsage -= TxIndexEntryMemoryUsage(res.first->second);
+    }
+    res.first->second = std::move(entry);
+    nMemoryUsage += TxIndexEntryMemoryUsage(res.first->second);
+}
+
+void CTxDBChanges::SetBlockIndex(const uint256& hash, std::string&& serializedIndex)
+{
+    std::pair<BlockIndexMap::iterator, bool> res =
+        blockIndexes.insert(std::make_pair(hash, std::string()));
+    if (res.second) {
+        nMemoryUsage += MAP_NODE_OVERHEAD + sizeof(BlockIndexMap::value_type);
+    }
+    nMemoryUsage -= res.first->second.capacity();
+    res.first->second = std::move(serializedIndex);
+    nMemoryUsage += res.first->second.capacity();
+}
+
+void CTxDBChanges::SetAddressIndexRecord(const std::string& key, boost::optional<std::string>&& value)
+{
+    SetRecord(addressIndexRecords, key, std::move(value));
+}
+
+void CTxDBChanges::SetAddressUnspentRecord(const std::string& key, boost::optional<std::string>&& value)
+{
+    SetRecord(addressUnspentRecords, key, std::move(value));
+}
+
+void CTxDBChanges::SetNTP1IndexRecord(const std::string& key, boost::optional<std::string>&& value)
+{
+    SetRecord(ntp1IndexRecords, key, std::move(value));
+}
+
+void CTxDBChanges::SetRecord(RecordMap& records, const std::string& key,
+                             boost::optional<std::string>&& value)
+{
+    std::pair<RecordMap::iterator, bool> res =
+        records.insert(std::make_pair(key, boost::optional<std::string>()));
+    if (res.second) {
+        nMemoryUsage += MAP_NODE_OVERHEAD + sizeof(RecordMap::value_type) + key.capacity();
+    } else if (res.first->second) {
+        nMemoryUsage -= res.first->second->capacity();
+    }
+    res.first->second = std::move(value);
+    if (res.first->second) {
+        nMemoryUsage += res.first->second->capacity();
+    }
+}
+
+CTxDBChanges::Lookup CTxDBChanges::LookupTxIndex(const uint256& hash, CTxIndex& txindex) const
+{
+    TxIndexMap::const_iterator it = txIndexes.find(hash);
+    if (it == txIndexes.end()) {
+        return Lookup::Unknown;
+    }
+    if (!it->second) {
+        return Lookup::Erased;
+    }
+    txindex = *it->second;
+    return Lookup::Found;
+}
+
+void CTxDBChanges::MergeFrom(CTxDBChanges&& other)
+{
+    if (IsEmpty()) {
+        std::swap(*this, other);
+        other.Clear();
+        return;
+    }
+    for (TxIndexMap::value_type& item : other.txIndexes) {
+        SetTxIndexEntry(item.first, std::move(item.second));
+    }
+    for (BlockIndexMap::value_type& item : other.blockIndexes) {
+        SetBlockIndex(item.first, std::move(item.second));
+    }
+    if (other.hashBestChain) {
+        hashBestChain = other.hashBestChain;
+    }
+    for (RecordMap::value_type& item : other.addressIndexRecords) {
+        SetRecord(addressIndexRecords, item.first, std::move(item.second));
+    }
+    for (RecordMap::value_type& item : other.addressUnspentRecords) {
+        SetRecord(addressUnspentRecords, item.first, std::move(item.second));
+    }
+    for (RecordMap::value_type& item : other.ntp1IndexRecords) {
+        SetRecord(ntp1IndexRecords, item.first, std::move(item.second));
+    }
+    other.Clear();
+}
+
+void CTxDBChanges::GetRecordsWithPrefix(RecordMapGetter getRecords, const std::string& prefix,
+                                        const std::string& startKey, RecordMap& result) const
+{
+    const RecordMap& records = (this->*getRecords)();
+    for (RecordMap::const_iterator it = records.lower_bound(startKey);
+         it != records.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it) {
+        result[it->first] = it->second;
+    }
+}
+
+bool CTxDBChanges::IsEmpty() const
+{
+    return txIndexes.empty() && blockIndexes.empty() && !hashBestChain && addressIndexRecords.empty() &&
+           addressUnspentRecords.empty() && ntp1IndexRecords.empty();
+}
+
+void CTxDBChanges::Clear()
+{
+    txIndexes.clear();
+    blockIndexes.clear();
+    hashBestChain = boost::none;
+    addressIndexRecords.clear();
+    addressUnspentRecords.clear();
+    ntp1IndexRecords.clear();
+    nMemoryUsage = 0;
+}
+
+CTxDBCache::CTxDBCache(std::size_t nMaxMemoryUsageIn)
+    : nReadMemoryUsage(0), nMaxMemoryUsage(nMaxMemoryUsageIn), nFlushCount(0), nFirstChangeTime(0)
+{
+}
+
+CTxDBChanges::Lookup CTxDBCache::LookupTxIndex(const uint256& hash, CTxIndex& txindex) const
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    const CTxDBChanges::Lookup res = changes.LookupTxIndex(hash, txindex);
+    if (res != CTxDBChanges::Lookup::Unknown) {
+        return res;
+    }
+    std::map<uint256, CTxIndex>::const_iterator it = readTxIndexes.find(hash);
+    if (it == readTxIndexes.end()) {
+        return CTxDBChanges::Lookup::Unknown;
+    }
+    txindex = it->second;
+    return CTxDBChanges::Lookup::Found;
+}
+
+boost::optional<uint256> CTxDBCache::GetHashBestChain() const
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    return changes.GetHashBestChain();
+}
+
+void CTxDBCache::AddReadTxIndex(const uint256& hash, const CTxIndex& txindex,
+                                uint64_t nFlushCountBeforeRead)
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    if (nFlushCount != nFlushCountBeforeRead || changes.GetTxIndexes().count(hash)) {
+        return;
+    }
+    // reads alone never make the cache outgrow its limit
+    if (changes.GetMemoryUsage() + nReadMemoryUsage >= nMaxMemoryUsage) {
+        return;
+    }
+    if (readTxIndexes.insert(std::make_pair(hash, txindex)).second) {
+        nReadMemoryUsage += CTxDBChanges::TxIndexMemoryUsage(txindex);
+    }
+}
+
+void CTxDBCache::Commit(CTxDBChanges&& newChanges)
+{
+    if (newChanges.IsEmpty()) {
+        return;
+    }
+    boost::lock_guard<boost::mutex> lock(mtx);
+    // tx indexes read before are outdated by the changes
+    for (const CTxDBChanges::TxIndexMap::value_type& item : newChanges.GetTxIndexes()) {
+        std::map<uint256, CTxIndex>::iterator it = readTxIndexes.find(item.first);
+        if (it != readTxIndexes.end()) {
+            nReadMemoryUsage -= CTxDBChanges::TxIndexMemoryUsage(it->second);
+            readTxIndexes.erase(it);
+        }
+    }
+    if (nFirstChangeTime == 0) {
+        nFirstChangeTime = GetTime();
+    }
+    changes.MergeFrom(std::move(newChanges));
+}
+
+bool CTxDBCache::Flush(const std::function<bool(const CTxDBChanges&)>& writeChanges)
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    if (!writeChanges(changes)) {
+        return false;
+    }
+    changes.Clear();
+    readTxIndexes.clear();
+    nReadMemoryUsage = 0;
+    nFirstChangeTime = 0;
+    nFlushCount++;
+    return true;
+}
+
+bool CTxDBCache::ShouldFlush(int64_t nNow, int64_t nFlushInterval) const
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    if (changes.GetMemoryUsage() + nReadMemoryUsage > nMaxMemoryUsage) {
+        return true;
+    }
+    return nFirstChangeTime != 0 && nNow - nFirstChangeTime >= nFlushInterval;
+}
+
+bool CTxDBCache::HasUnflushedChanges() const
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    return !changes.IsEmpty();
+}
+
+uint64_t CTxDBCache::GetRecordsWithPrefix(CTxDBChanges::RecordMapGetter getRecords,
+                                          const std::string& prefix, const std::string& startKey,
+                                          CTxDBChanges::RecordMap& result) const
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    changes.GetRecordsWithPrefix(getRecords, prefix, startKey, result);
+    return nFlushCount;
+}
+
+void CTxDBCache::Clear()
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    changes.Clear();
+    readTxIndexes.clear();
+    nReadMemoryUsage = 0;
+    nFirstChangeTime = 0;
+    nFlushCount++;
+}
+
+uint64_t CTxDBCache::GetFlushCount() const
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    return nFlushCount;
+}
+
+std::size_t CTxDBCache::GetMemoryUsage() const
+{
+    boost::lock_guard<boost::mutex> lock(mtx);
+    return changes.GetMemoryUsage() + nReadMemoryUsage;
+}
+
+CTxDBCache& TxDBCache()
+{
+    static CTxDBCache cache(
+        static_cast<std::size_t>(std::max<int64_t>(GetArg("-dbcache", DEFAULT_DB_CACHE_SIZE), 1)) *
+        1024 * 1024);
+    return cache;
+}
@@ -0,0 +1,159 @@
+#ifndef TXDBCACHE_H
+#define TXDBCACHE_H
+
+#include "txindex.h"
+#include "uint256.h"
+
+#include <boost/optional.hpp>
+#include <boost/thread/mutex.hpp>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <string>
+
+/**
+ * Changes to the records of the tx db that connecting and disconnecting blocks makes: tx indexes,
+ * block index entries, the hash of the best chain and the records of the address and NTP1 indexes. A
+ * later change of a record replaces the earlier one.
+ */
+class CTxDBChanges
+{
+public:
+    enum class Lookup
+    {
+        Unknown,
+        Found,
+        Erased
+    };
+
+    /** Changed tx indexes; none marks an erased one */
+    typedef std::map<uint256, boost::optional<CTxIndex>> TxIndexMap;
+    /** Changed block index entries, already serialized */
+    typedef std::map<uint256, std::string> BlockIndexMap;
+    /** Changed records of an index by their serialized keys; none marks an erased one */
+    typedef std::map<std::string, boost::optional<std::string>> RecordMap;
+    /** One of the getters of the records of an index below */
+    typedef const RecordMap& (CTxDBChanges::*RecordMapGetter)() const;
+
+    CTxDBChanges() : nMemoryUsage(0) {}
+
+    void SetTxIndex(const uint256& hash, const CTxIndex& txindex);
+    void EraseTxIndex(const uint256& hash);
+    void SetBlockIndex(const uint256& hash, std::string&& serializedIndex);
+    void SetHashBestChain(const uint256& hash) { hashBestChain = hash; }
+    void SetAddressIndexRecord(const std::string& key, boost::optional<std::string>&& value);
+    void SetAddressUnspentRecord(const std::string& key, boost::optional<std::string>&& value);
+    void SetNTP1IndexRecord(const std::string& key, boost::optional<std::string>&& value);
+
+    /** Sets txindex and returns Found if the tx index was changed, or Erased if it was erased */
+    Lookup LookupTxIndex(const uint256& hash, CTxIndex& txindex) const;
+
+    const TxIndexMap&               GetTxIndexes() const { return txIndexes; }
+    const BlockIndexMap&            GetBlockIndexes() const { return blockIndexes; }
+    const boost::optional<uint256>& GetHashBestChain() const { return hashBestChain; }
+    const RecordMap&                GetAddressIndexRecords() const { return addressIndexRecords; }
+    const RecordMap&                GetAddressUnspentRecords() const { return addressUnspentRecords; }
+    const RecordMap&                GetNTP1IndexRecords() const { return ntp1IndexRecords; }
+
+    /** Moves all changes of other into this object, replacing the ones of the same records */
+    void MergeFrom(CTxDBChanges&& other);
+
+    /**
+     * Copies the changed records of an index that start with prefix, from startKey on, into result,
+     * replacing the ones of the same keys
+     */
+    void GetRecordsWithPrefix(RecordMapGetter getRecords, const std::string& prefix,
+                              const std::string& startKey, RecordMap& result) const;
+
+    bool IsEmpty() const;
+    void Clear();
+
+    /** An estimate of the heap memory taken by the changes, in bytes */
+    std::size_t GetMemoryUsage() const { return nMemoryUsage; }
+
+    /** An estimate of the heap memory a tx index takes in a map */
+    static std::size_t TxIndexMemoryUsage(const CTxIndex& txindex);
+
+private:
+    TxIndexMap               txIndexes;
+    BlockIndexMap            blockIndexes;
+    boost::optional<uint256> hashBestChain;
+    RecordMap                addressIndexRecords;
+    RecordMap                addressUnspentRecords;
+    RecordMap                ntp1IndexRecords;
+    std::size_t              nMemoryUsage;
+
+    void SetTxIndexEntry(const uint256& hash, boost::optional<CTxIndex>&& entry);
+    void SetRecord(RecordMap& records, const std::string& key, boost::optional<std::string>&& value);
+};
+
+/**
+ * Write-back cache in front of the tx db. Committed changes of block connections are kept in
+ * memory across blocks, together with tx indexes that were read from the db, and are written to
+ * the db in a single transaction when the cache is flushed. Until then, the records in the db are
+ * those of the last flush, so the best chain hash in the db always matches its tx indexes.
+ */
+class CTxDBCache
+{
+public:
+    explicit CTxDBCache(std::size_t nMaxMemoryUsageIn);
+    CTxDBCache(const CTxDBCache&) = delete;
+    CTxDBCache& operator=(const CTxDBCache&) = delete;
+
+    /** Looks a tx index up among the changes not yet flushed and the tx indexes read before */
+    CTxDBChanges::Lookup LookupTxIndex(const uint256& hash, CTxIndex& txindex) const;
+
+    /** The best chain hash, if it changed since the last flush */
+    boost::optional<uint256> GetHashBestChain() const;
+
+    /**
+     * Keeps a tx index that was read from the db, unless the cache is full. It's dropped if the cache
+     * was flushed since nFlushCountBeforeRead was taken, or if the tx index was changed meanwhile,
+     * as the value read may be outdated then.
+     */
+    void AddReadTxIndex(const uint256& hash, const CTxIndex& txindex, uint64_t nFlushCountBeforeRead);
+
+    /** Makes committed changes part of the cache */
+    void Commit(CTxDBChanges&& changes);
+
+    /**
+     * Calls writeChanges with the changes not yet flushed, with the cache locked. If it returns
+     * true, the changes are in the db now, and the cache is emptied.
+     */
+    bool Flush(const std::function<bool(const CTxDBChanges&)>& writeChanges);
+
+    /** Whether the cache outgrew its memory limit, or has changes older than nFlushInterval */
+    bool ShouldFlush(int64_t nNow, int64_t nFlushInterval) const;
+
+    /** Whether there are committed changes that weren't flushed to the db yet */
+    bool HasUnflushedChanges() const;
+
+    /**
+     * CTxDBChanges::GetRecordsWithPrefix() of the changes not yet flushed. Returns the flush count
+     * they were taken at, as they're only those missing from the db as long as it's the same.
+     */
+    uint64_t GetRecordsWithPrefix(CTxDBChanges::RecordMapGetter getRecords, const std::string& prefix,
+                                  const std::string& startKey, CTxDBChanges::RecordMap& result) const;
+
+    /** Drops everything in the cache, including changes that weren't flushed */
+    void Clear();
+
+    uint64_t    GetFlushCount() const;
+    std::size_t GetMemoryUsage() const;
+    std::size_t GetMaxMemoryUsage() const { return nMaxMemoryUsage; }
+
+private:
+    mutable boost::mutex        mtx;
+    CTxDBChanges                changes;
+    std::map<uint256, CTxIndex> readTxIndexes;
+    std::size_t                 nReadMemoryUsage;
+    const std::size_t           nMaxMemoryUsage;
+    uint64_t                    nFlushCount;
+    // time of the first change since the last flush, 0 if there's none
+    int64_t nFirstChangeTime;
+};
+
+/** The cache of the tx db, sized by -dbcache */
+CTxDBCache& TxDBCache();
+
+#endif // TXDBCACHE_H
@@ -2,37 +2,192 @@
 
 #include "globals.h"
 
-bool CTxMemPool::addUnchecked(const uint256& hash, const CTransaction& tx)
+/** Rough estimate of the memory taken by a pool entry, its index nodes and its mapNextTx nodes */
+static std::size_t EstimateEntryUsage(const CTransaction& tx)
+{
+    // one hashed and three ordered index nodes are allocated together with the entry
+    std::size_t usage = sizeof(CTxMemPoolEntry) + 12 * sizeof(void*);
+    usage += tx.vin.capacity() * sizeof(CTxIn) + tx.vout.capacity() * sizeof(CTxOut);
+    for (const CTxIn& txin : tx.vin)
+        usage += txin.scriptSig.capacity();
+    for (const CTxOut& txout : tx.vout)
+        usage += txout.scriptPubKey.capacity();
+    usage += tx.vin.size() * (sizeof(std::pair<const COutPoint, CInPoint>) + 4 * sizeof(void*));
+    return usage;
+}
+
+CTxMemPoolEntry::CTxMemPoolEntry(const CTransaction& txIn, int64_t nFeeIn, int64_t nTimeIn)
+    : tx(txIn), hash(txIn.GetHash()), nFee(nFeeIn), nTime(nTimeIn)
+{
+    nTxSize    = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+    nUsageSize = EstimateEntryUsage(tx);
+
+    nCountWithAncestors = 1;
+    nSizeWithAncestors  = nTxSize;
+    nFeesWithAncestors  = nFee;
+}
+
+void CTxMemPoolEntry::UpdateAncestorState(int64_t modifySize, int64_t modifyFee, int64_t modifyCount)
+{
+    nSizeWithAncestors += modifySize;
+    nFeesWithAncestors += modifyFee;
+    nCountWithAncestors += modifyCount;
+    assert(int64_t(nSizeWithAncestors) > 0);
+    assert(int64_t(nCountWithAncestors) > 0);
+}
+
+bool CTxMemPool::addUnchecked(const CTxMemPoolEntry& entry)
 {
     // Add to memory pool without checking anything.  Don't call this directly,
     // call AcceptToMemoryPool to properly check the transaction first.
     {
-        mapTx[hash] = tx;
+        CTxMemPoolEntry newEntry(entry);
+
+        // the in-pool ancestors make the package this transaction is mined with
+        std::set<uint256> setAncestors;
+        CalculateAncestors(entry.GetTx(), setAncestors);
+        for (const uint256& hash : setAncestors) {
+            indexed_transaction_set::const_iterator it = mapTx.find(hash);
+            newEntry.UpdateAncestorState(it->GetTxSize(), it->GetFee(), 1);
+        }
+
+        std::pair<indexed_transaction_set::iterator, bool> inserted = mapTx.insert(newEntry);
+        if (!inserted.second)
+            return false;
+        const CTransaction& tx = inserted.first->GetTx();
         for (unsigned int i = 0; i < tx.vin.size(); i++)
-            mapNextTx[tx.vin[i].prevout] = CInPoint(&mapTx[hash], i);
+            mapNextTx[tx.vin[i].prevout] = CInPoint(&tx, i);
+        nTotalUsageSize += inserted.first->GetUsageSize();
         nTransactionsUpdated++;
+
+        // a transaction put back into the pool by a reorganization can already have descendants
+        // there, which get it as an ancestor, together with whatever ancestors it brings along
+        std::set<uint256> setDescendants;
+        CalculateDescendants(entry.GetHash(), setDescendants);
+        if (setAncestors.empty()) {
+            // each descendant gains exactly this one transaction
+            UpdateAncestorState(setDescendants, inserted.first->GetTxSize(), inserted.first->GetFee(),
+                                1);
+        } else {
+            // a descendant may already have some of the new ancestors through another parent
+            RecalculateAncestorState(setDescendants);
+        }
     }
     return true;
 }
 
+void CTxMemPool::CalculateAncestors(const CTransaction& tx, std::set<uint256>& setAncestors) const
+{
+    std::vector<const CTransaction*> vToVisit;
+    vToVisit.push_back(&tx);
+    while (!vToVisit.empty()) {
+        const CTransaction* ptx = vToVisit.back();
+        vToVisit.pop_back();
+        for (const CTxIn& txin : ptx->vin) {
+            const CTransaction* pparent = lookup_unsafe(txin.prevout.hash);
+            if (pparent && setAncestors.insert(txin.prevout.hash).second)
+                vToVisit.push_back(pparent);
+        }
+    }
+}
+
+void CTxMemPool::RecalculateAncestorState(const std::set<uint256>& setHashes)
+{
+    for (const uint256& hash : setHashes) {
+        indexed_transaction_set::iterator it = mapTx.find(hash);
+        if (it == mapTx.end())
+            continue;
+        std::set<uint256> setAncestors;
+        CalculateAncestors(it->GetTx(), setAncestors);
+        int64_t nSize  = it->GetTxSize();
+        int64_t nFee   = it->GetFee();
+        int64_t nCount = 1;
+        for (const uint256& ancestorHash : setAncestors) {
+            indexed_transaction_set::const_iterator ait = mapTx.find(ancestorHash);
+            nSize += ait->GetTxSize();
+            nFee += ait->GetFee();
+            nCount++;
+        }
+        mapTx.modify(it, [nSize, nFee, nCount](CTxMemPoolEntry& e) {
+            e.UpdateAncestorState(nSize - static_cast<int64_t>(e.GetSizeWithAncestors()),
+                                  nFee - e.GetFeesWithAncestors(),
+                                  nCount - static_cast<int64_t>(e.GetCountWithAncestors()));
+        });
+    }
+}
+
+void CTxMemPool::UpdateAncestorState(const std::set<uint256>& setHashes, int64_t modifySize,
+                                     int64_t modifyFee, int64_t modifyCount)
+{
+    for (const uint256& hash : setHashes) {
+        indexed_transaction_set::iterator it = mapTx.find(hash);
+        if (it == mapTx.end())
+            continue;
+        mapTx.modify(it, [modifySize, modifyFee, modifyCount](CTxMemPoolEntry& e) {
+            e.UpdateAncestorState(modifySize, modifyFee, modifyCount);
+        });
+    }
+}
+
+void CTxMemPool::CalculateDescendants(const uint256& hash, std::set<uint256>& setDescendants) const
+{
+    std::vector<uint256> vToVisit;
+    vToVisit.push_back(hash);
+    while (!vToVisit.empty()) {
+        const uint256 parentHash = vToVisit.back();
+        vToVisit.pop_back();
+        // spenders of all the outputs of a transaction are adjacent in mapNextTx
+        for (std::map<COutPoint, CInPoint>::const_iterator it =
+                 mapNextTx.lower_bound(COutPoint(parentHash, 0));
+             it != mapNextTx.end() && it->first.hash == parentHash; ++it) {
+            const uint256 childHash = it->second.ptx->GetHash();
+            if (setDescendants.insert(childHash).second)
+                vToVisit.push_back(childHash);
+        }
+    }
+}
+
+void CTxMemPool::removeUnchecked(indexed_transaction_set::iterator it)
+{
+    // whatever spends this transaction and stays in the pool loses it as an ancestor, and the
+    // ancestors that only it connected them to
+    std::set<uint256> setDescendants;
+    CalculateDescendants(it->GetHash(), setDescendants);
+    const bool    fHasAncestors = it->GetCountWithAncestors() > 1;
+    const int64_t nSize         = it->GetTxSize();
+    const int64_t nFee          = it->GetFee();
+
+    for (const CTxIn& txin : it->GetTx().vin)
+        mapNextTx.erase(txin.prevout);
+    nTotalUsageSize -= it->GetUsageSize();
+    mapTx.erase(it);
+    nTransactionsUpdated++;
+
+    // mined transactions leave in block order, so they have no in-pool ancestors left, and recursive
+    // removals take the leaves first, so they leave no descendants behind; only a transaction with
+    // both needs its descendants' ancestors walked again
+    if (!fHasAncestors)
+        UpdateAncestorState(setDescendants, -nSize, -nFee, -1);
+    else
+        RecalculateAncestorState(setDescendants);
+}
+
 bool CTxMemPool::remove(const CTransaction& tx, bool fRecursive)
 {
     // Remove transaction from memory pool
     {
         LOCK(cs);
-        uint256 hash = tx.GetHash();
-        if (mapTx.count(hash)) {
+        uint256                           hash = tx.GetHash();
+        indexed_transaction_set::iterator it   = mapTx.find(hash);
+        if (it != mapTx.end()) {
             if (fRecursive) {
                 for (unsigned int i = 0; i < tx.vout.size(); i++) {
-                    std::map<COutPoint, CInPoint>::iterator it = mapNextTx.find(COutPoint(hash, i));
-                    if (it != mapNextTx.end())
-                        remove(*it->second.ptx, true);
+                    std::map<COutPoint, CInPoint>::iterator nit = mapNextTx.find(COutPoint(hash, i));
+                    if (nit != mapNextTx.end())
+                        remove(*nit->second.ptx, true);
                 }
             }
-            for (const CTxIn& txin : tx.vin)
-                mapNextTx.erase(txin.prevout);
-            mapTx.erase(hash);
-            nTransactionsUpdated++;
+            removeUnchecked(it);
         }
     }
     return true;
@@ -53,11 +208,29 @@ bool CTxMemPool::removeConflicts(const CTransaction& tx)
     return true;
 }
 
+void CTxMemPool::TrimToSize(std::size_t sizelimit)
+{
+    LOCK(cs);
+    std::size_t nTxnRemoved = 0;
+    while (!mapTx.empty() && nTotalUsageSize > sizelimit) {
+        // the last entry of the fee rate index pays the least per byte
+        const CTxMemPoolEntry& worst      = *mapTx.get<FeeRateTag>().rbegin();
+        const std::size_t      sizeBefore = mapTx.size();
+        remove(worst.GetTx(), true);
+        nTxnRemoved += sizeBefore - mapTx.size();
+    }
+    if (nTxnRemoved > 0)
+        printf("CTxMemPool::TrimToSize: removed %" PRIszu " transactions to stay under %" PRIszu
+               " bytes\n",
+               nTxnRemoved, sizelimit);
+}
+
 void CTxMemPool::clear()
 {
     LOCK(cs);
     mapTx.clear();
     mapNextTx.clear();
+    nTotalUsageSize = 0;
     ++nTransactionsUpdated;
 }
 
@@ -67,6 +240,6 @@ void CTxMemPool::queryHashes(std::vector<uint256>& vtxid)
 
     LOCK(cs);
     vtxid.reserve(mapTx.size());
-    for (std::map<uint256, CTransaction>::iterator mi = mapTx.begin(); mi != mapTx.end(); ++mi)
-        vtxid.push_back((*mi).first);
+    for (indexed_transaction_set::const_iterator mi = mapTx.begin(); mi != mapTx.end(); ++mi)
+        vtxid.push_back(mi->GetHash());
 }
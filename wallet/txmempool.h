@@ -4,28 +4,191 @@
 #include "transaction.h"
 #include "util.h"
 #include <map>
+#include <set>
+
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/identity.hpp>
+#include <boost/multi_index/mem_fun.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index_container.hpp>
 
 static const uint32_t MEMPOOL_HEIGHT = 0x7FFFFFFF;
 
+/** Default for -maxmempool, the maximum memory usage of the transaction memory pool in megabytes */
+static const unsigned int DEFAULT_MAX_MEMPOOL_SIZE = 300;
+
+/**
+ * A transaction in the memory pool, together with the values the pool is indexed by. Everything here is
+ * computed once when the transaction enters the pool, so that ordering the pool by fee doesn't require
+ * re-serializing or re-fetching the inputs of each transaction.
+ *
+ * The ancestor values are the sums over this transaction and all its unconfirmed ancestors in the pool.
+ */
+class CTxMemPoolEntry
+{
+    CTransaction tx;
+    uint256      hash;
+    int64_t      nFee;       // fee paid by this transaction
+    unsigned int nTxSize;    // serialized size of the transaction
+    std::size_t  nUsageSize; // estimated memory used by the entry in the pool
+    int64_t      nTime;      // local time when the transaction entered the pool
+
+    uint64_t nCountWithAncestors;
+    uint64_t nSizeWithAncestors;
+    int64_t  nFeesWithAncestors;
+
+public:
+    CTxMemPoolEntry(const CTransaction& txIn, int64_t nFeeIn, int64_t nTimeIn);
+
+    const CTransaction& GetTx() const { return tx; }
+    const uint256&      GetHash() const { return hash; }
+    int64_t             GetFee() const { return nFee; }
+    unsigned int        GetTxSize() const { return nTxSize; }
+    std::size_t         GetUsageSize() const { return nUsageSize; }
+    int64_t             GetTime() const { return nTime; }
+
+    uint64_t GetCountWithAncestors() const { return nCountWithAncestors; }
+    uint64_t GetSizeWithAncestors() const { return nSizeWithAncestors; }
+    int64_t  GetFeesWithAncestors() const { return nFeesWithAncestors; }
+
+    /** Adjusts the ancestor sums; used when ancestors enter or leave the pool */
+    void UpdateAncestorState(int64_t modifySize, int64_t modifyFee, int64_t modifyCount);
+};
+
+/** Sorts by fee rate (fee / size), highest first; ties are broken by hash */
+struct CompareTxMemPoolEntryByFeeRate
+{
+    bool operator()(const CTxMemPoolEntry& a, const CTxMemPoolEntry& b) const
+    {
+        // cross-multiply instead of dividing to keep the comparison exact for equal rates
+        const double f1 = static_cast<double>(a.GetFee()) * b.GetTxSize();
+        const double f2 = static_cast<double>(b.GetFee()) * a.GetTxSize();
+        if (f1 == f2)
+            return a.GetHash() < b.GetHash();
+        return f1 > f2;
+    }
+};
+
+/**
+ * Sorts by ancestor score, highest first; ties are broken by hash.
+ * The ancestor score of a transaction is the lower of its own fee rate and the fee rate of the package
+ * made of it and its ancestors. Taking the minimum keeps a high-fee child from pulling a low-fee
+ * transaction ahead of where it belongs.
+ */
+struct CompareTxMemPoolEntryByAncestorFee
+{
+    static void GetScore(const CTxMemPoolEntry& e, double& fee, double& size)
+    {
+        const double fFeeAncestors  = static_cast<double>(e.GetFeesWithAncestors());
+        const double fSizeAncestors = static_cast<double>(e.GetSizeWithAncestors());
+        if (fFeeAncestors * e.GetTxSize() < static_cast<double>(e.GetFee()) * fSizeAncestors) {
+            fee  = fFeeAncestors;
+            size = fSizeAncestors;
+        } else {
+            fee  = static_cast<double>(e.GetFee());
+            size = static_cast<double>(e.GetTxSize());
+        }
+    }
+
+    bool operator()(const CTxMemPoolEntry& a, const CTxMemPoolEntry& b) const
+    {
+        double aFee, aSize, bFee, bSize;
+        GetScore(a, aFee, aSize);
+        GetScore(b, bFee, bSize);
+        const double f1 = aFee * bSize;
+        const double f2 = bFee * aSize;
+        if (f1 == f2)
+            return a.GetHash() < b.GetHash();
+        return f1 > f2;
+    }
+};
+
+struct CompareTxMemPoolEntryByEntryTime
+{
+    bool operator()(const CTxMemPoolEntry& a, const CTxMemPoolEntry& b) const
+    {
+        return a.GetTime() < b.GetTime();
+    }
+};
+
+struct TxidTag
+{
+};
+struct FeeRateTag
+{
+};
+struct AncestorScoreTag
+{
+};
+struct EntryTimeTag
+{
+};
+
 class CTxMemPool
 {
 public:
-    mutable CCriticalSection        cs;
-    std::map<uint256, CTransaction> mapTx;
-    std::map<COutPoint, CInPoint>   mapNextTx;
+    using indexed_transaction_set = boost::multi_index_container<
+        CTxMemPoolEntry,
+        boost::multi_index::indexed_by<
+            // the default index; lookup by txid
+            boost::multi_index::hashed_unique<
+                boost::multi_index::tag<TxidTag>,
+                boost::multi_index::const_mem_fun<CTxMemPoolEntry, const uint256&,
+                                                  &CTxMemPoolEntry::GetHash>,
+                std::hash<uint256>>,
+            boost::multi_index::ordered_non_unique<boost::multi_index::tag<FeeRateTag>,
+                                                   boost::multi_index::identity<CTxMemPoolEntry>,
+                                                   CompareTxMemPoolEntryByFeeRate>,
+            boost::multi_index::ordered_non_unique<boost::multi_index::tag<AncestorScoreTag>,
+                                                   boost::multi_index::identity<CTxMemPoolEntry>,
+                                                   CompareTxMemPoolEntryByAncestorFee>,
+            boost::multi_index::ordered_non_unique<boost::multi_index::tag<EntryTimeTag>,
+                                                   boost::multi_index::identity<CTxMemPoolEntry>,
+                                                   CompareTxMemPoolEntryByEntryTime>>>;
+
+    mutable CCriticalSection      cs;
+    indexed_transaction_set       mapTx;
+    std::map<COutPoint, CInPoint> mapNextTx;
 
-    bool addUnchecked(const uint256& hash, const CTransaction& tx);
+private:
+    std::size_t nTotalUsageSize = 0; // sum of the usage sizes of all the entries
+
+    /** Hashes of all the in-pool transactions whose outputs the given one spends, recursively */
+    void CalculateAncestors(const CTransaction& tx, std::set<uint256>& setAncestors) const;
+    /** Hashes of all the in-pool transactions that spend outputs of the given one, recursively */
+    void CalculateDescendants(const uint256& hash, std::set<uint256>& setDescendants) const;
+    /** Sets the ancestor sums of the given entries to those of their current in-pool ancestors */
+    void RecalculateAncestorState(const std::set<uint256>& setHashes);
+    /** Adds the same amounts to the ancestor sums of each of the given entries */
+    void UpdateAncestorState(const std::set<uint256>& setHashes, int64_t modifySize, int64_t modifyFee,
+                             int64_t modifyCount);
+    void removeUnchecked(indexed_transaction_set::iterator it);
+
+public:
+    bool addUnchecked(const CTxMemPoolEntry& entry);
     bool remove(const CTransaction& tx, bool fRecursive = false);
     bool removeConflicts(const CTransaction& tx);
     void clear();
     void queryHashes(std::vector<uint256>& vtxid);
 
+    /**
+     * Evicts the lowest fee rate transactions, together with everything in the pool that spends them,
+     * until the estimated memory usage of the pool is at most sizelimit bytes
+     */
+    void TrimToSize(std::size_t sizelimit);
+
     unsigned long size() const
     {
         LOCK(cs);
         return mapTx.size();
     }
 
+    std::size_t DynamicMemoryUsage() const
+    {
+        LOCK(cs);
+        return nTotalUsageSize;
+    }
+
     bool exists(uint256 hash) const
     {
         LOCK(cs);
@@ -35,10 +198,10 @@ public:
     bool lookup(uint256 hash, CTransaction& result) const
     {
         LOCK(cs);
-        std::map<uint256, CTransaction>::const_iterator i = mapTx.find(hash);
+        indexed_transaction_set::const_iterator i = mapTx.find(hash);
         if (i == mapTx.end())
             return false;
-        result = i->second;
+        result = i->GetTx();
         return true;
     }
 
@@ -53,7 +216,7 @@ public:
     {
         auto it = mapTx.find(hash);
         if (it != mapTx.cend())
-            return &it->second;
+            return &it->GetTx();
         else
             return nullptr;
     }
@@ -218,6 +218,8 @@ void                           ParseParameters(int argc, const char* const argv[
 bool                           WildcardMatch(const char* psz, const char* mask);
 bool                           WildcardMatch(const std::string& str, const std::string& mask);
 void                           FileCommit(FILE* fileout);
+/** Raises the soft limit of open files to nMinFD if possible; returns the limit in effect */
+int                            RaiseFileDescriptorLimit(int nMinFD);
 bool                           RenameOver(boost::filesystem::path src, boost::filesystem::path dest);
 boost::filesystem::path        GetDefaultDataDir();
 const boost::filesystem::path& GetDataDir(bool fNetSpecific = true);
@@ -105,6 +105,15 @@ contains(USE_UPNP, -) {
     win32:LIBS += -liphlpapi
 }
 
+# use: qmake "USE_SECP256K1=1" to sign and verify ECDSA signatures with libsecp256k1 instead of OpenSSL
+# libsecp256k1 (https://github.com/bitcoin-core/secp256k1) must be installed, with its recovery module
+contains(USE_SECP256K1, 1) {
+    message(Building with libsecp256k1 support)
+    DEFINES += USE_SECP256K1
+    INCLUDEPATH += $$SECP256K1_INCLUDE_PATH
+    LIBS += $$join(SECP256K1_LIB_PATH,,-L,) -lsecp256k1
+}
+
 # use: qmake "USE_DBUS=1" or qmake "USE_DBUS=0"
 linux:count(USE_DBUS, 0) {
     USE_DBUS=1
@@ -15,8 +15,11 @@
 #include "txmempool.h"
 #include "ui_interface.h"
 #include "walletdb.h"
+#include <atomic>
 #include <boost/algorithm/string/replace.hpp>
 #include <boost/make_shared.hpp>
+#include <future>
+#include <thread>
 
 using namespace std;
 
@@ -275,6 +278,9 @@ bool CWallet::ChangeWalletPassphrase(const SecureString& strOldWalletPassphrase,
 
 void CWallet::SetBestChain(const CBlockLocator& loc)
 {
+    // a rescan writes how far it got, so that it's resumed on the next start if it's interrupted
+    if (fRescanning)
+        return;
     CWalletDB walletdb(strWalletFile);
     if (!walletdb.WriteBestBlock(loc))
         printf("Failed to write best chain to wallet at: %s\n",
@@ -451,6 +457,8 @@ void CWallet::MarkDirty()
         LOCK(cs_wallet);
         for (PAIRTYPE(const uint256, CWalletTx) & item : mapWallet)
             item.second.MarkDirty();
+        // what's ours may have changed too
+        fUnspentIndexBuilt = false;
     }
 }
 
@@ -585,6 +593,7 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             wtx.nIndex    = -1;
             wtx.hashBlock = hashBlock;
             wtx.MarkDirty();
+            MarkUnspentDirty(now);
             wtx.WriteToDisk(&walletdb);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them
             // conflicted too
@@ -599,8 +608,10 @@ void CWallet::MarkConflicted(const uint256& hashBlock, const uint256& hashTx)
             // If a transaction changes 'conflicted' state, that changes the balance
             // available of the outputs it spends. So force those to be recomputed
             for (const CTxIn& txin : wtx.vin) {
-                if (mapWallet.count(txin.prevout.hash))
+                if (mapWallet.count(txin.prevout.hash)) {
                     mapWallet[txin.prevout.hash].MarkDirty();
+                    MarkUnspentDirty(txin.prevout.hash);
+                }
             }
         }
     }
@@ -644,6 +655,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
         wtx.BindWallet(this);
         wtxOrdered.insert(std::make_pair(wtx.nOrderPos, TxPair(&wtx, (CAccountingEntry*)0)));
         AddToSpends(hash);
+        MarkUnspentDirty(hash);
     } else {
 
         LOCK(cs_wallet);
@@ -708,6 +720,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet, CWalletD
 
         // Break debit/credit balance caches:
         wtx.MarkDirty();
+        MarkUnspentDirty(hash);
 
         // Notify UI of new or updated transaction
         NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
@@ -736,19 +749,24 @@ bool CWallet::AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pbl
 
         if (pblock && !tx.IsCoinBase()) {
             for (const CTxIn& txin : tx.vin) {
-                auto txSpends = mapTxSpends.get();
-                std::pair<TxSpends::const_iterator, TxSpends::const_iterator> range =
-                    txSpends.equal_range(txin.prevout);
-                while (range.first != range.second) {
-                    if (range.first->second != tx.GetHash()) {
-                        printf("Transaction %s (in block %s) conflicts with wallet transaction %s "
-                               "(both spend %s:%i)\n",
-                               tx.GetHash().ToString().c_str(), pblock->GetHash().ToString().c_str(),
-                               range.first->second.ToString().c_str(),
-                               range.first->first.hash.ToString().c_str(), range.first->first.n);
-                        MarkConflicted(pblock->GetHash(), range.first->second);
+                std::vector<uint256> vConflicts;
+                {
+                    auto            lock     = mapTxSpends.get_lock();
+                    const TxSpends& txSpends = mapTxSpends.get_unsafe();
+                    std::pair<TxSpends::const_iterator, TxSpends::const_iterator> range =
+                        txSpends.equal_range(txin.prevout);
+                    for (; range.first != range.second; range.first++) {
+                        if (range.first->second != hash)
+                            vConflicts.push_back(range.first->second);
                     }
-                    range.first++;
+                }
+                for (const uint256& hashConflict : vConflicts) {
+                    printf("Transaction %s (in block %s) conflicts with wallet transaction %s "
+                           "(both spend %s:%i)\n",
+                           hash.ToString().c_str(), pblock->GetHash().ToString().c_str(),
+                           hashConflict.ToString().c_str(), txin.prevout.hash.ToString().c_str(),
+                           txin.prevout.n);
+                    MarkConflicted(pblock->GetHash(), hashConflict);
                 }
             }
         }
@@ -778,8 +796,15 @@ bool CWallet::EraseFromWallet(uint256 hash)
         return false;
     {
         LOCK(cs_wallet);
-        if (mapWallet.erase(hash))
+        auto it = mapWallet.find(hash);
+        if (it != mapWallet.end()) {
+            // the outputs it spent may be unspent again
+            for (const CTxIn& txin : it->second.vin)
+                MarkUnspentDirty(txin.prevout.hash);
+            MarkUnspentDirty(hash);
+            mapWallet.erase(it);
             CWalletDB(strWalletFile).EraseTx(hash);
+        }
     }
     return true;
 }
@@ -1056,45 +1081,258 @@ bool CWalletTx::WriteToDisk(CWalletDB* pwalletdb)
     return CWalletDB(pwallet->strWalletFile).WriteTx(GetHash(), *this);
 }
 
+bool CWalletScanFilter::IsRelevant(const CTransaction& tx) const
+{
+    if (setTxHashes.count(tx.GetHash()))
+        return true;
+    for (const CTxIn& txin : tx.vin) {
+        if (setTxHashes.count(txin.prevout.hash))
+            return true;
+    }
+    // every output IsMine() accepts pays to one of our keys or scripts
+    for (const CTxOut& txout : tx.vout) {
+        std::vector<valtype> vSolutions;
+        txnouttype           whichType;
+        if (!Solver(txout.scriptPubKey, whichType, vSolutions))
+            continue;
+        for (const valtype& solution : vSolutions) {
+            if (solution.size() == 20 && setIDs.count(uint160(solution)))
+                return true;
+            if ((solution.size() == 33 || solution.size() == 65) &&
+                setIDs.count(CPubKey(solution).GetID()))
+                return true;
+        }
+    }
+    return false;
+}
+
+CWalletScanFilter CWallet::GetScanFilter() const
+{
+    CWalletScanFilter filter;
+
+    std::set<CKeyID> setKeys;
+    GetKeys(setKeys);
+    filter.setIDs.insert(setKeys.begin(), setKeys.end());
+    {
+        LOCK(cs_KeyStore);
+        for (const auto& p : mapScripts)
+            filter.setIDs.insert(p.first);
+    }
+
+    LOCK(cs_wallet);
+    for (const auto& p : mapWallet)
+        filter.setTxHashes.insert(filter.setTxHashes.end(), p.first);
+    {
+        // conflicts with what the wallet spends
+        auto lock = mapTxSpends.get_lock();
+        for (const auto& p : mapTxSpends.get_unsafe())
+            filter.setTxHashes.insert(p.first.hash);
+    }
+    return filter;
+}
+
+// how many blocks a rescan reads ahead, and then applies to the wallet at once
+static const std::size_t RESCAN_BATCH_SIZE = 256;
+
+namespace {
+/** A block read by a rescan, with the transactions that its filter matched */
+struct CRescanBlock
+{
+    CBlockIndexSmartPtr       pindex;
+    CBlock                    block;
+    bool                      fRead;
+    std::vector<unsigned int> vMatches;
+
+    explicit CRescanBlock(const CBlockIndexSmartPtr& pindexIn) : pindex(pindexIn), fRead(false) {}
+};
+} // namespace
+
+// reads the blocks and runs the filter on their transactions, with as many threads as there are cores
+static void ReadRescanBlocks(std::vector<CRescanBlock>* pvBlocks, const CWalletScanFilter* pfilter)
+{
+    std::atomic<std::size_t> nNext(0);
+
+    auto worker = [pvBlocks, pfilter, &nNext]() {
+        for (std::size_t i = nNext++; i < pvBlocks->size(); i = nNext++) {
+            CRescanBlock& rescanBlock = (*pvBlocks)[i];
+            try {
+                rescanBlock.fRead = rescanBlock.block.ReadFromDisk(rescanBlock.pindex.get(), true);
+            } catch (std::exception& ex) {
+                printf("Error while reading block %s for a rescan: %s\n",
+                       rescanBlock.pindex->GetBlockHash().ToString().c_str(), ex.what());
+                rescanBlock.fRead = false;
+            }
+            if (!rescanBlock.fRead)
+                continue;
+            for (unsigned int j = 0; j < rescanBlock.block.vtx.size(); j++) {
+                if (pfilter->IsRelevant(rescanBlock.block.vtx[j]))
+                    rescanBlock.vMatches.push_back(j);
+            }
+        }
+    };
+
+    const unsigned int       nThreads = std::max(1u, boost::thread::hardware_concurrency());
+    std::vector<std::thread> vThreads;
+    for (unsigned int i = 1; i < nThreads; i++)
+        vThreads.emplace_back(worker);
+    worker();
+    for (std::thread& thread : vThreads)
+        thread.join();
+}
+
 // Scan the block chain (starting in pindexStart) for transactions
 // from or to us. If fUpdate is true, found transactions that already
 // exist in the wallet will be updated.
+//
+// Blocks are read and filtered by a pool of threads, a batch ahead of the one that's applied to the
+// wallet. Only the transactions the filter matches go through AddToWalletIfInvolvingMe(), under
+// cs_main and cs_wallet, which are held for one batch at a time. The progress is written as the
+// wallet's best block, so that an interrupted rescan is resumed on the next start.
 int CWallet::ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate)
 {
     int ret = 0;
 
-    CBlockIndex* pindex = pindexStart;
+    LOCK(cs_rescan);
+    fRescanning = true;
+    try {
+        ret = ScanForWalletTransactionsInBatches(pindexStart, fUpdate);
+    } catch (...) {
+        fRescanning = false;
+        throw;
+    }
+    fRescanning = false;
+
+    uiInterface.InitMessage(_("Updating wallet on disk (do not shutdown)..."));
+    FlushWalletDB(true, strWalletFile, nullptr);
+    uiInterface.InitMessage(_("Rescanning... ") + "(done)");
+    return ret;
+}
 
-    uint64_t blockCount = pindexStart->nHeight;
+int CWallet::ScanForWalletTransactionsInBatches(CBlockIndex* pindexStart, bool fUpdate)
+{
+    int ret = 0;
 
-    {
-        LOCK2(cs_main, cs_wallet);
-        while (pindex) {
-            blockCount++;
+    const CWalletScanFilter filter = GetScanFilter();
 
-            if (blockCount % 1000 == 0) {
-                uiInterface.InitMessage(_("Rescanning... ") + "(block: " + std::to_string(blockCount) +
-                                        "/" + std::to_string(nBestHeight) + ")");
-            }
+    // the next block to read
+    CBlockIndexSmartPtr pindexNext;
+    {
+        LOCK(cs_main);
+        BlockIndexMapType::iterator mi = mapBlockIndex.find(pindexStart->GetBlockHash());
+        if (mi != mapBlockIndex.end())
+            pindexNext = boost::atomic_load(&mi->second);
+    }
 
+    // the next batch of blocks, from pindexNext on
+    auto nextBatch = [this, &pindexNext]() {
+        std::vector<CRescanBlock> vBlocks;
+        LOCK(cs_main);
+        while (pindexNext && vBlocks.size() < RESCAN_BATCH_SIZE) {
             // no need to read and scan block, if block was created before
             // our wallet birthday (as adjusted for block time variability)
-            if (nTimeFirstKey && (pindex->nTime < (nTimeFirstKey - 7200))) {
-                pindex = boost::atomic_load(&pindex->pnext).get();
-                continue;
+            if (!nTimeFirstKey || pindexNext->nTime >= nTimeFirstKey - 7200)
+                vBlocks.emplace_back(pindexNext);
+            pindexNext = boost::atomic_load(&pindexNext->pnext);
+        }
+        return vBlocks;
+    };
+
+    std::vector<CRescanBlock> vBlocks = nextBatch();
+    ReadRescanBlocks(&vBlocks, &filter);
+
+    // the transactions added by this rescan, and what they spend, that the filter doesn't know about
+    std::set<uint256> setScanned;
+
+    CTxDB      txdb("r");
+    const bool fPruned        = txdb.HavePrunedBlocks();
+    unsigned   nPrunedSkipped = 0;
+
+    while (!vBlocks.empty() && !fShutdown) {
+        std::vector<CRescanBlock> vNextBlocks = nextBatch();
+        std::future<void>         readNext =
+            std::async(std::launch::async, ReadRescanBlocks, &vNextBlocks, &filter);
+
+        bool fReorganized = false;
+        {
+            LOCK2(cs_main, cs_wallet);
+            for (CRescanBlock& rescanBlock : vBlocks) {
+                if (!rescanBlock.pindex->IsInMainChain()) {
+                    // carry on from where the main chain forked off
+                    CBlockIndexSmartPtr pindexFork = rescanBlock.pindex;
+                    while (pindexFork->pprev && !pindexFork->IsInMainChain())
+                        pindexFork = boost::atomic_load(&pindexFork->pprev);
+                    pindexNext   = boost::atomic_load(&pindexFork->pnext);
+                    fReorganized = true;
+                    break;
+                }
+                if (!rescanBlock.fRead) {
+                    // only blocks whose outputs are all spent are pruned, so the balance is still
+                    // right without them, but the history of those outputs is missing
+                    if (fPruned && !txdb.ContainsBlock(rescanBlock.pindex->blockKeyInDB)) {
+                        nPrunedSkipped++;
+                        continue;
+                    }
+                    printf("ScanForWalletTransactions() : failed to read block %s\n",
+                           rescanBlock.pindex->GetBlockHash().ToString().c_str());
+                    continue;
+                }
+
+                std::vector<unsigned int>::const_iterator itMatch = rescanBlock.vMatches.begin();
+                for (unsigned int j = 0; j < rescanBlock.block.vtx.size(); j++) {
+                    const CTransaction& tx = rescanBlock.block.vtx[j];
+                    if (itMatch != rescanBlock.vMatches.end() && *itMatch == j) {
+                        ++itMatch;
+                    } else {
+                        bool fSpendsScanned = false;
+                        for (const CTxIn& txin : tx.vin) {
+                            if (setScanned.count(txin.prevout.hash)) {
+                                fSpendsScanned = true;
+                                break;
+                            }
+                        }
+                        if (!fSpendsScanned)
+                            continue;
+                    }
+
+                    const uint256 hash = tx.GetHash();
+                    if (AddToWalletIfInvolvingMe(tx, &rescanBlock.block, fUpdate))
+                        ret++;
+                    if (!filter.setTxHashes.count(hash) && mapWallet.count(hash)) {
+                        setScanned.insert(hash);
+                        for (const CTxIn& txin : tx.vin)
+                            setScanned.insert(txin.prevout.hash);
+                    }
+                }
             }
 
-            CBlock block;
-            block.ReadFromDisk(pindex, true);
-            for (CTransaction& tx : block.vtx) {
-                if (AddToWalletIfInvolvingMe(tx, &block, fUpdate))
-                    ret++;
+            const CBlockIndex* pindexLast = vBlocks.back().pindex.get();
+            if (!fReorganized && pindexLast->IsInMainChain()) {
+                CWalletDB(strWalletFile).WriteBestBlock(CBlockLocator(pindexLast));
+                uiInterface.InitMessage(_("Rescanning... ") + "(block: " +
+                                        std::to_string(pindexLast->nHeight) + "/" +
+                                        std::to_string(nBestHeight) + ")");
             }
-            pindex = boost::atomic_load(&pindex->pnext).get();
         }
-        uiInterface.InitMessage(_("Updating wallet on disk (do not shutdown)..."));
-        FlushWalletDB(true, strWalletFile, nullptr);
-        uiInterface.InitMessage(_("Rescanning... ") + "(done)");
+
+        readNext.get();
+        if (fReorganized) {
+            vBlocks = nextBatch();
+            ReadRescanBlocks(&vBlocks, &filter);
+        } else {
+            vBlocks.swap(vNextBlocks);
+        }
+    }
+
+    if (nPrunedSkipped > 0) {
+        printf("ScanForWalletTransactions() : skipped %u pruned blocks; transactions in them are "
+               "missing from the wallet\n",
+               nPrunedSkipped);
+    }
+
+    if (!fShutdown) {
+        // the blocks connected meanwhile were synced with the wallet as usual
+        LOCK(cs_main);
+        CWalletDB(strWalletFile).WriteBestBlock(CBlockLocator(pindexBest.get()));
     }
     return ret;
 }
@@ -1192,35 +1430,194 @@ void CWallet::ResendWalletTransactions(bool fForce)
 // Actions
 //
 
-CAmount CWallet::GetBalance() const
+void CWallet::MarkUnspentDirty(const uint256& hash)
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end();
-             ++it) {
-            const CWalletTx* pcoin = &(*it).second;
-            if (pcoin->IsTrusted()) {
-                nTotal += pcoin->GetAvailableCredit();
+    AssertLockHeld(cs_wallet);
+    if (fUnspentIndexBuilt)
+        setUnspentDirty.insert(hash);
+}
+
+std::vector<std::pair<unsigned int, uint256>> CWallet::GetSpends(const uint256& hash) const
+{
+    std::vector<std::pair<unsigned int, uint256>> result;
+
+    auto            lock     = mapTxSpends.get_lock();
+    const TxSpends& txSpends = mapTxSpends.get_unsafe();
+    for (TxSpends::const_iterator it = txSpends.lower_bound(COutPoint(hash, 0));
+         it != txSpends.end() && it->first.hash == hash; ++it) {
+        result.push_back(std::make_pair(it->first.n, it->second));
+    }
+    return result;
+}
+
+/**
+ * Whether the transaction belongs in the unspent index. fVolatile is set if that may change without
+ * the wallet being told, i.e. with no call to MarkUnspentDirty().
+ */
+bool CWallet::IsUnspentIndexed(const CWalletTx& wtx, bool& fVolatile) const
+{
+    fVolatile = false;
+
+    if ((wtx.IsCoinBase() || wtx.IsCoinStake()) && wtx.GetBlocksToMaturity() > 0) {
+        // immature credit counts the spent outputs too. One that's not in the main chain counts for
+        // nothing, and is marked dirty again if its block is connected.
+        fVolatile = wtx.IsInMainChain();
+        return fVolatile;
+    }
+
+    const std::vector<std::pair<unsigned int, uint256>> vSpends = GetSpends(wtx.GetHash());
+
+    bool fIndexed = false;
+    for (unsigned int i = 0; i < wtx.vout.size(); i++) {
+        if (IsMine(wtx.vout[i]) == ISMINE_NO)
+            continue;
+
+        // the same rules as IsSpent()
+        bool fSpent = false;
+        for (const auto& spend : vSpends) {
+            if (spend.first != i)
+                continue;
+            std::map<uint256, CWalletTx>::const_iterator mit = mapWallet.find(spend.second);
+            if (mit == mapWallet.end())
+                continue;
+            const CWalletTx& spender = mit->second;
+            const int        nDepth  = spender.GetDepthInMainChain();
+            if (spender.IsCoinStake()) {
+                // a coinstake stops spending the output once its block is disconnected, and the wallet
+                // isn't told about that
+                if (nDepth > 0) {
+                    fSpent = true;
+                    if (spender.GetBlocksToMaturity() > 0)
+                        fVolatile = true;
+                }
+            } else if (nDepth > 0 || (nDepth == 0 && !spender.isAbandoned())) {
+                fSpent = true;
             }
         }
+        if (!fSpent)
+            fIndexed = true;
     }
+    return fIndexed;
+}
+
+void CWallet::UpdateUnspentIndex() const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
 
-    return nTotal;
+    std::set<uint256> todo;
+    if (!fUnspentIndexBuilt) {
+        setUnspentIndex.clear();
+        setUnspentDirty.clear();
+        setUnspentVolatile.clear();
+        for (const auto& p : mapWallet)
+            todo.insert(todo.end(), p.first);
+        fUnspentIndexBuilt = true;
+    } else {
+        if (setUnspentDirty.empty() && hashUnspentIndexBestChain == hashBestChain)
+            return;
+        // whether the outputs a transaction spends are spent depends on it
+        for (const uint256& hash : setUnspentDirty) {
+            todo.insert(hash);
+            std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hash);
+            if (it == mapWallet.end())
+                continue;
+            for (const CTxIn& txin : it->second.vin) {
+                if (mapWallet.count(txin.prevout.hash))
+                    todo.insert(txin.prevout.hash);
+            }
+        }
+        setUnspentDirty.clear();
+        if (hashUnspentIndexBestChain != hashBestChain)
+            todo.insert(setUnspentVolatile.begin(), setUnspentVolatile.end());
+    }
+    hashUnspentIndexBestChain = hashBestChain;
+
+    for (const uint256& hash : todo) {
+        std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hash);
+        bool fVolatile = false;
+        if (it != mapWallet.end() && IsUnspentIndexed(it->second, fVolatile))
+            setUnspentIndex.insert(hash);
+        else
+            setUnspentIndex.erase(hash);
+        if (fVolatile)
+            setUnspentVolatile.insert(hash);
+        else
+            setUnspentVolatile.erase(hash);
+    }
+    nUnspentIndexGeneration++;
 }
 
-CAmount CWallet::GetColdStakingBalance() const
+const CWallet::CBalances& CWallet::GetBalances() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (const auto& p : mapWallet) {
-            const CWalletTx& pcoin = p.second;
-            if (pcoin.HasP2CSOutputs() && pcoin.IsTrusted())
-                nTotal += pcoin.GetColdStakingCredit();
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    UpdateUnspentIndex();
+    const uint32_t nTxUpdated = nTransactionsUpdated;
+    if (cachedBalances && fCachedBalancesFinal && nBalancesIndexGeneration == nUnspentIndexGeneration &&
+        hashBalancesBestChain == hashBestChain && nBalancesTransactionsUpdated == nTxUpdated) {
+        return *cachedBalances;
+    }
+
+    CBalances balances = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+    // lock times can expire with no new block, so balances with non-final transactions aren't kept
+    bool fAllFinal = true;
+    for (const uint256& hash : setUnspentIndex) {
+        std::map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hash);
+        if (it == mapWallet.end())
+            continue;
+        const CWalletTx& pcoin = it->second;
+
+        if (!IsFinalTx(pcoin))
+            fAllFinal = false;
+
+        const bool fTrusted = pcoin.IsTrusted();
+        if (fTrusted) {
+            balances.nBalance += pcoin.GetAvailableCredit();
+            if (pcoin.HasP2CSOutputs()) {
+                balances.nColdStaking += pcoin.GetColdStakingCredit();
+                balances.nDelegated += pcoin.GetStakeDelegationCredit();
+            }
+        } else if (pcoin.GetDepthInMainChain() == 0 && pcoin.InMempool()) {
+            balances.nUnconfirmed += pcoin.GetAvailableCredit();
+        }
+
+        balances.nImmatureColdStaking += pcoin.GetImmatureCredit(false, ISMINE_COLD);
+        balances.nImmatureDelegated += pcoin.GetImmatureCredit(false, ISMINE_SPENDABLE_DELEGATED);
+
+        if ((pcoin.IsCoinBase() || pcoin.IsCoinStake()) && pcoin.GetBlocksToMaturity() > 0) {
+            const int nDepth = pcoin.GetDepthInMainChain();
+            if (pcoin.IsCoinBase() && nDepth > 0)
+                balances.nImmature += pcoin.GetImmatureCredit(false);
+            if (nDepth > 0) {
+                const CAmount nCredit = CWallet::GetCredit(pcoin, ISMINE_SPENDABLE_ALL, true);
+                if (pcoin.IsCoinStake())
+                    balances.nStake += nCredit;
+                else
+                    balances.nNewMint += nCredit;
+            }
         }
     }
-    return nTotal;
+
+    cachedBalances               = balances;
+    fCachedBalancesFinal         = fAllFinal;
+    nBalancesIndexGeneration     = nUnspentIndexGeneration;
+    hashBalancesBestChain        = hashBestChain;
+    nBalancesTransactionsUpdated = nTxUpdated;
+    return *cachedBalances;
+}
+
+CAmount CWallet::GetBalance() const
+{
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nBalance;
+}
+
+CAmount CWallet::GetColdStakingBalance() const
+{
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nColdStaking;
 }
 
 CAmount CWallet::GetStakingBalance(const bool fIncludeColdStaking) const
@@ -1231,71 +1628,32 @@ CAmount CWallet::GetStakingBalance(const bool fIncludeColdStaking) const
 
 CAmount CWallet::GetDelegatedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (const auto& p : mapWallet) {
-            const CWalletTx& pcoin = p.second;
-            if (pcoin.HasP2CSOutputs() && pcoin.IsTrusted())
-                nTotal += pcoin.GetStakeDelegationCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nDelegated;
 }
 
 CAmount CWallet::GetUnconfirmedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (const auto& p : mapWallet) {
-            const CWalletTx& pcoin = p.second;
-            if (!pcoin.IsTrusted() && pcoin.GetDepthInMainChain() == 0 && pcoin.InMempool())
-                nTotal += pcoin.GetAvailableCredit();
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nUnconfirmed;
 }
 
 CAmount CWallet::GetImmatureColdStakingBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (const auto& p : mapWallet) {
-            const CWalletTx& pcoin = p.second;
-            nTotal += pcoin.GetImmatureCredit(false, ISMINE_COLD);
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nImmatureColdStaking;
 }
 
 CAmount CWallet::GetImmatureDelegatedBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (const auto& p : mapWallet) {
-            const CWalletTx& pcoin = p.second;
-            nTotal += pcoin.GetImmatureCredit(false, ISMINE_SPENDABLE_DELEGATED);
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nImmatureDelegated;
 }
 
 CAmount CWallet::GetImmatureBalance() const
 {
-    CAmount nTotal = 0;
-    {
-        LOCK2(cs_main, cs_wallet);
-        for (const auto& p : mapWallet) {
-            const CWalletTx& pcoin = p.second;
-            if (pcoin.IsCoinBase() && pcoin.GetBlocksToMaturity() > 0 && pcoin.IsInMainChain()) {
-                nTotal += pcoin.GetImmatureCredit(false);
-            }
-        }
-    }
-    return nTotal;
+    LOCK2(cs_main, cs_wallet);
+    return GetBalances().nImmature;
 }
 
 // populate vCoins with vector of spendable COutputs
@@ -1305,8 +1663,11 @@ void CWallet::AvailableCoins(vector<COutput>& vCoins, bool fOnlyConfirmed, bool
     vCoins.clear();
     {
         LOCK2(cs_main, cs_wallet);
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end();
-             ++it) {
+        UpdateUnspentIndex();
+        for (const uint256& hash : setUnspentIndex) {
+            map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hash);
+            if (it == mapWallet.end())
+                continue;
             const CWalletTx* pcoin = &(*it).second;
 
             if (!IsFinalTx(*pcoin))
@@ -1378,9 +1739,12 @@ void CWallet::GetAvailableP2CSCoins(std::vector<COutput>& vCoins) const
     vCoins.clear();
     {
         LOCK2(cs_main, cs_wallet);
-        for (const auto& it : mapWallet) {
-            const uint256&   wtxid = it.first;
-            const CWalletTx* pcoin = &it.second;
+        UpdateUnspentIndex();
+        for (const uint256& wtxid : setUnspentIndex) {
+            map<uint256, CWalletTx>::const_iterator it = mapWallet.find(wtxid);
+            if (it == mapWallet.end())
+                continue;
+            const CWalletTx* pcoin = &it->second;
 
             bool fConflicted;
             int  nDepth = pcoin->GetDepthAndMempool(fConflicted);
@@ -1415,9 +1779,12 @@ void CWallet::AvailableCoinsForStaking(vector<COutput>& vCoins, unsigned int nSp
 
     {
         LOCK2(cs_main, cs_wallet);
+        UpdateUnspentIndex();
         unsigned int nSMA = Params().StakeMinAge();
-        for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end();
-             ++it) {
+        for (const uint256& hash : setUnspentIndex) {
+            map<uint256, CWalletTx>::const_iterator it = mapWallet.find(hash);
+            if (it == mapWallet.end())
+                continue;
             const CWalletTx* pcoin = &(*it).second;
 
             // Filtering by tx timestamp instead of block timestamp may give false positives but never
@@ -1537,26 +1904,14 @@ static void ApproximateBestSubset(vector<pair<CAmount, pair<const CWalletTx*, un
 // ppcoin: total coins staked (non-spendable until maturity)
 CAmount CWallet::GetStake() const
 {
-    CAmount nTotal = 0;
     LOCK2(cs_main, cs_wallet);
-    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-        const CWalletTx* pcoin = &(*it).second;
-        if (pcoin->IsCoinStake() && pcoin->GetBlocksToMaturity() > 0 && pcoin->GetDepthInMainChain() > 0)
-            nTotal += CWallet::GetCredit(*pcoin, ISMINE_SPENDABLE_ALL, true);
-    }
-    return nTotal;
+    return GetBalances().nStake;
 }
 
 CAmount CWallet::GetNewMint() const
 {
-    CAmount nTotal = 0;
     LOCK2(cs_main, cs_wallet);
-    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
-        const CWalletTx* pcoin = &(*it).second;
-        if (pcoin->IsCoinBase() && pcoin->GetBlocksToMaturity() > 0 && pcoin->GetDepthInMainChain() > 0)
-            nTotal += CWallet::GetCredit(*pcoin, ISMINE_SPENDABLE_ALL, true);
-    }
-    return nTotal;
+    return GetBalances().nNewMint;
 }
 
 bool CWallet::AddAccountingEntry(const CAccountingEntry& acentry, CWalletDB& pwalletdb)
@@ -1706,14 +2061,18 @@ bool CWallet::SelectCoinsMinConf(CAmount nTargetValue, unsigned int nSpendTime,
  */
 bool CWallet::IsSpent(const uint256& hash, unsigned int n) const
 {
-    const COutPoint                                               outpoint(hash, n);
-    std::pair<TxSpends::const_iterator, TxSpends::const_iterator> range;
-
-    auto txSpends = mapTxSpends.get();
-    range         = txSpends.equal_range(outpoint);
+    const COutPoint      outpoint(hash, n);
+    std::vector<uint256> vSpenders;
+    {
+        auto            lock     = mapTxSpends.get_lock();
+        const TxSpends& txSpends = mapTxSpends.get_unsafe();
+        std::pair<TxSpends::const_iterator, TxSpends::const_iterator> range =
+            txSpends.equal_range(outpoint);
+        for (TxSpends::const_iterator it = range.first; it != range.second; ++it)
+            vSpenders.push_back(it->second);
+    }
 
-    for (TxSpends::const_iterator it = range.first; it != range.second; ++it) {
-        const uint256&                               wtxid = it->second;
+    for (const uint256& wtxid : vSpenders) {
         std::map<uint256, CWalletTx>::const_iterator mit   = mapWallet.find(wtxid);
         if (mit != mapWallet.end()) {
             bool      fConflicted;
@@ -1840,6 +2199,7 @@ void CWallet::SetTxNTP1OpRet(CTransaction& wtxNew, const std::shared_ptr<NTP1Scr
     }
 
     it->scriptPubKey = CScript() << OP_RETURN << ParseHex(opRetScriptHex);
+    wtxNew.InvalidateHash();
 }
 
 void CWallet::SetTxNTP1OpRet(CTransaction&                                       wtxNew,
@@ -1930,6 +2290,7 @@ CWallet::AddNTP1TokenInputsToTx(CTransaction& wtxNew, const NTP1SendTxData& ntp1
             TIs.push_back(iti.TIs[j]);
         }
     }
+    wtxNew.InvalidateHash();
 
     return TIs;
 }
@@ -1962,6 +2323,7 @@ int CWallet::AddNTP1TokenOutputsToTx(CTransaction& wtxNew, const NTP1SendTxData&
         scriptPubKey.SetDestination(CBitcoinAddress(r.destination).Get());
         wtxNew.vout.push_back(CTxOut(MIN_TX_FEE, scriptPubKey));
     }
+    wtxNew.InvalidateHash();
 
     return tokenOutputsOffset;
 }
@@ -2037,6 +2399,7 @@ bool CWallet::CreateTransaction(const vector<pair<CScript, CAmount>>& vecSend, C
             while (true) {
                 wtxNew.vin.clear();
                 wtxNew.vout.clear();
+                wtxNew.InvalidateHash();
                 wtxNew.fFromMe = true;
 
                 CAmount nTotalValue = nValue + nFeeRet;
@@ -2219,6 +2582,8 @@ bool CWallet::CreateTransaction(const vector<pair<CScript, CAmount>>& vecSend, C
                 if (changeOutputIndex >= 0 && wtxNew.vout[changeOutputIndex].nValue < MIN_TX_FEE) {
                     wtxNew.vout[changeOutputIndex].nValue = MIN_TX_FEE;
                 }
+                // outputs and inputs were added since the hash may have been taken
+                wtxNew.InvalidateHash();
 
                 try {
                     NTP1SendTxData::FixTIsChangeOutputIndex(TIs, changeOutputIndex);
@@ -2994,6 +3359,7 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
         auto it = mapWallet.find(txin.prevout.hash);
         if (it != mapWallet.end()) {
             it->second.MarkDirty();
+            MarkUnspentDirty(it->first);
         }
     }
 }
@@ -3152,6 +3518,7 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
             wtx.nIndex = -1;
             wtx.setAbandoned();
             wtx.MarkDirty();
+            MarkUnspentDirty(now);
             wtx.WriteToDisk(&walletdb);
             NotifyTransactionChanged(this, wtx.GetHash(), CT_UPDATED);
             // Iterate over all its outputs, and mark transactions in the wallet that spend them
@@ -3167,8 +3534,10 @@ bool CWallet::AbandonTransaction(const uint256& hashTx)
             // If a transaction changes 'conflicted' state, that changes the balance
             // available of the outputs it spends. So force those to be recomputed
             for (const CTxIn& txin : wtx.vin) {
-                if (mapWallet.count(txin.prevout.hash))
+                if (mapWallet.count(txin.prevout.hash)) {
                     mapWallet[txin.prevout.hash].MarkDirty();
+                    MarkUnspentDirty(txin.prevout.hash);
+                }
             }
         }
     }
@@ -5,7 +5,9 @@
 #ifndef BITCOIN_WALLET_H
 #define BITCOIN_WALLET_H
 
+#include <boost/atomic.hpp>
 #include <boost/container/flat_map.hpp>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -76,6 +78,22 @@ public:
                         READWRITE(vchPubKey);)
 };
 
+/**
+ * A snapshot of the wallet's keys, scripts and transactions that rescans check block transactions
+ * against without taking any lock. It may match transactions that turn out not to be the wallet's, but
+ * it never misses one that is, as of when it was taken.
+ */
+class CWalletScanFilter
+{
+public:
+    // the ids of the keys and the scripts of the wallet
+    std::set<uint160> setIDs;
+    // the wallet transactions, and those they spend from
+    std::set<uint256> setTxHashes;
+
+    bool IsRelevant(const CTransaction& tx) const;
+};
+
 /** A CWallet is an extension of a keystore, which also maintains a set of transactions and balances,
  * and provides the ability to create new transactions.
  */
@@ -115,6 +133,58 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    /** The wallet transactions that spend the outputs of the given transaction, by output index */
+    std::vector<std::pair<unsigned int, uint256>> GetSpends(const uint256& hash) const;
+
+    /**
+     * Index of the wallet transactions that may have unspent outputs of ours, so that balances and coin
+     * lists don't have to go through the whole of mapWallet. It may hold transactions whose outputs
+     * turned out to be spent, so whoever uses it still checks every output, but it never misses one that
+     * isn't. Transactions whose state changed are marked with MarkUnspentDirty() and are looked at again
+     * by the next UpdateUnspentIndex(); those spent by recent coinstakes, and immature ones, are looked
+     * at again on every new best block, as the wallet doesn't hear about blocks being disconnected.
+     * All of it is protected by cs_wallet.
+     */
+    mutable std::set<uint256> setUnspentIndex;
+    mutable std::set<uint256> setUnspentDirty;
+    mutable std::set<uint256> setUnspentVolatile;
+    mutable uint256           hashUnspentIndexBestChain;
+    mutable bool              fUnspentIndexBuilt;
+    mutable uint64_t          nUnspentIndexGeneration;
+
+    void MarkUnspentDirty(const uint256& hash);
+    bool IsUnspentIndexed(const CWalletTx& wtx, bool& fVolatile) const;
+    void UpdateUnspentIndex() const;
+
+    /** All the balances, computed in one pass over the unspent index */
+    struct CBalances
+    {
+        CAmount nBalance;
+        CAmount nColdStaking;
+        CAmount nDelegated;
+        CAmount nUnconfirmed;
+        CAmount nImmature;
+        CAmount nImmatureColdStaking;
+        CAmount nImmatureDelegated;
+        CAmount nStake;
+        CAmount nNewMint;
+    };
+    // kept until the index, the best chain or the mempool change, unless some lock time may expire
+    mutable boost::optional<CBalances> cachedBalances;
+    mutable bool                       fCachedBalancesFinal;
+    mutable uint64_t                   nBalancesIndexGeneration;
+    mutable uint256                    hashBalancesBestChain;
+    mutable uint32_t                   nBalancesTransactionsUpdated;
+
+    const CBalances& GetBalances() const;
+
+    // rescans run one at a time, and meanwhile the best block is the rescan's progress
+    CCriticalSection    cs_rescan;
+    boost::atomic<bool> fRescanning;
+
+    CWalletScanFilter GetScanFilter() const;
+    int               ScanForWalletTransactionsInBatches(CBlockIndex* pindexStart, bool fUpdate);
+
 public:
     /// Main wallet lock.
     /// This lock protects all the fields added by CWallet
@@ -164,6 +234,13 @@ public:
         pwalletdbEncryption = nullptr;
         nOrderPosNext       = 0;
         nTimeFirstKey       = 0;
+
+        fRescanning                  = false;
+        fUnspentIndexBuilt           = false;
+        nUnspentIndexGeneration      = 0;
+        fCachedBalancesFinal         = false;
+        nBalancesIndexGeneration     = 0;
+        nBalancesTransactionsUpdated = 0;
     }
 
     std::map<uint256, CWalletTx> mapWallet;
@@ -17,6 +17,9 @@ HEADERS += qt/bitcoingui.h \
     base58.h \
     bignum.h \
     checkpoints.h \
+    checkqueue.h \
+    workqueue.h \
+    cuckoocache.h \
     compat.h \
     coincontrol.h \
     sync.h \
@@ -142,9 +145,15 @@ HEADERS += qt/bitcoingui.h \
     SerializationTester.h \
     blockindexcatalog.h   \
     blockindex.h          \
+    blockindexpool.h      \
+    activechain.h         \
+    txdbcache.h           \
+    addressindex.h        \
+    cachedhash.h          \
     outpoint.h            \
     inpoint.h             \
     block.h               \
+    blockdownload.h       \
     transaction.h         \
     globals.h             \
     diskblockindex.h      \
@@ -184,6 +193,7 @@ HEADERS +=                 \
     ntp1/ntp1inpoint.h     \
     ntp1/ntp1outpoint.h    \
     ntp1/ntp1transaction.h \
+    ntp1/ntp1index.h       \
     ntp1/ntp1txin.h        \
     ntp1/ntp1txout.h       \
     ntp1/ntp1tokentxdata.h \
@@ -313,9 +323,14 @@ SOURCES += qt/bitcoin.cpp \
     SerializationTester.cpp \
     blockindexcatalog.cpp \
     blockindex.cpp        \
+    blockindexpool.cpp    \
+    activechain.cpp       \
+    txdbcache.cpp         \
+    addressindex.cpp      \
     outpoint.cpp          \
     inpoint.cpp           \
     block.cpp             \
+    blockdownload.cpp     \
     transaction.cpp       \
     globals.cpp           \
     diskblockindex.cpp    \
@@ -355,6 +370,7 @@ SOURCES +=                   \
     ntp1/ntp1inpoint.cpp     \
     ntp1/ntp1outpoint.cpp    \
     ntp1/ntp1transaction.cpp \
+    ntp1/ntp1index.cpp       \
     ntp1/ntp1txin.cpp        \
     ntp1/ntp1txout.cpp       \
     ntp1/ntp1tokentxdata.cpp \
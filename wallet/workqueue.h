@@ -0,0 +1,84 @@
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+
+/**
+ * A bounded queue of work items, run by a fixed pool of worker threads.
+ *
+ * Enqueue() never blocks: once the queue holds its maximum number of items, new ones are refused, so
+ * that the producer can turn its client away instead of piling up work it can't keep up with. Worker
+ * threads call Run(), which returns when the queue is interrupted.
+ */
+class CWorkQueue
+{
+public:
+    typedef std::function<void()> WorkItem;
+
+private:
+    std::mutex              mutex;
+    std::condition_variable cond;
+    std::deque<WorkItem>    queue;
+    const std::size_t       nMaxDepth;
+    bool                    fRunning;
+
+public:
+    explicit CWorkQueue(std::size_t nMaxDepthIn) : nMaxDepth(nMaxDepthIn), fRunning(true) {}
+
+    CWorkQueue(const CWorkQueue&) = delete;
+    CWorkQueue& operator=(const CWorkQueue&) = delete;
+
+    /** Returns false, and drops the item, if the queue is full or was interrupted */
+    bool Enqueue(WorkItem item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        if (!fRunning || queue.size() >= nMaxDepth)
+            return false;
+        queue.push_back(std::move(item));
+        cond.notify_one();
+        return true;
+    }
+
+    /** Runs queued items until the queue is interrupted. Items must not let exceptions escape. */
+    void Run()
+    {
+        while (true) {
+            WorkItem item;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [this]() { return !fRunning || !queue.empty(); });
+                if (!fRunning)
+                    return;
+                item = std::move(queue.front());
+                queue.pop_front();
+            }
+            item();
+        }
+    }
+
+    /** Workers return once they're done with their current item; items still queued are dropped */
+    void Interrupt()
+    {
+        std::deque<WorkItem> dropped;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            fRunning = false;
+            dropped.swap(queue);
+        }
+        cond.notify_all();
+    }
+
+    std::size_t Depth()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        return queue.size();
+    }
+
+    std::size_t MaxDepth() const { return nMaxDepth; }
+};
+
+#endif // WORKQUEUE_H